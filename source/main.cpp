@@ -19,6 +19,8 @@
 */
 
 #include "qpcv.h"
+#include "qpcv_benchmark.h"
+#include "qpcv_thumbnail.h"
 #include <QtWidgets/QApplication>
 
 int main(int argc, char *argv[])
@@ -35,6 +37,14 @@ int main(int argc, char *argv[])
   fmt.setProfile(QSurfaceFormat::CoreProfile);
   QSurfaceFormat::setDefaultFormat(fmt);
 
+  // The benchmark and the thumbnails render offscreen (no display is needed).
+  // The platform has to be chosen before QApplication is created
+  for (int i = 1; i < argc; i++)
+    if ((strcmp(argv[i], "--benchmark") == 0 || strcmp(argv[i], "--dumpPLY") == 0 ||
+         strcmp(argv[i], "--sendTestStream") == 0 || strcmp(argv[i], "--thumbnails") == 0) &&
+        qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+      qputenv("QT_QPA_PLATFORM", "offscreen");
+
   QApplication app(argc, argv);
   QApplication::setApplicationName("qpcv");
   QApplication::setApplicationVersion("1.0");
@@ -44,17 +54,56 @@ int main(int argc, char *argv[])
   QCommandLineParser  parser;
   parser.addHelpOption();
   parser.addVersionOption();
-  parser.addPositionalArgument("file", QApplication::translate("main", "File to open."));
+  parser.addPositionalArgument("file", QApplication::translate("main", "File to open. Several files or a directory are opened as tiles."), "[file...]");
   parser.addOptions(
   {
-    {"enableTestData", QApplication::translate("main", "Enable the test data generation.")}  // --debug option
+    {"enableTestData", QApplication::translate("main", "Enable the test data generation.")},  // --debug option
+    {"decodeThreads", QApplication::translate("main", "Number of decoder threads (0: all cores)."), "num", "0"},
+    {"outOfCore", QApplication::translate("main", "Open the file in the out-of-core (chunk paging) mode.")},
+    {"vramBudget", QApplication::translate("main", "Draw buffer size of the out-of-core mode in MB."), "MB", "512"},
+    {"hostBudget", QApplication::translate("main", "Chunk cache size of the out-of-core mode in MB."), "MB", "2048"},
+    {"cache", QApplication::translate("main", "Write (and reuse) a decoded sidecar cache of the file.")},
+    {"cacheDir", QApplication::translate("main", "Directory of the sidecar cache (default: next to the file)."), "dir"},
+    {"compact", QApplication::translate("main", "Store the out-of-core chunks as 8 byte quantized points.")},
+    {"benchmark", QApplication::translate("main", "Load the file, render a camera orbit offscreen and print the timings as JSON.")},
+    {"frames", QApplication::translate("main", "Number of frames rendered by --benchmark."), "num", "300"},
+    {"output", QApplication::translate("main", "JSON output file of --benchmark (default: stdout)."), "file"},
+    {"benchmarkLOD", QApplication::translate("main", "Draw the orbit of --benchmark with the LOD of the view (off by default).")},
+    {"generate", QApplication::translate("main", "Generate a synthetic point cloud (k, M and G suffixes are accepted)."), "num"},
+    {"distribution", QApplication::translate("main", "Distribution of --generate: surface, uniform, clustered or scanlines."), "name", "surface"},
+    {"seed", QApplication::translate("main", "Random seed of --generate."), "seed", "0"},
+    {"dumpPLY", QApplication::translate("main", "Write the --generate result as a binary PLY file and exit."), "file"},
+    {"stream", QApplication::translate("main", "Receive live point frames on a local socket."), "name"},
+    {"sendTestStream", QApplication::translate("main", "Send test frames to a qpcv listening with --stream (use --frames to stop)."), "name"},
+    {"streamFPS", QApplication::translate("main", "Frame rate of --sendTestStream."), "fps", "30"},
+    {"sequence", QApplication::translate("main", "Play the PLY sequence the file belongs to (frame_00001.ply ...).")},
+    {"thumbnails", QApplication::translate("main", "Render each file (or each file of a directory) offscreen into a PNG and exit.")},
+    {"fileList", QApplication::translate("main", "Text file listing the files of --thumbnails (one per line)."), "file"},
+    {"size", QApplication::translate("main", "Image size of --thumbnails (e.g. 512 or 1920x1080)."), "WxH", "512x512"},
+    {"tileSize", QApplication::translate("main", "Larger images are rendered in tiles of this size."), "pixels", "2048"},
+    {"outputDir", QApplication::translate("main", "Output directory of --thumbnails (default: next to each file)."), "dir"},
+    {"log", QApplication::translate("main", "Per file timings of --thumbnails (default: stderr)."), "file"},
+    {"prefetch", QApplication::translate("main", "Number of files decoded ahead while rendering."), "num", "1"},
+    {"colorMode", QApplication::translate("main", "Point color of --thumbnails: auto, single, map or file."), "mode", "auto"},
+    {"colorMap", QApplication::translate("main", "Color map of --thumbnails (the names of the color map menu)."), "name"},
+    {"colorMapAxis", QApplication::translate("main", "Color map axis of --thumbnails: x, y or z."), "axis", "z"},
+    {"backdrop", QApplication::translate("main", "Backdrop of --thumbnails: single, blue, darkBlue, gray or darkGray."), "mode", "single"},
+    {"backdropColor", QApplication::translate("main", "Single backdrop color of --thumbnails (e.g. #4c4c4c)."), "color"}
   });
 
   qpcvWindow window;
 
   parser.process(app);
   const QStringList args = parser.positionalArguments();
-  if (args.isEmpty() == false)
+  if (args.size() > 1)
+  {
+    window.mAppOptTileFileList = args;
+  }
+  else if (args.isEmpty() == false && QFileInfo(args[0]).isDir())
+  {
+    window.mAppOptTileFileList = qpcvTileSet::findTileFiles(args[0]);
+  }
+  else if (args.isEmpty() == false)
   {
     window.mAppOptFileNameSpecified = true;
     window.mFileName = args[0];
@@ -63,6 +112,157 @@ int main(int argc, char *argv[])
   {
     window.mAppOptEnaleTestData = true;
   }
+  if (parser.isSet("decodeThreads"))
+  {
+    window.mAppOptDecodeThreadNum = parser.value("decodeThreads").toInt();
+  }
+  if (parser.isSet("outOfCore"))
+  {
+    window.mAppOptOutOfCore = true;
+  }
+  if (parser.isSet("vramBudget"))
+  {
+    window.mAppOptVRAMBudget = (size_t )parser.value("vramBudget").toULongLong() * 1024 * 1024;
+  }
+  if (parser.isSet("hostBudget"))
+  {
+    window.mAppOptHostBudget = (size_t )parser.value("hostBudget").toULongLong() * 1024 * 1024;
+  }
+  if (parser.isSet("cache") || parser.isSet("cacheDir"))
+  {
+    window.mAppOptCache = true;
+    window.mAppOptCacheDir = parser.value("cacheDir");
+  }
+  if (parser.isSet("compact"))
+  {
+    window.mAppOptCompact = true;
+  }
+  if (parser.isSet("generate") || parser.isSet("enableTestData"))
+  {
+    if (parser.isSet("generate"))
+    {
+      window.mAppOptGeneratePointNum = qpcvGenerator::parsePointNum(parser.value("generate"));
+      if (window.mAppOptGeneratePointNum == 0)
+      {
+        std::cerr << "Invalid --generate value" << std::endl;
+        return 1;
+      }
+    }
+    window.mAppOptDistribution = qpcvGenerator::findDistribution(parser.value("distribution"));
+    if (window.mAppOptDistribution < 0)
+    {
+      std::cerr << "Unknown --distribution " << parser.value("distribution").toStdString() << std::endl;
+      return 1;
+    }
+    window.mAppOptSeed = parser.value("seed").toULongLong();
+  }
+  if (parser.isSet("sequence") && window.mAppOptFileNameSpecified)
+  {
+    window.mAppOptFileNameSpecified = false;
+    window.mAppOptSequenceFileName = window.mFileName;
+  }
+  if (parser.isSet("stream"))
+  {
+    window.mAppOptStreamName = parser.value("stream");
+  }
+  if (parser.isSet("sendTestStream"))
+  {
+    qpcvStreamSender  sender;
+    sender.mServerName = parser.value("sendTestStream");
+    sender.mFrameRate = parser.value("streamFPS").toInt();
+    if (parser.isSet("frames"))
+      sender.mFrameNum = parser.value("frames").toInt();
+    return sender.run();
+  }
+  if (parser.isSet("dumpPLY"))
+  {
+    size_t  num = window.mAppOptGeneratePointNum;
+    if (num == 0)
+      num = qpcvGenerator::DEFAULT_POINT_NUM;
+    std::vector<ibc::gl::glXYZf_RGBAub> data(num);
+    qpcvGenerator::generate(data.data(), num, window.mAppOptDistribution,
+                            window.mAppOptSeed, window.mAppOptDecodeThreadNum);
+    if (qpcvGenerator::writePLY(parser.value("dumpPLY"), data.data(), num) == false)
+    {
+      std::cerr << "Can't write " << parser.value("dumpPLY").toStdString() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+  if (parser.isSet("thumbnails"))
+  {
+    qpcvThumbnail thumbnail;
+    for (int i = 0; i < args.size(); i++)
+    {
+      if (QFileInfo(args[i]).isDir())
+        thumbnail.mFileList << qpcvTileSet::findTileFiles(args[i]);
+      else
+        thumbnail.mFileList << args[i];
+    }
+    if (parser.isSet("fileList") &&
+        qpcvThumbnail::readFileList(parser.value("fileList"), &(thumbnail.mFileList)) == false)
+    {
+      std::cerr << "Can't read " << parser.value("fileList").toStdString() << std::endl;
+      return 1;
+    }
+    if (thumbnail.mFileList.isEmpty())
+    {
+      std::cerr << "--thumbnails needs files" << std::endl;
+      return 1;
+    }
+    thumbnail.mTileSize = parser.value("tileSize").toInt();
+    thumbnail.mPrefetchNum = parser.value("prefetch").toInt();
+    thumbnail.mColorMode = qpcvThumbnail::findColorMode(parser.value("colorMode"));
+    thumbnail.mColorMapAxis = QString("xyz").indexOf(parser.value("colorMapAxis").toLower());
+    thumbnail.mBackdropMode = qpcvThumbnail::findBackdropMode(parser.value("backdrop"));
+    if (qpcvThumbnail::parseSize(parser.value("size"),
+                                 &(thumbnail.mWidth), &(thumbnail.mHeight)) == false ||
+        thumbnail.mTileSize <= 0 || thumbnail.mPrefetchNum < 0 ||
+        thumbnail.mColorMode < qpcvThumbnail::COLOR_MODE_AUTO ||
+        thumbnail.mColorMapAxis < 0 || parser.value("colorMapAxis").size() != 1 ||
+        thumbnail.mBackdropMode < 0)
+    {
+      std::cerr << "Invalid --thumbnails option" << std::endl;
+      return 1;
+    }
+    if (parser.isSet("backdropColor"))
+    {
+      QColor  color(parser.value("backdropColor"));
+      if (color.isValid() == false)
+      {
+        std::cerr << "Invalid --backdropColor" << std::endl;
+        return 1;
+      }
+      thumbnail.mBackColor[0] = color.red() / 255.0;
+      thumbnail.mBackColor[1] = color.green() / 255.0;
+      thumbnail.mBackColor[2] = color.blue() / 255.0;
+    }
+    thumbnail.mColorMapName = parser.value("colorMap");
+    thumbnail.mOutputDir = parser.value("outputDir");
+    thumbnail.mLogFileName = parser.value("log");
+    thumbnail.mDecodeThreadNum = window.mAppOptDecodeThreadNum;
+    thumbnail.mIsCacheEnabled = window.mAppOptCache;
+    thumbnail.mCacheDir = window.mAppOptCacheDir;
+    return thumbnail.run();
+  }
+  if (parser.isSet("benchmark"))
+  {
+    if (args.isEmpty())
+    {
+      std::cerr << "--benchmark needs a file" << std::endl;
+      return 1;
+    }
+    qpcvBenchmark benchmark;
+    benchmark.mFileName = args[0];
+    benchmark.mDecodeThreadNum = window.mAppOptDecodeThreadNum;
+    benchmark.mIsCacheEnabled = window.mAppOptCache;
+    benchmark.mCacheDir = window.mAppOptCacheDir;
+    if (parser.isSet("frames"))
+      benchmark.mFrameNum = parser.value("frames").toInt();
+    benchmark.mOutputFileName = parser.value("output");
+    benchmark.mIsLODEnabled = parser.isSet("benchmarkLOD");
+    return benchmark.run();
+  }
 
   window.show();
   return app.exec();
@@ -34,7 +34,27 @@
 #include <math.h>
 #include <QtWidgets/QMainWindow>
 #include <QFileDialog>
+#include <QProgressBar>
+#include <QToolButton>
+#include <QElapsedTimer>
+#include <QMessageBox>
+#include <QListWidget>
+#include <QInputDialog>
 #include "ui_qpcv.h"
+#include "qpcv_loader.h"
+#include "qpcv_bounds.h"
+#include "qpcv_gl_view.h"
+#include "qpcv_chunk_store.h"
+#include "qpcv_chunk_pager.h"
+#include "qpcv_generator.h"
+#include "qpcv_tile_set.h"
+#include "qpcv_stream.h"
+#include "qpcv_sequence.h"
+#include "qpcv_spatial_index.h"
+#include "qpcv_histogram.h"
+#include "qpcv_histogram_view.h"
+#include "qpcv_filter_pipeline.h"
+#include "qpcv_ply_writer.h"
 // ibc related includes
 #include "ibc/qt/gl_point_cloud_view.h"
 #include "ibc/base/log.h"
@@ -71,6 +91,13 @@ Q_OBJECT
       BACKDROP_COLOR_MODE_DARK_GRAY
     };
 
+    enum  FilterStage
+    {
+      FILTER_STAGE_CROP   = 0,
+      FILTER_STAGE_OUTLIER,
+      FILTER_STAGE_DOWNSAMPLE
+    };
+
 public:
   // Constructors and Destructor -----------------------------------------------
   // ---------------------------------------------------------------------------
@@ -83,11 +110,44 @@ public:
     mAppInitCalled = false;
     mAppOptFileNameSpecified = false;
     mAppOptEnaleTestData = false;
+    mAppOptDecodeThreadNum = 0;
+    mAppOptOutOfCore = false;
+    mAppOptVRAMBudget = 0;
+    mAppOptHostBudget = 0;
+    mAppOptCache = false;
+    mAppOptCompact = false;
+    mAppOptGeneratePointNum = 0;
+    mAppOptDistribution = qpcvGenerator::DISTRIBUTION_SURFACE;
+    mAppOptSeed = 0;
 
     // Initialize data related variables
     mData = NULL;
+    mDataFile = NULL;
     mDataNum = 0;
-    mGLView = new ibc::qt::GLPointCloudView();
+    mGLView = new qpcvGLView();
+    mLoader = NULL;
+    mGenerateJob = NULL;
+    mStoreBuilder = NULL;
+    mPager = NULL;
+    mTileSet = NULL;
+    mTileComposer = NULL;
+    mIsTileComposePending = false;
+    mTileComposeTime = 0;
+    mStream = NULL;
+    mSequence = NULL;
+    mIndexBuilder = NULL;
+    mSpatialIndex = NULL;
+    mHistogramView = NULL;
+    mRangeJob = NULL;
+    mAttributeStore = NULL;
+    mAttributeDecoder = NULL;
+    mCropFilter = NULL;
+    mOutlierFilter = NULL;
+    mDownsampleFilter = NULL;
+    mFilterJob = NULL;
+    mFilterData = NULL;
+    mFilterNum = 0;
+    mSaveJob = NULL;
 
     // Initialize background related variables
     mBackColor[0] = 0.3f;
@@ -104,47 +164,151 @@ public:
     initColorMapUI();
     initDataParamUI();
     initDisplaySettingUI();
+    initLoadProgressUI();
+    initTileUI();
+    initStreamUI();
+    initSequenceUI();
+    initFilterUI();
+
+    connect(mGLView, &qpcvGLView::pickChanged,
+            this,
+            [=](const QString &inText)
+            {
+              statusBar()->showMessage(inText);
+            });
   }
   // ---------------------------------------------------------------------------
   // ~qpcvWindow
   // ---------------------------------------------------------------------------
   virtual ~qpcvWindow()
   {
-    if (mData != NULL)
-      delete mData;
+    if (mLoader != NULL)
+      delete mLoader;
+    releaseGenerateJob();
+    if (mStoreBuilder != NULL)
+      delete mStoreBuilder;
+    releaseTileComposer();
+    if (mTileSet != NULL)
+      delete mTileSet;
+    releaseData();
   }
   // Member variables ----------------------------------------------------------
   bool  mAppOptFileNameSpecified;
   bool  mAppOptEnaleTestData;
+  int   mAppOptDecodeThreadNum;
+  bool  mAppOptOutOfCore;
+  size_t  mAppOptVRAMBudget;   // bytes (0 : qpcvChunkPager default)
+  size_t  mAppOptHostBudget;   // bytes (0 : qpcvChunkPager default)
+  bool  mAppOptCache;
+  QString mAppOptCacheDir;     // Empty : the cache is written next to the file
+  bool  mAppOptCompact;        // qpcvCompactPoint chunks in the out-of-core mode
+  size_t  mAppOptGeneratePointNum;  // 0 : no synthetic data unless mAppOptEnaleTestData
+  int   mAppOptDistribution;   // qpcvGenerator::Distribution
+  quint64 mAppOptSeed;
+  QStringList mAppOptTileFileList;  // Not empty : open these files as tiles
+  QString mAppOptStreamName;   // Not empty : receive a live stream on this socket
+  QString mAppOptSequenceFileName;  // Not empty : play the sequence of this frame
   QString mFileName;
 
 protected:
   // Member variables ----------------------------------------------------------
   bool  mAppInitCalled;
-  ibc::qt::GLPointCloudView *mGLView;
+  qpcvGLView  *mGLView;
   ibc::gl::glXYZf_RGBAub *mData;
+  QFile *mDataFile;   // Not NULL when mData points into a file mapping
   size_t  mDataNum;
+  std::vector<size_t> mLevelEndTable;   // qpcvLOD levels of mData (empty : none)
 
   bool  mHasColorData;
+  std::vector<uint32_t> mFaceIndex;   // Triangle list into mData (empty : no mesh)
+  std::string mColorFormatStr;  // As reported on load (empty : no color)
 
   ibc::image::ColorMap::ColorMapIndex mColorMapIndex;
   std::vector<ibc::image::ColorMap::ColorMapIndex>  mColorMapIndexTable;
 
   GLfloat mParam[4], mMinMax[6];
+
   double  mColorMapFrom;
   double  mColorMapTo;
+  qpcvHistogram mHistogram;   // Of mData (no counts when it is not available)
+  qpcvHistogramView *mHistogramView;
+  qpcvPercentileRangeJob  *mRangeJob;   // "Auto" of the color map range
+  qpcvAttributeStore  *mAttributeStore;   // Other properties of mData (NULL : none)
+  qpcvAttributeDecoder  *mAttributeDecoder;
+
+  qpcvLoader  *mLoader;
+  qpcvGenerateJob *mGenerateJob;
+  QElapsedTimer mLoadTimer;
+  QProgressBar  *mLoadProgressBar;
+  QLabel  *mLoadStatusLabel;
+  QToolButton *mLoadCancelButton;
+
+  // Out-of-core mode (mData is not used, the chunks are drawn by the view)
+  static const size_t STORE_WRITE_BUFFER_SIZE = 256 * 1024 * 1024;
+  qpcvChunkStoreBuilder *mStoreBuilder;
+  qpcvChunkPager  *mPager;
+
+  // Tiled data set (mData is the composed copy of the visible tiles)
+  static const int  TILE_COMPOSE_MIN_INTERVAL_MSEC = 200;
+  qpcvTileSet *mTileSet;
+  qpcvTileComposer  *mTileComposer;
+  bool  mIsTileComposePending;   // Composed again when mTileComposer finishes
+  QTimer  mTileComposeTimer;
+  qint64  mTileComposeTime;
+
+  // Live stream (mData is owned by mStream then)
+  static const int  STREAM_STATS_INTERVAL_MSEC = 1000;
+  qpcvStreamReceiver  *mStream;
+  bool  mStreamIsFitted;
+  qint64  mStreamPendingTime;   // Receive time of the frame waiting for display (-1 : none)
+  quint64 mStreamDisplayedNum;
+  double  mStreamLatencySum;
+  double  mStreamLatencyMax;
+  QTimer  mStreamStatsTimer;
+  QElapsedTimer mStreamStatsClock;
+
+  // PLY sequence (mData is owned by mSequence then)
+  qpcvSequencePlayer  *mSequence;
+  QTimer  mSequenceTimer;
+  int mSequenceFrame;         // Displayed frame (-1 : none yet)
+  int mSequenceTargetFrame;   // Frame to be displayed as soon as it is decoded
+  bool  mSequenceIsFitted;
+  int mSequenceShownNum;      // Since the last status update
+  int mSequenceLateNum;       // Timer ticks where the next frame was not decoded yet
+  QElapsedTimer mSequenceStatsClock;
+
+  // Spatial index of mData for picking (built on a worker thread after a load)
+  qpcvSpatialIndexBuilder *mIndexBuilder;
+  qpcvSpatialIndex  *mSpatialIndex;
+
+  // Filters on mData (crop box -> outliers -> downsampling). The result is
+  // shown instead of mData unless "Show original" is checked
+  qpcvFilterPipeline  mFilterPipeline;
+  qpcvCropFilter  *mCropFilter;   // The filters are owned by mFilterPipeline
+  qpcvOutlierFilter *mOutlierFilter;
+  qpcvDownsampleFilter  *mDownsampleFilter;
+  qpcvFilterJob *mFilterJob;
+  ibc::gl::glXYZf_RGBAub *mFilterData;   // Owned by mFilterPipeline
+  size_t  mFilterNum;
+  std::vector<size_t> mFilterLevelEndTable;
+  qpcvHistogram mFilterHistogram;   // Of mFilterData (built by the first mRangeJob on it)
+
+  // "Save As" of the shown data (mData or the filter result)
+  qpcvPLYWriterJob  *mSaveJob;
 
   // Member functions ----------------------------------------------------------
   // ---------------------------------------------------------------------------
   // openFile
   // ---------------------------------------------------------------------------
-  bool openFile(bool *outIsCanceled)
+  bool openFile(bool *outIsCanceled, bool inOutOfCore = false)
   {
     QString fileName = QFileDialog::getOpenFileName(
                                         this,
-                                        tr("Open PLY file"),
+                                        tr("Open point cloud file"),
                                         "",
-                                        tr("PLY File (*.ply);;All Files (*)"));
+                                        tr("Point Cloud Files (*.ply *.ply.gz *.ply.zst *.pcd *.xyz *.xyzrgb);;"
+                                           "PLY File (*.ply *.ply.gz *.ply.zst);;PCD File (*.pcd);;"
+                                           "XYZ File (*.xyz *.xyzrgb *.txt);;All Files (*)"));
     if (fileName == "")
     {
       *outIsCanceled = true;
@@ -152,45 +316,137 @@ protected:
     }
 
     *outIsCanceled = false;
+    if (inOutOfCore)
+      return openOutOfCore(fileName);
     return readPLY(fileName.toStdString().c_str());
   }
   // ---------------------------------------------------------------------------
   // readPLY
   // ---------------------------------------------------------------------------
+  // Starts loading the file on a worker thread and returns immediately.
+  // The current data stays displayed until the new one is ready (see applyLoadResult())
   bool  readPLY(const char *inFileName)
   {
-    ibc::gl::file::PLYHeader  *header;
-    unsigned char *fileDataPtr;
-    size_t  fileDataSize;
-    char  *headerStrBufPtr = NULL;
+    cancelLoad();
 
-    if (mData != NULL)
-    {
-      delete mData;
-      mData = NULL;
-      mDataNum = 0;
-    }
-    if (ibc::gl::file::PLYFile::readHeader(inFileName, &header, &fileDataPtr,
-                                       &fileDataSize, &headerStrBufPtr) == false)
+    mLoader = new qpcvLoader(QString(inFileName), mAppOptDecodeThreadNum,
+                             qpcvLoader::DEFAULT_LOD_MIN_POINT_NUM, this);
+    mLoader->setCache(mAppOptCache, mAppOptCacheDir);
+    connect(mLoader, &qpcvLoader::progressChanged,
+            this,
+            [=](int inStage, qint64 inDoneBytes, qint64 inTotalBytes)
+            {
+              updateLoadProgressUI(inStage, inDoneBytes, inTotalBytes);
+            });
+    connect(mLoader, &QThread::finished,
+            this,
+            [=]()
+            {
+              loadFinished();
+            });
+
+    QFileInfo fileInfo(mLoader->getFileName());
+    mLoadStatusLabel->setText(QString("Loading %1").arg(fileInfo.fileName()));
+    mLoadProgressBar->setValue(0);
+    mLoadProgressBar->setVisible(true);
+    mLoadStatusLabel->setVisible(true);
+    mLoadCancelButton->setVisible(true);
+    mLoadTimer.start();
+    mLoader->start();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // cancelLoad
+  // ---------------------------------------------------------------------------
+  void  cancelLoad()
+  {
+    releaseGenerateJob();
+    if (mTileSet != NULL)
     {
-      return false;
+      // The tiles loaded so far stay displayed (mData is a copy)
+      mTileComposeTimer.stop();
+      releaseTileComposer();
+      delete mTileSet;
+      mTileSet = NULL;
+      mUI.mTileList->clear();
+      hideLoadProgressUI();
     }
-    //header->debugDumpHeader(&std::cout);
-    if (ibc::gl::file::PLYFile::get_glXYZf_RGBAub(*header, fileDataPtr, fileDataSize,
-                                                 &mData, &mDataNum) == false)
+    if (mLoader == NULL && mStoreBuilder == NULL)
+      return;
+    // Do not wait for the worker here (that would block the GUI thread).
+    // The worker deletes itself when the current stage is done
+    QThread *worker = mLoader;
+    if (worker == NULL)
+      worker = mStoreBuilder;
+    mLoader = NULL;
+    mStoreBuilder = NULL;
+    worker->disconnect(this);
+    worker->requestInterruption();
+    if (worker->isFinished())
+      delete worker;
+    else
+      connect(worker, &QThread::finished, worker, &QObject::deleteLater);
+    hideLoadProgressUI();
+  }
+  // ---------------------------------------------------------------------------
+  // loadFinished
+  // ---------------------------------------------------------------------------
+  void  loadFinished()
+  {
+    qpcvLoader  *loader = mLoader;
+    mLoader = NULL;
+    hideLoadProgressUI();
+    if (loader == NULL)
+      return;
+
+    qpcvLoadResult  *result = loader->takeResult();
+    bool  isCanceled = loader->isCanceled();
+    QString errorStr = loader->getErrorStr();
+    loader->deleteLater();
+    if (result == NULL)
     {
-      delete header;
-      return false;
+      if (isCanceled)
+      {
+        statusBar()->showMessage(tr("Loading canceled"), 3000);
+        return;
+      }
+      std::cerr << "Failed to load: " << errorStr.toStdString() << std::endl;
+      statusBar()->showMessage(tr("Failed to load the file"));
+      QMessageBox::critical(this, tr("qpcv"),
+                            tr("Failed to load the file.\n%1").arg(errorStr));
+      return;
     }
-    ibc::gl::file::PLYFile::calcFitParam_glXYZf_RGBAub(mData, mDataNum, mParam, mMinMax);
-    mGLView->mDataModel.setDataPtr((float *)mData, mDataNum);
-    mGLView->mDataModel.setModelFitParam(mParam);
+    applyLoadResult(result);
+    delete result;
+  }
+  // ---------------------------------------------------------------------------
+  // applyLoadResult
+  // ---------------------------------------------------------------------------
+  void  applyLoadResult(qpcvLoadResult *inResult)
+  {
+    releaseData();
+    mDataNum = inResult->dataNum;
+    mData = inResult->takeData(&mDataFile);
+    for (int i = 0; i < 4; i++)
+      mParam[i] = inResult->param[i];
+    for (int i = 0; i < 6; i++)
+      mMinMax[i] = inResult->minMax[i];
+
+    mLevelEndTable = inResult->lodLevelEndTable;
+    mFaceIndex.swap(inResult->faceIndex);
+    mGLView->setPointData(mData, mDataNum, mLevelEndTable);
+    mGLView->setMeshData(mFaceIndex.data(), mFaceIndex.size() / 3);
+    if (mGLView->hasMesh())
+      mGLView->setRenderMode(qpcvGLView::RENDER_MODE_SHADED);
+    mGLView->setModelFitParam(mParam);
     mGLView->mDataModel.setColorMapAxis(2);
     mColorMapFrom = mMinMax[4];
     mColorMapTo   = mMinMax[5];
     calcColorMapParams();
+    mHistogram = inResult->histogram;
+    mAttributeStore = inResult->takeAttributeStore();
 
-    QString fileName(inFileName);
+    QString fileName(inResult->fileName.c_str());
     QFileInfo fileInfo(fileName);
 
     mUI.mFileName->setText(fileInfo.fileName());
@@ -200,8 +456,8 @@ protected:
     mUI.mFileModified->setText(fileInfo.lastModified().toString());
     //
     mUI.mPLYPointsNum->setText(QString("%1").arg(mDataNum));
-    std::string str = header->getColorFormatStr(ibc::gl::file::PLYHeader::ELEMENT_TYPE_VERTEX);
-    if (str.size() == 0)
+    mColorFormatStr = inResult->colorFormatStr;
+    if (inResult->colorFormatStr.size() == 0)
     {
       mHasColorData = false;
       mGLView->mDataModel.setColorMode(POINT_COLOR_MODE_MAP);
@@ -211,15 +467,23 @@ protected:
     {
       mHasColorData = true;
       mGLView->mDataModel.setColorMode(POINT_COLOR_MODE_FILE);
-      mUI.mPLYPointColor->setText(QString(str.c_str()));
+      mUI.mPLYPointColor->setText(QString(inResult->colorFormatStr.c_str()));
     }
-    str = header->getFormatStr();
-    mUI.mPLYFormat->setText(QString(str.c_str()));
-    size_t  index;
-    if (header->findElementIndex(ibc::gl::file::PLYHeader::ELEMENT_TYPE_FACE, &index) == false)
+    mUI.mPLYFormat->setText(QString(inResult->formatStr.c_str()));
+    if (inResult->hasFace == false)
       mUI.mPLYFace->setText(QString("none"));
+    else if (inResult->faceErrorStr.size() != 0)
+    {
+      std::cerr << "Faces are not drawn: " << inResult->faceErrorStr << std::endl;
+      mUI.mPLYFace->setText(QString("%1 faces (not drawn: %2)")
+                              .arg(inResult->faceNum).arg(inResult->faceErrorStr.c_str()));
+    }
+    else if (mGLView->hasMesh() == false)
+      mUI.mPLYFace->setText(QString("has face data (not drawn)"));
     else
-      mUI.mPLYFace->setText(QString("has face data"));
+      mUI.mPLYFace->setText(QString("%1 faces (%2 triangles)")
+                              .arg(inResult->faceNum).arg(mGLView->getMeshTriangleNum()));
+    mUI.mPLYQuantization->setText(QString("none"));
 
     mUI.mPLYXMin->setText(QString("%1").arg(mMinMax[0]));
     mUI.mPLYXMax->setText(QString("%1").arg(mMinMax[1]));
@@ -227,61 +491,1073 @@ protected:
     mUI.mPLYYMax->setText(QString("%1").arg(mMinMax[3]));
     mUI.mPLYZMin->setText(QString("%1").arg(mMinMax[4]));
     mUI.mPLYZMax->setText(QString("%1").arg(mMinMax[5]));
-    mUI.mPLYHeader->setPlainText(QString(headerStrBufPtr));
+    mUI.mPLYHeader->setPlainText(QString(inResult->headerStr.c_str()));
 
     updatePointColorModeUI();
     updateColorMapUI();
     updateDataParamUI();
+    updateRenderModeUI();
+    fitCropBox();
+    updateFilterUI();
+    startSpatialIndex();
+
+    double  sec = mLoadTimer.elapsed() / 1000.0;
+    if (inResult->isFromCache)
+      statusBar()->showMessage(
+        QString("Loaded %1 points in %2 sec from the cache (%3 ms)")
+          .arg(mDataNum).arg(sec, 0, 'f', 2).arg(inResult->cacheTime), 10000);
+    else
+      statusBar()->showMessage(
+        QString("Loaded %1 points in %2 sec (header %3 ms, decode %4 ms, faces %5 ms, bounds %6 ms, LOD %7 ms, histogram %8 ms, cache %9 ms)")
+          .arg(mDataNum).arg(sec, 0, 'f', 2)
+          .arg(inResult->headerTime).arg(inResult->decodeTime).arg(inResult->faceTime)
+          .arg(inResult->boundsTime).arg(inResult->lodTime).arg(inResult->histogramTime)
+          .arg(inResult->cacheTime), 10000);
+    QStringList hudInfo;
+    hudInfo << QString("Host data %1 MB%2")
+                 .arg(mDataNum * sizeof(ibc::gl::glXYZf_RGBAub) / (1024 * 1024))
+                 .arg(inResult->isFromCache ? " (mapped cache)" : "");
+    hudInfo << QString("Load header %1 / decode %2 / bounds %3 / LOD %4 / histogram %5 / cache %6 ms")
+                 .arg(inResult->headerTime).arg(inResult->decodeTime).arg(inResult->boundsTime)
+                 .arg(inResult->lodTime).arg(inResult->histogramTime).arg(inResult->cacheTime);
+    if (mGLView->hasMesh())
+    {
+      hudInfo << QString("Mesh %1 triangles, index buffer %2 MB")
+                   .arg(mGLView->getMeshTriangleNum())
+                   .arg(mFaceIndex.size() * sizeof(uint32_t) / (1024 * 1024));
+      if (inResult->faceACMR[1] > 0)
+        hudInfo << QString("Faces %1 ms, vertex cache ACMR %2 -> %3")
+                     .arg(inResult->faceTime)
+                     .arg(inResult->faceACMR[0], 0, 'f', 2).arg(inResult->faceACMR[1], 0, 'f', 2);
+    }
+    mGLView->setHUDInfo(hudInfo);
+    mGLView->update();
+  }
+  // ---------------------------------------------------------------------------
+  // releaseData
+  // ---------------------------------------------------------------------------
+  void  releaseData()
+  {
+    releaseRangeJob();
+    releaseSpatialIndex();
+    releaseSaveJob();
+    releaseFilterData();
+    if (mSequence != NULL)
+    {
+      mSequenceTimer.stop();
+      delete mSequence;
+      mSequence = NULL;
+      mData = NULL;
+      mUI.mSequencePlay->setChecked(false);
+    }
+    if (mStream != NULL)
+    {
+      mStreamStatsTimer.stop();
+      mGLView->setStreamFrame(NULL, 0);
+      delete mStream;
+      mStream = NULL;
+      mData = NULL;
+    }
+    if (mPager != NULL)
+    {
+      delete mPager;
+      mPager = NULL;
+      mData = NULL;
+      mGLView->setChunkStore(NULL, 0);
+    }
+    if (mDataFile != NULL)
+    {
+      delete mDataFile;
+      mDataFile = NULL;
+    }
+    else if (mData != NULL)
+      delete [] mData;
+    mData = NULL;
+    mDataNum = 0;
+    mLevelEndTable.clear();
+    mGLView->setMeshData(NULL, 0);
+    std::vector<uint32_t>().swap(mFaceIndex);
+    updateRenderModeUI();
+    mColorFormatStr.clear();
+    mHistogram.clear();
+    releaseAttributeDecoder();
+    if (mAttributeStore != NULL)
+    {
+      delete mAttributeStore;
+      mAttributeStore = NULL;
+    }
+    mGLView->setScalarAttribute(-1);
+    updateColorMapAxisUI();
+    updateHistogramUI();
+    updateFilterUI();
+  }
+  // ---------------------------------------------------------------------------
+  // startSpatialIndex
+  // ---------------------------------------------------------------------------
+  // Picking is enabled when the index is ready (the data must stay until
+  // releaseSpatialIndex() is called, see releaseData())
+  void  startSpatialIndex()
+  {
+    releaseSpatialIndex();
+    if (mData == NULL || mDataNum == 0)
+      return;
+    mUI.mPLYIndex->setText(tr("building..."));
+    mIndexBuilder = new qpcvSpatialIndexBuilder(mData, mDataNum, mMinMax,
+                                                mAppOptDecodeThreadNum, this);
+    connect(mIndexBuilder, &QThread::finished,
+            this,
+            [=]()
+            {
+              qpcvSpatialIndexBuilder *builder = mIndexBuilder;
+              mIndexBuilder = NULL;
+              mSpatialIndex = builder->takeIndex();
+              if (mSpatialIndex != NULL)
+              {
+                const int *dim = mSpatialIndex->getGridDim();
+                mUI.mPLYIndex->setText(
+                  QString("grid %1x%2x%3, %4 MB, %5 ms")
+                    .arg(dim[0]).arg(dim[1]).arg(dim[2])
+                    .arg(mSpatialIndex->getMemorySize() / (1024.0 * 1024.0), 0, 'f', 1)
+                    .arg(builder->getBuildTime()));
+                if (isFilterDataShown() == false)
+                  mGLView->setSpatialIndex(mSpatialIndex);
+              }
+              else
+                mUI.mPLYIndex->setText(tr("none"));
+              builder->deleteLater();
+            });
+    mIndexBuilder->start();
+  }
+  // ---------------------------------------------------------------------------
+  // releaseSpatialIndex
+  // ---------------------------------------------------------------------------
+  // Waits for a running build (it stops at the next block)
+  void  releaseSpatialIndex()
+  {
+    mGLView->setSpatialIndex(NULL);
+    if (mIndexBuilder != NULL)
+    {
+      mIndexBuilder->disconnect(this);
+      delete mIndexBuilder;
+      mIndexBuilder = NULL;
+    }
+    if (mSpatialIndex != NULL)
+    {
+      delete mSpatialIndex;
+      mSpatialIndex = NULL;
+    }
+    mUI.mPLYIndex->setText(tr("none"));
+  }
+  // ---------------------------------------------------------------------------
+  // canFilterData
+  // ---------------------------------------------------------------------------
+  // Only the whole in-core data can be filtered (not the paged, streamed or
+  // sequence data, which is replaced all the time)
+  bool  canFilterData() const
+  {
+    return (mData != NULL && mDataNum != 0 &&
+            mPager == NULL && mStream == NULL && mSequence == NULL);
+  }
+  // ---------------------------------------------------------------------------
+  // startFilter
+  // ---------------------------------------------------------------------------
+  // Only the stages whose parameters (or inputs) changed since the last run
+  // are computed. The current data stays displayed until the result is ready
+  void  startFilter()
+  {
+    if (canFilterData() == false || mFilterJob != NULL)
+      return;
+    double  box[6] =
+    {
+      mUI.mCropXMin->value(), mUI.mCropXMax->value(),
+      mUI.mCropYMin->value(), mUI.mCropYMax->value(),
+      mUI.mCropZMin->value(), mUI.mCropZMax->value()
+    };
+    mCropFilter->setBox(box);
+    mOutlierFilter->setParam(mUI.mOutlierNeighbors->value(), mUI.mOutlierStdRatio->value());
+    mDownsampleFilter->setParam(mUI.mVoxelSize->value(), mUI.mVoxelMode->currentIndex());
+    mFilterPipeline.setEnabled(FILTER_STAGE_CROP, mUI.mCropEnable->isChecked());
+    mFilterPipeline.setEnabled(FILTER_STAGE_OUTLIER, mUI.mOutlierEnable->isChecked());
+    mFilterPipeline.setEnabled(FILTER_STAGE_DOWNSAMPLE, mUI.mVoxelEnable->isChecked());
+    if (mFilterPipeline.hasInput() == false)
+      mFilterPipeline.setInput(mData, mDataNum, mMinMax);
 
-    delete headerStrBufPtr;
-    delete fileDataPtr;
-    delete header;
+    mFilterJob = new qpcvFilterJob(&mFilterPipeline, mAppOptDecodeThreadNum,
+                                   qpcvLoader::DEFAULT_LOD_MIN_POINT_NUM, this);
+    connect(mFilterJob, &qpcvFilterJob::progressChanged,
+            this,
+            [=](int inStage, int inPercent)
+            {
+              QString name = tr("LOD");
+              if (inStage < mFilterPipeline.getStageNum())
+                name = mFilterPipeline.getFilter(inStage)->getName();
+              mUI.mFilterStatus->setText(QString("%1... %2 %").arg(name).arg(inPercent));
+            });
+    connect(mFilterJob, &QThread::finished,
+            this,
+            [=]()
+            {
+              qpcvFilterJob *job = mFilterJob;
+              mFilterJob = NULL;
+              if (job->isSucceeded() == false)
+              {
+                // The view keeps the previous result
+                QString str = job->getErrorStr();
+                mUI.mFilterStatus->setText(str.isEmpty() ? tr("canceled") : str);
+              }
+              else
+              {
+                // The previous result is released below
+                releaseRangeJob();
+                mFilterHistogram.clear();
+                mFilterData = mFilterPipeline.getResult(&mFilterNum, &mFilterLevelEndTable);
+                updateFilterStatus(job->getTime());
+                showFilterData(mUI.mFilterShowOriginal->isChecked() == false);
+                mFilterPipeline.releaseGarbage();
+              }
+              job->deleteLater();
+              updateFilterUI();
+            });
+    mUI.mFilterStatus->setText(tr("filtering..."));
+    mFilterJob->start();
+    updateFilterUI();
+  }
+  // ---------------------------------------------------------------------------
+  // updateFilterStatus
+  // ---------------------------------------------------------------------------
+  void  updateFilterStatus(qint64 inTime)
+  {
+    if (mFilterData == NULL)
+    {
+      mUI.mFilterStatus->setText(tr("No filter enabled"));
+      return;
+    }
+    QString str;
+    for (int i = 0; i < mFilterPipeline.getStageNum(); i++)
+    {
+      if (mFilterPipeline.isEnabled(i) == false)
+        continue;
+      size_t  num;
+      qint64  time;
+      bool  isReused;
+      mFilterPipeline.getStageResult(i, &num, &time, &isReused);
+      str += QString("%1: %2 points, %3\n")
+               .arg(mFilterPipeline.getFilter(i)->getName()).arg(num)
+               .arg(isReused ? tr("cached") : QString("%1 ms").arg(time));
+    }
+    str += QString("%1 % of %2 points in %3 ms")
+             .arg(100.0 * mFilterNum / mDataNum, 0, 'f', 2).arg(mDataNum).arg(inTime);
+    mUI.mFilterStatus->setText(str);
+  }
+  // ---------------------------------------------------------------------------
+  // releaseFilterData
+  // ---------------------------------------------------------------------------
+  // Waits for a running job (it stops at the next block). Like mData, the
+  // caller makes sure the view does not show mFilterData any more
+  void  releaseFilterData()
+  {
+    releaseRangeJob();
+    mFilterHistogram.clear();
+    if (mFilterJob != NULL)
+    {
+      mFilterJob->disconnect(this);
+      delete mFilterJob;
+      mFilterJob = NULL;
+    }
+    mFilterPipeline.setInput(NULL, 0, NULL);
+    mFilterData = NULL;
+    mFilterNum = 0;
+    mFilterLevelEndTable.clear();
+    mUI.mFilterStatus->setText("");
+  }
+  // ---------------------------------------------------------------------------
+  // isFilterDataShown
+  // ---------------------------------------------------------------------------
+  bool  isFilterDataShown() const
+  {
+    return (mFilterData != NULL && mUI.mFilterShowOriginal->isChecked() == false);
+  }
+  // ---------------------------------------------------------------------------
+  // showFilterData
+  // ---------------------------------------------------------------------------
+  // Switches the view between the filter result and the original. Picking
+  // is only available on the original (the spatial index is built on it)
+  void  showFilterData(bool inIsFilterData)
+  {
+    if (canFilterData() == false)
+      return;
+    releaseRangeJob();
+    releaseAttributeDecoder();
+    // The attributes are read for the original points only (and dropped by
+    // setPointData()), so the color map goes back to the z axis
+    bool  isScalarShown = (mGLView->getScalarAttribute() >= 0);
+    // The filters work on the points only, so the result has no mesh
+    if (inIsFilterData && mFilterData != NULL)
+    {
+      mGLView->setSpatialIndex(NULL);
+      mGLView->setPointData(mFilterData, mFilterNum, mFilterLevelEndTable);
+    }
+    else
+    {
+      mGLView->setPointData(mData, mDataNum, mLevelEndTable);
+      mGLView->setMeshData(mFaceIndex.data(), mFaceIndex.size() / 3);
+      mGLView->setSpatialIndex(mSpatialIndex);
+    }
+    if (isScalarShown)
+      selectColorMapAxis(2);
+    updateColorMapAxisUI();
+    updateRenderModeUI();
+    mGLView->update();
+  }
+  // ---------------------------------------------------------------------------
+  // fitCropBox
+  // ---------------------------------------------------------------------------
+  void  fitCropBox()
+  {
+    QDoubleSpinBox  *spinBoxTable[6] =
+    {
+      mUI.mCropXMin, mUI.mCropXMax,
+      mUI.mCropYMin, mUI.mCropYMax,
+      mUI.mCropZMin, mUI.mCropZMax
+    };
+    for (int i = 0; i < 6; i++)
+      spinBoxTable[i]->setValue(mMinMax[i]);
+  }
+  // ---------------------------------------------------------------------------
+  // startSave
+  // ---------------------------------------------------------------------------
+  // Saves the shown data (the filter result unless "Show Original" is
+  // checked) with the color properties of the loaded file. Filtering is
+  // disabled until the job finishes, since it may free the shown result
+  void  startSave(const QString &inFileName, int inFormat)
+  {
+    if (canFilterData() == false || mFilterJob != NULL || mSaveJob != NULL)
+      return;
+    ibc::gl::glXYZf_RGBAub  *data = mData;
+    size_t  num = mDataNum;
+    if (isFilterDataShown())
+    {
+      data = mFilterData;
+      num = mFilterNum;
+    }
+    std::vector<qpcvPLYWriter::ColorProperty> colorTable;
+    if (mHasColorData &&
+        qpcvPLYWriter::parseColorFormatStr(mColorFormatStr, &colorTable) == false)
+      colorTable = qpcvPLYWriter::getDefaultColorProperties();
+
+    mSaveJob = new qpcvPLYWriterJob(inFileName, data, num, inFormat, colorTable,
+                                    mAppOptDecodeThreadNum, this);
+    connect(mSaveJob, &qpcvPLYWriterJob::progressChanged,
+            this,
+            [=](int inPercent)
+            {
+              statusBar()->showMessage(QString("Saving... %1 %").arg(inPercent));
+            });
+    connect(mSaveJob, &QThread::finished,
+            this,
+            [=]()
+            {
+              qpcvPLYWriterJob  *job = mSaveJob;
+              mSaveJob = NULL;
+              if (job->isSucceeded())
+              {
+                double  sec = job->getTime() / 1000.0;
+                double  mb = QFileInfo(job->getFileName()).size() / (1024.0 * 1024.0);
+                statusBar()->showMessage(
+                  QString("Saved %1 (%2 MB) in %3 sec (%4 MB/s)")
+                    .arg(job->getFileName()).arg(mb, 0, 'f', 1).arg(sec, 0, 'f', 2)
+                    .arg(sec > 0 ? mb / sec : 0, 0, 'f', 0), 10000);
+              }
+              else
+              {
+                statusBar()->clearMessage();
+                QMessageBox::critical(this, tr("qpcv"),
+                                      tr("Failed to write %1\n%2")
+                                        .arg(job->getFileName()).arg(job->getErrorStr()));
+              }
+              job->deleteLater();
+              updateFilterUI();
+            });
+    statusBar()->showMessage(tr("Saving..."));
+    mSaveJob->start();
+    updateFilterUI();
+  }
+  // ---------------------------------------------------------------------------
+  // releaseSaveJob
+  // ---------------------------------------------------------------------------
+  // Cancels a running save (the partial file is removed by the job)
+  void  releaseSaveJob()
+  {
+    if (mSaveJob == NULL)
+      return;
+    mSaveJob->disconnect(this);
+    delete mSaveJob;
+    mSaveJob = NULL;
+    statusBar()->clearMessage();
+  }
+  // ---------------------------------------------------------------------------
+  // openOutOfCore
+  // ---------------------------------------------------------------------------
+  // The file is converted into a qpcvChunkStore next to it on the first open
+  // (on a worker thread), then the chunks are paged in by qpcvChunkPager
+  bool  openOutOfCore(const QString &inFileName)
+  {
+    cancelLoad();
+
+    int pointFormat = qpcvChunkStore::POINT_FORMAT_FULL;
+    if (mAppOptCompact)
+      pointFormat = qpcvChunkStore::POINT_FORMAT_COMPACT;
+    qpcvChunkStore  store;
+    if (store.open(inFileName, pointFormat))
+      return startPager(inFileName, store);
 
+    mStoreBuilder = new qpcvChunkStoreBuilder(inFileName, pointFormat, mAppOptDecodeThreadNum,
+                                              STORE_WRITE_BUFFER_SIZE, this);
+    connect(mStoreBuilder, &qpcvChunkStoreBuilder::progressChanged,
+            this,
+            [=](int inStage, qint64 inDoneNum, qint64 inTotalNum)
+            {
+              updateLoadProgressUI(inStage, inDoneNum, inTotalNum);
+            });
+    connect(mStoreBuilder, &QThread::finished,
+            this,
+            [=]()
+            {
+              storeBuildFinished();
+            });
+
+    QFileInfo fileInfo(inFileName);
+    mLoadStatusLabel->setText(QString("Building chunks of %1").arg(fileInfo.fileName()));
+    mLoadProgressBar->setValue(0);
+    mLoadProgressBar->setVisible(true);
+    mLoadStatusLabel->setVisible(true);
+    mLoadCancelButton->setVisible(true);
+    mLoadTimer.start();
+    mStoreBuilder->start();
     return true;
   }
   // ---------------------------------------------------------------------------
-  // generateTestData
+  // storeBuildFinished
   // ---------------------------------------------------------------------------
-  bool  generateTestData()
+  void  storeBuildFinished()
+  {
+    qpcvChunkStoreBuilder *builder = mStoreBuilder;
+    mStoreBuilder = NULL;
+    hideLoadProgressUI();
+    if (builder == NULL)
+      return;
+
+    QString fileName = builder->getFileName();
+    int pointFormat = builder->getPointFormat();
+    bool  result = builder->getResult();
+    QString errorStr = builder->getErrorStr();
+    builder->deleteLater();
+    qpcvChunkStore  store;
+    if (result == false || store.open(fileName, pointFormat) == false)
+    {
+      if (errorStr.size() == 0)
+      {
+        statusBar()->showMessage(tr("Loading canceled"), 3000);
+        return;
+      }
+      std::cerr << "Failed to build the chunks: " << errorStr.toStdString() << std::endl;
+      statusBar()->showMessage(tr("Failed to build the chunks"));
+      QMessageBox::critical(this, tr("qpcv"),
+                            tr("Failed to build the chunks.\n%1").arg(errorStr));
+      return;
+    }
+    startPager(fileName, store);
+  }
+  // ---------------------------------------------------------------------------
+  // startPager
+  // ---------------------------------------------------------------------------
+  bool  startPager(const QString &inFileName, const qpcvChunkStore &inStore)
   {
-    size_t width = 640;
-    size_t height = 480;
+    releaseData();
+    const qpcvChunkStore::FileHeader  &header = inStore.getHeader();
+    for (int i = 0; i < 4; i++)
+      mParam[i] = header.param[i];
+    for (int i = 0; i < 6; i++)
+      mMinMax[i] = header.minMax[i];
+
+    qulonglong  totalNum = header.pointNum;
+    mPager = new qpcvChunkPager(inStore, mAppOptVRAMBudget, mAppOptHostBudget, this);
+    connect(mPager, &qpcvChunkPager::bufferReady,
+            this,
+            [=](size_t inPointNum, size_t inChunkNum)
+            {
+              const qpcvChunkPager::Frame *frame;
+              if (mPager == NULL || mPager->acquireFrame(&frame) == false)
+                return;
+              std::vector<size_t>  releaseTable;
+              mGLView->setChunkFrame(*frame, &releaseTable);
+              mPager->releaseChunks(releaseTable);
+              size_t  vramUsed = mGLView->getChunkVRAMUsed() / (1024 * 1024);
+              statusBar()->showMessage(
+                QString("Drawing %1 of %2 points (%3 chunks in full detail, host cache %4 MB, VRAM %5 MB)")
+                  .arg(inPointNum).arg(totalNum)
+                  .arg(inChunkNum).arg(mPager->getHostUsed() / (1024 * 1024)).arg(vramUsed));
+              mGLView->setHUDInfo(QStringList()
+                << QString("Host chunk cache %1 MB").arg(mPager->getHostUsed() / (1024 * 1024))
+                << QString("Chunk buffers %1 MB").arg(vramUsed)
+                << QString("Out-of-core %1 of %2 points").arg(inPointNum).arg(totalNum));
+            });
+    connect(mPager, &qpcvChunkPager::errorOccurred,
+            this,
+            [=](const QString &inErrorStr)
+            {
+              statusBar()->showMessage(inErrorStr);
+            });
+
+    connect(mGLView, &qpcvGLView::viewChanged,
+            mPager,
+            [=]()
+            {
+              updatePagerView();
+            });
+
+    mGLView->setPointData(NULL, 0, std::vector<size_t>());
+    mGLView->setChunkStore(&(mPager->getStore()), mPager->getVRAMBudget());
+    mGLView->setModelFitParam(mParam);
+    mGLView->mDataModel.setColorMapAxis(2);
+    mColorMapFrom = mMinMax[4];
+    mColorMapTo   = mMinMax[5];
+    calcColorMapParams();
+
+    QFileInfo fileInfo(inFileName);
+    mUI.mFileName->setText(fileInfo.fileName());
+    mUI.mFilePath->setText(fileInfo.absolutePath());
+    mUI.mFileSize->setText(QString("%1 bytes").arg(fileInfo.size()));
+    mUI.mFileCreated->setText(fileInfo.created().toString());
+    mUI.mFileModified->setText(fileInfo.lastModified().toString());
     //
-    mDataNum = width * height;
-    mData = new ibc::gl::glXYZf_RGBAub[mDataNum];
-    if (mData == NULL)
+    mUI.mPLYPointsNum->setText(QString("%1").arg((qulonglong )header.pointNum));
+    mHasColorData = (header.hasColor != 0);
+    if (mHasColorData == false)
+    {
+      mGLView->mDataModel.setColorMode(POINT_COLOR_MODE_MAP);
+      mUI.mPLYPointColor->setText("No color data");
+    }
+    else
+    {
+      mGLView->mDataModel.setColorMode(POINT_COLOR_MODE_FILE);
+      mUI.mPLYPointColor->setText("From file");
+    }
+    mUI.mPLYFormat->setText(QString("out-of-core (%1 chunks)").arg(header.chunkNum));
+    mUI.mPLYFace->setText(QString("none"));
+    if (header.pointFormat == qpcvChunkStore::POINT_FORMAT_COMPACT)
+      mUI.mPLYQuantization->setText(QString("16 bit per chunk, max error %1")
+                                      .arg(inStore.getMaxQuantizationError()));
+    else
+      mUI.mPLYQuantization->setText(QString("none"));
+    mUI.mPLYXMin->setText(QString("%1").arg(mMinMax[0]));
+    mUI.mPLYXMax->setText(QString("%1").arg(mMinMax[1]));
+    mUI.mPLYYMin->setText(QString("%1").arg(mMinMax[2]));
+    mUI.mPLYYMax->setText(QString("%1").arg(mMinMax[3]));
+    mUI.mPLYZMin->setText(QString("%1").arg(mMinMax[4]));
+    mUI.mPLYZMax->setText(QString("%1").arg(mMinMax[5]));
+    mUI.mPLYHeader->setPlainText(QString());
+
+    updatePointColorModeUI();
+    updateColorMapUI();
+    updateDataParamUI();
+    updatePagerView();
+    mPager->start();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // updatePagerView
+  // ---------------------------------------------------------------------------
+  // The frustum and the eye of the camera of the view (connected to
+  // qpcvGLView::viewChanged() while paging)
+  void  updatePagerView()
+  {
+    if (mPager == NULL)
+      return;
+    GLfloat eye[3];
+    mGLView->getEyePosition(eye);
+    mPager->setView(mGLView->getDataMatrix().constData(), eye);
+  }
+  // ---------------------------------------------------------------------------
+  // openTiles
+  // ---------------------------------------------------------------------------
+  // The tiles are shown as they finish loading (see composeTiles())
+  bool  openTiles(const QStringList &inFileList)
+  {
+    cancelLoad();
+    if (inFileList.size() == 0)
       return false;
-    //
-    double xPitch = 1.0 * 2.0 / (double )width;
-    for (unsigned int i = 0; i < height; i++)
-      for (unsigned int j = 0; j < width; j++)
+
+    mTileSet = new qpcvTileSet(inFileList, 0, mAppOptDecodeThreadNum, this);
+    mTileSet->setCache(mAppOptCache, mAppOptCacheDir);
+    connect(mTileSet, &qpcvTileSet::tileFinished,
+            this,
+            [=](int inIndex)
+            {
+              tileFinished(inIndex);
+            });
+
+    mUI.mTileList->blockSignals(true);
+    mUI.mTileList->clear();
+    for (int i = 0; i < mTileSet->getTileNum(); i++)
+    {
+      QListWidgetItem *item = new QListWidgetItem(mUI.mTileList);
+      item->setFlags(Qt::ItemIsUserCheckable | Qt::ItemIsEnabled);
+      item->setCheckState(Qt::Checked);
+      updateTileItem(i);
+    }
+    mUI.mTileList->blockSignals(false);
+    mUI.mTileStatus->setText(QString("Loading %1 tiles").arg(mTileSet->getTileNum()));
+
+    mLoadStatusLabel->setText(QString("Loading 0 / %1 tiles").arg(mTileSet->getTileNum()));
+    mLoadProgressBar->setValue(0);
+    mLoadProgressBar->setVisible(true);
+    mLoadStatusLabel->setVisible(true);
+    mLoadCancelButton->setVisible(true);
+    mTileComposeTime = 0;
+    mLoadTimer.start();
+    mTileSet->start();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // tileFinished
+  // ---------------------------------------------------------------------------
+  void  tileFinished(int inIndex)
+  {
+    updateTileItem(inIndex);
+    const qpcvTileSet::Tile &tile = mTileSet->getTile(inIndex);
+    if (tile.state == qpcvTileSet::TILE_STATE_FAILED)
+      std::cerr << "Failed to load: " << tile.fileName.toStdString()
+                << " " << tile.errorStr.toStdString() << std::endl;
+
+    int finishedNum = mTileSet->getFinishedNum();
+    int tileNum = mTileSet->getTileNum();
+    mLoadProgressBar->setValue(finishedNum * 1000 / tileNum);
+    mLoadStatusLabel->setText(QString("Loading %1 / %2 tiles").arg(finishedNum).arg(tileNum));
+    if (mTileSet->isFinished())
+    {
+      hideLoadProgressUI();
+      mTileComposeTimer.stop();
+      composeTiles();
+      return;
+    }
+    // Composing copies all the tiles, so it is not done more often than
+    // every other composing time
+    if (mTileComposeTimer.isActive() == false)
+      mTileComposeTimer.start(std::max((qint64 )TILE_COMPOSE_MIN_INTERVAL_MSEC,
+                                       mTileComposeTime * 2));
+  }
+  // ---------------------------------------------------------------------------
+  // composeTiles
+  // ---------------------------------------------------------------------------
+  // The tiles are composed on a qpcvTileComposer (see tileComposed()). A
+  // request made while it runs is done when it finishes
+  void  composeTiles()
+  {
+    if (mTileSet == NULL)
+      return;
+    if (mTileComposer != NULL)
+    {
+      mIsTileComposePending = true;
+      return;
+    }
+    mIsTileComposePending = false;
+    mTileComposer = new qpcvTileComposer(*mTileSet, mTileSet->isFinished(),
+                                         mAppOptDecodeThreadNum, this);
+    connect(mTileComposer, &QThread::finished,
+            this,
+            [=]()
+            {
+              qpcvTileComposer  *composer = mTileComposer;
+              mTileComposer = NULL;
+              tileComposed(composer);
+              composer->deleteLater();
+              if (mIsTileComposePending)
+                composeTiles();
+            });
+    mTileComposer->start();
+  }
+  // ---------------------------------------------------------------------------
+  // tileComposed
+  // ---------------------------------------------------------------------------
+  void  tileComposed(qpcvTileComposer *inComposer)
+  {
+    if (inComposer->isSucceeded() == false)
+      return;
+    ibc::gl::glXYZf_RGBAub  *data;
+    size_t  num;
+    std::vector<size_t> levelEndTable;
+    inComposer->takeData(&data, &num, &levelEndTable);
+    const GLfloat *param = inComposer->getParam();
+    const GLfloat *minMax = inComposer->getMinMax();
+    bool  isFirst = (mData == NULL);
+    // The view has to let go of the old buffer before it is released
+    mGLView->setPointData(data, num, levelEndTable);
+    releaseData();
+    mData = data;
+    mDataNum = num;
+    mLevelEndTable = levelEndTable;
+    bool  isBoundsChanged = false;
+    for (int i = 0; i < 6; i++)
+      if (mMinMax[i] != minMax[i])
+        isBoundsChanged = true;
+    if (isFirst || isBoundsChanged)
+    {
+      for (int i = 0; i < 4; i++)
+        mParam[i] = param[i];
+      for (int i = 0; i < 6; i++)
+        mMinMax[i] = minMax[i];
+      mGLView->setModelFitParam(mParam);
+      mColorMapFrom = mMinMax[4];
+      mColorMapTo   = mMinMax[5];
+      calcColorMapParams();
+      updateColorMapUI();
+      updateDataParamUI();
+      fitCropBox();
+    }
+    mTileComposeTime = inComposer->getTime();
+
+    size_t  loadedNum = 0;
+    for (int i = 0; i < mTileSet->getTileNum(); i++)
+      if (mTileSet->getTile(i).state == qpcvTileSet::TILE_STATE_LOADED)
+        loadedNum++;
+    mUI.mTileStatus->setText(QString("%1 of %2 tiles loaded, %3 points shown")
+                               .arg(loadedNum).arg(mTileSet->getTileNum()).arg(mDataNum));
+    mUI.mPLYPointsNum->setText(QString("%1").arg(mDataNum));
+    mUI.mPLYXMin->setText(QString("%1").arg(mMinMax[0]));
+    mUI.mPLYXMax->setText(QString("%1").arg(mMinMax[1]));
+    mUI.mPLYYMin->setText(QString("%1").arg(mMinMax[2]));
+    mUI.mPLYYMax->setText(QString("%1").arg(mMinMax[3]));
+    mUI.mPLYZMin->setText(QString("%1").arg(mMinMax[4]));
+    mUI.mPLYZMax->setText(QString("%1").arg(mMinMax[5]));
+    if (inComposer->hasHistogram())
+    {
+      mHistogram = inComposer->getHistogram();
+      updateColorMapUI();
+      updateFilterUI();
+      startSpatialIndex();
+      statusBar()->showMessage(
+        QString("Loaded %1 tiles (%2 points) in %3 sec")
+          .arg(loadedNum).arg(mDataNum).arg(mLoadTimer.elapsed() / 1000.0, 0, 'f', 2), 10000);
+    }
+    mGLView->update();
+  }
+  // ---------------------------------------------------------------------------
+  // releaseTileComposer
+  // ---------------------------------------------------------------------------
+  // Must be called before mTileSet is deleted (the composer reads its tiles)
+  void  releaseTileComposer()
+  {
+    mIsTileComposePending = false;
+    if (mTileComposer == NULL)
+      return;
+    mTileComposer->disconnect(this);
+    delete mTileComposer;
+    mTileComposer = NULL;
+  }
+  // ---------------------------------------------------------------------------
+  // updateTileItem
+  // ---------------------------------------------------------------------------
+  void  updateTileItem(int inIndex)
+  {
+    static const char *stateStrTable[] =
+    {
+      "pending", "loading", "", "failed"
+    };
+    QListWidgetItem *item = mUI.mTileList->item(inIndex);
+    if (item == NULL)
+      return;
+    const qpcvTileSet::Tile &tile = mTileSet->getTile(inIndex);
+    QString text = QFileInfo(tile.fileName).fileName();
+    if (tile.state == qpcvTileSet::TILE_STATE_LOADED)
+      text += QString(" (%1 points)").arg(tile.result->dataNum);
+    else
+      text += QString(" (%1)").arg(stateStrTable[tile.state]);
+    mUI.mTileList->blockSignals(true);
+    item->setText(text);
+    item->setToolTip(tile.state == qpcvTileSet::TILE_STATE_FAILED ? tile.errorStr : tile.fileName);
+    mUI.mTileList->blockSignals(false);
+  }
+  // ---------------------------------------------------------------------------
+  // startStream
+  // ---------------------------------------------------------------------------
+  // Listens on inServerName (see qpcvStreamReceiver) and draws every frame
+  // as it arrives. The view is fitted to the first frame
+  bool  startStream(const QString &inServerName)
+  {
+    cancelLoad();
+    mGLView->setPointData(NULL, 0, std::vector<size_t>());
+    releaseData();
+
+    mStream = new qpcvStreamReceiver(inServerName, this);
+    connect(mStream, &qpcvStreamReceiver::frameReady,
+            this,
+            [=]()
+            {
+              streamFrameReady();
+            });
+    connect(mStream, &qpcvStreamReceiver::connectionChanged,
+            this,
+            [=](bool inIsConnected)
+            {
+              statusBar()->showMessage(inIsConnected ? tr("Stream connected") :
+                                                       tr("Stream disconnected"), 3000);
+            });
+    connect(mStream, &qpcvStreamReceiver::errorOccurred,
+            this,
+            [=](const QString &inErrorStr)
+            {
+              statusBar()->showMessage(inErrorStr);
+            });
+    mStreamIsFitted = false;
+    mStreamPendingTime = -1;
+    mStreamDisplayedNum = 0;
+    mStreamLatencySum = 0;
+    mStreamLatencyMax = 0;
+    mStreamStatsClock.start();
+    mStreamStatsTimer.start(STREAM_STATS_INTERVAL_MSEC);
+    mStream->start();
+
+    mUI.mFileName->setText(inServerName);
+    mUI.mFilePath->setText(tr("live stream"));
+    statusBar()->showMessage(QString("Waiting for a stream on %1").arg(inServerName));
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // streamFrameReady
+  // ---------------------------------------------------------------------------
+  void  streamFrameReady()
+  {
+    ibc::gl::glXYZf_RGBAub  *data;
+    qpcvStreamReceiver::FrameInfo info;
+    if (mStream == NULL || mStream->acquireFrame(&data, &info) == false)
+      return;
+    mData = data;
+    mDataNum = info.pointNum;
+    mGLView->setStreamFrame(mData, mDataNum);
+    if (mStreamIsFitted == false && mDataNum != 0)
+    {
+      qpcvBounds  bounds;
+      for (int i = 0; i < 2; i++)
       {
-        double x = -1.0 + xPitch * j;
-        double y = -1.0 + xPitch * i;
-        double k = (M_PI * 3.0) * (M_PI * 3.0);
-        double z, d;
-        if (x == 0 && y == 0)
-          z = 1;
-        else
-        {
-          d = sqrt(k*x*x + k*y*y);
-          z = sin(d) / d;
-        }
-        mData[width * i + j].x = x;
-        mData[width * i + j].y = y;
-        mData[width * i + j].z = z;
-        //
-        mData[width * i + j].r = (GLubyte )(z * 255);
-        mData[width * i + j].g = (GLubyte )(z * 255);
-        mData[width * i + j].b = (GLubyte )(z * 255);
-        mData[width * i + j].a = 255;
+        ibc::gl::glXYZf_RGBAub  corner;
+        corner.x = info.minMax[0 + i];
+        corner.y = info.minMax[2 + i];
+        corner.z = info.minMax[4 + i];
+        corner.r = corner.g = corner.b = corner.a = 255;
+        bounds.add(corner);
       }
+      bounds.calcFitParam(mParam, mMinMax);
+      mGLView->setModelFitParam(mParam);
+      mColorMapFrom = mMinMax[4];
+      mColorMapTo   = mMinMax[5];
+      calcColorMapParams();
+      updateColorMapUI();
+      updateDataParamUI();
+      mStreamIsFitted = true;
+    }
+    // A frame replaced before it was shown is not counted (see frameSwapped)
+    mStreamPendingTime = info.receiveTime;
+    mUI.mPLYPointsNum->setText(QString("%1").arg(mDataNum));
+    mGLView->update();
+  }
+  // ---------------------------------------------------------------------------
+  // openSequence
+  // ---------------------------------------------------------------------------
+  // inFileName is one frame of the sequence (see findFrameFiles()). The
+  // current data is kept when no frame is found
+  bool  openSequence(const QString &inFileName)
+  {
+    QStringList fileList = qpcvSequencePlayer::findFrameFiles(inFileName);
+    if (fileList.isEmpty())
+    {
+      QString errorStr = QString("No frame is found for %1").arg(inFileName);
+      std::cerr << "Failed to open the sequence: " << errorStr.toStdString() << std::endl;
+      statusBar()->showMessage(errorStr);
+      QMessageBox::critical(this, tr("qpcv"),
+                            tr("Failed to open the sequence.\n%1").arg(errorStr));
+      return false;
+    }
+    cancelLoad();
+    mGLView->setPointData(NULL, 0, std::vector<size_t>());
+    releaseData();
 
-    ibc::gl::file::PLYFile::calcFitParam_glXYZf_RGBAub(mData, mDataNum, mParam, mMinMax);
-    mGLView->mDataModel.setDataPtr((float *)mData, mDataNum);
-    mGLView->mDataModel.setModelFitParam(mParam);
+    mSequence = new qpcvSequencePlayer(fileList, qpcvSequencePlayer::DEFAULT_PREFETCH_NUM,
+                                       mAppOptDecodeThreadNum, this);
+    connect(mSequence, &qpcvSequencePlayer::frameDecoded,
+            this,
+            [=](int inIndex)
+            {
+              if (inIndex == mSequenceTargetFrame)
+                showSequenceFrame(inIndex);
+            });
+    connect(mSequence, &qpcvSequencePlayer::errorOccurred,
+            this,
+            [=](const QString &inErrorStr)
+            {
+              std::cerr << "Failed to decode: " << inErrorStr.toStdString() << std::endl;
+            });
+    mSequenceFrame = -1;
+    mSequenceTargetFrame = 0;
+    mSequenceIsFitted = false;
+    mSequenceShownNum = 0;
+    mSequenceLateNum = 0;
+    mSequenceStatsClock.start();
+
+    mUI.mSequenceSlider->blockSignals(true);
+    mUI.mSequenceSlider->setRange(0, mSequence->getFrameNum() - 1);
+    mUI.mSequenceSlider->setValue(0);
+    mUI.mSequenceSlider->blockSignals(false);
+    mUI.mSequenceStatus->setText(QString("%1 frames").arg(mSequence->getFrameNum()));
+    mSequence->start();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // showSequenceFrame
+  // ---------------------------------------------------------------------------
+  // Returns false when the frame is not decoded yet
+  bool  showSequenceFrame(int inIndex)
+  {
+    ibc::gl::glXYZf_RGBAub  *data;
+    size_t  num;
+    GLfloat minMax[6];
+    if (mSequence == NULL || mSequence->acquireFrame(inIndex, &data, &num, minMax) == false)
+      return false;
+    mData = data;
+    mDataNum = num;
+    mSequenceFrame = inIndex;
+    mGLView->setPointData(mData, mDataNum, std::vector<size_t>());
+    // The view is fitted to the first frame only, so it stays still while playing
+    if (mSequenceIsFitted == false && mDataNum != 0)
+    {
+      qpcvBounds  bounds;
+      for (int i = 0; i < 2; i++)
+      {
+        ibc::gl::glXYZf_RGBAub  corner;
+        corner.x = minMax[0 + i];
+        corner.y = minMax[2 + i];
+        corner.z = minMax[4 + i];
+        corner.r = corner.g = corner.b = corner.a = 255;
+        bounds.add(corner);
+      }
+      bounds.calcFitParam(mParam, mMinMax);
+      mGLView->setModelFitParam(mParam);
+      mColorMapFrom = mMinMax[4];
+      mColorMapTo   = mMinMax[5];
+      calcColorMapParams();
+      updateColorMapUI();
+      updateDataParamUI();
+      mSequenceIsFitted = true;
+    }
+    mSequenceShownNum++;
+    mUI.mSequenceSlider->blockSignals(true);
+    mUI.mSequenceSlider->setValue(inIndex);
+    mUI.mSequenceSlider->blockSignals(false);
+    QFileInfo fileInfo(mSequence->getFileName(inIndex));
+    mUI.mFileName->setText(fileInfo.fileName());
+    mUI.mFilePath->setText(fileInfo.absolutePath());
+    mUI.mPLYPointsNum->setText(QString("%1").arg(mDataNum));
+    mGLView->update();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // updateSequenceStatus
+  // ---------------------------------------------------------------------------
+  void  updateSequenceStatus()
+  {
+    double  sec = mSequenceStatsClock.elapsed() / 1000.0;
+    if (mSequence == NULL || sec < 1.0)
+      return;
+    mUI.mSequenceStatus->setText(
+      QString("Frame %1 / %2, %3 fps, %4 late")
+        .arg(mSequenceFrame + 1).arg(mSequence->getFrameNum())
+        .arg(mSequenceShownNum / sec, 0, 'f', 1).arg(mSequenceLateNum));
+    mSequenceStatsClock.restart();
+    mSequenceShownNum = 0;
+    mSequenceLateNum = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // generateTestData
+  // ---------------------------------------------------------------------------
+  // The data is made on a qpcvGenerateJob and shown when it finishes (see
+  // generateFinished()). The current data stays until then
+  bool  generateTestData()
+  {
+    cancelLoad();
+    size_t  num = mAppOptGeneratePointNum;
+    if (num == 0)
+      num = qpcvGenerator::DEFAULT_POINT_NUM;
+    mGenerateJob = new qpcvGenerateJob(num, mAppOptDistribution, mAppOptSeed,
+                                       qpcvLoader::DEFAULT_LOD_MIN_POINT_NUM,
+                                       mAppOptDecodeThreadNum, this);
+    connect(mGenerateJob, &QThread::finished,
+            this,
+            [=]()
+            {
+              generateFinished();
+            });
+    statusBar()->showMessage(QString("Generating %1 %2 points...")
+                               .arg(num).arg(qpcvGenerator::getDistributionName(mAppOptDistribution)));
+    mGenerateJob->start();
     return true;
   }
+  // ---------------------------------------------------------------------------
+  // generateFinished
+  // ---------------------------------------------------------------------------
+  void  generateFinished()
+  {
+    qpcvGenerateJob *job = mGenerateJob;
+    mGenerateJob = NULL;
+    if (job == NULL)
+      return;
+    job->deleteLater();
+    if (job->isSucceeded() == false)
+    {
+      if (job->getErrorStr().isEmpty())
+      {
+        statusBar()->showMessage(tr("Generating canceled"), 3000);
+        return;
+      }
+      std::cerr << "Failed to generate: " << job->getErrorStr().toStdString() << std::endl;
+      statusBar()->showMessage(tr("Failed to generate the test data"));
+      QMessageBox::critical(this, tr("qpcv"),
+                            tr("Failed to generate the test data.\n%1").arg(job->getErrorStr()));
+      return;
+    }
+    // The view has to let go of the old buffer before it is released
+    mGLView->setPointData(NULL, 0, std::vector<size_t>());
+    releaseData();
+    mDataNum = job->getDataNum();
+    mData = job->takeData();
+    for (int i = 0; i < 4; i++)
+      mParam[i] = job->getParam()[i];
+    for (int i = 0; i < 6; i++)
+      mMinMax[i] = job->getMinMax()[i];
+    mLevelEndTable = job->getLevelEndTable();
+    mHistogram = job->getHistogram();
+
+    mGLView->setPointData(mData, mDataNum, mLevelEndTable);
+    mGLView->setModelFitParam(mParam);
+    updateHistogramUI();
+    fitCropBox();
+    updateFilterUI();
+    startSpatialIndex();
+    statusBar()->showMessage(
+      QString("Generated %1 %2 points (seed %3) in %4 ms, LOD %5 ms")
+        .arg(mDataNum).arg(qpcvGenerator::getDistributionName(job->getDistribution()))
+        .arg(job->getSeed()).arg(job->getGenerateTime()).arg(job->getTime()), 10000);
+  }
+  // ---------------------------------------------------------------------------
+  // releaseGenerateJob
+  // ---------------------------------------------------------------------------
+  void  releaseGenerateJob()
+  {
+    if (mGenerateJob == NULL)
+      return;
+    mGenerateJob->disconnect(this);
+    delete mGenerateJob;
+    mGenerateJob = NULL;
+  }
 
   // UI related functions ------------------------------------------------------
   // ---------------------------------------------------------------------------
@@ -346,13 +1622,13 @@ protected:
     ibc::image::ColorMap::getColorMapNameTable(&strTable, &mColorMapIndexTable);
     for (size_t i = 0; i < strTable.size(); i++)
       mUI.mColorMapTheme->addItem(QString(strTable[i].c_str()));
-    mUI.mColorMapAxis->addItem(QString("x"));
-    mUI.mColorMapAxis->addItem(QString("y"));
-    mUI.mColorMapAxis->addItem(QString("z"));
     //
     mColorMapIndex = mGLView->mDataModel.getColorMapIndex();
     mColorMapFrom = 0;
     mColorMapTo = 0;
+    mHistogramView = new qpcvHistogramView();
+    mHistogramView->setHistogram(&mHistogram);
+    mUI.verticalLayout_10->addWidget(mHistogramView);
     //
     updateColorMapUI();
     //
@@ -369,26 +1645,8 @@ protected:
             this,
             [=](int d)
             {
-              mGLView->mDataModel.setColorMapAxis(d);
-              switch (d)
-              {
-                case 0:
-                  mColorMapFrom = mMinMax[0];
-                  mColorMapTo   = mMinMax[1];
-                  break;
-                case 1:
-                  mColorMapFrom = mMinMax[2];
-                  mColorMapTo   = mMinMax[3];
-                  break;
-                case 2:
-                  mColorMapFrom = mMinMax[4];
-                  mColorMapTo   = mMinMax[5];
-                  break;
-              }
-              calcColorMapParams();
-              mUI.mColorMapFrom->setValue(mColorMapFrom);
-              mUI.mColorMapTo->setValue(mColorMapTo);
-              mGLView->update();
+              if (d >= 0)
+                selectColorMapAxis(d);
             });
     connect(mUI.mColorMapRepeatNum,
             static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged),
@@ -405,6 +1663,7 @@ protected:
             {
               mColorMapFrom = d;
               calcColorMapParams();
+              updateHistogramUI();
               mGLView->update();
             });
     connect(mUI.mColorMapTo,
@@ -414,6 +1673,7 @@ protected:
             {
               mColorMapTo = d;
               calcColorMapParams();
+              updateHistogramUI();
               mGLView->update();
             });
     connect(mUI.mUnmappedPoints,
@@ -424,6 +1684,159 @@ protected:
               mGLView->mDataModel.setColorMapUnmapMode(d);
               mGLView->update();
             });
+    connect(mUI.mColorMapAutoRange, &QPushButton::clicked,
+            this,
+            [=]()
+            {
+              autoColorMapRange(mUI.mColorMapPercentile->value());
+            });
+  }
+  // ---------------------------------------------------------------------------
+  // selectColorMapAxis
+  // ---------------------------------------------------------------------------
+  // 0 - 2 : x, y, z, 3 - : the attributes of mAttributeStore. An attribute is
+  // read from the file the first time it is selected for the shown data
+  void  selectColorMapAxis(int inIndex)
+  {
+    if (inIndex >= 3)
+    {
+      if (selectScalarAttribute(inIndex - 3) == false)
+      {
+        updateColorMapAxisUI();
+        return;
+      }
+    }
+    else
+    {
+      mGLView->setScalarAttribute(-1);
+      mGLView->mDataModel.setColorMapAxis(inIndex);
+      switch (inIndex)
+      {
+        case 0:
+          mColorMapFrom = mMinMax[0];
+          mColorMapTo   = mMinMax[1];
+          break;
+        case 1:
+          mColorMapFrom = mMinMax[2];
+          mColorMapTo   = mMinMax[3];
+          break;
+        case 2:
+          mColorMapFrom = mMinMax[4];
+          mColorMapTo   = mMinMax[5];
+          break;
+      }
+    }
+    calcColorMapParams();
+    mUI.mColorMapFrom->setValue(mColorMapFrom);
+    mUI.mColorMapTo->setValue(mColorMapTo);
+    updateHistogramUI();
+    mGLView->update();
+  }
+  // ---------------------------------------------------------------------------
+  // selectScalarAttribute
+  // ---------------------------------------------------------------------------
+  // Once uploaded, switching to the attribute again needs no decode. The
+  // first time, the attribute is read on a worker thread and selected when it
+  // is ready (false is returned until then)
+  bool  selectScalarAttribute(int inIndex)
+  {
+    if (mAttributeStore == NULL || inIndex < 0 ||
+        (size_t )inIndex >= mAttributeStore->getAttributeNum() || isFilterDataShown())
+      return false;
+    if (mGLView->hasScalarData(inIndex) == false)
+    {
+      startAttributeDecode(inIndex);
+      return false;
+    }
+    const qpcvAttributeStore::Attribute &attribute = mAttributeStore->getAttribute(inIndex);
+    mGLView->setScalarAttribute(inIndex);
+    mColorMapFrom = attribute.minMax[0];
+    mColorMapTo   = attribute.minMax[1];
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // startAttributeDecode
+  // ---------------------------------------------------------------------------
+  // The view keeps the current color map while the attribute is read
+  void  startAttributeDecode(int inIndex)
+  {
+    if (mAttributeDecoder != NULL)
+    {
+      if (mAttributeDecoder->getIndex() == (size_t )inIndex)
+        return;
+      releaseAttributeDecoder();
+    }
+    QString name(mAttributeStore->getAttribute(inIndex).name.c_str());
+    mAttributeDecoder = new qpcvAttributeDecoder(mAttributeStore, inIndex,
+                                                 mAppOptDecodeThreadNum, this);
+    connect(mAttributeDecoder, &QThread::finished,
+            this,
+            [=]()
+            {
+              qpcvAttributeDecoder  *decoder = mAttributeDecoder;
+              mAttributeDecoder = NULL;
+              if (decoder->isSucceeded() == false)
+              {
+                statusBar()->clearMessage();
+                if (decoder->getErrorStr().isEmpty() == false)
+                  QMessageBox::critical(this, tr("qpcv"),
+                                        tr("Failed to read \"%1\".\n%2")
+                                          .arg(name).arg(decoder->getErrorStr()));
+              }
+              else
+              {
+                std::vector<float>  values;
+                decoder->takeValues(&values);
+                size_t  size = values.size() * sizeof(float);
+                mGLView->setScalarData(inIndex, &values);
+                statusBar()->showMessage(
+                  QString("Read \"%1\" in %2 ms (%3 MB on the GPU)")
+                    .arg(name).arg(decoder->getTime()).arg(size / (1024 * 1024)), 5000);
+                selectColorMapAxis(inIndex + 3);
+                updateColorMapAxisUI();
+              }
+              decoder->deleteLater();
+            });
+    statusBar()->showMessage(QString("Reading \"%1\"...").arg(name));
+    mAttributeDecoder->start();
+  }
+  // ---------------------------------------------------------------------------
+  // releaseAttributeDecoder
+  // ---------------------------------------------------------------------------
+  // Waits for a running decode (it stops at the next block). Called before
+  // mAttributeStore is deleted or the shown data changes
+  void  releaseAttributeDecoder()
+  {
+    if (mAttributeDecoder == NULL)
+      return;
+    mAttributeDecoder->disconnect(this);
+    delete mAttributeDecoder;
+    mAttributeDecoder = NULL;
+    statusBar()->clearMessage();
+  }
+  // ---------------------------------------------------------------------------
+  // updateColorMapAxisUI
+  // ---------------------------------------------------------------------------
+  // x, y, z and the attributes of the shown data
+  void  updateColorMapAxisUI()
+  {
+    mUI.mColorMapAxis->blockSignals(true);
+    mUI.mColorMapAxis->clear();
+    mUI.mColorMapAxis->addItem(QString("x"));
+    mUI.mColorMapAxis->addItem(QString("y"));
+    mUI.mColorMapAxis->addItem(QString("z"));
+    if (mAttributeStore != NULL && isFilterDataShown() == false)
+    {
+      for (size_t i = 0; i < mAttributeStore->getAttributeNum(); i++)
+        mUI.mColorMapAxis->addItem(QString(mAttributeStore->getAttribute(i).name.c_str()));
+    }
+    int index = mGLView->getScalarAttribute();
+    if (index >= 0)
+      index += 3;
+    else
+      index = mGLView->mDataModel.getColorMapAxis();
+    mUI.mColorMapAxis->setCurrentIndex(index);
+    mUI.mColorMapAxis->blockSignals(false);
   }
   // ---------------------------------------------------------------------------
   // updateColorMapUI
@@ -433,7 +1846,7 @@ protected:
     auto index = std::find( mColorMapIndexTable.cbegin(),
                             mColorMapIndexTable.cend(), mColorMapIndex);
     mUI.mColorMapTheme->setCurrentIndex((index - mColorMapIndexTable.cbegin()));
-    mUI.mColorMapAxis->setCurrentIndex(mGLView->mDataModel.getColorMapAxis());
+    updateColorMapAxisUI();
     mUI.mColorMapRepeatNum->setValue(mGLView->mDataModel.getColorMapRepeatNum());
     mUI.mColorMapFrom->setValue(mColorMapFrom);
     mUI.mColorMapTo->setValue(mColorMapTo);
@@ -441,6 +1854,93 @@ protected:
       mUI.mUnmappedPoints->setChecked(false);
     else
       mUI.mUnmappedPoints->setChecked(true);
+    updateHistogramUI();
+  }
+  // ---------------------------------------------------------------------------
+  // updateHistogramUI
+  // ---------------------------------------------------------------------------
+  void  updateHistogramUI()
+  {
+    if (mHistogramView == NULL)
+      return;
+    // The histogram is of the axes only
+    bool  isAxis = (mGLView->getScalarAttribute() < 0);
+    mHistogramView->setVisible(isAxis);
+    mHistogramView->setAxis(mGLView->mDataModel.getColorMapAxis());
+    mHistogramView->setRange(mColorMapFrom, mColorMapTo);
+    mUI.mColorMapAutoRange->setEnabled(isAxis && mHistogram.getTotalNum(0) != 0 &&
+                                       mRangeJob == NULL);
+  }
+  // ---------------------------------------------------------------------------
+  // autoColorMapRange
+  // ---------------------------------------------------------------------------
+  // inPercent - (100 - inPercent) percentile range of the color map axis of
+  // the shown data (the filter result unless "Show Original" is checked).
+  // The range is set when the job finishes (see releaseRangeJob())
+  void  autoColorMapRange(double inPercent)
+  {
+    int axis = mGLView->mDataModel.getColorMapAxis();
+    if (mRangeJob != NULL || mHistogram.getTotalNum(axis) == 0)
+      return;
+    const ibc::gl::glXYZf_RGBAub  *data = mData;
+    size_t  num = mDataNum;
+    const qpcvHistogram *histogram = &mHistogram;
+    bool  isFilterData = isFilterDataShown();
+    if (isFilterData)
+    {
+      data = mFilterData;
+      num = mFilterNum;
+      histogram = NULL;
+      if (mFilterHistogram.getTotalNum(axis) != 0)
+        histogram = &mFilterHistogram;
+    }
+    mRangeJob = new qpcvPercentileRangeJob(data, num, histogram, mMinMax, axis,
+                                           inPercent, 100.0 - inPercent,
+                                           mAppOptDecodeThreadNum, this);
+    connect(mRangeJob, &QThread::finished,
+            this,
+            [=]()
+            {
+              qpcvPercentileRangeJob  *job = mRangeJob;
+              mRangeJob = NULL;
+              if (job->isSucceeded())
+              {
+                if (isFilterData)
+                  mFilterHistogram = job->getHistogram();
+                double  from, to;
+                job->getRange(&from, &to);
+                if (mGLView->mDataModel.getColorMapAxis() == job->getAxis())
+                {
+                  mColorMapFrom = from;
+                  mColorMapTo = to;
+                  calcColorMapParams();
+                  updateColorMapUI();
+                  mGLView->update();
+                }
+                statusBar()->showMessage(
+                  QString("Color map range %1 - %2 (%3 - %4 %, %5 ms)")
+                    .arg(from).arg(to).arg(inPercent).arg(100.0 - inPercent)
+                    .arg(job->getTime()), 5000);
+              }
+              job->deleteLater();
+              updateHistogramUI();
+            });
+    mRangeJob->start();
+    updateHistogramUI();
+  }
+  // ---------------------------------------------------------------------------
+  // releaseRangeJob
+  // ---------------------------------------------------------------------------
+  // Waits for a running job (it stops at the next block). Called before the
+  // data it reads is released or replaced
+  void  releaseRangeJob()
+  {
+    if (mRangeJob == NULL)
+      return;
+    mRangeJob->disconnect(this);
+    delete mRangeJob;
+    mRangeJob = NULL;
+    updateHistogramUI();
   }
   // ---------------------------------------------------------------------------
   // initPointSettingUI
@@ -448,8 +1948,14 @@ protected:
   void  initPointSettingUI()
   {
     mUI.mPointSize->setMinimum(0.01);
+    mUI.mPointBudget->setRange(1, 1000);
+    mUI.mPointBudget->setSuffix(tr(" M"));
     mUI.mPointColorBox->setAutoFillBackground(true);  // We already did this with the Qt Designer
+    mUI.mRenderMode->addItem(tr("Points"));
+    mUI.mRenderMode->addItem(tr("Wireframe"));
+    mUI.mRenderMode->addItem(tr("Shaded"));
     updatePointSettingUI();
+    updateRenderModeUI();
     //
     connect(mUI.mPointSize,
             static_cast<void(QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged),
@@ -459,6 +1965,20 @@ protected:
               mGLView->mDataModel.setPointSize(d);
               mGLView->update();
             });
+    connect(mUI.mRenderMode,
+            static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+            this,
+            [=](int i)
+            {
+              mGLView->setRenderMode(i);
+            });
+    connect(mUI.mPointBudget,
+            static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+            this,
+            [=](int i)
+            {
+              mGLView->setPointBudget((size_t )i * 1000 * 1000);
+            });
     connect(mUI.mPointColorButton,
             static_cast<void(QAbstractButton::*)()>(&QAbstractButton::released),
             this,
@@ -487,11 +2007,21 @@ protected:
             });
   }
   // ---------------------------------------------------------------------------
+  // updateRenderModeUI
+  // ---------------------------------------------------------------------------
+  // The mode is kept while there is no mesh (all the modes draw points then)
+  void  updateRenderModeUI()
+  {
+    mUI.mRenderMode->setEnabled(mGLView->hasMesh());
+    mUI.mRenderMode->setCurrentIndex(mGLView->getRenderMode());
+  }
+  // ---------------------------------------------------------------------------
   // updatePointSettingUI
   // ---------------------------------------------------------------------------
   void  updatePointSettingUI()
   {
     mUI.mPointSize->setValue(mGLView->mDataModel.getPointSize());
+    mUI.mPointBudget->setValue((int )(mGLView->getPointBudget() / (1000 * 1000)));
     const float *color = mGLView->mDataModel.getSingleColor();
     int r = color[0] * 255.0;
     int g = color[1] * 255.0;
@@ -510,13 +2040,7 @@ protected:
   // ---------------------------------------------------------------------------
   void  calcColorMapParams()
   {
-    double  gain;
-    if (mColorMapFrom >= mColorMapTo)
-      gain = 0;
-    else
-      gain = 1.0 / (mColorMapTo - mColorMapFrom);
-    mGLView->mDataModel.setColorMapOffset(mColorMapFrom);
-    mGLView->mDataModel.setColorMapGain(gain);
+    mGLView->setColorMapRange(mColorMapFrom, mColorMapTo);
   }
   // ---------------------------------------------------------------------------
   // initDataParamUI
@@ -531,7 +2055,7 @@ protected:
             [=](double d)
             {
               mParam[3] = d;
-              mGLView->mDataModel.setModelFitParam(mParam);
+              mGLView->setModelFitParam(mParam);
               mGLView->update();
             });
     connect(mUI.mDataXOffset,
@@ -540,7 +2064,7 @@ protected:
             [=](double d)
             {
               mParam[0] = d;
-              mGLView->mDataModel.setModelFitParam(mParam);
+              mGLView->setModelFitParam(mParam);
               mGLView->update();
             });
     connect(mUI.mDataYOffset,
@@ -549,7 +2073,7 @@ protected:
             [=](double d)
             {
               mParam[1] = d;
-              mGLView->mDataModel.setModelFitParam(mParam);
+              mGLView->setModelFitParam(mParam);
               mGLView->update();
             });
     connect(mUI.mDataZOffset,
@@ -558,7 +2082,7 @@ protected:
             [=](double d)
             {
               mParam[2] = d;
-              mGLView->mDataModel.setModelFitParam(mParam);
+              mGLView->setModelFitParam(mParam);
               mGLView->update();
             });
   }
@@ -585,6 +2109,9 @@ protected:
     mUI.mBackgroundColorMode->addItem(QApplication::translate("main", "Gray Gradation"));
     mUI.mBackgroundColorMode->addItem(QApplication::translate("main", "Dark Gray Gradation"));
     mUI.mBackgroundColorMode->setCurrentIndex(mBackColorMode);
+    const GLfloat *topColor, *bottomColor;
+    getBackdropColor(&topColor, &bottomColor);
+    mGLView->setBackdropColor(topColor, bottomColor);
 
     updatDisplaySettingUI();
     //
@@ -604,7 +2131,7 @@ protected:
               const GLfloat *topColor, *bottomColor;
               mBackColorMode = (BackdropColorMode )i;
               getBackdropColor(&topColor, &bottomColor);
-              mGLView->mBackdropModel.setBackdropColor(topColor, bottomColor);;
+              mGLView->setBackdropColor(topColor, bottomColor);
               mGLView->update();
             });
     connect(mUI.mDisplayColorButton,
@@ -626,7 +2153,7 @@ protected:
               mBackColor[0] = selColor.red() / 255.0;
               mBackColor[1] = selColor.green() / 255.0;
               mBackColor[2] = selColor.blue() / 255.0;
-              mGLView->mBackdropModel.setBackdropColor(mBackColor, mBackColor);;
+              mGLView->setBackdropColor(mBackColor, mBackColor);
               updatDisplaySettingUI();
               mGLView->update();
             });
@@ -646,6 +2173,235 @@ protected:
               mGLView->mAxisModel.setEnabled(d);
               mGLView->update();
             });
+    connect(mUI.mDisplayPerfHUD,
+            static_cast<void(QCheckBox::*)(bool)>(&QAbstractButton::toggled),
+            this,
+            [=](bool d)
+            {
+              mGLView->setHUDEnabled(d);
+            });
+  }
+  // ---------------------------------------------------------------------------
+  // initLoadProgressUI
+  // ---------------------------------------------------------------------------
+  void  initLoadProgressUI()
+  {
+    mLoadStatusLabel = new QLabel(this);
+    mLoadProgressBar = new QProgressBar(this);
+    mLoadProgressBar->setRange(0, 1000);
+    mLoadProgressBar->setMaximumWidth(200);
+    mLoadProgressBar->setTextVisible(false);
+    mLoadCancelButton = new QToolButton(this);
+    mLoadCancelButton->setText(tr("Cancel"));
+    statusBar()->addPermanentWidget(mLoadStatusLabel);
+    statusBar()->addPermanentWidget(mLoadProgressBar);
+    statusBar()->addPermanentWidget(mLoadCancelButton);
+    hideLoadProgressUI();
+    //
+    connect(mLoadCancelButton,
+            static_cast<void(QAbstractButton::*)()>(&QAbstractButton::released),
+            this,
+            [=]()
+            {
+              cancelLoad();
+              statusBar()->showMessage(tr("Loading canceled"), 3000);
+            });
+  }
+  // ---------------------------------------------------------------------------
+  // updateLoadProgressUI
+  // ---------------------------------------------------------------------------
+  void  updateLoadProgressUI(int inStage, qint64 inDoneBytes, qint64 inTotalBytes)
+  {
+    static const char *stageStrTable[] =
+    {
+      "", "Reading", "Decoding", "Decoding faces", "Bounds", "Building LOD", "Histogram", "Writing cache", "Done"
+    };
+
+    int value = 0;
+    if (inTotalBytes > 0)
+      value = (int )(inDoneBytes * 1000 / inTotalBytes);
+    mLoadProgressBar->setValue(value);
+
+    double  sec = mLoadTimer.elapsed() / 1000.0;
+    double  mbPerSec = 0;
+    if (sec > 0)
+      mbPerSec = inDoneBytes / (1024.0 * 1024.0) / sec;
+    if (inStage < 0 || inStage > qpcvLoader::LOAD_STAGE_DONE)
+      inStage = 0;
+    mLoadStatusLabel->setText(QString("%1 %2 / %3 MB (%4 MB/s)")
+                                .arg(stageStrTable[inStage])
+                                .arg(inDoneBytes / (1024 * 1024))
+                                .arg(inTotalBytes / (1024 * 1024))
+                                .arg(mbPerSec, 0, 'f', 1));
+  }
+  // ---------------------------------------------------------------------------
+  // hideLoadProgressUI
+  // ---------------------------------------------------------------------------
+  void  hideLoadProgressUI()
+  {
+    mLoadProgressBar->setVisible(false);
+    mLoadStatusLabel->setVisible(false);
+    mLoadCancelButton->setVisible(false);
+  }
+  // ---------------------------------------------------------------------------
+  // initStreamUI
+  // ---------------------------------------------------------------------------
+  void  initStreamUI()
+  {
+    // End-to-end latency: from the frame header arrival to the buffer swap
+    // of the first paint that used the frame
+    connect(mGLView, &QOpenGLWidget::frameSwapped,
+            this,
+            [=]()
+            {
+              if (mStream == NULL || mStreamPendingTime < 0)
+                return;
+              double  latency = (qpcvStreamReceiver::getTime() - mStreamPendingTime) / 1000.0;
+              mStreamPendingTime = -1;
+              mStreamDisplayedNum++;
+              mStreamLatencySum += latency;
+              if (latency > mStreamLatencyMax)
+                mStreamLatencyMax = latency;
+            });
+    connect(&mStreamStatsTimer, &QTimer::timeout,
+            this,
+            [=]()
+            {
+              if (mStream == NULL)
+                return;
+              double  sec = mStreamStatsClock.restart() / 1000.0;
+              double  fps = (sec > 0) ? mStreamDisplayedNum / sec : 0;
+              double  latency = (mStreamDisplayedNum > 0) ? mStreamLatencySum / mStreamDisplayedNum : 0;
+              QString str = QString("Stream %1 fps, latency %2 ms (max %3 ms), %4 received, %5 dropped")
+                              .arg(fps, 0, 'f', 1).arg(latency, 0, 'f', 1)
+                              .arg(mStreamLatencyMax, 0, 'f', 1)
+                              .arg(mStream->getReceivedNum()).arg(mStream->getDroppedNum());
+              statusBar()->showMessage(str);
+              mGLView->setHUDInfo(QStringList() << str);
+              mStreamDisplayedNum = 0;
+              mStreamLatencySum = 0;
+              mStreamLatencyMax = 0;
+            });
+  }
+  // ---------------------------------------------------------------------------
+  // initFilterUI
+  // ---------------------------------------------------------------------------
+  void  initFilterUI()
+  {
+    // In the FilterStage order
+    mCropFilter = new qpcvCropFilter();
+    mOutlierFilter = new qpcvOutlierFilter();
+    mDownsampleFilter = new qpcvDownsampleFilter();
+    mFilterPipeline.addFilter(mCropFilter);
+    mFilterPipeline.addFilter(mOutlierFilter);
+    mFilterPipeline.addFilter(mDownsampleFilter);
+    for (int i = 0; i < qpcvVoxelFilter::MODE_NUM; i++)
+      mUI.mVoxelMode->addItem(QString(qpcvVoxelFilter::getModeName(i)));
+    mUI.mOutlierNeighbors->setMaximum(qpcvOutlierFilter::MAX_NEIGHBOR_NUM);
+    updateFilterUI();
+    //
+    connect(mUI.mCropFit, &QPushButton::clicked,
+            this,
+            [=]()
+            {
+              fitCropBox();
+            });
+    connect(mUI.mFilterApply, &QPushButton::clicked,
+            this,
+            [=]()
+            {
+              startFilter();
+            });
+    connect(mUI.mFilterShowOriginal,
+            static_cast<void(QCheckBox::*)(bool)>(&QAbstractButton::toggled),
+            this,
+            [=](bool d)
+            {
+              showFilterData(d == false);
+            });
+  }
+  // ---------------------------------------------------------------------------
+  // updateFilterUI
+  // ---------------------------------------------------------------------------
+  void  updateFilterUI()
+  {
+    bool  isIdle = (mFilterJob == NULL && mSaveJob == NULL);
+    mUI.mFilterApply->setEnabled(canFilterData() && isIdle);
+    mUI.mFilterShowOriginal->setEnabled(mFilterData != NULL);
+    mUI.actionSave->setEnabled(canFilterData() && isIdle);
+  }
+  // ---------------------------------------------------------------------------
+  // initSequenceUI
+  // ---------------------------------------------------------------------------
+  void  initSequenceUI()
+  {
+    mSequenceTimer.setTimerType(Qt::PreciseTimer);
+    connect(&mSequenceTimer, &QTimer::timeout,
+            this,
+            [=]()
+            {
+              if (mSequence == NULL || mSequence->getFrameNum() == 0)
+                return;
+              // Playback waits for a frame which is not decoded yet (no frame is skipped)
+              int next = (mSequenceFrame + 1) % mSequence->getFrameNum();
+              mSequenceTargetFrame = next;
+              mSequence->setCurrentFrame(next);
+              if (showSequenceFrame(next) == false)
+                mSequenceLateNum++;
+              updateSequenceStatus();
+            });
+    connect(mUI.mSequencePlay,
+            static_cast<void(QPushButton::*)(bool)>(&QAbstractButton::toggled),
+            this,
+            [=](bool d)
+            {
+              mUI.mSequencePlay->setText(d ? tr("Pause") : tr("Play"));
+              if (d && mSequence != NULL)
+                mSequenceTimer.start(1000 / mUI.mSequenceFPS->value());
+              else
+                mSequenceTimer.stop();
+            });
+    connect(mUI.mSequenceFPS,
+            static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+            this,
+            [=](int inValue)
+            {
+              if (mSequenceTimer.isActive())
+                mSequenceTimer.start(1000 / inValue);
+            });
+    connect(mUI.mSequenceSlider, &QSlider::valueChanged,
+            this,
+            [=](int inValue)
+            {
+              if (mSequence == NULL)
+                return;
+              mSequenceTargetFrame = inValue;
+              mSequence->setCurrentFrame(inValue);
+              showSequenceFrame(inValue);
+            });
+  }
+  // ---------------------------------------------------------------------------
+  // initTileUI
+  // ---------------------------------------------------------------------------
+  void  initTileUI()
+  {
+    mTileComposeTimer.setSingleShot(true);
+    connect(&mTileComposeTimer, &QTimer::timeout,
+            this,
+            [=]()
+            {
+              composeTiles();
+            });
+    connect(mUI.mTileList, &QListWidget::itemChanged,
+            this,
+            [=](QListWidgetItem *inItem)
+            {
+              if (mTileSet == NULL)
+                return;
+              mTileSet->setTileVisible(mUI.mTileList->row(inItem),
+                                       inItem->checkState() == Qt::Checked);
+              composeTiles();
+            });
   }
   // ---------------------------------------------------------------------------
   // updatDisplaySettingUI
@@ -673,10 +2429,22 @@ protected:
   // ---------------------------------------------------------------------------
   virtual bool  appInit()
   {
+    if (mAppOptGeneratePointNum != 0)
+      return generateTestData();
+    if (mAppOptTileFileList.isEmpty() == false)
+      return openTiles(mAppOptTileFileList);
+    if (mAppOptStreamName.isEmpty() == false)
+      return startStream(mAppOptStreamName);
+    if (mAppOptSequenceFileName.isEmpty() == false)
+      return openSequence(mAppOptSequenceFileName);
     if (mAppOptFileNameSpecified)
+    {
+      if (mAppOptOutOfCore)
+        return openOutOfCore(mFileName);
       return readPLY(mFileName.toStdString().c_str());
+    }
     bool  isCanceled;
-    if (openFile(&isCanceled) == false)
+    if (openFile(&isCanceled, mAppOptOutOfCore) == false)
     {
       if (mAppOptEnaleTestData && isCanceled)
         return generateTestData();
@@ -716,42 +2484,7 @@ private:
   // ---------------------------------------------------------------------------
   void getBackdropColor(const GLfloat **outTopColor, const GLfloat **outBottomColor)
   {
-    static const GLfloat  colorTable[] =
-    {
-      0.780f, 0.860f, 0.930f,
-      0.360f, 0.500f, 0.660f,
-      0.000f, 0.360f, 0.600f,
-      0.000f, 0.070f, 0.200f,
-      0.930f, 0.900f, 0.900f,
-      0.360f, 0.300f, 0.300f,
-      0.430f, 0.400f, 0.400f,
-      0.060f, 0.010f, 0.010f,
-    };
-
-    switch (mBackColorMode)
-    {
-      case BACKDROP_COLOR_MODE_BLUE:
-        *outTopColor = &(colorTable[0]);
-        *outBottomColor = &(colorTable[3]);
-        break;
-      case BACKDROP_COLOR_MODE_DARK_BLUE:
-        *outTopColor = &(colorTable[6]);
-        *outBottomColor = &(colorTable[9]);
-        break;
-      case BACKDROP_COLOR_MODE_GRAY:
-        *outTopColor = &(colorTable[12]);
-        *outBottomColor = &(colorTable[15]);
-        break;
-      case BACKDROP_COLOR_MODE_DARK_GRAY:
-        *outTopColor = &(colorTable[18]);
-        *outBottomColor = &(colorTable[21]);
-        break;
-      default:
-      //case BACKDROP_COLOR_MODE_SINGLE:
-        *outTopColor = mBackColor;
-        *outBottomColor = mBackColor;
-        break;
-    }
+    qpcvGLView::getBackdropColor(mBackColorMode, mBackColor, outTopColor, outBottomColor);
   }
 
 private slots:
@@ -768,6 +2501,113 @@ private slots:
     }
   }
   // ---------------------------------------------------------------------------
+  // on_actionOpenOutOfCore_triggered
+  // ---------------------------------------------------------------------------
+  void on_actionOpenOutOfCore_triggered(void)
+  {
+    bool  isCanceled;
+    if (openFile(&isCanceled, true) == false)
+    {
+      if (isCanceled == false)
+        close();
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // on_actionOpenTiles_triggered
+  // ---------------------------------------------------------------------------
+  void on_actionOpenTiles_triggered(void)
+  {
+    QStringList fileList = QFileDialog::getOpenFileNames(
+                                        this,
+                                        tr("Open tiles"),
+                                        "",
+                                        tr("Point Cloud Files (*.ply *.ply.gz *.ply.zst *.pcd *.xyz *.xyzrgb);;All Files (*)"));
+    if (fileList.isEmpty())
+      return;
+    openTiles(fileList);
+  }
+  // ---------------------------------------------------------------------------
+  // on_actionOpenTileDirectory_triggered
+  // ---------------------------------------------------------------------------
+  void on_actionOpenTileDirectory_triggered(void)
+  {
+    QString dirName = QFileDialog::getExistingDirectory(this, tr("Open tile directory"));
+    if (dirName.isEmpty())
+      return;
+    QStringList fileList = qpcvTileSet::findTileFiles(dirName);
+    if (fileList.isEmpty())
+    {
+      QMessageBox::information(this, tr("qpcv"), tr("No point cloud files in %1").arg(dirName));
+      return;
+    }
+    openTiles(fileList);
+  }
+  // ---------------------------------------------------------------------------
+  // on_actionOpenStream_triggered
+  // ---------------------------------------------------------------------------
+  void on_actionOpenStream_triggered(void)
+  {
+    bool  isOK;
+    QString name = QInputDialog::getText(this, tr("Open Stream"),
+                                         tr("Local socket name:"), QLineEdit::Normal,
+                                         "qpcv", &isOK);
+    if (isOK == false || name.isEmpty())
+      return;
+    startStream(name);
+  }
+  // ---------------------------------------------------------------------------
+  // on_actionOpenSequence_triggered
+  // ---------------------------------------------------------------------------
+  void on_actionOpenSequence_triggered(void)
+  {
+    QString fileName = QFileDialog::getOpenFileName(
+                                        this,
+                                        tr("Open a frame of a PLY sequence"),
+                                        "",
+                                        tr("PLY File (*.ply);;All Files (*)"));
+    if (fileName.isEmpty())
+      return;
+    openSequence(fileName);
+  }
+  // ---------------------------------------------------------------------------
+  // on_actionExportPerfTrace_triggered
+  // ---------------------------------------------------------------------------
+  void on_actionExportPerfTrace_triggered(void)
+  {
+    if (mGLView->isHUDEnabled() == false)
+    {
+      QMessageBox::information(this, tr("qpcv"),
+                               tr("Frames are recorded while the performance HUD is shown."));
+      return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this,
+                          tr("Export Performance Trace"), "", tr("CSV Files (*.csv)"));
+    if (fileName.isEmpty())
+      return;
+    if (mGLView->exportPerfTrace(fileName) == false)
+      QMessageBox::critical(this, tr("qpcv"), tr("Failed to write %1").arg(fileName));
+  }
+  // ---------------------------------------------------------------------------
+  // on_actionSave_triggered
+  // ---------------------------------------------------------------------------
+  void on_actionSave_triggered(void)
+  {
+    QString filterTable[qpcvPLYWriter::FORMAT_NUM];
+    for (int i = 0; i < qpcvPLYWriter::FORMAT_NUM; i++)
+      filterTable[i] = tr("%1 Files (*.ply)").arg(qpcvPLYWriter::getFormatName(i));
+    QString selectedFilter;
+    QString fileName = QFileDialog::getSaveFileName(this,
+                          tr("Save As"), "",
+                          filterTable[0] + ";;" + filterTable[1], &selectedFilter);
+    if (fileName.isEmpty())
+      return;
+    int format = qpcvPLYWriter::FORMAT_BINARY;
+    for (int i = 0; i < qpcvPLYWriter::FORMAT_NUM; i++)
+      if (selectedFilter == filterTable[i])
+        format = i;
+    startSave(fileName, format);
+  }
+  // ---------------------------------------------------------------------------
   // on_actionQuit_triggered
   // ---------------------------------------------------------------------------
   void on_actionQuit_triggered(void)
@@ -1,4 +1,4 @@
-QT += core gui widgets
+QT += core gui widgets network
 
 TARGET = qpcv
 TEMPLATE = app
@@ -18,6 +18,27 @@ QMAKE_CXXFLAGS += -std=c++17
 #DEFINES += LIBIBC_OPENGL_MAJOR_VER="4"
 #DEFINES += LIBIBC_OPENGL_MINOR_VER="1"
 
+# The bounds computation (qpcv_bounds.h) uses AVX when it is enabled
+#QMAKE_CXXFLAGS += -mavx2
+
+# Compressed PLY input (.ply.gz / .ply.zst, qpcv_decompress_stream.h)
+# Enabled when pkg-config finds the library. Otherwise (e.g. Windows) set
+# the defines and the libraries by hand
+#DEFINES += QPCV_USE_ZLIB
+#LIBS += -lz
+#DEFINES += QPCV_USE_ZSTD
+#LIBS += -lzstd
+unix:packagesExist(zlib) {
+  CONFIG += link_pkgconfig
+  PKGCONFIG += zlib
+  DEFINES += QPCV_USE_ZLIB
+}
+unix:packagesExist(libzstd) {
+  CONFIG += link_pkgconfig
+  PKGCONFIG += libzstd
+  DEFINES += QPCV_USE_ZSTD
+}
+
 # 3.3 works for the most environments
 DEFINES += LIBIBC_OPENGL_MAJOR_VER="3"
 DEFINES += LIBIBC_OPENGL_MINOR_VER="3"
@@ -31,7 +52,48 @@ HEADERS += \
   ../libibc/include/ibc/qt/gl_obj_view.h \
   ../libibc/include/ibc/qt/gl_surface_plot.h \
   ../libibc/include/ibc/qt/gl_point_cloud_view.h \
-  qpcv.h
+  qpcv.h \
+  qpcv_loader.h \
+  qpcv_load_result.h \
+  qpcv_cache.h \
+  qpcv_ply_layout.h \
+  qpcv_ply_decoder.h \
+  qpcv_ply_ascii_decoder.h \
+  qpcv_parallel.h \
+  qpcv_bounds.h \
+  qpcv_lod.h \
+  qpcv_camera.h \
+  qpcv_point_layer.h \
+  qpcv_guide_layer.h \
+  qpcv_gl_view.h \
+  qpcv_chunk_store.h \
+  qpcv_chunk_pager.h \
+  qpcv_chunk_layer.h \
+  qpcv_stream_layer.h \
+  qpcv_quantize.h \
+  qpcv_benchmark.h \
+  qpcv_perf_hud.h \
+  qpcv_generator.h \
+  qpcv_tile_set.h \
+  qpcv_stream.h \
+  qpcv_sequence.h \
+  qpcv_spatial_index.h \
+  qpcv_histogram.h \
+  qpcv_histogram_view.h \
+  qpcv_voxel_filter.h \
+  qpcv_filter.h \
+  qpcv_filter_pipeline.h \
+  qpcv_ply_writer.h \
+  qpcv_ply_face_decoder.h \
+  qpcv_mesh_optimizer.h \
+  qpcv_lzf.h \
+  qpcv_text_decoder.h \
+  qpcv_pcd_decoder.h \
+  qpcv_decompress_stream.h \
+  qpcv_ply_stream_decoder.h \
+  qpcv_thumbnail.h \
+  qpcv_attribute_store.h \
+  qpcv_scalar_layer.h
 
 SOURCES += \
   main.cpp
@@ -0,0 +1,405 @@
+// =============================================================================
+//  qpcv_attribute_store.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_attribute_store.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Lazily decoded scalar vertex attributes of a PLY file
+*/
+
+#ifndef QPCV_ATTRIBUTE_STORE_H_
+#define QPCV_ATTRIBUTE_STORE_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <math.h>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QThread>
+#include <QElapsedTimer>
+#include "qpcv_ply_layout.h"
+#include "qpcv_ply_decoder.h"
+#include "qpcv_ply_ascii_decoder.h"
+#include "qpcv_parallel.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvAttributeStore class
+// -----------------------------------------------------------------------------
+// The vertex properties of a PLY file besides the position and the color
+// (intensity, confidence, normals ...) are not decoded by the loader. The
+// store only keeps the layout, and decode() reads one property as a float
+// array from the file when it is used for the first time. The array is meant
+// to be handed over to the GPU (see qpcvScalarLayer), so an attribute costs
+// host memory only while it is decoded. When the loader reorders the points
+// (qpcvLOD), the same reorder is applied to the attributes. Like qpcvCache,
+// the file must still have the size and the modification time it was
+// loaded with.
+class qpcvAttributeStore
+{
+public:
+  struct Attribute
+  {
+    std::string name;
+    qpcvPLYLayout::PropertyType type;
+    size_t  propertyIndex;
+    bool  isDecoded;      // minMax is valid
+    double  minMax[2];    // NaN values are ignored
+  };
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvAttributeStore
+  // ---------------------------------------------------------------------------
+  qpcvAttributeStore()
+  {
+    mVertexIndex = 0;
+    mFileSize = 0;
+    mFileModified = 0;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // init
+  // ---------------------------------------------------------------------------
+  // Returns false when the vertex element has no other scalar property than
+  // the ones in inMap (no store is needed then). inFileModified is the
+  // lastModified() of the loaded file in msec since the epoch
+  bool  init(const std::string &inFileName, qint64 inFileSize, qint64 inFileModified,
+             const qpcvPLYLayout &inLayout, size_t inVertexIndex,
+             const qpcvPLYDecoder::VertexMap &inMap)
+  {
+    mFileName = inFileName;
+    mFileSize = inFileSize;
+    mFileModified = inFileModified;
+    mLayout = inLayout;
+    mVertexIndex = inVertexIndex;
+    mAttributeTable.clear();
+    mSourceIndex.clear();
+
+    const qpcvPLYLayout::Element  &vertex = inLayout.getElement(inVertexIndex);
+    std::vector<bool> isUsed(vertex.properties.size(), false);
+    for (int i = 0; i < qpcvPLYDecoder::VERTEX_FIELD_NUM; i++)
+    {
+      if (inMap.isValid[i] == false)
+        continue;
+      if (i >= qpcvPLYDecoder::VERTEX_FIELD_R && inMap.hasColor == false)
+        continue;
+      isUsed[inMap.propertyIndex[i]] = true;
+    }
+    for (size_t i = 0; i < vertex.properties.size(); i++)
+    {
+      const qpcvPLYLayout::Property &property = vertex.properties[i];
+      if (isUsed[i] || property.isList)
+        continue;
+      if (inLayout.isBinary() && vertex.recordSize == 0)
+        continue;
+      Attribute attribute;
+      attribute.name = property.name;
+      attribute.type = property.type;
+      attribute.propertyIndex = i;
+      attribute.isDecoded = false;
+      attribute.minMax[0] = attribute.minMax[1] = 0;
+      mAttributeTable.push_back(attribute);
+    }
+    return (mAttributeTable.size() != 0);
+  }
+  // ---------------------------------------------------------------------------
+  // getAttributeNum
+  // ---------------------------------------------------------------------------
+  size_t  getAttributeNum() const
+  {
+    return mAttributeTable.size();
+  }
+  // ---------------------------------------------------------------------------
+  // getAttribute
+  // ---------------------------------------------------------------------------
+  const Attribute &getAttribute(size_t inIndex) const
+  {
+    return mAttributeTable[inIndex];
+  }
+  // ---------------------------------------------------------------------------
+  // setSourceIndex
+  // ---------------------------------------------------------------------------
+  // The index in the file of each point of the reordered data (see
+  // qpcvLOD::build()). ioTable is taken over
+  void  setSourceIndex(std::vector<uint32_t> *ioTable)
+  {
+    mSourceIndex.swap(*ioTable);
+  }
+  // ---------------------------------------------------------------------------
+  // decode
+  // ---------------------------------------------------------------------------
+  // outValues returns the attribute of every point in the order of the
+  // loaded data. inThreadNum <= 0 uses all cores. Returns false with an empty
+  // outErrorStr when canceled by inProgressFunc. One decode at a time (see
+  // qpcvAttributeDecoder)
+  bool  decode(size_t inIndex, int inThreadNum, std::vector<float> *outValues,
+               std::string *outErrorStr,
+               const qpcvParallel::ProgressFunc &inProgressFunc = qpcvParallel::ProgressFunc())
+  {
+    Attribute &attribute = mAttributeTable[inIndex];
+    const qpcvPLYLayout::Element  &vertex = mLayout.getElement(mVertexIndex);
+    QFile file(QString::fromStdString(mFileName));
+    if (file.open(QIODevice::ReadOnly) == false || file.size() != mFileSize ||
+        QFileInfo(file).lastModified().toMSecsSinceEpoch() != mFileModified)
+    {
+      *outErrorStr = "The file has been changed or removed since it was loaded";
+      return false;
+    }
+    const unsigned char *filePtr = file.map(0, mFileSize);
+    if (filePtr == NULL)
+    {
+      *outErrorStr = "Can't map the file";
+      return false;
+    }
+    const unsigned char *body = filePtr + mLayout.getHeaderSize();
+    size_t  bodySize = (size_t )mFileSize - mLayout.getHeaderSize();
+
+    std::vector<float>  values;
+    bool  result;
+    outErrorStr->clear();
+    if (mLayout.isBinary())
+      result = decodeBinary(attribute, body, bodySize, inThreadNum, &values,
+                            inProgressFunc, outErrorStr);
+    else
+      result = decodeAscii(attribute, body, bodySize, inThreadNum, &values,
+                           inProgressFunc, outErrorStr);
+    file.close();
+    if (result == false)
+      return false;
+
+    // Into the order of the loaded data
+    size_t  num = vertex.count;
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, num, 1024 * 1024);
+    if (mSourceIndex.size() == num)
+    {
+      outValues->resize(num);
+      qpcvParallel::forEachRange(num, threadNum, 64 * 1024,
+        [&](int, size_t inBegin, size_t inEnd)
+        {
+          for (size_t i = inBegin; i < inEnd; i++)
+            (*outValues)[i] = values[mSourceIndex[i]];
+        });
+    }
+    else
+      outValues->swap(values);
+
+    std::vector<double> minMaxTable(threadNum * 2, NAN);
+    qpcvParallel::forEachRange(num, threadNum, 64 * 1024,
+      [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+      {
+        double  *minMax = &(minMaxTable[inThreadIndex * 2]);
+        for (size_t i = inBegin; i < inEnd; i++)
+        {
+          double  value = (*outValues)[i];
+          if (isnan(value))
+            continue;
+          if (isnan(minMax[0]) || value < minMax[0])
+            minMax[0] = value;
+          if (isnan(minMax[1]) || value > minMax[1])
+            minMax[1] = value;
+        }
+      });
+    attribute.minMax[0] = attribute.minMax[1] = 0;
+    bool  isFirst = true;
+    for (int i = 0; i < threadNum; i++)
+    {
+      const double  *minMax = &(minMaxTable[i * 2]);
+      if (isnan(minMax[0]))
+        continue;
+      if (isFirst || minMax[0] < attribute.minMax[0])
+        attribute.minMax[0] = minMax[0];
+      if (isFirst || minMax[1] > attribute.minMax[1])
+        attribute.minMax[1] = minMax[1];
+      isFirst = false;
+    }
+    attribute.isDecoded = true;
+    return true;
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  std::string mFileName;
+  qint64  mFileSize;
+  qint64  mFileModified;    // msec since the epoch
+  qpcvPLYLayout mLayout;
+  size_t  mVertexIndex;
+  std::vector<Attribute>  mAttributeTable;
+  std::vector<uint32_t> mSourceIndex;   // Empty : the file order
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // decodeBinary
+  // ---------------------------------------------------------------------------
+  // Reads the column straight from the records
+  bool  decodeBinary(const Attribute &inAttribute,
+                     const unsigned char *inBody, size_t inBodySize, int inThreadNum,
+                     std::vector<float> *outValues,
+                     const qpcvParallel::ProgressFunc &inProgressFunc, std::string *outErrorStr)
+  {
+    const qpcvPLYLayout::Element  &vertex = mLayout.getElement(mVertexIndex);
+    const qpcvPLYLayout::Property &property = vertex.properties[inAttribute.propertyIndex];
+    size_t  vertexOffset;
+    if (mLayout.getBinaryElementOffset(mVertexIndex, &vertexOffset) == false ||
+        vertex.recordSize == 0 || vertexOffset > inBodySize ||
+        vertex.count > (inBodySize - vertexOffset) / vertex.recordSize)
+    {
+      *outErrorStr = "The PLY file is truncated";
+      return false;
+    }
+    const unsigned char *ptr = inBody + vertexOffset + property.offset;
+    const size_t  recordSize = vertex.recordSize;
+    const bool  swap = mLayout.needsByteSwap();
+    const qpcvPLYLayout::PropertyType type = property.type;
+    outValues->resize(vertex.count);
+    return qpcvParallel::forEachRange(
+      vertex.count,
+      qpcvParallel::getThreadNum(inThreadNum, vertex.count, qpcvPLYDecoder::PARALLEL_MIN_VERTEX_NUM),
+      64 * 1024,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+          (*outValues)[i] = (float )qpcvPLYDecoder::readValue(type, ptr + i * recordSize, swap);
+      },
+      inProgressFunc);
+  }
+  // ---------------------------------------------------------------------------
+  // decodeAscii
+  // ---------------------------------------------------------------------------
+  // Parses the column of the attribute only (see
+  // qpcvPLYAsciiDecoder::decodeColumnParallel())
+  bool  decodeAscii(const Attribute &inAttribute,
+                    const unsigned char *inBody, size_t inBodySize, int inThreadNum,
+                    std::vector<float> *outValues,
+                    const qpcvParallel::ProgressFunc &inProgressFunc, std::string *outErrorStr)
+  {
+    const qpcvPLYLayout::Element  &vertex = mLayout.getElement(mVertexIndex);
+    const std::string &headerStr = mLayout.getHeaderStr();
+    size_t  firstLineNum = std::count(headerStr.begin(), headerStr.end(), '\n') + 1;
+    outValues->resize(vertex.count);
+    return qpcvPLYAsciiDecoder::decodeColumnParallel(
+             mLayout, mVertexIndex, inAttribute.propertyIndex, inBody, inBodySize,
+             firstLineNum, outValues->data(), inThreadNum, inProgressFunc, outErrorStr);
+  }
+};
+
+// -----------------------------------------------------------------------------
+// qpcvAttributeDecoder class
+// -----------------------------------------------------------------------------
+// qpcvAttributeStore::decode() on a worker thread. The store must not be
+// deleted before the decoder finished (or was deleted, which waits for it),
+// and one decoder runs at a time per store
+class qpcvAttributeDecoder : public QThread
+{
+Q_OBJECT
+
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvAttributeDecoder
+  // ---------------------------------------------------------------------------
+  qpcvAttributeDecoder(qpcvAttributeStore *inStore, size_t inIndex, int inThreadNum,
+                       QObject *parent = Q_NULLPTR)
+  : QThread(parent)
+  {
+    mStore = inStore;
+    mIndex = inIndex;
+    mThreadNum = inThreadNum;
+    mIsSucceeded = false;
+    mTime = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvAttributeDecoder
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvAttributeDecoder()
+  {
+    requestInterruption();
+    wait();
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getIndex
+  // ---------------------------------------------------------------------------
+  size_t  getIndex() const
+  {
+    return mIndex;
+  }
+  // ---------------------------------------------------------------------------
+  // isSucceeded
+  // ---------------------------------------------------------------------------
+  // Only valid after finished() was emitted
+  bool  isSucceeded() const
+  {
+    return mIsSucceeded;
+  }
+  // ---------------------------------------------------------------------------
+  // getErrorStr
+  // ---------------------------------------------------------------------------
+  // Empty when canceled
+  QString getErrorStr() const
+  {
+    return QString::fromStdString(mErrorStr);
+  }
+  // ---------------------------------------------------------------------------
+  // takeValues
+  // ---------------------------------------------------------------------------
+  // The decoded values are swapped into ioValues
+  void  takeValues(std::vector<float> *ioValues)
+  {
+    mValues.swap(*ioValues);
+  }
+  // ---------------------------------------------------------------------------
+  // getTime
+  // ---------------------------------------------------------------------------
+  qint64  getTime() const
+  {
+    return mTime;
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  qpcvAttributeStore  *mStore;
+  size_t  mIndex;
+  int mThreadNum;
+  bool  mIsSucceeded;
+  std::string mErrorStr;
+  std::vector<float>  mValues;
+  qint64  mTime;
+
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  virtual void  run()
+  {
+    QElapsedTimer timer;
+    timer.start();
+    mIsSucceeded = mStore->decode(mIndex, mThreadNum, &mValues, &mErrorStr,
+                                  [&](size_t)
+                                  {
+                                    return !isInterruptionRequested();
+                                  });
+    if (isInterruptionRequested())
+      mErrorStr.clear();
+    mTime = timer.elapsed();
+  }
+};
+
+#endif  // #ifdef QPCV_ATTRIBUTE_STORE_H_
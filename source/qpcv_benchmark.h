@@ -0,0 +1,262 @@
+// =============================================================================
+//  qpcv_benchmark.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_benchmark.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Headless load and render benchmark (--benchmark)
+*/
+
+#ifndef QPCV_BENCHMARK_H_
+#define QPCV_BENCHMARK_H_
+
+// Includes --------------------------------------------------------------------
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+#include <QApplication>
+#include <QMouseEvent>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include "qpcv_loader.h"
+#include "qpcv_gl_view.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvBenchmark class
+// -----------------------------------------------------------------------------
+// Loads a file with qpcvLoader (same code path as the window), then renders a
+// camera orbit into an offscreen qpcvGLView. The orbit is driven by mouse drag
+// events, so it goes through the same camera code as an interactive session.
+// The upload is timed on its own (qpcvGLView::uploadData()) and each frame
+// ends with glFinish() (qpcvGLView::renderFrame()), so no read back is timed.
+// The LOD is off unless mIsLODEnabled, otherwise the orbit would draw the
+// interaction budget of the view. The JSON reports it with the mean number of
+// points per frame
+class qpcvBenchmark
+{
+public:
+  // Constants -----------------------------------------------------------------
+  static const int  DEFAULT_FRAME_NUM = 300;
+  static const int  VIEW_WIDTH = 1280;
+  static const int  VIEW_HEIGHT = 720;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvBenchmark
+  // ---------------------------------------------------------------------------
+  qpcvBenchmark()
+  {
+    mFrameNum = DEFAULT_FRAME_NUM;
+    mDecodeThreadNum = 0;
+    mLODMinPointNum = qpcvLoader::DEFAULT_LOD_MIN_POINT_NUM;
+    mIsCacheEnabled = false;
+    mIsLODEnabled = false;
+  }
+
+  // Member variables ----------------------------------------------------------
+  QString mFileName;
+  QString mOutputFileName;    // Empty : stdout
+  int mFrameNum;
+  int mDecodeThreadNum;
+  size_t  mLODMinPointNum;
+  bool  mIsCacheEnabled;
+  QString mCacheDir;
+  bool  mIsLODEnabled;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  // Returns the process exit code
+  int run()
+  {
+    QJsonObject json;
+    json["file"] = mFileName;
+
+    // Load
+    QElapsedTimer timer;
+    timer.start();
+    qpcvLoader  loader(mFileName, mDecodeThreadNum, mLODMinPointNum);
+    loader.setCache(mIsCacheEnabled, mCacheDir);
+    loader.start();
+    loader.wait();
+    qint64  loadTime = timer.elapsed();
+    qpcvLoadResult  *result = loader.takeResult();
+    if (result == NULL)
+    {
+      std::cerr << "Failed to load: " << loader.getErrorStr().toStdString() << std::endl;
+      return 1;
+    }
+    QJsonObject load;
+    load["points"] = (double )result->dataNum;
+    load["bytes"] = (double )result->fileSize;
+    load["format"] = QString(result->formatStr.c_str());
+    load["headerMs"] = (double )result->headerTime;
+    load["decodeMs"] = (double )result->decodeTime;
+    load["boundsMs"] = (double )result->boundsTime;
+    load["faceMs"] = (double )result->faceTime;
+    load["triangles"] = (double )(result->faceIndex.size() / 3);
+    load["lodMs"] = (double )result->lodTime;
+    load["histogramMs"] = (double )result->histogramTime;
+    load["cacheMs"] = (double )result->cacheTime;
+    load["fromCache"] = result->isFromCache;
+    load["totalMs"] = (double )loadTime;
+    load["MBPerSec"] = getRate(result->fileSize / (1024.0 * 1024.0), loadTime);
+    load["decodePointsPerSec"] = getRate((double )result->dataNum, result->decodeTime);
+
+    // Upload, then a first frame (program setup and the first draw)
+    qpcvGLView  view;
+    view.setAttribute(Qt::WA_DontShowOnScreen);
+    view.resize(VIEW_WIDTH, VIEW_HEIGHT);
+    view.show();
+    QApplication::processEvents();
+    view.grabFramebuffer();   // Creates the context (not timed)
+    view.setPointData(result->data, result->dataNum,
+                      mIsLODEnabled ? result->lodLevelEndTable : std::vector<size_t>());
+    view.setMeshData(result->faceIndex.data(), result->faceIndex.size() / 3);
+    if (view.hasMesh())
+      view.setRenderMode(qpcvGLView::RENDER_MODE_SHADED);
+    view.setModelFitParam(result->param);
+    timer.restart();
+    view.uploadData();
+    load["uploadMs"] = timer.nsecsElapsed() / 1000000.0;
+    timer.restart();
+    view.renderFrame();
+    load["firstFrameMs"] = timer.nsecsElapsed() / 1000000.0;
+    json["load"] = load;
+
+    // Orbit (a left button drag across half the view width)
+    std::vector<double> frameTable;
+    QPoint  pos(VIEW_WIDTH / 2, VIEW_HEIGHT / 2);
+    sendMouseEvent(&view, QEvent::MouseButtonPress, pos);
+    size_t  drawNum = 0;
+    for (int i = 0; i < mFrameNum; i++)
+    {
+      pos.setX(VIEW_WIDTH / 4 + (VIEW_WIDTH / 2) * (i + 1) / mFrameNum);
+      sendMouseEvent(&view, QEvent::MouseMove, pos);
+      timer.restart();
+      view.renderFrame();
+      frameTable.push_back(timer.nsecsElapsed() / 1000000.0);
+      drawNum += view.getDrawNum();
+    }
+    sendMouseEvent(&view, QEvent::MouseButtonRelease, pos);
+    bool  isLOD = view.hasLOD();
+    size_t  dataNum = result->dataNum;
+    view.setPointData(NULL, 0, std::vector<size_t>());
+    delete result;
+
+    QJsonObject render;
+    render["frames"] = mFrameNum;
+    render["width"] = VIEW_WIDTH;
+    render["height"] = VIEW_HEIGHT;
+    render["lod"] = isLOD;
+    render["meanDrawPoints"] = (mFrameNum <= 0) ? 0 : (double )drawNum / mFrameNum;
+    render["dataPoints"] = (double )dataNum;
+    std::sort(frameTable.begin(), frameTable.end());
+    double  totalMs = 0;
+    for (size_t i = 0; i < frameTable.size(); i++)
+      totalMs += frameTable[i];
+    render["meanMs"] = frameTable.size() == 0 ? 0 : totalMs / frameTable.size();
+    render["p50Ms"] = getPercentile(frameTable, 50);
+    render["p90Ms"] = getPercentile(frameTable, 90);
+    render["p99Ms"] = getPercentile(frameTable, 99);
+    render["maxMs"] = getPercentile(frameTable, 100);
+    render["pointsPerSec"] = getRate((double )drawNum, totalMs);
+    json["render"] = render;
+    json["peakRSSBytes"] = (double )getPeakRSS();
+
+    QByteArray  str = QJsonDocument(json).toJson();
+    if (mOutputFileName.size() == 0)
+    {
+      std::cout << str.toStdString();
+      return 0;
+    }
+    QFile file(mOutputFileName);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate) == false ||
+        file.write(str) != str.size())
+    {
+      std::cerr << "Can't write " << mOutputFileName.toStdString() << std::endl;
+      return 1;
+    }
+    return 0;
+  }
+
+protected:
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // sendMouseEvent
+  // ---------------------------------------------------------------------------
+  static void sendMouseEvent(QWidget *inWidget, QEvent::Type inType, const QPoint &inPos)
+  {
+    Qt::MouseButtons  buttons = Qt::LeftButton;
+    if (inType == QEvent::MouseButtonRelease)
+      buttons = Qt::NoButton;
+    QMouseEvent event(inType, inPos, inWidget->mapToGlobal(inPos),
+                      Qt::LeftButton, buttons, Qt::NoModifier);
+    QApplication::sendEvent(inWidget, &event);
+  }
+  // ---------------------------------------------------------------------------
+  // getPercentile
+  // ---------------------------------------------------------------------------
+  // inTable must be sorted (nearest rank)
+  static double getPercentile(const std::vector<double> &inTable, int inPercent)
+  {
+    if (inTable.size() == 0)
+      return 0;
+    size_t  rank = (size_t )ceil(inPercent / 100.0 * inTable.size());
+    if (rank < 1)
+      rank = 1;
+    if (rank > inTable.size())
+      rank = inTable.size();
+    return inTable[rank - 1];
+  }
+  // ---------------------------------------------------------------------------
+  // getRate
+  // ---------------------------------------------------------------------------
+  static double getRate(double inAmount, double inMsec)
+  {
+    if (inMsec <= 0)
+      return 0;
+    return inAmount * 1000.0 / inMsec;
+  }
+  // ---------------------------------------------------------------------------
+  // getPeakRSS
+  // ---------------------------------------------------------------------------
+  // 0 when not supported
+  static size_t getPeakRSS()
+  {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+      return 0;
+#if defined(__APPLE__)
+    return (size_t )usage.ru_maxrss;          // bytes
+#else
+    return (size_t )usage.ru_maxrss * 1024;   // kilobytes
+#endif
+#else
+    return 0;
+#endif
+  }
+};
+
+#endif  // #ifdef QPCV_BENCHMARK_H_
@@ -0,0 +1,242 @@
+// =============================================================================
+//  qpcv_bounds.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_bounds.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Min / max reduction of glXYZf_RGBAub data
+*/
+
+#ifndef QPCV_BOUNDS_H_
+#define QPCV_BOUNDS_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <float.h>
+#if defined(__AVX2__) || defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define QPCV_BOUNDS_SSE2
+#endif
+#include "qpcv_parallel.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+#include "ibc/gl/file/ply.h"
+
+// -----------------------------------------------------------------------------
+// qpcvBounds class
+// -----------------------------------------------------------------------------
+// Meant to be fed right after each decoded block while it still is in the cache,
+// so no separate pass over the whole data is needed. One object per thread,
+// merged at the end.
+class qpcvBounds
+{
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvBounds
+  // ---------------------------------------------------------------------------
+  qpcvBounds()
+  {
+    clear();
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // clear
+  // ---------------------------------------------------------------------------
+  void  clear()
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      mMin[i] = FLT_MAX;
+      mMax[i] = -FLT_MAX;
+    }
+    mNum = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // add
+  // ---------------------------------------------------------------------------
+  // NaN coordinates are ignored (like the comparisons of the scalar code)
+  void  add(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum)
+  {
+    addBlock(inData, inNum);
+    mNum += inNum;
+  }
+  // ---------------------------------------------------------------------------
+  // add
+  // ---------------------------------------------------------------------------
+  void  add(const ibc::gl::glXYZf_RGBAub &inData)
+  {
+    addBlock(&inData, 1);
+    mNum++;
+  }
+  // ---------------------------------------------------------------------------
+  // merge
+  // ---------------------------------------------------------------------------
+  void  merge(const qpcvBounds &inBounds)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      if (inBounds.mMin[i] < mMin[i])
+        mMin[i] = inBounds.mMin[i];
+      if (inBounds.mMax[i] > mMax[i])
+        mMax[i] = inBounds.mMax[i];
+    }
+    mNum += inBounds.mNum;
+  }
+  // ---------------------------------------------------------------------------
+  // getNum
+  // ---------------------------------------------------------------------------
+  size_t  getNum() const
+  {
+    return mNum;
+  }
+  // ---------------------------------------------------------------------------
+  // getMinMax
+  // ---------------------------------------------------------------------------
+  // Same order as calcFitParam_glXYZf_RGBAub() (x min, x max, y min, ...)
+  void  getMinMax(GLfloat *outMinMax) const
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      if (mNum == 0)
+      {
+        outMinMax[i * 2 + 0] = 0;
+        outMinMax[i * 2 + 1] = 0;
+        continue;
+      }
+      outMinMax[i * 2 + 0] = mMin[i];
+      outMinMax[i * 2 + 1] = mMax[i];
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // calcFitParam
+  // ---------------------------------------------------------------------------
+  // The fit parameters only depend on the bounding box, so they are obtained
+  // by running calcFitParam_glXYZf_RGBAub() on its two corners instead of on
+  // the whole data
+  void  calcFitParam(GLfloat *outParam, GLfloat *outMinMax) const
+  {
+    GLfloat minMax[6];
+    getMinMax(minMax);
+    ibc::gl::glXYZf_RGBAub  corner[2];
+    for (int i = 0; i < 2; i++)
+    {
+      corner[i].x = minMax[0 + i];
+      corner[i].y = minMax[2 + i];
+      corner[i].z = minMax[4 + i];
+      corner[i].r = corner[i].g = corner[i].b = corner[i].a = 255;
+    }
+    ibc::gl::file::PLYFile::calcFitParam_glXYZf_RGBAub(corner, 2, outParam, outMinMax);
+  }
+  // ---------------------------------------------------------------------------
+  // calcParallel
+  // ---------------------------------------------------------------------------
+  // For the data that is not decoded by us (e.g. zero copy mapped data)
+  static void calcParallel(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                           int inThreadNum, qpcvBounds *outBounds)
+  {
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, inNum, 1024 * 1024);
+    std::vector<qpcvBounds> boundsTable(threadNum);
+    qpcvParallel::forEachRange(
+      inNum, threadNum, 1024 * 1024,
+      [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+      {
+        boundsTable[inThreadIndex].add(inData + inBegin, inEnd - inBegin);
+      });
+    outBounds->clear();
+    for (size_t i = 0; i < boundsTable.size(); i++)
+      outBounds->merge(boundsTable[i]);
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  GLfloat mMin[3], mMax[3];
+  size_t  mNum;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // addBlock
+  // ---------------------------------------------------------------------------
+  // One glXYZf_RGBAub is exactly 16 bytes, so a point is one 128 bit load
+  // (the 4th lane holds the color bits and is ignored). AVX handles two points
+  // per 256 bit load. minps / maxps return the second operand when either one
+  // is NaN, so the loaded point goes first: a NaN coordinate keeps the
+  // accumulator, which therefore never holds NaN (the reductions are safe)
+  void  addBlock(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum)
+  {
+    static_assert(sizeof(ibc::gl::glXYZf_RGBAub) == 16, "unexpected glXYZf_RGBAub size");
+    size_t  i = 0;
+    float minBuf[4], maxBuf[4];
+#if defined(__AVX2__) || defined(__AVX__)
+    __m256  min8 = _mm256_set1_ps(FLT_MAX);
+    __m256  max8 = _mm256_set1_ps(-FLT_MAX);
+    for (; i + 2 <= inNum; i += 2)
+    {
+      __m256  v = _mm256_loadu_ps((const float *)(inData + i));
+      min8 = _mm256_min_ps(v, min8);
+      max8 = _mm256_max_ps(v, max8);
+    }
+    __m128  min4 = _mm_min_ps(_mm256_castps256_ps128(min8), _mm256_extractf128_ps(min8, 1));
+    __m128  max4 = _mm_max_ps(_mm256_castps256_ps128(max8), _mm256_extractf128_ps(max8, 1));
+    for (; i < inNum; i++)
+    {
+      __m128  v = _mm_loadu_ps((const float *)(inData + i));
+      min4 = _mm_min_ps(v, min4);
+      max4 = _mm_max_ps(v, max4);
+    }
+    _mm_storeu_ps(minBuf, min4);
+    _mm_storeu_ps(maxBuf, max4);
+#elif defined(QPCV_BOUNDS_SSE2)
+    __m128  min4 = _mm_set1_ps(FLT_MAX);
+    __m128  max4 = _mm_set1_ps(-FLT_MAX);
+    for (; i < inNum; i++)
+    {
+      __m128  v = _mm_loadu_ps((const float *)(inData + i));
+      min4 = _mm_min_ps(v, min4);
+      max4 = _mm_max_ps(v, max4);
+    }
+    _mm_storeu_ps(minBuf, min4);
+    _mm_storeu_ps(maxBuf, max4);
+#else
+    for (int j = 0; j < 3; j++)
+    {
+      minBuf[j] = FLT_MAX;
+      maxBuf[j] = -FLT_MAX;
+    }
+    for (; i < inNum; i++)
+    {
+      const GLfloat *v = &(inData[i].x);
+      for (int j = 0; j < 3; j++)
+      {
+        if (v[j] < minBuf[j])
+          minBuf[j] = v[j];
+        if (v[j] > maxBuf[j])
+          maxBuf[j] = v[j];
+      }
+    }
+#endif
+    for (int j = 0; j < 3; j++)
+    {
+      if (minBuf[j] < mMin[j])
+        mMin[j] = minBuf[j];
+      if (maxBuf[j] > mMax[j])
+        mMax[j] = maxBuf[j];
+    }
+  }
+};
+
+#endif  // #ifdef QPCV_BOUNDS_H_
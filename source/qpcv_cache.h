@@ -0,0 +1,266 @@
+// =============================================================================
+//  qpcv_cache.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_cache.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Sidecar cache of a decoded PLY file
+*/
+
+#ifndef QPCV_CACHE_H_
+#define QPCV_CACHE_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <functional>
+#include <string.h>
+#include <stdint.h>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include "qpcv_load_result.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvCache class
+// -----------------------------------------------------------------------------
+// File layout : FileHeader, the LOD level end table (uint64_t), the header,
+// format and color format strings, then the glXYZf_RGBAub data at a page
+// aligned offset followed by the triangle indices (if any). The data is used
+// straight from the read-only mapping when the cache is read, so a reopen
+// costs one mmap() call (and a copy of the indices for a mesh).
+class qpcvCache
+{
+public:
+  // Called with the number of written bytes. Return false to cancel
+  typedef std::function<bool(qint64 inDoneBytes, qint64 inTotalBytes)> ProgressFunc;
+
+  struct FileHeader
+  {
+    char      magic[8];
+    uint64_t  sourceSize;
+    int64_t   sourceModified;   // msec since epoch
+    uint64_t  dataNum;
+    uint64_t  dataOffset;
+    uint64_t  faceIndexNum;     // Follow the data (uint32_t)
+    uint64_t  faceNum;
+    uint32_t  pointSize;        // sizeof(glXYZf_RGBAub)
+    uint32_t  levelNum;         // 0 : not in the qpcvLOD order
+    uint32_t  headerStrSize;
+    uint32_t  formatStrSize;
+    uint32_t  colorFormatStrSize;
+    uint32_t  hasFace;
+    GLfloat   param[4];
+    GLfloat   minMax[6];
+  };
+
+  // Constants -----------------------------------------------------------------
+  static const size_t DATA_ALIGNMENT = 4096;
+  static const size_t WRITE_BLOCK_SIZE = 64 * 1024 * 1024;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getCacheFileName
+  // ---------------------------------------------------------------------------
+  // Next to the source file when inCacheDir is empty. In a cache directory the
+  // name is made from the hash of the absolute path of the source
+  static QString  getCacheFileName(const QString &inSourceFileName, const QString &inCacheDir)
+  {
+    if (inCacheDir.size() == 0)
+      return inSourceFileName + ".qpcvcache";
+    QFileInfo fileInfo(inSourceFileName);
+    QByteArray  hash = QCryptographicHash::hash(fileInfo.absoluteFilePath().toUtf8(),
+                                                QCryptographicHash::Md5);
+    return QDir(inCacheDir).filePath(fileInfo.fileName() + "." +
+                                     QString(hash.toHex()) + ".qpcvcache");
+  }
+  // ---------------------------------------------------------------------------
+  // read
+  // ---------------------------------------------------------------------------
+  // Fails when there is no cache or it does not match the source file (size
+  // and modification time). On success outResult->data points into the mapping
+  // owned by outResult->mappedFile
+  static bool read(const QString &inSourceFileName, const QString &inCacheDir,
+                   qpcvLoadResult *outResult)
+  {
+    QFileInfo sourceInfo(inSourceFileName);
+    QFile *file = new QFile(getCacheFileName(inSourceFileName, inCacheDir));
+    FileHeader  header;
+    if (file->open(QIODevice::ReadOnly) == false ||
+        file->read((char *)&header, sizeof(header)) != sizeof(header) ||
+        isValidHeader(header, sourceInfo, file->size()) == false)
+    {
+      delete file;
+      return false;
+    }
+    const unsigned char *ptr = file->map(0, file->size());
+    if (ptr == NULL)
+    {
+      delete file;
+      return false;
+    }
+    const unsigned char *pos = ptr + sizeof(header);
+    std::vector<size_t> levelEndTable(header.levelNum);
+    for (uint32_t i = 0; i < header.levelNum; i++)
+    {
+      uint64_t  value;
+      memcpy(&value, pos, sizeof(value));
+      levelEndTable[i] = (size_t )value;
+      pos += sizeof(value);
+    }
+    outResult->headerStr.assign((const char *)pos, header.headerStrSize);
+    pos += header.headerStrSize;
+    outResult->formatStr.assign((const char *)pos, header.formatStrSize);
+    pos += header.formatStrSize;
+    outResult->colorFormatStr.assign((const char *)pos, header.colorFormatStrSize);
+    const uint32_t  *faceIndex = (const uint32_t *)(ptr + getFaceIndexOffset(header));
+    outResult->faceIndex.assign(faceIndex, faceIndex + header.faceIndexNum);
+    outResult->faceNum = (size_t )header.faceNum;
+
+    outResult->fileName = inSourceFileName.toStdString();
+    outResult->fileSize = sourceInfo.size();
+    outResult->data = (ibc::gl::glXYZf_RGBAub *)(ptr + header.dataOffset);
+    outResult->dataNum = (size_t )header.dataNum;
+    outResult->mappedFile = file;
+    outResult->hasFace = (header.hasFace != 0);
+    for (int i = 0; i < 4; i++)
+      outResult->param[i] = header.param[i];
+    for (int i = 0; i < 6; i++)
+      outResult->minMax[i] = header.minMax[i];
+    outResult->lodLevelEndTable = levelEndTable;
+    outResult->isFromCache = true;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // write
+  // ---------------------------------------------------------------------------
+  // Written to a temporary file which is renamed at the end, so a canceled or
+  // failed write never leaves a cache that looks valid
+  static bool write(const QString &inSourceFileName, const QString &inCacheDir,
+                    const qpcvLoadResult &inResult,
+                    const ProgressFunc &inProgressFunc = ProgressFunc())
+  {
+    QFileInfo sourceInfo(inSourceFileName);
+    QString cacheFileName = getCacheFileName(inSourceFileName, inCacheDir);
+    if (inCacheDir.size() != 0)
+      QDir().mkpath(inCacheDir);
+
+    FileHeader  header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, getMagic(), sizeof(header.magic));
+    header.sourceSize = (uint64_t )sourceInfo.size();
+    header.sourceModified = sourceInfo.lastModified().toMSecsSinceEpoch();
+    header.dataNum = inResult.dataNum;
+    header.pointSize = sizeof(ibc::gl::glXYZf_RGBAub);
+    header.levelNum = (uint32_t )inResult.lodLevelEndTable.size();
+    header.headerStrSize = (uint32_t )inResult.headerStr.size();
+    header.formatStrSize = (uint32_t )inResult.formatStr.size();
+    header.colorFormatStrSize = (uint32_t )inResult.colorFormatStr.size();
+    header.hasFace = inResult.hasFace ? 1 : 0;
+    header.faceIndexNum = inResult.faceIndex.size();
+    header.faceNum = inResult.faceNum;
+    for (int i = 0; i < 4; i++)
+      header.param[i] = inResult.param[i];
+    for (int i = 0; i < 6; i++)
+      header.minMax[i] = inResult.minMax[i];
+
+    // Everything before the data
+    std::string meta((const char *)&header, sizeof(header));
+    for (size_t i = 0; i < inResult.lodLevelEndTable.size(); i++)
+    {
+      uint64_t  value = inResult.lodLevelEndTable[i];
+      meta.append((const char *)&value, sizeof(value));
+    }
+    meta += inResult.headerStr;
+    meta += inResult.formatStr;
+    meta += inResult.colorFormatStr;
+    header.dataOffset = (meta.size() + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT * DATA_ALIGNMENT;
+    memcpy(&meta[0], &header, sizeof(header));
+    meta.resize((size_t )header.dataOffset, '\0');
+
+    QFile file(cacheFileName + ".tmp");
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate) == false)
+      return false;
+    bool  result = (file.write(meta.data(), (qint64 )meta.size()) == (qint64 )meta.size());
+    const char  *data = (const char *)inResult.data;
+    qint64  dataSize = (qint64 )(inResult.dataNum * sizeof(ibc::gl::glXYZf_RGBAub));
+    for (qint64 done = 0; result && done < dataSize; done += WRITE_BLOCK_SIZE)
+    {
+      qint64  size = dataSize - done;
+      if (size > (qint64 )WRITE_BLOCK_SIZE)
+        size = WRITE_BLOCK_SIZE;
+      if (file.write(data + done, size) != size)
+        result = false;
+      else if (inProgressFunc && inProgressFunc(done + size, dataSize) == false)
+        result = false;
+    }
+    qint64  faceIndexSize = (qint64 )(inResult.faceIndex.size() * sizeof(uint32_t));
+    if (result && faceIndexSize != 0 &&
+        file.write((const char *)inResult.faceIndex.data(), faceIndexSize) != faceIndexSize)
+      result = false;
+    file.close();
+    if (result)
+    {
+      QFile::remove(cacheFileName);
+      result = file.rename(cacheFileName);
+    }
+    if (result == false)
+      file.remove();
+    return result;
+  }
+
+protected:
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getMagic
+  // ---------------------------------------------------------------------------
+  static const char *getMagic()
+  {
+    return "QPCVCAC2";
+  }
+  // ---------------------------------------------------------------------------
+  // getFaceIndexOffset
+  // ---------------------------------------------------------------------------
+  static uint64_t getFaceIndexOffset(const FileHeader &inHeader)
+  {
+    return inHeader.dataOffset + inHeader.dataNum * sizeof(ibc::gl::glXYZf_RGBAub);
+  }
+  // ---------------------------------------------------------------------------
+  // isValidHeader
+  // ---------------------------------------------------------------------------
+  static bool isValidHeader(const FileHeader &inHeader, const QFileInfo &inSourceInfo,
+                            qint64 inCacheSize)
+  {
+    if (memcmp(inHeader.magic, getMagic(), sizeof(inHeader.magic)) != 0 ||
+        inHeader.pointSize != sizeof(ibc::gl::glXYZf_RGBAub) ||
+        inHeader.sourceSize != (uint64_t )inSourceInfo.size() ||
+        inHeader.sourceModified != inSourceInfo.lastModified().toMSecsSinceEpoch())
+      return false;
+    uint64_t  metaSize = sizeof(FileHeader) + inHeader.levelNum * sizeof(uint64_t) +
+                         inHeader.headerStrSize + inHeader.formatStrSize +
+                         inHeader.colorFormatStrSize;
+    if (inHeader.dataOffset < metaSize ||
+        inHeader.dataOffset % DATA_ALIGNMENT != 0 ||
+        getFaceIndexOffset(inHeader) + inHeader.faceIndexNum * sizeof(uint32_t) >
+          (uint64_t )inCacheSize)
+      return false;
+    return true;
+  }
+};
+
+#endif  // #ifdef QPCV_CACHE_H_
@@ -0,0 +1,231 @@
+// =============================================================================
+//  qpcv_camera.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_camera.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Orbit camera of qpcvGLView
+*/
+
+#ifndef QPCV_CAMERA_H_
+#define QPCV_CAMERA_H_
+
+// Includes --------------------------------------------------------------------
+#include <math.h>
+#include <QMatrix4x4>
+#include <QVector3D>
+
+// -----------------------------------------------------------------------------
+// qpcvCamera class
+// -----------------------------------------------------------------------------
+// A perspective camera orbiting a target point. It works in the fitted model
+// coordinates (the cloud scaled into about [-1, 1] by the fit parameters), so
+// the default position frames any cloud. The mouse deltas are in pixels of
+// the viewport given to setViewportSize(). With setTile(), the projection
+// covers one tile of a larger image (an off-axis frustum).
+class qpcvCamera
+{
+public:
+  // Constants -----------------------------------------------------------------
+  static constexpr double DEFAULT_DISTANCE = 3.0;
+  static constexpr double MIN_DISTANCE = 0.001;
+  static constexpr double MAX_DISTANCE = 1000.0;
+  static constexpr double FOV_DEGREE = 45.0;
+  // Degrees of a drag across the viewport height
+  static constexpr double ORBIT_DEGREE = 180.0;
+  static constexpr double DOLLY_RATIO = 0.9;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvCamera
+  // ---------------------------------------------------------------------------
+  qpcvCamera()
+  {
+    mViewportWidth = 1;
+    mViewportHeight = 1;
+    clearTile();
+    reset();
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // reset
+  // ---------------------------------------------------------------------------
+  // Looks at the origin down the -z axis
+  void  reset()
+  {
+    mTarget = QVector3D(0, 0, 0);
+    mDistance = DEFAULT_DISTANCE;
+    mYaw = 0;
+    mPitch = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // setViewportSize
+  // ---------------------------------------------------------------------------
+  void  setViewportSize(int inWidth, int inHeight)
+  {
+    mViewportWidth = (inWidth > 0) ? inWidth : 1;
+    mViewportHeight = (inHeight > 0) ? inHeight : 1;
+  }
+  // ---------------------------------------------------------------------------
+  // setTile
+  // ---------------------------------------------------------------------------
+  // The projection only covers the inWidth x inHeight part whose top left is
+  // (inX, inY) of an inImageWidth x inImageHeight image, so an image of any
+  // size can be rendered a viewport at a time. The tile may extend past the
+  // image (the part outside is cropped by the caller)
+  void  setTile(int inX, int inY, int inWidth, int inHeight,
+                int inImageWidth, int inImageHeight)
+  {
+    mIsTileEnabled = (inImageWidth > 0 && inImageHeight > 0);
+    if (mIsTileEnabled == false)
+      return;
+    mTile[0] = (double )inX / inImageWidth;
+    mTile[1] = (double )(inX + inWidth) / inImageWidth;
+    mTile[2] = (double )inY / inImageHeight;
+    mTile[3] = (double )(inY + inHeight) / inImageHeight;
+    mImageAspect = (double )inImageWidth / inImageHeight;
+  }
+  // ---------------------------------------------------------------------------
+  // clearTile
+  // ---------------------------------------------------------------------------
+  void  clearTile()
+  {
+    mIsTileEnabled = false;
+    mTile[0] = mTile[2] = 0;
+    mTile[1] = mTile[3] = 1;
+    mImageAspect = 1;
+  }
+  // ---------------------------------------------------------------------------
+  // orbit
+  // ---------------------------------------------------------------------------
+  void  orbit(double inDeltaX, double inDeltaY)
+  {
+    mYaw += inDeltaX * ORBIT_DEGREE / mViewportHeight;
+    mPitch += inDeltaY * ORBIT_DEGREE / mViewportHeight;
+    mYaw = fmod(mYaw, 360.0);
+    if (mPitch > 90.0)
+      mPitch = 90.0;
+    if (mPitch < -90.0)
+      mPitch = -90.0;
+  }
+  // ---------------------------------------------------------------------------
+  // pan
+  // ---------------------------------------------------------------------------
+  // The point under the cursor at the target depth follows the cursor
+  void  pan(double inDeltaX, double inDeltaY)
+  {
+    double  scale = 2.0 * mDistance * tan(FOV_DEGREE * M_PI / 360.0) / mViewportHeight;
+    QMatrix4x4  rotation = getRotationMatrix().transposed();
+    QVector3D right = rotation.mapVector(QVector3D(1, 0, 0));
+    QVector3D up = rotation.mapVector(QVector3D(0, 1, 0));
+    mTarget -= right * (float )(inDeltaX * scale);
+    mTarget += up * (float )(inDeltaY * scale);
+  }
+  // ---------------------------------------------------------------------------
+  // dolly
+  // ---------------------------------------------------------------------------
+  // inStep > 0 moves closer (one wheel notch is one step)
+  void  dolly(double inStep)
+  {
+    mDistance *= pow(DOLLY_RATIO, inStep);
+    if (mDistance < MIN_DISTANCE)
+      mDistance = MIN_DISTANCE;
+    if (mDistance > MAX_DISTANCE)
+      mDistance = MAX_DISTANCE;
+  }
+  // ---------------------------------------------------------------------------
+  // getViewMatrix
+  // ---------------------------------------------------------------------------
+  // Model (fitted) coordinates to eye coordinates
+  QMatrix4x4  getViewMatrix() const
+  {
+    QMatrix4x4  matrix;
+    matrix.translate(0, 0, (float )-mDistance);
+    matrix *= getRotationMatrix();
+    matrix.translate(-mTarget);
+    return matrix;
+  }
+  // ---------------------------------------------------------------------------
+  // getProjectionMatrix
+  // ---------------------------------------------------------------------------
+  QMatrix4x4  getProjectionMatrix() const
+  {
+    QMatrix4x4  matrix;
+    if (mIsTileEnabled == false)
+    {
+      matrix.perspective((float )FOV_DEGREE, (float )mViewportWidth / mViewportHeight,
+                         (float )getNearPlane(), (float )getFarPlane());
+      return matrix;
+    }
+    // The part of the image frustum at the near plane (the tile is top down)
+    double  top = getNearPlane() * tan(FOV_DEGREE * M_PI / 360.0);
+    double  right = top * mImageAspect;
+    matrix.frustum((float )(right * (mTile[0] * 2.0 - 1.0)),
+                   (float )(right * (mTile[1] * 2.0 - 1.0)),
+                   (float )(top * (1.0 - mTile[3] * 2.0)),
+                   (float )(top * (1.0 - mTile[2] * 2.0)),
+                   (float )getNearPlane(), (float )getFarPlane());
+    return matrix;
+  }
+  // ---------------------------------------------------------------------------
+  // getDistance
+  // ---------------------------------------------------------------------------
+  double  getDistance() const
+  {
+    return mDistance;
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  QVector3D mTarget;
+  double  mDistance;
+  double  mYaw;       // Degrees around the y axis
+  double  mPitch;     // Degrees around the x axis
+  int mViewportWidth;
+  int mViewportHeight;
+  bool  mIsTileEnabled;
+  double  mTile[4];     // Left, right, top, bottom in 0 - 1 of the image
+  double  mImageAspect;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getRotationMatrix
+  // ---------------------------------------------------------------------------
+  QMatrix4x4  getRotationMatrix() const
+  {
+    QMatrix4x4  matrix;
+    matrix.rotate((float )mPitch, 1, 0, 0);
+    matrix.rotate((float )mYaw, 0, 1, 0);
+    return matrix;
+  }
+  // ---------------------------------------------------------------------------
+  // getNearPlane
+  // ---------------------------------------------------------------------------
+  // The fitted cloud is about 2 units across, so the planes keep it in the
+  // frustum from any distance
+  double  getNearPlane() const
+  {
+    return mDistance / 100.0;
+  }
+  // ---------------------------------------------------------------------------
+  // getFarPlane
+  // ---------------------------------------------------------------------------
+  double  getFarPlane() const
+  {
+    return mDistance + 100.0;
+  }
+};
+
+#endif  // #ifdef QPCV_CAMERA_H_
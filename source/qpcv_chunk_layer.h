@@ -0,0 +1,333 @@
+// =============================================================================
+//  qpcv_chunk_layer.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_chunk_layer.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Per chunk GPU buffers of the out-of-core mode of qpcvGLView
+*/
+
+#ifndef QPCV_CHUNK_LAYER_H_
+#define QPCV_CHUNK_LAYER_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QMatrix4x4>
+#include "qpcv_chunk_pager.h"
+#include "qpcv_point_layer.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+#ifndef GL_COPY_READ_BUFFER
+#define GL_COPY_READ_BUFFER   0x8F36
+#endif
+#ifndef GL_COPY_WRITE_BUFFER
+#define GL_COPY_WRITE_BUFFER  0x8F37
+#endif
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT       0x0001
+#endif
+
+// -----------------------------------------------------------------------------
+// qpcvChunkLayer class
+// -----------------------------------------------------------------------------
+// Each chunk of the qpcvChunkPager frames has its own buffer holding a prefix
+// of the chunk, which grows with the pieces of the frames, so a chunk is
+// uploaded only once while it stays on the GPU. The buffers of the chunks not
+// drawn by the current frame stay as a cache and the least recently drawn ones
+// are deleted when the buffers exceed the VRAM budget. A buffer doubles when
+// it grows, but only while the doubled size fits the budget (it holds just
+// the prefix otherwise), so the buffers of the current frame, which are never
+// deleted, stay within the budget the pager plans the frame with. The buffers
+// hold the
+// stored format of the chunk store, compact points are dequantized by the
+// program of qpcvPointLayer with the origin and the step of their chunk. The
+// functions taking QOpenGLExtraFunctions need the context current.
+class qpcvChunkLayer
+{
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvChunkLayer
+  // ---------------------------------------------------------------------------
+  qpcvChunkLayer()
+  {
+    mIsCompact = false;
+    mPointSize = sizeof(ibc::gl::glXYZf_RGBAub);
+    mVRAMBudget = 0;
+    mVRAMUsed = 0;
+    mFrameCount = 0;
+    mDrawNum = 0;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // hasChunks
+  // ---------------------------------------------------------------------------
+  bool  hasChunks() const
+  {
+    return (mChunkTable.size() != 0);
+  }
+  // ---------------------------------------------------------------------------
+  // setStore
+  // ---------------------------------------------------------------------------
+  // Deletes all buffers and takes the chunks of inStore (NULL : leaves the
+  // out-of-core mode)
+  void  setStore(QOpenGLExtraFunctions *inFunc, const qpcvChunkStore *inStore, size_t inVRAMBudget)
+  {
+    release(inFunc);
+    mVRAMBudget = inVRAMBudget;
+    if (inStore == NULL)
+      return;
+    const std::vector<qpcvChunkStore::ChunkEntry> &chunkTable = inStore->getChunkTable();
+    mIsCompact = (inStore->getHeader().pointFormat == qpcvChunkStore::POINT_FORMAT_COMPACT);
+    mPointSize = qpcvChunkStore::getPointSize(inStore->getHeader().pointFormat);
+    mChunkTable.assign(chunkTable.size(), ChunkBuffer());
+    for (size_t i = 0; i < chunkTable.size(); i++)
+      for (int j = 0; j < 3; j++)
+      {
+        mChunkTable[i].origin[j] = chunkTable[i].origin[j];
+        mChunkTable[i].step[j] = chunkTable[i].step[j];
+      }
+  }
+  // ---------------------------------------------------------------------------
+  // applyFrame
+  // ---------------------------------------------------------------------------
+  // Uploads the pieces of inFrame and deletes the least recently drawn
+  // buffers over the budget. outReleaseTable gets the chunks to be released
+  // in the pager: the deleted ones and the ones whose piece does not continue
+  // the prefix on the GPU (they are sent again from the start)
+  void  applyFrame(QOpenGLExtraFunctions *inFunc, const qpcvChunkPager::Frame &inFrame,
+                   std::vector<size_t> *outReleaseTable)
+  {
+    outReleaseTable->clear();
+    if (inFrame.countTable.size() != mChunkTable.size())
+      return;
+    mFrameCount++;
+    for (size_t i = 0; i < inFrame.pieceTable.size(); i++)
+    {
+      const qpcvChunkPager::Piece &piece = inFrame.pieceTable[i];
+      ChunkBuffer &chunk = mChunkTable[piece.chunk];
+      if (piece.begin > chunk.num)
+      {
+        deleteBuffer(inFunc, &chunk);
+        outReleaseTable->push_back(piece.chunk);
+        continue;
+      }
+      if (reserve(inFunc, &chunk, piece.end) == false)
+      {
+        outReleaseTable->push_back(piece.chunk);
+        continue;
+      }
+      inFunc->glBindBuffer(GL_ARRAY_BUFFER, chunk.buffer);
+      inFunc->glBufferSubData(GL_ARRAY_BUFFER, (GLintptr )(piece.begin * mPointSize),
+                              (GLsizeiptr )((piece.end - piece.begin) * mPointSize),
+                              inFrame.data.data() + piece.offset * mPointSize);
+      inFunc->glBindBuffer(GL_ARRAY_BUFFER, 0);
+      chunk.num = std::max(chunk.num, piece.end);
+    }
+    mDrawNum = 0;
+    for (size_t i = 0; i < mChunkTable.size(); i++)
+    {
+      ChunkBuffer &chunk = mChunkTable[i];
+      chunk.drawNum = std::min(inFrame.countTable[i], chunk.num);
+      if (inFrame.countTable[i] == 0)
+        continue;
+      chunk.lastUse = mFrameCount;
+      mDrawNum += chunk.drawNum;
+      // A prefix lost on the way (e.g. released while the frame was composed)
+      if (chunk.drawNum < inFrame.countTable[i] &&
+          std::find(outReleaseTable->begin(), outReleaseTable->end(), i) == outReleaseTable->end())
+        outReleaseTable->push_back(i);
+    }
+    evictChunks(inFunc, outReleaseTable);
+  }
+  // ---------------------------------------------------------------------------
+  // draw
+  // ---------------------------------------------------------------------------
+  // inMatrix maps the data coordinates to the clip coordinates
+  void  draw(QOpenGLContext *inContext, const QMatrix4x4 &inMatrix,
+             qpcvPointLayer *inPointLayer, const qpcvPointLayer::DrawParam &inParam)
+  {
+    QOpenGLExtraFunctions *func = inContext->extraFunctions();
+    if (mDrawNum == 0 || inPointLayer->bindProgram(inContext, inMatrix, inParam) == false)
+      return;
+    for (size_t i = 0; i < mChunkTable.size(); i++)
+    {
+      const ChunkBuffer &chunk = mChunkTable[i];
+      if (chunk.drawNum == 0)
+        continue;
+      if (mIsCompact)
+        inPointLayer->setCompactTransform(chunk.origin, chunk.step);
+      func->glBindVertexArray(chunk.vao);
+      func->glDrawArrays(GL_POINTS, 0, (GLsizei )chunk.drawNum);
+    }
+    func->glBindVertexArray(0);
+    inPointLayer->releaseProgram(func);
+  }
+  // ---------------------------------------------------------------------------
+  // getDrawNum
+  // ---------------------------------------------------------------------------
+  size_t  getDrawNum() const
+  {
+    return mDrawNum;
+  }
+  // ---------------------------------------------------------------------------
+  // getVRAMUsed
+  // ---------------------------------------------------------------------------
+  size_t  getVRAMUsed() const
+  {
+    return mVRAMUsed;
+  }
+  // ---------------------------------------------------------------------------
+  // release
+  // ---------------------------------------------------------------------------
+  void  release(QOpenGLExtraFunctions *inFunc)
+  {
+    for (size_t i = 0; i < mChunkTable.size(); i++)
+      deleteBuffer(inFunc, &(mChunkTable[i]));
+    mChunkTable.clear();
+    mVRAMUsed = 0;
+    mDrawNum = 0;
+  }
+
+protected:
+  struct ChunkBuffer
+  {
+    GLuint  buffer = 0;
+    GLuint  vao = 0;
+    size_t  capacity = 0;   // Points
+    size_t  num = 0;        // Prefix on the GPU
+    size_t  drawNum = 0;
+    uint64_t  lastUse = 0;
+    GLfloat origin[3];      // Quantization of the compact format
+    GLfloat step[3];
+  };
+
+  // Member variables ----------------------------------------------------------
+  std::vector<ChunkBuffer>  mChunkTable;
+  bool  mIsCompact;
+  size_t  mPointSize;
+  size_t  mVRAMBudget;
+  size_t  mVRAMUsed;
+  uint64_t  mFrameCount;
+  size_t  mDrawNum;
+  std::vector<unsigned char>  mReadBackData;   // Prefix of a buffer being resized
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // reserve
+  // ---------------------------------------------------------------------------
+  // Grows the buffer to hold inNum points. The prefix is read back to the host
+  // and the old buffer is deleted before the new one is created, so a resize
+  // never holds both buffers on the GPU
+  bool  reserve(QOpenGLExtraFunctions *inFunc, ChunkBuffer *ioChunk, size_t inNum)
+  {
+    if (inNum <= ioChunk->capacity)
+      return true;
+    size_t  capacity = std::max(inNum, ioChunk->capacity * 2);
+    size_t  otherUsed = mVRAMUsed - ioChunk->capacity * mPointSize;
+    if (otherUsed + capacity * mPointSize > mVRAMBudget)
+      capacity = inNum;
+    size_t  num = ioChunk->num;
+    if (num != 0)
+    {
+      size_t  size = num * mPointSize;
+      mReadBackData.resize(size);
+      inFunc->glBindBuffer(GL_COPY_READ_BUFFER, ioChunk->buffer);
+      void  *ptr = inFunc->glMapBufferRange(GL_COPY_READ_BUFFER, 0, (GLsizeiptr )size, GL_MAP_READ_BIT);
+      if (ptr != NULL)
+      {
+        memcpy(mReadBackData.data(), ptr, size);
+        inFunc->glUnmapBuffer(GL_COPY_READ_BUFFER);
+      }
+      inFunc->glBindBuffer(GL_COPY_READ_BUFFER, 0);
+      if (ptr == NULL)
+      {
+        // The prefix is lost, the caller has the chunk sent again
+        deleteBuffer(inFunc, ioChunk);
+        return false;
+      }
+    }
+    deleteBuffer(inFunc, ioChunk);
+    GLuint  buffer = 0;
+    inFunc->glGenBuffers(1, &buffer);
+    if (buffer == 0)
+      return false;
+    inFunc->glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    // glBufferData() directly, QOpenGLBuffer::allocate() takes an int size
+    inFunc->glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr )(capacity * mPointSize), NULL, GL_STATIC_DRAW);
+    if (num != 0)
+      inFunc->glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr )(num * mPointSize), mReadBackData.data());
+    inFunc->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ioChunk->buffer = buffer;
+    ioChunk->capacity = capacity;
+    ioChunk->num = num;
+    mVRAMUsed += capacity * mPointSize;
+    inFunc->glGenVertexArrays(1, &(ioChunk->vao));
+    inFunc->glBindVertexArray(ioChunk->vao);
+    inFunc->glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    qpcvPointLayer::setVertexFormat(inFunc, mIsCompact);
+    inFunc->glBindVertexArray(0);
+    inFunc->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // deleteBuffer
+  // ---------------------------------------------------------------------------
+  void  deleteBuffer(QOpenGLExtraFunctions *inFunc, ChunkBuffer *ioChunk)
+  {
+    if (ioChunk->vao != 0)
+      inFunc->glDeleteVertexArrays(1, &(ioChunk->vao));
+    if (ioChunk->buffer != 0)
+      inFunc->glDeleteBuffers(1, &(ioChunk->buffer));
+    mVRAMUsed -= ioChunk->capacity * mPointSize;
+    ioChunk->buffer = 0;
+    ioChunk->vao = 0;
+    ioChunk->capacity = 0;
+    ioChunk->num = 0;
+    ioChunk->drawNum = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // evictChunks
+  // ---------------------------------------------------------------------------
+  // Deletes the least recently drawn buffers until the budget is met. The
+  // buffers of the current frame are never deleted
+  void  evictChunks(QOpenGLExtraFunctions *inFunc, std::vector<size_t> *ioReleaseTable)
+  {
+    while (mVRAMUsed > mVRAMBudget)
+    {
+      size_t  oldest = mChunkTable.size();
+      for (size_t i = 0; i < mChunkTable.size(); i++)
+      {
+        const ChunkBuffer &chunk = mChunkTable[i];
+        if (chunk.capacity == 0 || chunk.lastUse == mFrameCount)
+          continue;
+        if (oldest == mChunkTable.size() || chunk.lastUse < mChunkTable[oldest].lastUse)
+          oldest = i;
+      }
+      if (oldest == mChunkTable.size())
+        break;
+      deleteBuffer(inFunc, &(mChunkTable[oldest]));
+      ioReleaseTable->push_back(oldest);
+    }
+  }
+};
+
+#endif  // #ifdef QPCV_CHUNK_LAYER_H_
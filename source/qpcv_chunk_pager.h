@@ -0,0 +1,475 @@
+// =============================================================================
+//  qpcv_chunk_pager.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_chunk_pager.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Streams the chunks of a qpcvChunkStore to the per chunk buffers of the GPU
+*/
+
+#ifndef QPCV_CHUNK_PAGER_H_
+#define QPCV_CHUNK_PAGER_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <QFile>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include "qpcv_chunk_store.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvChunkPager class
+// -----------------------------------------------------------------------------
+// A frame draws at most (VRAM budget / point size) points. A quarter of it is
+// a coarse prefix of every chunk (the chunks are in the qpcvLOD order, so a
+// prefix is a uniform subsample), the rest goes to the chunks inside the view
+// frustum, nearest to the eye first. The GPU keeps a prefix of each chunk (see
+// qpcvChunkLayer), so a frame carries only the points of the chunks beyond
+// the prefix sent before (the pieces). The chunk data read from the file is
+// kept in an LRU cache limited by the host budget. The pieces and the GPU
+// buffers are in the stored format too (compact chunks are dequantized by the
+// vertex shader), so the compact format also halves the VRAM of a point and
+// a frame can draw twice as many points. There are two frames: the GUI
+// uploads one while the pager composes the other, and acquireFrame() swaps
+// them. The GUI reports the chunks it dropped from the GPU with
+// releaseChunks(), they are sent again from the start then.
+class qpcvChunkPager : public QThread
+{
+Q_OBJECT
+
+public:
+  // Constants -----------------------------------------------------------------
+  static const size_t DEFAULT_VRAM_BUDGET = (size_t )512 * 1024 * 1024;
+  static const size_t DEFAULT_HOST_BUDGET = (size_t )2048 * 1024 * 1024;
+  // Part of the frame used for the coarse prefix of all chunks (1 / n)
+  static const size_t COARSE_DIVISOR = 4;
+
+  // Points [begin, end) of a chunk, at the point offset of the frame data
+  struct Piece
+  {
+    size_t  chunk;
+    size_t  begin, end;
+    size_t  offset;
+  };
+
+  struct Frame
+  {
+    std::vector<unsigned char>  data;   // Points in the stored format
+    std::vector<Piece>  pieceTable;
+    std::vector<size_t> countTable;   // Prefix of each chunk to draw
+  };
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvChunkPager
+  // ---------------------------------------------------------------------------
+  // inStore must have been opened. The host budget is raised to the VRAM
+  // budget when it is smaller (the chunks of one buffer must fit in the cache)
+  qpcvChunkPager(const qpcvChunkStore &inStore, size_t inVRAMBudget, size_t inHostBudget,
+                 QObject *parent = Q_NULLPTR)
+  : QThread(parent)
+  {
+    mStore = inStore;
+    mPointSize = qpcvChunkStore::getPointSize(mStore.getHeader().pointFormat);
+    if (inVRAMBudget == 0)
+      inVRAMBudget = DEFAULT_VRAM_BUDGET;
+    if (inHostBudget == 0)
+      inHostBudget = DEFAULT_HOST_BUDGET;
+    if (inHostBudget < inVRAMBudget)
+      inHostBudget = inVRAMBudget;
+    mVRAMBudget = inVRAMBudget;
+    mBufferPointNum = inVRAMBudget / mPointSize;
+    if (mBufferPointNum > mStore.getHeader().pointNum)
+      mBufferPointNum = (size_t )mStore.getHeader().pointNum;
+    mHostBudget = inHostBudget;
+    mHostUsed = 0;
+    mFrameCount = 0;
+    for (int i = 0; i < 2; i++)
+      mFrame[i].data.resize(mBufferPointNum * mPointSize);
+    mFrontIndex = 0;
+    mIsBackReady = false;
+    mIsRequested = true;
+    for (int i = 0; i < 16; i++)
+      mMatrix[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    mIsFrustumValid = false;    // Everything is in view
+    for (int i = 0; i < 3; i++)
+      mEye[i] = (mStore.getHeader().minMax[i * 2] + mStore.getHeader().minMax[i * 2 + 1]) / 2;
+    mCacheTable.resize(mStore.getChunkTable().size());
+    mSentTable.assign(mStore.getChunkTable().size(), 0);
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvChunkPager
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvChunkPager()
+  {
+    requestInterruption();
+    mMutex.lock();
+    mCondition.wakeAll();
+    mMutex.unlock();
+    wait();
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // setView
+  // ---------------------------------------------------------------------------
+  // inMatrix (16 floats, column major) maps the data coordinates to the clip
+  // coordinates of the camera and inEye is the camera position in the data
+  // coordinates
+  void  setView(const GLfloat *inMatrix, const GLfloat *inEye)
+  {
+    QMutexLocker  locker(&mMutex);
+    for (int i = 0; i < 16; i++)
+      mMatrix[i] = inMatrix[i];
+    for (int i = 0; i < 3; i++)
+      mEye[i] = inEye[i];
+    mIsFrustumValid = true;
+    mIsRequested = true;
+    mCondition.wakeAll();
+  }
+  // ---------------------------------------------------------------------------
+  // acquireFrame
+  // ---------------------------------------------------------------------------
+  // Called from the GUI thread after bufferReady(). The returned frame stays
+  // valid until the next acquireFrame() call. Every piece of it has to be
+  // uploaded (or its chunk released) before that, the next frame only has
+  // the points after them
+  bool  acquireFrame(const Frame **outFrame)
+  {
+    QMutexLocker  locker(&mMutex);
+    if (mIsBackReady == false)
+      return false;
+    mFrontIndex = 1 - mFrontIndex;
+    mIsBackReady = false;
+    *outFrame = &(mFrame[mFrontIndex]);
+    mCondition.wakeAll();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // releaseChunks
+  // ---------------------------------------------------------------------------
+  // The chunks are not on the GPU any more, the next frame sends them from
+  // the start when they are drawn
+  void  releaseChunks(const std::vector<size_t> &inChunkTable)
+  {
+    if (inChunkTable.size() == 0)
+      return;
+    QMutexLocker  locker(&mMutex);
+    for (size_t i = 0; i < inChunkTable.size(); i++)
+      if (inChunkTable[i] < mSentTable.size())
+        mSentTable[inChunkTable[i]] = 0;
+    mIsRequested = true;
+    mCondition.wakeAll();
+  }
+  // ---------------------------------------------------------------------------
+  // getStore
+  // ---------------------------------------------------------------------------
+  const qpcvChunkStore  &getStore() const
+  {
+    return mStore;
+  }
+  // ---------------------------------------------------------------------------
+  // getBufferPointNum
+  // ---------------------------------------------------------------------------
+  size_t  getBufferPointNum() const
+  {
+    return mBufferPointNum;
+  }
+  // ---------------------------------------------------------------------------
+  // getVRAMBudget
+  // ---------------------------------------------------------------------------
+  size_t  getVRAMBudget() const
+  {
+    return mVRAMBudget;
+  }
+  // ---------------------------------------------------------------------------
+  // getHostUsed
+  // ---------------------------------------------------------------------------
+  size_t  getHostUsed()
+  {
+    QMutexLocker  locker(&mMutex);
+    return mHostUsed;
+  }
+
+signals:
+  void  bufferReady(size_t inPointNum, size_t inChunkNum);
+  void  errorOccurred(const QString &inErrorStr);
+
+protected:
+  struct CacheEntry
+  {
+    std::vector<unsigned char>  data;   // Prefix of the chunk (as stored in the file)
+    uint64_t  lastUse;
+  };
+
+  // Member variables ----------------------------------------------------------
+  qpcvChunkStore  mStore;
+  size_t  mPointSize;
+  size_t  mVRAMBudget;
+  size_t  mBufferPointNum;
+  size_t  mHostBudget;
+  size_t  mHostUsed;
+  uint64_t  mFrameCount;
+  std::vector<CacheEntry> mCacheTable;
+
+  // Protected by mMutex
+  QMutex  mMutex;
+  QWaitCondition  mCondition;
+  Frame mFrame[2];
+  int   mFrontIndex;
+  bool  mIsBackReady;
+  bool  mIsRequested;
+  GLfloat mMatrix[16];
+  bool  mIsFrustumValid;
+  GLfloat mEye[3];
+  std::vector<size_t> mSentTable;   // Prefix of each chunk sent to the GPU
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  virtual void  run()
+  {
+    QFile file(mStore.getFileName());
+    if (file.open(QIODevice::ReadOnly) == false)
+    {
+      emit errorOccurred(QString("Can't open %1").arg(mStore.getFileName()));
+      return;
+    }
+    while (true)
+    {
+      GLfloat matrix[16], eye[3];
+      bool  isFrustumValid;
+      std::vector<size_t> sentTable;
+      int backIndex;
+      {
+        // Wait for a new view and for the back frame to be free
+        QMutexLocker  locker(&mMutex);
+        while (isInterruptionRequested() == false &&
+               (mIsRequested == false || mIsBackReady))
+          mCondition.wait(&mMutex);
+        if (isInterruptionRequested())
+          return;
+        mIsRequested = false;
+        for (int i = 0; i < 16; i++)
+          matrix[i] = mMatrix[i];
+        for (int i = 0; i < 3; i++)
+          eye[i] = mEye[i];
+        isFrustumValid = mIsFrustumValid;
+        sentTable = mSentTable;
+        backIndex = 1 - mFrontIndex;
+      }
+
+      Frame &frame = mFrame[backIndex];
+      size_t  chunkNum = planChunks(isFrustumValid ? matrix : NULL, eye, &(frame.countTable));
+      if (composeFrame(&file, sentTable, &frame) == false)
+      {
+        emit errorOccurred(QString("Can't read %1").arg(mStore.getFileName()));
+        return;
+      }
+      size_t  num = 0;
+      for (size_t i = 0; i < frame.countTable.size(); i++)
+        num += frame.countTable[i];
+      {
+        // A chunk released meanwhile is found by the GUI (the piece does not
+        // continue its prefix) and released again
+        QMutexLocker  locker(&mMutex);
+        for (size_t i = 0; i < frame.pieceTable.size(); i++)
+          mSentTable[frame.pieceTable[i].chunk] = frame.pieceTable[i].end;
+        mIsBackReady = true;
+      }
+      emit bufferReady(num, chunkNum);
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // planChunks
+  // ---------------------------------------------------------------------------
+  // Number of points (prefix) to draw from each chunk. inMatrix is the data
+  // to clip matrix (NULL : everything is visible). Returns the number of the
+  // chunks getting more than the coarse prefix
+  size_t  planChunks(const GLfloat *inMatrix, const GLfloat *inEye,
+                     std::vector<size_t> *outCountTable)
+  {
+    const std::vector<qpcvChunkStore::ChunkEntry> &chunkTable = mStore.getChunkTable();
+    const uint64_t  totalNum = mStore.getHeader().pointNum;
+    outCountTable->assign(chunkTable.size(), 0);
+    if (totalNum == 0)
+      return 0;
+
+    // Coarse prefix of every chunk, proportional to its size
+    size_t  coarseNum = mBufferPointNum / COARSE_DIVISOR;
+    if (mBufferPointNum >= totalNum)
+      coarseNum = mBufferPointNum;
+    size_t  usedNum = 0;
+    for (size_t i = 0; i < chunkTable.size(); i++)
+    {
+      size_t  n = (size_t )((double )chunkTable[i].pointNum * coarseNum / totalNum);
+      (*outCountTable)[i] = n;
+      usedNum += n;
+    }
+
+    // The rest goes to the visible chunks, nearest first
+    std::vector<std::pair<double, size_t> > visibleTable;
+    for (size_t i = 0; i < chunkTable.size(); i++)
+    {
+      if (chunkTable[i].pointNum == 0)
+        continue;
+      if (inMatrix != NULL && isInFrustum(chunkTable[i].minMax, inMatrix) == false)
+        continue;
+      visibleTable.push_back(std::make_pair(getDistance(chunkTable[i].minMax, inEye), i));
+    }
+    std::sort(visibleTable.begin(), visibleTable.end());
+    size_t  detailNum = 0;
+    for (size_t i = 0; i < visibleTable.size() && usedNum < mBufferPointNum; i++)
+    {
+      size_t  chunk = visibleTable[i].second;
+      size_t  n = (size_t )chunkTable[chunk].pointNum - (*outCountTable)[chunk];
+      if (n > mBufferPointNum - usedNum)
+        n = mBufferPointNum - usedNum;
+      (*outCountTable)[chunk] += n;
+      usedNum += n;
+      detailNum++;
+    }
+    return detailNum;
+  }
+  // ---------------------------------------------------------------------------
+  // composeFrame
+  // ---------------------------------------------------------------------------
+  // The pieces of the chunks drawn beyond their sent prefix (ioFrame has the
+  // count table of planChunks())
+  bool  composeFrame(QFile *inFile, const std::vector<size_t> &inSentTable, Frame *ioFrame)
+  {
+    const std::vector<qpcvChunkStore::ChunkEntry> &chunkTable = mStore.getChunkTable();
+    mFrameCount++;
+    ioFrame->pieceTable.clear();
+    size_t  pos = 0;
+    for (size_t i = 0; i < chunkTable.size(); i++)
+    {
+      size_t  num = ioFrame->countTable[i];
+      if (num == 0)
+        continue;
+      CacheEntry  &entry = mCacheTable[i];
+      size_t  cachedNum = entry.data.size() / mPointSize;
+      if (cachedNum < num)
+      {
+        // Only the missing part of the prefix is read
+        entry.data.resize(num * mPointSize);
+        qint64  size = (qint64 )((num - cachedNum) * mPointSize);
+        if (inFile->seek(chunkTable[i].offset + cachedNum * mPointSize) == false ||
+            inFile->read((char *)(entry.data.data() + cachedNum * mPointSize), size) != size)
+          return false;
+        addHostUsed((num - cachedNum) * mPointSize, true);
+      }
+      entry.lastUse = mFrameCount;
+      if (num <= inSentTable[i])
+        continue;
+      Piece piece = {i, inSentTable[i], num, pos};
+      memcpy(ioFrame->data.data() + pos * mPointSize, entry.data.data() + piece.begin * mPointSize,
+             (piece.end - piece.begin) * mPointSize);
+      ioFrame->pieceTable.push_back(piece);
+      pos += piece.end - piece.begin;
+    }
+    evictChunks();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // evictChunks
+  // ---------------------------------------------------------------------------
+  // Drops the least recently used chunks until the cache fits the host budget.
+  // The chunks of the current frame are never dropped
+  void  evictChunks()
+  {
+    while (getHostUsed() > mHostBudget)
+    {
+      size_t  oldest = mCacheTable.size();
+      for (size_t i = 0; i < mCacheTable.size(); i++)
+      {
+        if (mCacheTable[i].data.size() == 0 || mCacheTable[i].lastUse == mFrameCount)
+          continue;
+        if (oldest == mCacheTable.size() || mCacheTable[i].lastUse < mCacheTable[oldest].lastUse)
+          oldest = i;
+      }
+      if (oldest == mCacheTable.size())
+        break;
+      addHostUsed(mCacheTable[oldest].data.size(), false);
+      std::vector<unsigned char>().swap(mCacheTable[oldest].data);
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // addHostUsed
+  // ---------------------------------------------------------------------------
+  void  addHostUsed(size_t inSize, bool inIsAdd)
+  {
+    QMutexLocker  locker(&mMutex);
+    if (inIsAdd)
+      mHostUsed += inSize;
+    else
+      mHostUsed -= inSize;
+  }
+  // ---------------------------------------------------------------------------
+  // getDistance
+  // ---------------------------------------------------------------------------
+  // Distance between inPoint and the box (0 when inside)
+  static double getDistance(const GLfloat *inMinMax, const GLfloat *inPoint)
+  {
+    double  sum = 0;
+    for (int i = 0; i < 3; i++)
+    {
+      double  d = 0;
+      if (inPoint[i] < inMinMax[i * 2 + 0])
+        d = inMinMax[i * 2 + 0] - inPoint[i];
+      else if (inPoint[i] > inMinMax[i * 2 + 1])
+        d = inPoint[i] - inMinMax[i * 2 + 1];
+      sum += d * d;
+    }
+    return sqrt(sum);
+  }
+  // ---------------------------------------------------------------------------
+  // isInFrustum
+  // ---------------------------------------------------------------------------
+  // false when all corners of the box are outside of the same clip plane
+  static bool isInFrustum(const GLfloat *inMinMax, const GLfloat *inMatrix)
+  {
+    int outsideCount[6] = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 8; i++)
+    {
+      double  v[3] = {inMinMax[0 + (i & 1)], inMinMax[2 + ((i >> 1) & 1)],
+                      inMinMax[4 + ((i >> 2) & 1)]};
+      double  clip[4];
+      for (int j = 0; j < 4; j++)
+        clip[j] = inMatrix[j] * v[0] + inMatrix[4 + j] * v[1] +
+                  inMatrix[8 + j] * v[2] + inMatrix[12 + j];
+      for (int j = 0; j < 3; j++)
+      {
+        if (clip[j] < -clip[3])
+          outsideCount[j * 2]++;
+        if (clip[j] > clip[3])
+          outsideCount[j * 2 + 1]++;
+      }
+    }
+    for (int j = 0; j < 6; j++)
+      if (outsideCount[j] == 8)
+        return false;
+    return true;
+  }
+};
+
+#endif  // #ifdef QPCV_CHUNK_PAGER_H_
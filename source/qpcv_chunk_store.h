@@ -0,0 +1,626 @@
+// =============================================================================
+//  qpcv_chunk_store.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_chunk_store.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Spatially chunked on-disk point store for the out-of-core mode
+*/
+
+#ifndef QPCV_CHUNK_STORE_H_
+#define QPCV_CHUNK_STORE_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <functional>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QThread>
+#include "qpcv_ply_layout.h"
+#include "qpcv_ply_decoder.h"
+#include "qpcv_bounds.h"
+#include "qpcv_lod.h"
+#include "qpcv_quantize.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+#include "ibc/gl/file/ply.h"
+
+// -----------------------------------------------------------------------------
+// qpcvChunkStore class
+// -----------------------------------------------------------------------------
+// File layout : FileHeader, ChunkEntry[chunkNum], then the points of each chunk
+// (stored in the qpcvLOD order inside the chunk, so reading the first n points
+// of a chunk gives a uniform subsample of it). The points are glXYZf_RGBAub or
+// qpcvCompactPoint quantized to the grid cell of the chunk (POINT_FORMAT_COMPACT)
+class qpcvChunkStore
+{
+public:
+  typedef std::function<bool(int inStage, qint64 inDoneNum, qint64 inTotalNum)> ProgressFunc;
+
+  enum  PointFormat
+  {
+    POINT_FORMAT_FULL = 0,
+    POINT_FORMAT_COMPACT
+  };
+
+  enum  BuildStage
+  {
+    BUILD_STAGE_BOUNDS  = 0,
+    BUILD_STAGE_COUNT,
+    BUILD_STAGE_SCATTER,
+    BUILD_STAGE_LOD
+  };
+
+  struct FileHeader
+  {
+    char      magic[8];
+    uint64_t  sourceSize;
+    int64_t   sourceModified;   // msec since epoch
+    uint64_t  pointNum;
+    uint32_t  chunkNum;
+    uint32_t  gridDim[3];
+    uint32_t  hasColor;
+    uint32_t  pointFormat;
+    GLfloat   minMax[6];
+    GLfloat   param[4];
+  };
+
+  struct ChunkEntry
+  {
+    GLfloat   minMax[6];
+    GLfloat   origin[3];  // Quantization of POINT_FORMAT_COMPACT (see qpcvQuantizer)
+    GLfloat   step[3];
+    uint64_t  offset;   // Byte offset of the first point in the file
+    uint64_t  pointNum;
+    uint64_t  levelEnd[qpcvLOD::LEVEL_NUM];
+  };
+
+  // Constants -----------------------------------------------------------------
+  static const size_t TARGET_CHUNK_POINT_NUM = 1024 * 1024;
+  static const size_t BLOCK_POINT_NUM = 1024 * 1024;
+  static const int    MAX_GRID_DIM = 128;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvChunkStore
+  // ---------------------------------------------------------------------------
+  qpcvChunkStore()
+  {
+    memset(&mHeader, 0, sizeof(mHeader));
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getStoreFileName
+  // ---------------------------------------------------------------------------
+  static QString  getStoreFileName(const QString &inSourceFileName)
+  {
+    return inSourceFileName + ".qpcvchunks";
+  }
+  // ---------------------------------------------------------------------------
+  // open
+  // ---------------------------------------------------------------------------
+  // Reads the header and the chunk table. Fails when the store does not exist
+  // or does not match the source file (size and modification time) or the
+  // point format
+  bool  open(const QString &inSourceFileName, int inPointFormat = POINT_FORMAT_FULL)
+  {
+    QFileInfo sourceInfo(inSourceFileName);
+    QFile file(getStoreFileName(inSourceFileName));
+    if (file.open(QIODevice::ReadOnly) == false)
+      return false;
+    if (file.read((char *)&mHeader, sizeof(mHeader)) != sizeof(mHeader))
+      return false;
+    if (memcmp(mHeader.magic, getMagic(), sizeof(mHeader.magic)) != 0 ||
+        mHeader.pointFormat != (uint32_t )inPointFormat ||
+        mHeader.sourceSize != (uint64_t )sourceInfo.size() ||
+        mHeader.sourceModified != sourceInfo.lastModified().toMSecsSinceEpoch())
+      return false;
+    mChunkTable.resize(mHeader.chunkNum);
+    qint64  tableSize = sizeof(ChunkEntry) * (qint64 )mHeader.chunkNum;
+    if (file.read((char *)mChunkTable.data(), tableSize) != tableSize)
+      return false;
+    mFileName = file.fileName();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // getFileName
+  // ---------------------------------------------------------------------------
+  const QString &getFileName() const
+  {
+    return mFileName;
+  }
+  // ---------------------------------------------------------------------------
+  // getHeader
+  // ---------------------------------------------------------------------------
+  const FileHeader  &getHeader() const
+  {
+    return mHeader;
+  }
+  // ---------------------------------------------------------------------------
+  // getChunkTable
+  // ---------------------------------------------------------------------------
+  const std::vector<ChunkEntry> &getChunkTable() const
+  {
+    return mChunkTable;
+  }
+  // ---------------------------------------------------------------------------
+  // getMaxQuantizationError
+  // ---------------------------------------------------------------------------
+  // 0 for POINT_FORMAT_FULL
+  double  getMaxQuantizationError() const
+  {
+    double  error = 0;
+    if (mHeader.pointFormat != POINT_FORMAT_COMPACT)
+      return 0;
+    for (size_t i = 0; i < mChunkTable.size(); i++)
+    {
+      double  e = qpcvQuantizer::getMaxError(mChunkTable[i].step);
+      if (e > error)
+        error = e;
+    }
+    return error;
+  }
+  // ---------------------------------------------------------------------------
+  // getPointSize
+  // ---------------------------------------------------------------------------
+  static size_t getPointSize(int inPointFormat)
+  {
+    if (inPointFormat == POINT_FORMAT_COMPACT)
+      return sizeof(qpcvCompactPoint);
+    return sizeof(ibc::gl::glXYZf_RGBAub);
+  }
+  // ---------------------------------------------------------------------------
+  // decodePoints
+  // ---------------------------------------------------------------------------
+  // inRaw is inNum points of the chunk as stored in the file
+  static void decodePoints(const unsigned char *inRaw, size_t inNum,
+                           const ChunkEntry &inEntry, int inPointFormat,
+                           ibc::gl::glXYZf_RGBAub *outData)
+  {
+    if (inPointFormat == POINT_FORMAT_COMPACT)
+      qpcvQuantizer::decode((const qpcvCompactPoint *)inRaw, inNum,
+                            inEntry.origin, inEntry.step, outData);
+    else
+      memcpy(outData, inRaw, inNum * sizeof(ibc::gl::glXYZf_RGBAub));
+  }
+  // ---------------------------------------------------------------------------
+  // build
+  // ---------------------------------------------------------------------------
+  // Converts a binary PLY file into the chunk store. The source is mapped and
+  // decoded in BLOCK_POINT_NUM blocks, so the memory use does not depend on
+  // the file size (except the largest chunk during the LOD stage).
+  // inWriteBufferSize is the total size of the per chunk write buffers
+  static bool build(const QString &inSourceFileName, int inPointFormat, int inThreadNum,
+                    size_t inWriteBufferSize,
+                    const ProgressFunc &inProgressFunc, std::string *outErrorStr)
+  {
+    QFile source(inSourceFileName);
+    if (source.open(QIODevice::ReadOnly) == false)
+      return setError("Can't open the file", outErrorStr);
+    qint64  sourceSize = source.size();
+    const unsigned char *sourcePtr = source.map(0, sourceSize);
+    if (sourcePtr == NULL)
+      return setError("Can't map the file", outErrorStr);
+    qpcvPLYLayout layout;
+    size_t  vertexIndex, vertexOffset;
+    qpcvPLYDecoder::VertexMap vertexMap;
+    if (layout.parse(sourcePtr, (size_t )sourceSize) == false)
+      return setError(layout.getErrorStr().c_str(), outErrorStr);
+    if (layout.isBinary() == false ||
+        layout.findElementIndex("vertex", &vertexIndex) == false ||
+        layout.getBinaryElementOffset(vertexIndex, &vertexOffset) == false ||
+        qpcvPLYDecoder::prepareVertexMap(layout.getElement(vertexIndex), &vertexMap) == false)
+      return setError("The out-of-core mode needs a binary PLY file with x, y, z vertices", outErrorStr);
+    const qpcvPLYLayout::Element  &vertex = layout.getElement(vertexIndex);
+    const unsigned char *records = sourcePtr + layout.getHeaderSize() + vertexOffset;
+    const size_t  pointNum = vertex.count;
+    const size_t  bodyOffset = layout.getHeaderSize() + vertexOffset;
+    if (vertex.recordSize == 0)
+      return setError("Binary vertices with list properties are not supported", outErrorStr);
+    if (bodyOffset > (size_t )sourceSize ||
+        pointNum > ((size_t )sourceSize - bodyOffset) / vertex.recordSize)
+      return setError("The PLY file is truncated", outErrorStr);
+    bool  isSwap = layout.needsByteSwap();
+    std::vector<ibc::gl::glXYZf_RGBAub> block(BLOCK_POINT_NUM);
+
+    // Walks through the source one block at a time
+    auto  forEachBlock = [&](int inStage,
+                             const std::function<void(const ibc::gl::glXYZf_RGBAub *, size_t)> &inFunc)
+    {
+      for (size_t begin = 0; begin < pointNum; begin += BLOCK_POINT_NUM)
+      {
+        size_t  num = pointNum - begin;
+        if (num > BLOCK_POINT_NUM)
+          num = BLOCK_POINT_NUM;
+        qpcvPLYDecoder::decodeBinaryVerticesParallel(
+                  vertexMap, records + begin * vertex.recordSize, isSwap,
+                  num, block.data(), NULL, inThreadNum);
+        inFunc(block.data(), num);
+        if (inProgressFunc && inProgressFunc(inStage, begin + num, pointNum) == false)
+          return false;
+      }
+      return true;
+    };
+
+    // Pass 1 : bounds
+    qpcvBounds  bounds;
+    if (forEachBlock(BUILD_STAGE_BOUNDS,
+                     [&](const ibc::gl::glXYZf_RGBAub *inData, size_t inNum)
+                     {
+                       bounds.add(inData, inNum);
+                     }) == false)
+      return false;
+    FileHeader  header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, getMagic(), sizeof(header.magic));
+    header.sourceSize = sourceSize;
+    header.sourceModified = QFileInfo(inSourceFileName).lastModified().toMSecsSinceEpoch();
+    header.pointNum = pointNum;
+    header.hasColor = vertexMap.hasColor ? 1 : 0;
+    header.pointFormat = (uint32_t )inPointFormat;
+    bounds.calcFitParam(header.param, header.minMax);
+    calcGridDim(header.minMax, pointNum, header.gridDim);
+    header.chunkNum = header.gridDim[0] * header.gridDim[1] * header.gridDim[2];
+
+    // Pass 2 : count
+    std::vector<ChunkEntry> chunkTable(header.chunkNum);
+    memset(chunkTable.data(), 0, sizeof(ChunkEntry) * header.chunkNum);
+    if (forEachBlock(BUILD_STAGE_COUNT,
+                     [&](const ibc::gl::glXYZf_RGBAub *inData, size_t inNum)
+                     {
+                       for (size_t i = 0; i < inNum; i++)
+                         chunkTable[getChunkIndex(header, inData[i])].pointNum++;
+                     }) == false)
+      return false;
+    // The grid cell is the quantization box (the chunk bounds are only known
+    // after the scatter)
+    const size_t  pointSize = getPointSize(inPointFormat);
+    uint64_t  offset = sizeof(FileHeader) + sizeof(ChunkEntry) * (uint64_t )header.chunkNum;
+    for (size_t i = 0; i < chunkTable.size(); i++)
+    {
+      GLfloat cellMinMax[6];
+      getCellMinMax(header, i, cellMinMax);
+      qpcvQuantizer::calcStep(cellMinMax, chunkTable[i].origin, chunkTable[i].step);
+      chunkTable[i].offset = offset;
+      offset += chunkTable[i].pointNum * pointSize;
+    }
+
+    // Pass 3 : scatter through per chunk write buffers
+    QFile store(getStoreFileName(inSourceFileName) + ".tmp");
+    if (store.open(QIODevice::ReadWrite | QIODevice::Truncate) == false ||
+        store.resize((qint64 )offset) == false)
+      return removeStore(&store, "Can't create the chunk file", outErrorStr);
+    size_t  bufferNum = inWriteBufferSize / sizeof(ibc::gl::glXYZf_RGBAub) / header.chunkNum;
+    if (bufferNum < 256)
+      bufferNum = 256;
+    std::vector<std::vector<ibc::gl::glXYZf_RGBAub> > bufferTable(header.chunkNum);
+    std::vector<uint64_t> writtenTable(header.chunkNum, 0);
+    bool  isWriteError = false;
+    auto  flush = [&](size_t inChunk)
+    {
+      std::vector<ibc::gl::glXYZf_RGBAub> &buffer = bufferTable[inChunk];
+      if (buffer.size() == 0)
+        return;
+      if (writePoints(&store, chunkTable[inChunk], inPointFormat, writtenTable[inChunk],
+                      buffer.data(), buffer.size()) == false)
+        isWriteError = true;
+      writtenTable[inChunk] += buffer.size();
+      buffer.clear();
+    };
+    if (forEachBlock(BUILD_STAGE_SCATTER,
+                     [&](const ibc::gl::glXYZf_RGBAub *inData, size_t inNum)
+                     {
+                       for (size_t i = 0; i < inNum; i++)
+                       {
+                         size_t  chunk = getChunkIndex(header, inData[i]);
+                         if (bufferTable[chunk].capacity() == 0)
+                           bufferTable[chunk].reserve(bufferNum);
+                         bufferTable[chunk].push_back(inData[i]);
+                         if (bufferTable[chunk].size() >= bufferNum)
+                           flush(chunk);
+                       }
+                     }) == false)
+      return removeStore(&store, NULL, outErrorStr);
+    for (size_t i = 0; i < bufferTable.size(); i++)
+    {
+      flush(i);
+      std::vector<ibc::gl::glXYZf_RGBAub>().swap(bufferTable[i]);
+    }
+    if (isWriteError)
+      return removeStore(&store, "Can't write the chunk file", outErrorStr);
+
+    // Pass 4 : LOD order and bounds of each chunk
+    std::vector<ibc::gl::glXYZf_RGBAub> chunkData, lodData;
+    std::vector<unsigned char>  rawData;
+    for (size_t i = 0; i < chunkTable.size(); i++)
+    {
+      ChunkEntry  &entry = chunkTable[i];
+      if (entry.pointNum != 0)
+      {
+        chunkData.resize(entry.pointNum);
+        lodData.resize(entry.pointNum);
+        rawData.resize(entry.pointNum * pointSize);
+        qint64  size = (qint64 )rawData.size();
+        if (store.seek(entry.offset) == false ||
+            store.read((char *)rawData.data(), size) != size)
+          return removeStore(&store, "Can't read the chunk file", outErrorStr);
+        decodePoints(rawData.data(), entry.pointNum, entry, inPointFormat, chunkData.data());
+        qpcvBounds  chunkBounds;
+        qpcvBounds::calcParallel(chunkData.data(), chunkData.size(), inThreadNum, &chunkBounds);
+        chunkBounds.getMinMax(entry.minMax);
+        // One cell: the pager takes any prefix of a chunk as a uniform subsample
+        qpcvLOD lod(0);
+        lod.build(chunkData.data(), chunkData.size(), entry.minMax, inThreadNum, lodData.data());
+        for (int j = 0; j < qpcvLOD::LEVEL_NUM; j++)
+          entry.levelEnd[j] = qpcvLOD::getLevelEnd(lod.getLevelEndTable(), j);
+        if (writePoints(&store, entry, inPointFormat, 0, lodData.data(), entry.pointNum) == false)
+          return removeStore(&store, "Can't write the chunk file", outErrorStr);
+      }
+      if (inProgressFunc && inProgressFunc(BUILD_STAGE_LOD, i + 1, chunkTable.size()) == false)
+        return removeStore(&store, NULL, outErrorStr);
+    }
+
+    // Header and table last, so a partial file never looks valid
+    qint64  tableSize = sizeof(ChunkEntry) * (qint64 )header.chunkNum;
+    if (store.seek(0) == false ||
+        store.write((const char *)&header, sizeof(header)) != sizeof(header) ||
+        store.write((const char *)chunkTable.data(), tableSize) != tableSize)
+      return removeStore(&store, "Can't write the chunk file", outErrorStr);
+    store.close();
+    QFile::remove(getStoreFileName(inSourceFileName));
+    if (store.rename(getStoreFileName(inSourceFileName)) == false)
+      return removeStore(&store, "Can't rename the chunk file", outErrorStr);
+    return true;
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  QString mFileName;
+  FileHeader  mHeader;
+  std::vector<ChunkEntry> mChunkTable;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getMagic
+  // ---------------------------------------------------------------------------
+  static const char *getMagic()
+  {
+    return "QPCVCHK2";
+  }
+  // ---------------------------------------------------------------------------
+  // calcGridDim
+  // ---------------------------------------------------------------------------
+  // Cubic cells sized for TARGET_CHUNK_POINT_NUM points on average
+  static void calcGridDim(const GLfloat *inMinMax, size_t inPointNum, uint32_t *outDim)
+  {
+    double  extent[3], maxExtent = 0;
+    for (int i = 0; i < 3; i++)
+    {
+      extent[i] = inMinMax[i * 2 + 1] - inMinMax[i * 2 + 0];
+      if (extent[i] > maxExtent)
+        maxExtent = extent[i];
+    }
+    double  cellNum = (double )inPointNum / TARGET_CHUNK_POINT_NUM;
+    if (maxExtent <= 0 || cellNum <= 1)
+    {
+      outDim[0] = outDim[1] = outDim[2] = 1;
+      return;
+    }
+    // Flat axes (e.g. terrain) get a single layer
+    double  volume = 1;
+    for (int i = 0; i < 3; i++)
+    {
+      if (extent[i] < maxExtent * 1e-3)
+        extent[i] = maxExtent * 1e-3;
+      volume *= extent[i];
+    }
+    double  cellSize = pow(volume / cellNum, 1.0 / 3.0);
+    for (int i = 0; i < 3; i++)
+    {
+      double  d = ceil(extent[i] / cellSize);
+      if (d < 1)
+        d = 1;
+      if (d > MAX_GRID_DIM)
+        d = MAX_GRID_DIM;
+      outDim[i] = (uint32_t )d;
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // getCellMinMax
+  // ---------------------------------------------------------------------------
+  static void getCellMinMax(const FileHeader &inHeader, size_t inChunkIndex, GLfloat *outMinMax)
+  {
+    size_t  cell[3];
+    cell[0] = inChunkIndex % inHeader.gridDim[0];
+    cell[1] = (inChunkIndex / inHeader.gridDim[0]) % inHeader.gridDim[1];
+    cell[2] = inChunkIndex / inHeader.gridDim[0] / inHeader.gridDim[1];
+    for (int i = 0; i < 3; i++)
+    {
+      double  min = inHeader.minMax[i * 2 + 0];
+      double  size = (inHeader.minMax[i * 2 + 1] - min) / inHeader.gridDim[i];
+      outMinMax[i * 2 + 0] = (GLfloat )(min + size * cell[i]);
+      outMinMax[i * 2 + 1] = (GLfloat )(min + size * (cell[i] + 1));
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // writePoints
+  // ---------------------------------------------------------------------------
+  // Writes inNum points at the point index inBegin of the chunk
+  static bool writePoints(QFile *inFile, const ChunkEntry &inEntry, int inPointFormat,
+                          uint64_t inBegin, const ibc::gl::glXYZf_RGBAub *inData, size_t inNum)
+  {
+    const size_t  pointSize = getPointSize(inPointFormat);
+    const char  *ptr = (const char *)inData;
+    std::vector<qpcvCompactPoint> compactData;
+    if (inPointFormat == POINT_FORMAT_COMPACT)
+    {
+      compactData.resize(inNum);
+      qpcvQuantizer::encode(inData, inNum, inEntry.origin, inEntry.step, compactData.data());
+      ptr = (const char *)compactData.data();
+    }
+    qint64  size = (qint64 )(inNum * pointSize);
+    if (inFile->seek(inEntry.offset + inBegin * pointSize) == false ||
+        inFile->write(ptr, size) != size)
+      return false;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // getChunkIndex
+  // ---------------------------------------------------------------------------
+  static size_t getChunkIndex(const FileHeader &inHeader, const ibc::gl::glXYZf_RGBAub &inPoint)
+  {
+    const GLfloat *v = &(inPoint.x);
+    size_t  cell[3];
+    for (int i = 0; i < 3; i++)
+    {
+      double  range = inHeader.minMax[i * 2 + 1] - inHeader.minMax[i * 2 + 0];
+      double  d = 0;
+      if (range > 0)
+        d = (v[i] - inHeader.minMax[i * 2 + 0]) / range * inHeader.gridDim[i];
+      if (!(d > 0))
+        d = 0;
+      if (d > inHeader.gridDim[i] - 1)
+        d = inHeader.gridDim[i] - 1;
+      cell[i] = (size_t )d;
+    }
+    return (cell[2] * inHeader.gridDim[1] + cell[1]) * inHeader.gridDim[0] + cell[0];
+  }
+  // ---------------------------------------------------------------------------
+  // removeStore
+  // ---------------------------------------------------------------------------
+  // Deletes the partial chunk file of build() (inStr NULL : canceled)
+  static bool removeStore(QFile *ioStore, const char *inStr, std::string *outErrorStr)
+  {
+    ioStore->remove();
+    if (inStr == NULL)
+      return false;
+    return setError(inStr, outErrorStr);
+  }
+  // ---------------------------------------------------------------------------
+  // setError
+  // ---------------------------------------------------------------------------
+  static bool setError(const char *inStr, std::string *outErrorStr)
+  {
+    *outErrorStr = inStr;
+    return false;
+  }
+};
+
+// -----------------------------------------------------------------------------
+// qpcvChunkStoreBuilder class
+// -----------------------------------------------------------------------------
+// Runs qpcvChunkStore::build() on a worker thread. The progress is reported
+// with the qpcvLoader stage values and in bytes, so the same status bar UI can
+// show it
+class qpcvChunkStoreBuilder : public QThread
+{
+Q_OBJECT
+
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvChunkStoreBuilder
+  // ---------------------------------------------------------------------------
+  qpcvChunkStoreBuilder(const QString &inFileName, int inPointFormat,
+                        int inThreadNum, size_t inWriteBufferSize,
+                        QObject *parent = Q_NULLPTR)
+  : QThread(parent)
+  {
+    mFileName = inFileName;
+    mPointFormat = inPointFormat;
+    mThreadNum = inThreadNum;
+    mWriteBufferSize = inWriteBufferSize;
+    mResult = false;
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvChunkStoreBuilder
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvChunkStoreBuilder()
+  {
+    requestInterruption();
+    wait();
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getFileName
+  // ---------------------------------------------------------------------------
+  const QString &getFileName() const
+  {
+    return mFileName;
+  }
+  // ---------------------------------------------------------------------------
+  // getPointFormat
+  // ---------------------------------------------------------------------------
+  int getPointFormat() const
+  {
+    return mPointFormat;
+  }
+  // ---------------------------------------------------------------------------
+  // getResult
+  // ---------------------------------------------------------------------------
+  bool  getResult() const
+  {
+    return mResult;
+  }
+  // ---------------------------------------------------------------------------
+  // getErrorStr
+  // ---------------------------------------------------------------------------
+  QString getErrorStr() const
+  {
+    return QString(mErrorStr.c_str());
+  }
+
+signals:
+  void  progressChanged(int inStage, qint64 inDoneBytes, qint64 inTotalBytes);
+
+protected:
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  virtual void  run()
+  {
+    // Stage mapping : bounds -> header, count -> bounds, scatter -> decode.
+    // Each pass is reported as a pass over the source file bytes
+    static const int  stageTable[] = {1, 3, 2, 4};
+    qint64  sourceSize = QFileInfo(mFileName).size();
+    mResult = qpcvChunkStore::build(
+                mFileName, mPointFormat, mThreadNum, mWriteBufferSize,
+                [&](int inStage, qint64 inDoneNum, qint64 inTotalNum)
+                {
+                  if (inTotalNum > 0)
+                    inDoneNum = (qint64 )((double )sourceSize * inDoneNum / inTotalNum);
+                  emit progressChanged(stageTable[inStage], inDoneNum, sourceSize);
+                  return !isInterruptionRequested();
+                },
+                &mErrorStr);
+  }
+
+private:
+  // Member variables ----------------------------------------------------------
+  QString mFileName;
+  int mPointFormat;
+  int mThreadNum;
+  size_t  mWriteBufferSize;
+  bool  mResult;
+  std::string mErrorStr;
+};
+
+#endif  // #ifdef QPCV_CHUNK_STORE_H_
@@ -0,0 +1,497 @@
+// =============================================================================
+//  qpcv_decompress_stream.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_decompress_stream.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    gzip / zstd decompression into a bounded queue of blocks
+*/
+
+#ifndef QPCV_DECOMPRESS_STREAM_H_
+#define QPCV_DECOMPRESS_STREAM_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#ifdef QPCV_USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef QPCV_USE_ZSTD
+#include <zstd.h>
+#endif
+#include "qpcv_parallel.h"
+
+// -----------------------------------------------------------------------------
+// qpcvDecompressStream class
+// -----------------------------------------------------------------------------
+// A worker thread decompresses the input (usually a file mapping) into blocks
+// of BLOCK_BYTES and queues up to QUEUE_BLOCK_NUM of them, so the consumer
+// decodes one block while the next ones are decompressed and the memory use
+// does not depend on the decompressed size. A zstd input made of several
+// frames (pzstd, zstd --block-size etc.) is decompressed a group of frames
+// at a time in parallel, one frame per thread.
+// Compiled in with QPCV_USE_ZLIB (gzip) and QPCV_USE_ZSTD (zstd), see qpcv.pro
+class qpcvDecompressStream
+{
+public:
+  enum  Format
+  {
+    FORMAT_NONE = 0,
+    FORMAT_GZIP,
+    FORMAT_ZSTD
+  };
+
+  // Constants -----------------------------------------------------------------
+  static const size_t BLOCK_BYTES = 4 * 1024 * 1024;
+  static const int    QUEUE_BLOCK_NUM = 4;
+  // zstd frames up to this size are decompressed in parallel (one buffer each)
+  static const size_t PARALLEL_MAX_FRAME_BYTES = 64 * 1024 * 1024;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvDecompressStream
+  // ---------------------------------------------------------------------------
+  qpcvDecompressStream()
+  {
+    mData = NULL;
+    mSize = 0;
+    mFormat = FORMAT_NONE;
+    mThreadNum = 1;
+    mReadBytes = 0;
+    mIsStopped = false;
+    mIsFinished = false;
+    mCurrentBlock = NULL;
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvDecompressStream
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvDecompressStream()
+  {
+    stop();
+    if (mCurrentBlock != NULL)
+      delete mCurrentBlock;
+    for (size_t i = 0; i < mFreeList.size(); i++)
+      delete mFreeList[i];
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // detectFormat
+  // ---------------------------------------------------------------------------
+  static Format detectFormat(const unsigned char *inPtr, size_t inSize)
+  {
+    if (inSize >= 2 && inPtr[0] == 0x1F && inPtr[1] == 0x8B)
+      return FORMAT_GZIP;
+    if (inSize >= 4 && inPtr[0] == 0x28 && inPtr[1] == 0xB5 && inPtr[2] == 0x2F && inPtr[3] == 0xFD)
+      return FORMAT_ZSTD;
+    return FORMAT_NONE;
+  }
+  // ---------------------------------------------------------------------------
+  // isSupported
+  // ---------------------------------------------------------------------------
+  static bool isSupported(Format inFormat)
+  {
+#ifdef QPCV_USE_ZLIB
+    if (inFormat == FORMAT_GZIP)
+      return true;
+#endif
+#ifdef QPCV_USE_ZSTD
+    if (inFormat == FORMAT_ZSTD)
+      return true;
+#endif
+    return false;
+  }
+  // ---------------------------------------------------------------------------
+  // getFormatStr
+  // ---------------------------------------------------------------------------
+  static const char *getFormatStr(Format inFormat)
+  {
+    switch (inFormat)
+    {
+      case FORMAT_GZIP:
+        return "gzip";
+      case FORMAT_ZSTD:
+        return "zstd";
+      default:
+        break;
+    }
+    return "none";
+  }
+  // ---------------------------------------------------------------------------
+  // start
+  // ---------------------------------------------------------------------------
+  // inData must stay valid until the stream is stopped or deleted.
+  // inThreadNum <= 0 uses all cores (zstd frames only)
+  bool  start(const unsigned char *inData, size_t inSize, Format inFormat, int inThreadNum)
+  {
+    if (isSupported(inFormat) == false)
+      return false;
+    stop();
+    mData = inData;
+    mSize = inSize;
+    mFormat = inFormat;
+    mThreadNum = qpcvParallel::getThreadNum(inThreadNum, inSize, 1);
+    mReadBytes = 0;
+    mIsStopped = false;
+    mIsFinished = false;
+    mErrorStr.clear();
+    mThread = std::thread(
+      [this]()
+      {
+        bool  result = false;
+#ifdef QPCV_USE_ZLIB
+        if (mFormat == FORMAT_GZIP)
+          result = runGzip();
+#endif
+#ifdef QPCV_USE_ZSTD
+        if (mFormat == FORMAT_ZSTD)
+          result = runZstd();
+#endif
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (result == false && mErrorStr.size() == 0 && mIsStopped == false)
+          mErrorStr = std::string("Broken ") + getFormatStr(mFormat) + " data";
+        mIsFinished = true;
+        mCondition.notify_all();
+      });
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // stop
+  // ---------------------------------------------------------------------------
+  void  stop()
+  {
+    if (mThread.joinable() == false)
+      return;
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mIsStopped = true;
+      mCondition.notify_all();
+    }
+    mThread.join();
+    for (size_t i = 0; i < mQueue.size(); i++)
+      mFreeList.push_back(mQueue[i]);
+    mQueue.clear();
+  }
+  // ---------------------------------------------------------------------------
+  // next
+  // ---------------------------------------------------------------------------
+  // Waits for the next decompressed block. The block stays valid until the
+  // next call. Returns false at the end of the data or on error (getErrorStr())
+  bool  next(const unsigned char **outPtr, size_t *outSize)
+  {
+    std::unique_lock<std::mutex>  lock(mMutex);
+    if (mCurrentBlock != NULL)
+    {
+      mFreeList.push_back(mCurrentBlock);
+      mCurrentBlock = NULL;
+      mCondition.notify_all();
+    }
+    while (mQueue.size() == 0 && mIsFinished == false)
+      mCondition.wait(lock);
+    if (mQueue.size() == 0 || mErrorStr.size() != 0)
+      return false;
+    mCurrentBlock = mQueue.front();
+    mQueue.pop_front();
+    mCondition.notify_all();
+    *outPtr = mCurrentBlock->data();
+    *outSize = mCurrentBlock->size();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // getErrorStr
+  // ---------------------------------------------------------------------------
+  // Empty unless the data is broken
+  std::string getErrorStr()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mErrorStr;
+  }
+  // ---------------------------------------------------------------------------
+  // getReadBytes
+  // ---------------------------------------------------------------------------
+  // Compressed bytes consumed so far (for the progress)
+  size_t  getReadBytes() const
+  {
+    return mReadBytes;
+  }
+
+protected:
+  typedef std::vector<unsigned char>  Block;
+
+  // Member variables ----------------------------------------------------------
+  const unsigned char *mData;
+  size_t  mSize;
+  Format  mFormat;
+  int mThreadNum;
+  std::atomic<size_t> mReadBytes;
+  std::thread mThread;
+  std::mutex  mMutex;
+  std::condition_variable mCondition;
+  std::deque<Block *> mQueue;
+  std::vector<Block *>  mFreeList;
+  Block *mCurrentBlock;
+  bool  mIsStopped;
+  bool  mIsFinished;
+  std::string mErrorStr;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getFreeBlock
+  // ---------------------------------------------------------------------------
+  // Waits until the queue has room. NULL when stopped
+  Block *getFreeBlock()
+  {
+    std::unique_lock<std::mutex>  lock(mMutex);
+    while (mQueue.size() >= (size_t )QUEUE_BLOCK_NUM && mIsStopped == false)
+      mCondition.wait(lock);
+    if (mIsStopped)
+      return NULL;
+    if (mFreeList.size() == 0)
+      return new Block();
+    Block *block = mFreeList.back();
+    mFreeList.pop_back();
+    return block;
+  }
+  // ---------------------------------------------------------------------------
+  // pushBlock
+  // ---------------------------------------------------------------------------
+  // Empty blocks are recycled
+  void  pushBlock(Block *inBlock)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (inBlock->size() == 0)
+      mFreeList.push_back(inBlock);
+    else
+      mQueue.push_back(inBlock);
+    mCondition.notify_all();
+  }
+  // ---------------------------------------------------------------------------
+  // setError
+  // ---------------------------------------------------------------------------
+  bool  setError(const std::string &inStr)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mErrorStr = inStr;
+    return false;
+  }
+#ifdef QPCV_USE_ZLIB
+  // ---------------------------------------------------------------------------
+  // runGzip
+  // ---------------------------------------------------------------------------
+  // Concatenated gzip members (pigz, cat a.gz b.gz) are decompressed one
+  // after another
+  bool  runGzip()
+  {
+    z_stream  stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 15 + 16) != Z_OK)
+      return setError("Can't initialize zlib");
+    size_t  pos = 0;
+    bool  isEnd = false;    // At the end of a member
+    bool  result = true;
+    while (result)
+    {
+      Block *block = getFreeBlock();
+      if (block == NULL)
+        break;
+      block->resize(BLOCK_BYTES);
+      stream.next_out = block->data();
+      stream.avail_out = (uInt )block->size();
+      int ret = Z_OK;
+      while (stream.avail_out != 0 && !(isEnd && pos >= mSize))
+      {
+        // avail_in is 32 bit. With no input left, inflate() still flushes
+        // its pending output (Z_BUF_ERROR : nothing left, truncated)
+        size_t  inNum = std::min(mSize - pos, (size_t )(1 << 30));
+        stream.next_in = (Bytef *)(mData + pos);
+        stream.avail_in = (uInt )inNum;
+        ret = inflate(&stream, Z_NO_FLUSH);
+        pos += inNum - stream.avail_in;
+        if (ret == Z_STREAM_END)
+        {
+          isEnd = true;
+          ret = Z_OK;
+          if (pos < mSize)
+          {
+            if (inflateReset(&stream) != Z_OK)
+              ret = Z_DATA_ERROR;
+            isEnd = false;
+          }
+        }
+        if (ret != Z_OK)
+          break;
+      }
+      mReadBytes = pos;
+      block->resize(block->size() - stream.avail_out);
+      pushBlock(block);
+      if (ret == Z_BUF_ERROR)
+        result = setError("The gzip data is truncated");
+      else if (ret != Z_OK)
+        result = setError(std::string("Broken gzip data (") + (stream.msg != NULL ? stream.msg : "zlib error") + ")");
+      else if (isEnd && pos >= mSize)
+        break;
+    }
+    inflateEnd(&stream);
+    return result;
+  }
+#endif
+#ifdef QPCV_USE_ZSTD
+  // ---------------------------------------------------------------------------
+  // runZstd
+  // ---------------------------------------------------------------------------
+  bool  runZstd()
+  {
+    std::vector<size_t> frameTable;
+    if (mThreadNum > 1 && findFrames(&frameTable) && frameTable.size() > 2)
+      return runZstdFrames(frameTable);
+
+    ZSTD_DStream  *stream = ZSTD_createDStream();
+    if (stream == NULL)
+      return setError("Can't initialize zstd");
+    ZSTD_initDStream(stream);
+    ZSTD_inBuffer input = {mData, mSize, 0};
+    bool  result = true;
+    size_t  ret = 1;    // 0 : at the end of a frame
+    bool  isTruncated = false;
+    while (result)
+    {
+      Block *block = getFreeBlock();
+      if (block == NULL)
+        break;
+      block->resize(BLOCK_BYTES);
+      ZSTD_outBuffer  output = {block->data(), block->size(), 0};
+      while (output.pos < output.size && !(ret == 0 && input.pos >= input.size))
+      {
+        // With no input left, the pending output is still flushed
+        size_t  inPos = input.pos, outPos = output.pos;
+        ret = ZSTD_decompressStream(stream, &output, &input);
+        if (ZSTD_isError(ret))
+          break;
+        if (input.pos == inPos && output.pos == outPos && input.pos >= input.size)
+        {
+          isTruncated = true;
+          break;
+        }
+      }
+      mReadBytes = input.pos;
+      block->resize(output.pos);
+      pushBlock(block);
+      if (ZSTD_isError(ret))
+        result = setError(std::string("Broken zstd data (") + ZSTD_getErrorName(ret) + ")");
+      else if (isTruncated)
+        result = setError("The zstd data is truncated");
+      else if (ret == 0 && input.pos >= input.size)
+        break;
+    }
+    ZSTD_freeDStream(stream);
+    return result;
+  }
+  // ---------------------------------------------------------------------------
+  // findFrames
+  // ---------------------------------------------------------------------------
+  // Start offsets of the frames followed by mSize. Only the frame and block
+  // headers are read. Fails when a frame does not record its content size
+  // or is too large to be buffered as a whole
+  bool  findFrames(std::vector<size_t> *outFrameTable)
+  {
+    size_t  pos = 0;
+    outFrameTable->clear();
+    while (pos < mSize)
+    {
+      size_t  frameSize = ZSTD_findFrameCompressedSize(mData + pos, mSize - pos);
+      if (ZSTD_isError(frameSize) || frameSize == 0)
+        return false;
+      unsigned long long  contentSize = ZSTD_getFrameContentSize(mData + pos, mSize - pos);
+      if (contentSize == ZSTD_CONTENTSIZE_UNKNOWN || contentSize == ZSTD_CONTENTSIZE_ERROR ||
+          contentSize > PARALLEL_MAX_FRAME_BYTES)
+        return false;
+      outFrameTable->push_back(pos);
+      pos += frameSize;
+    }
+    outFrameTable->push_back(mSize);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // runZstdFrames
+  // ---------------------------------------------------------------------------
+  // Each group of mThreadNum frames is decompressed in parallel (a buffer
+  // and a context per thread) and queued in the frame order
+  bool  runZstdFrames(const std::vector<size_t> &inFrameTable)
+  {
+    size_t  frameNum = inFrameTable.size() - 1;
+    std::vector<ZSTD_DCtx *>  contextTable(mThreadNum, NULL);
+    for (int i = 0; i < mThreadNum; i++)
+      if ((contextTable[i] = ZSTD_createDCtx()) == NULL)
+      {
+        for (int j = 0; j < i; j++)
+          ZSTD_freeDCtx(contextTable[j]);
+        return setError("Can't initialize zstd");
+      }
+
+    bool  result = true;
+    for (size_t group = 0; group < frameNum && result; group += mThreadNum)
+    {
+      size_t  groupNum = std::min(frameNum - group, (size_t )mThreadNum);
+      std::vector<Block *>  blockTable(groupNum, NULL);
+      for (size_t i = 0; i < groupNum; i++)
+        if ((blockTable[i] = getFreeBlock()) == NULL)
+          break;
+      if (blockTable[groupNum - 1] == NULL)
+      {
+        for (size_t i = 0; i < groupNum; i++)
+          if (blockTable[i] != NULL)
+            pushBlock(blockTable[i]);
+        break;
+      }
+      std::vector<size_t> retTable(groupNum, 0);
+      qpcvParallel::forEachRange(
+        groupNum, (int )groupNum, 1,
+        [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+        {
+          for (size_t i = inBegin; i < inEnd; i++)
+          {
+            const unsigned char *src = mData + inFrameTable[group + i];
+            size_t  srcSize = inFrameTable[group + i + 1] - inFrameTable[group + i];
+            blockTable[i]->resize((size_t )ZSTD_getFrameContentSize(src, srcSize));
+            retTable[i] = ZSTD_decompressDCtx(contextTable[inThreadIndex],
+                                              blockTable[i]->data(), blockTable[i]->size(),
+                                              src, srcSize);
+          }
+        });
+      for (size_t i = 0; i < groupNum; i++)
+      {
+        if (result && ZSTD_isError(retTable[i]))
+          result = setError(std::string("Broken zstd data (") + ZSTD_getErrorName(retTable[i]) + ")");
+        if (result == false)
+          blockTable[i]->clear();
+        pushBlock(blockTable[i]);
+      }
+      mReadBytes = inFrameTable[group + groupNum];
+    }
+    for (int i = 0; i < mThreadNum; i++)
+      ZSTD_freeDCtx(contextTable[i]);
+    return result;
+  }
+#endif
+};
+
+#endif  // #ifdef QPCV_DECOMPRESS_STREAM_H_
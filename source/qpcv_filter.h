@@ -0,0 +1,483 @@
+// =============================================================================
+//  qpcv_filter.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_filter.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Point filters (crop box, statistical outlier removal, downsampling)
+*/
+
+#ifndef QPCV_FILTER_H_
+#define QPCV_FILTER_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <functional>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "qpcv_parallel.h"
+#include "qpcv_bounds.h"
+#include "qpcv_spatial_index.h"
+#include "qpcv_histogram.h"
+#include "qpcv_voxel_filter.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvFilter class
+// -----------------------------------------------------------------------------
+// One stage of a qpcvFilterPipeline. apply() reads the input and allocates a
+// new output, so the input (e.g. the cached output of the previous stage)
+// is never changed
+class qpcvFilter
+{
+public:
+  // Called with the number of processed points. Return false to cancel
+  typedef std::function<bool(size_t inDoneNum, size_t inTotalNum)> ProgressFunc;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // ~qpcvFilter
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvFilter()
+  {
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getName
+  // ---------------------------------------------------------------------------
+  virtual const char  *getName() const = 0;
+  // ---------------------------------------------------------------------------
+  // getParamStr
+  // ---------------------------------------------------------------------------
+  // The parameters as text. The pipeline recomputes a stage only when this
+  // or the input of the stage changed
+  virtual std::string getParamStr() const = 0;
+  // ---------------------------------------------------------------------------
+  // apply
+  // ---------------------------------------------------------------------------
+  // inMinMax bounds the input. *outData is allocated with new [] (the caller
+  // releases it) and outMinMax bounds the output. Returns false on cancel or
+  // error (outErrorStr is set on error)
+  virtual bool  apply(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                      const GLfloat *inMinMax, int inThreadNum,
+                      ibc::gl::glXYZf_RGBAub **outData, size_t *outNum, GLfloat *outMinMax,
+                      std::string *outErrorStr,
+                      const ProgressFunc &inProgressFunc = ProgressFunc()) = 0;
+
+protected:
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // compact
+  // ---------------------------------------------------------------------------
+  // Copies the points where inKeepFunc(index) is true, in the input order.
+  // The first pass counts the kept points of each thread slice, the second
+  // one copies them to the offsets of the slices (and collects the bounds)
+  template <typename KeepFunc>
+  static bool compact(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                      int inThreadNum, KeepFunc inKeepFunc,
+                      ibc::gl::glXYZf_RGBAub **outData, size_t *outNum, GLfloat *outMinMax,
+                      std::string *outErrorStr,
+                      const qpcvParallel::ProgressFunc &inProgressFunc = qpcvParallel::ProgressFunc())
+  {
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, inNum, 256 * 1024);
+    std::vector<size_t> countTable(threadNum, 0);
+    if (qpcvParallel::forEachRange(
+          inNum, threadNum, 1024 * 1024,
+          [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+          {
+            size_t  count = 0;
+            for (size_t i = inBegin; i < inEnd; i++)
+              if (inKeepFunc(i))
+                count++;
+            countTable[inThreadIndex] += count;
+          },
+          [&](size_t inDoneNum)
+          {
+            return !inProgressFunc || inProgressFunc(inDoneNum / 2);
+          }) == false)
+      return false;
+    size_t  num = 0;
+    for (int i = 0; i < threadNum; i++)
+    {
+      size_t  count = countTable[i];
+      countTable[i] = num;
+      num += count;
+    }
+    ibc::gl::glXYZf_RGBAub  *data = new (std::nothrow) ibc::gl::glXYZf_RGBAub[num == 0 ? 1 : num];
+    if (data == NULL)
+    {
+      *outErrorStr = "Out of memory";
+      return false;
+    }
+    std::vector<qpcvBounds> boundsTable(threadNum);
+    if (qpcvParallel::forEachRange(
+          inNum, threadNum, 1024 * 1024,
+          [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+          {
+            size_t  pos = countTable[inThreadIndex];
+            for (size_t i = inBegin; i < inEnd; i++)
+              if (inKeepFunc(i))
+                data[pos++] = inData[i];
+            boundsTable[inThreadIndex].add(data + countTable[inThreadIndex],
+                                           pos - countTable[inThreadIndex]);
+            countTable[inThreadIndex] = pos;
+          },
+          [&](size_t inDoneNum)
+          {
+            return !inProgressFunc || inProgressFunc((inNum + inDoneNum) / 2);
+          }) == false)
+    {
+      delete [] data;
+      return false;
+    }
+    qpcvBounds  bounds;
+    for (size_t i = 0; i < boundsTable.size(); i++)
+      bounds.merge(boundsTable[i]);
+    bounds.getMinMax(outMinMax);
+    *outData = data;
+    *outNum = num;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // formatParam
+  // ---------------------------------------------------------------------------
+  // Exact text of a double (so any change of a parameter is detected)
+  static std::string  formatParam(double inValue)
+  {
+    char  buf[32];
+    snprintf(buf, sizeof(buf), "%.17g", inValue);
+    return std::string(buf);
+  }
+};
+
+// -----------------------------------------------------------------------------
+// qpcvCropFilter class
+// -----------------------------------------------------------------------------
+// Keeps the points inside of an axis aligned box (the faces included)
+class qpcvCropFilter : public qpcvFilter
+{
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvCropFilter
+  // ---------------------------------------------------------------------------
+  qpcvCropFilter()
+  {
+    for (int i = 0; i < 6; i++)
+      mBox[i] = 0;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // setBox
+  // ---------------------------------------------------------------------------
+  // inMinMax : x min, x max, y min, ...
+  void  setBox(const double *inMinMax)
+  {
+    for (int i = 0; i < 6; i++)
+      mBox[i] = inMinMax[i];
+  }
+  // ---------------------------------------------------------------------------
+  // getName
+  // ---------------------------------------------------------------------------
+  virtual const char  *getName() const
+  {
+    return "Crop";
+  }
+  // ---------------------------------------------------------------------------
+  // getParamStr
+  // ---------------------------------------------------------------------------
+  virtual std::string getParamStr() const
+  {
+    std::string str;
+    for (int i = 0; i < 6; i++)
+      str += formatParam(mBox[i]) + " ";
+    return str;
+  }
+  // ---------------------------------------------------------------------------
+  // apply
+  // ---------------------------------------------------------------------------
+  virtual bool  apply(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                      const GLfloat *, int inThreadNum,
+                      ibc::gl::glXYZf_RGBAub **outData, size_t *outNum, GLfloat *outMinMax,
+                      std::string *outErrorStr,
+                      const ProgressFunc &inProgressFunc = ProgressFunc())
+  {
+    // The comparisons are false for NaN, so NaN points are dropped
+    GLfloat box[6];
+    for (int i = 0; i < 6; i++)
+      box[i] = (GLfloat )mBox[i];
+    return compact(inData, inNum, inThreadNum,
+                   [&](size_t i)
+                   {
+                     const ibc::gl::glXYZf_RGBAub &v = inData[i];
+                     return (v.x >= box[0] && v.x <= box[1] &&
+                             v.y >= box[2] && v.y <= box[3] &&
+                             v.z >= box[4] && v.z <= box[5]);
+                   },
+                   outData, outNum, outMinMax, outErrorStr,
+                   [&](size_t inDoneNum)
+                   {
+                     return !inProgressFunc || inProgressFunc(inDoneNum, inNum);
+                   });
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  double  mBox[6];
+};
+
+// -----------------------------------------------------------------------------
+// qpcvOutlierFilter class
+// -----------------------------------------------------------------------------
+// Statistical outlier removal: the mean distance of every point to its k
+// nearest neighbors is computed (with a qpcvSpatialIndex of the input), and
+// the points whose mean distance is above mean + ratio * stddev of all the
+// mean distances are removed
+class qpcvOutlierFilter : public qpcvFilter
+{
+public:
+  // Constants -----------------------------------------------------------------
+  static const int  MAX_NEIGHBOR_NUM = 64;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvOutlierFilter
+  // ---------------------------------------------------------------------------
+  qpcvOutlierFilter()
+  {
+    mNeighborNum = 8;
+    mStdRatio = 1.0;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // setParam
+  // ---------------------------------------------------------------------------
+  void  setParam(int inNeighborNum, double inStdRatio)
+  {
+    mNeighborNum = std::max(1, std::min((int )MAX_NEIGHBOR_NUM, inNeighborNum));
+    mStdRatio = inStdRatio;
+  }
+  // ---------------------------------------------------------------------------
+  // getName
+  // ---------------------------------------------------------------------------
+  virtual const char  *getName() const
+  {
+    return "Outliers";
+  }
+  // ---------------------------------------------------------------------------
+  // getParamStr
+  // ---------------------------------------------------------------------------
+  virtual std::string getParamStr() const
+  {
+    return formatParam(mNeighborNum) + " " + formatParam(mStdRatio);
+  }
+  // ---------------------------------------------------------------------------
+  // apply
+  // ---------------------------------------------------------------------------
+  virtual bool  apply(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                      const GLfloat *inMinMax, int inThreadNum,
+                      ibc::gl::glXYZf_RGBAub **outData, size_t *outNum, GLfloat *outMinMax,
+                      std::string *outErrorStr,
+                      const ProgressFunc &inProgressFunc = ProgressFunc())
+  {
+    // Progress : index 0 - 20 %, neighbors 20 - 90 %, copy 90 - 100 %
+    auto  progressFunc = [&](size_t inFrom, size_t inTo, size_t inDoneNum, size_t inTotalNum)
+    {
+      if (!inProgressFunc)
+        return true;
+      size_t  done = (inTotalNum == 0) ? inTo : inFrom + (inTo - inFrom) * inDoneNum / inTotalNum;
+      return inProgressFunc(inNum * done / 100, inNum);
+    };
+    // The grid covers the bulk of the points only. A few far outliers in the
+    // bounds would leave the dense part in a handful of huge cells (the
+    // points outside are clamped into the border cells). A coarse range will do
+    const double  lowPercent = 0.1;
+    const int rangeBinNum = 64;
+    GLfloat gridMinMax[6];
+    qpcvHistogram histogram;
+    qpcvHistogram::calcParallel(inData, inNum, inMinMax, inThreadNum, &histogram);
+    for (int i = 0; i < 3; i++)
+    {
+      double  from, to;
+      qpcvHistogram::calcPercentileRange(inData, inNum, histogram, i,
+                                         lowPercent, 100.0 - lowPercent,
+                                         inThreadNum, &from, &to, rangeBinNum);
+      gridMinMax[i * 2 + 0] = (GLfloat )from;
+      gridMinMax[i * 2 + 1] = (GLfloat )to;
+    }
+    qpcvSpatialIndex  index;
+    if (index.build(inData, inNum, gridMinMax, inThreadNum,
+                    [&](size_t inDoneNum, size_t inTotalNum)
+                    {
+                      return progressFunc(0, 20, inDoneNum, inTotalNum);
+                    }) == false)
+    {
+      if (inNum >= 0xFFFFFFFFull)
+        *outErrorStr = "Too many points";
+      return false;
+    }
+
+    // Mean neighbor distance of each point (NaN : no neighbor or NaN point)
+    struct Stat
+    {
+      double  sum, sum2;
+      size_t  num;
+    };
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, inNum, 16 * 1024);
+    std::vector<float>  meanDistTable(inNum);
+    std::vector<Stat> statTable(threadNum, Stat{0, 0, 0});
+    int neighborNum = mNeighborNum;
+    const uint32_t  *order = index.getIndexTable().data();
+    if (qpcvParallel::forEachRange(
+          inNum, threadNum, 16 * 1024,
+          [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+          {
+            double  dist2[MAX_NEIGHBOR_NUM];
+            size_t  neighbor[MAX_NEIGHBOR_NUM];
+            Stat  &stat = statTable[inThreadIndex];
+            // In the cell order, so the next query mostly hits the same cells
+            for (size_t j = inBegin; j < inEnd; j++)
+            {
+              size_t  i = order[j];
+              double  pos[3] = {inData[i].x, inData[i].y, inData[i].z};
+              int num = 0;
+              if (pos[0] == pos[0] && pos[1] == pos[1] && pos[2] == pos[2])
+                num = index.findKNearest(pos, neighborNum, i, dist2, neighbor);
+              if (num == 0)
+              {
+                meanDistTable[i] = NAN;
+                continue;
+              }
+              double  sum = 0;
+              for (int k = 0; k < num; k++)
+                sum += sqrt(dist2[k]);
+              double  meanDist = sum / num;
+              meanDistTable[i] = (float )meanDist;
+              stat.sum += meanDist;
+              stat.sum2 += meanDist * meanDist;
+              stat.num++;
+            }
+          },
+          [&](size_t inDoneNum)
+          {
+            return progressFunc(20, 90, inDoneNum, inNum);
+          }) == false)
+      return false;
+    Stat  total = {0, 0, 0};
+    for (size_t i = 0; i < statTable.size(); i++)
+    {
+      total.sum += statTable[i].sum;
+      total.sum2 += statTable[i].sum2;
+      total.num += statTable[i].num;
+    }
+    float threshold = HUGE_VALF;
+    if (total.num != 0)
+    {
+      double  mean = total.sum / total.num;
+      double  var = std::max(0.0, total.sum2 / total.num - mean * mean);
+      threshold = (float )(mean + mStdRatio * sqrt(var));
+    }
+    // A single (isolated) point has no neighbors and is kept, NaN is dropped
+    return compact(inData, inNum, inThreadNum,
+                   [&](size_t i)
+                   {
+                     if (meanDistTable[i] <= threshold)
+                       return true;
+                     return (total.num == 0 && inData[i].x == inData[i].x &&
+                             inData[i].y == inData[i].y && inData[i].z == inData[i].z);
+                   },
+                   outData, outNum, outMinMax, outErrorStr,
+                   [&](size_t inDoneNum)
+                   {
+                     return progressFunc(90, 100, inDoneNum, inNum);
+                   });
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  int mNeighborNum;
+  double  mStdRatio;
+};
+
+// -----------------------------------------------------------------------------
+// qpcvDownsampleFilter class
+// -----------------------------------------------------------------------------
+// qpcvVoxelFilter as a pipeline stage
+class qpcvDownsampleFilter : public qpcvFilter
+{
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvDownsampleFilter
+  // ---------------------------------------------------------------------------
+  qpcvDownsampleFilter()
+  {
+    mVoxelSize = 0.05;
+    mMode = qpcvVoxelFilter::MODE_CENTROID;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // setParam
+  // ---------------------------------------------------------------------------
+  void  setParam(double inVoxelSize, int inMode)
+  {
+    mVoxelSize = inVoxelSize;
+    mMode = inMode;
+  }
+  // ---------------------------------------------------------------------------
+  // getName
+  // ---------------------------------------------------------------------------
+  virtual const char  *getName() const
+  {
+    return "Downsampling";
+  }
+  // ---------------------------------------------------------------------------
+  // getParamStr
+  // ---------------------------------------------------------------------------
+  virtual std::string getParamStr() const
+  {
+    return formatParam(mVoxelSize) + " " + formatParam(mMode);
+  }
+  // ---------------------------------------------------------------------------
+  // apply
+  // ---------------------------------------------------------------------------
+  virtual bool  apply(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                      const GLfloat *inMinMax, int inThreadNum,
+                      ibc::gl::glXYZf_RGBAub **outData, size_t *outNum, GLfloat *outMinMax,
+                      std::string *outErrorStr,
+                      const ProgressFunc &inProgressFunc = ProgressFunc())
+  {
+    if (qpcvVoxelFilter::downsample(inData, inNum, inMinMax, mVoxelSize, mMode, inThreadNum,
+                                    outData, outNum, outErrorStr, inProgressFunc) == false)
+      return false;
+    qpcvBounds  bounds;
+    qpcvBounds::calcParallel(*outData, *outNum, inThreadNum, &bounds);
+    bounds.getMinMax(outMinMax);
+    return true;
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  double  mVoxelSize;
+  int mMode;
+};
+
+#endif  // #ifdef QPCV_FILTER_H_
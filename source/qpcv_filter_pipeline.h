@@ -0,0 +1,417 @@
+// =============================================================================
+//  qpcv_filter_pipeline.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_filter_pipeline.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Chain of qpcvFilter stages with a cached output per stage
+*/
+
+#ifndef QPCV_FILTER_PIPELINE_H_
+#define QPCV_FILTER_PIPELINE_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <functional>
+#include <QThread>
+#include <QElapsedTimer>
+#include "qpcv_filter.h"
+#include "qpcv_lod.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvFilterPipeline class
+// -----------------------------------------------------------------------------
+// Every stage keeps its output together with a key made of the keys of the
+// previous stages and its own parameters. run() only recomputes the stages
+// whose key changed, so changing a later stage does not recompute the earlier
+// ones. A disabled stage passes its input through (and keeps its cache).
+// The outputs replaced by run() are not released right away since the view
+// may still show one of them; see releaseGarbage()
+class qpcvFilterPipeline
+{
+public:
+  // Called with the stage index and the number of its processed points.
+  // Return false to cancel
+  typedef std::function<bool(int inStage, size_t inDoneNum, size_t inTotalNum)> ProgressFunc;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvFilterPipeline
+  // ---------------------------------------------------------------------------
+  qpcvFilterPipeline()
+  {
+    mInputData = NULL;
+    mInputNum = 0;
+    for (int i = 0; i < 6; i++)
+      mInputMinMax[i] = 0;
+    mInputID = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvFilterPipeline
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvFilterPipeline()
+  {
+    releaseCache();
+    for (size_t i = 0; i < mStageTable.size(); i++)
+      delete mStageTable[i].filter;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // addFilter
+  // ---------------------------------------------------------------------------
+  // inFilter is owned by the pipeline. Returns the stage index
+  int addFilter(qpcvFilter *inFilter, bool inIsEnabled = true)
+  {
+    Stage stage;
+    stage.filter = inFilter;
+    stage.isEnabled = inIsEnabled;
+    mStageTable.push_back(stage);
+    return (int )mStageTable.size() - 1;
+  }
+  // ---------------------------------------------------------------------------
+  // getStageNum
+  // ---------------------------------------------------------------------------
+  int getStageNum() const
+  {
+    return (int )mStageTable.size();
+  }
+  // ---------------------------------------------------------------------------
+  // getFilter
+  // ---------------------------------------------------------------------------
+  qpcvFilter  *getFilter(int inStage) const
+  {
+    return mStageTable[inStage].filter;
+  }
+  // ---------------------------------------------------------------------------
+  // setEnabled
+  // ---------------------------------------------------------------------------
+  void  setEnabled(int inStage, bool inIsEnabled)
+  {
+    mStageTable[inStage].isEnabled = inIsEnabled;
+  }
+  // ---------------------------------------------------------------------------
+  // isEnabled
+  // ---------------------------------------------------------------------------
+  bool  isEnabled(int inStage) const
+  {
+    return mStageTable[inStage].isEnabled;
+  }
+  // ---------------------------------------------------------------------------
+  // setInput
+  // ---------------------------------------------------------------------------
+  // Releases all the cached outputs. inData must stay valid while the
+  // pipeline uses it (NULL : no input)
+  void  setInput(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum, const GLfloat *inMinMax)
+  {
+    releaseCache();
+    mInputData = inData;
+    mInputNum = inNum;
+    for (int i = 0; i < 6; i++)
+      mInputMinMax[i] = (inMinMax != NULL) ? inMinMax[i] : 0;
+    mInputID++;
+  }
+  // ---------------------------------------------------------------------------
+  // hasInput
+  // ---------------------------------------------------------------------------
+  bool  hasInput() const
+  {
+    return (mInputData != NULL);
+  }
+  // ---------------------------------------------------------------------------
+  // releaseCache
+  // ---------------------------------------------------------------------------
+  // The caller makes sure that none of the outputs is shown any more
+  void  releaseCache()
+  {
+    for (size_t i = 0; i < mStageTable.size(); i++)
+      mStageTable[i].release(&mGarbageTable);
+    releaseGarbage();
+  }
+  // ---------------------------------------------------------------------------
+  // releaseGarbage
+  // ---------------------------------------------------------------------------
+  // Releases the outputs replaced by run(). Call after the view switched to
+  // the current result (or to something else)
+  void  releaseGarbage()
+  {
+    for (size_t i = 0; i < mGarbageTable.size(); i++)
+      delete [] mGarbageTable[i];
+    mGarbageTable.clear();
+  }
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  // The result is put in the LOD order when it has inLODMinPointNum points or
+  // more (0 : never). Returns false on cancel or error (outErrorStr is set
+  // on error). The stages before the failed one keep their new outputs
+  bool  run(int inThreadNum, size_t inLODMinPointNum, std::string *outErrorStr,
+            const ProgressFunc &inProgressFunc = ProgressFunc())
+  {
+    if (mInputData == NULL)
+    {
+      *outErrorStr = "No input data";
+      return false;
+    }
+    std::string key = std::to_string(mInputID);
+    const ibc::gl::glXYZf_RGBAub  *data = mInputData;
+    size_t  num = mInputNum;
+    const GLfloat *minMax = mInputMinMax;
+    Stage *last = NULL;
+    for (size_t i = 0; i < mStageTable.size(); i++)
+    {
+      Stage &stage = mStageTable[i];
+      stage.isReused = false;
+      if (stage.isEnabled == false)
+        continue;
+      key += std::string("/") + stage.filter->getName() + "(" + stage.filter->getParamStr() + ")";
+      if (stage.data != NULL && stage.key == key)
+        stage.isReused = true;
+      else
+      {
+        QElapsedTimer timer;
+        timer.start();
+        ibc::gl::glXYZf_RGBAub  *outData;
+        size_t  outNum;
+        GLfloat outMinMax[6];
+        if (stage.filter->apply(data, num, minMax, inThreadNum,
+                                &outData, &outNum, outMinMax, outErrorStr,
+                                [&](size_t inDoneNum, size_t inTotalNum)
+                                {
+                                  return !inProgressFunc ||
+                                         inProgressFunc((int )i, inDoneNum, inTotalNum);
+                                }) == false)
+          return false;
+        stage.release(&mGarbageTable);
+        stage.key = key;
+        stage.data = outData;
+        stage.num = outNum;
+        for (int j = 0; j < 6; j++)
+          stage.minMax[j] = outMinMax[j];
+        stage.time = timer.elapsed();
+      }
+      data = stage.data;
+      num = stage.num;
+      minMax = stage.minMax;
+      last = &stage;
+    }
+
+    // LOD order of the result (the other stages do not care about the order)
+    if (last != NULL && last->levelEndTable.empty() &&
+        inLODMinPointNum != 0 && last->num >= inLODMinPointNum)
+    {
+      ibc::gl::glXYZf_RGBAub  *lodData = new (std::nothrow) ibc::gl::glXYZf_RGBAub[last->num];
+      if (lodData == NULL)
+        return true;  // Shown without LOD
+      qpcvLOD lod;
+      if (lod.build(last->data, last->num, last->minMax, inThreadNum, lodData,
+                    [&](size_t inDoneNum, size_t inTotalNum)
+                    {
+                      return !inProgressFunc ||
+                             inProgressFunc((int )mStageTable.size(), inDoneNum, inTotalNum);
+                    }) == false)
+      {
+        delete [] lodData;
+        return false;
+      }
+      mGarbageTable.push_back(last->data);
+      last->data = lodData;
+      last->levelEndTable = lod.getLevelEndTable();
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // getResult
+  // ---------------------------------------------------------------------------
+  // The output of the last enabled stage. Returns NULL when no stage is
+  // enabled (the result is the input itself) or run() did not succeed yet.
+  // The data is owned by the pipeline
+  ibc::gl::glXYZf_RGBAub  *getResult(size_t *outNum, std::vector<size_t> *outLevelEndTable,
+                                     GLfloat *outMinMax = NULL) const
+  {
+    for (int i = (int )mStageTable.size() - 1; i >= 0; i--)
+    {
+      const Stage &stage = mStageTable[i];
+      if (stage.isEnabled == false)
+        continue;
+      *outNum = stage.num;
+      *outLevelEndTable = stage.levelEndTable;
+      if (outMinMax != NULL)
+        for (int j = 0; j < 6; j++)
+          outMinMax[j] = stage.minMax[j];
+      return stage.data;
+    }
+    *outNum = 0;
+    outLevelEndTable->clear();
+    return NULL;
+  }
+  // ---------------------------------------------------------------------------
+  // getStageResult
+  // ---------------------------------------------------------------------------
+  // The point number and the time of a stage after run(). outIsReused is true
+  // when the cached output was used
+  void  getStageResult(int inStage, size_t *outNum, qint64 *outTime, bool *outIsReused) const
+  {
+    const Stage &stage = mStageTable[inStage];
+    *outNum = stage.num;
+    *outTime = stage.time;
+    *outIsReused = stage.isReused;
+  }
+
+protected:
+  // ---------------------------------------------------------------------------
+  // Stage struct
+  // ---------------------------------------------------------------------------
+  struct Stage
+  {
+    Stage()
+    {
+      filter = NULL;
+      isEnabled = true;
+      data = NULL;
+      num = 0;
+      for (int i = 0; i < 6; i++)
+        minMax[i] = 0;
+      time = 0;
+      isReused = false;
+    }
+    void  release(std::vector<ibc::gl::glXYZf_RGBAub *> *ioGarbageTable)
+    {
+      if (data != NULL)
+        ioGarbageTable->push_back(data);
+      data = NULL;
+      num = 0;
+      key.clear();
+      levelEndTable.clear();
+    }
+
+    qpcvFilter  *filter;
+    bool  isEnabled;
+    std::string key;
+    ibc::gl::glXYZf_RGBAub  *data;
+    size_t  num;
+    GLfloat minMax[6];
+    std::vector<size_t> levelEndTable;
+    qint64  time;
+    bool  isReused;
+  };
+
+  // Member variables ----------------------------------------------------------
+  std::vector<Stage>  mStageTable;
+  std::vector<ibc::gl::glXYZf_RGBAub *>  mGarbageTable;
+  const ibc::gl::glXYZf_RGBAub  *mInputData;
+  size_t  mInputNum;
+  GLfloat mInputMinMax[6];
+  unsigned int  mInputID;   // Part of the stage keys
+};
+
+// -----------------------------------------------------------------------------
+// qpcvFilterJob class
+// -----------------------------------------------------------------------------
+// Runs qpcvFilterPipeline::run() on a worker thread. The pipeline (and its
+// input) must not be touched before the job finished (deleting the job waits
+// for it). The result is read from the pipeline after finished()
+class qpcvFilterJob : public QThread
+{
+Q_OBJECT
+
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvFilterJob
+  // ---------------------------------------------------------------------------
+  qpcvFilterJob(qpcvFilterPipeline *inPipeline, int inThreadNum, size_t inLODMinPointNum,
+                QObject *parent = Q_NULLPTR)
+  : QThread(parent)
+  {
+    mPipeline = inPipeline;
+    mThreadNum = inThreadNum;
+    mLODMinPointNum = inLODMinPointNum;
+    mIsSucceeded = false;
+    mTime = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvFilterJob
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvFilterJob()
+  {
+    requestInterruption();
+    wait();
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // isSucceeded
+  // ---------------------------------------------------------------------------
+  bool  isSucceeded() const
+  {
+    return mIsSucceeded;
+  }
+  // ---------------------------------------------------------------------------
+  // getErrorStr
+  // ---------------------------------------------------------------------------
+  QString getErrorStr() const
+  {
+    return QString(mErrorStr.c_str());
+  }
+  // ---------------------------------------------------------------------------
+  // getTime
+  // ---------------------------------------------------------------------------
+  qint64  getTime() const
+  {
+    return mTime;
+  }
+
+signals:
+  // inStage == the stage number : LOD build of the result
+  void  progressChanged(int inStage, int inPercent);
+
+protected:
+  // Member variables ----------------------------------------------------------
+  qpcvFilterPipeline  *mPipeline;
+  int mThreadNum;
+  size_t  mLODMinPointNum;
+  bool  mIsSucceeded;
+  std::string mErrorStr;
+  qint64  mTime;
+
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  virtual void  run()
+  {
+    QElapsedTimer timer;
+    timer.start();
+    int lastStage = -1, lastPercent = -1;
+    mIsSucceeded = mPipeline->run(
+      mThreadNum, mLODMinPointNum, &mErrorStr,
+      [&](int inStage, size_t inDoneNum, size_t inTotalNum)
+      {
+        int percent = (inTotalNum == 0) ? 100 : (int )(inDoneNum * 100 / inTotalNum);
+        if (inStage != lastStage || percent != lastPercent)
+        {
+          lastStage = inStage;
+          lastPercent = percent;
+          emit progressChanged(inStage, percent);
+        }
+        return !isInterruptionRequested();
+      });
+    mTime = timer.elapsed();
+  }
+};
+
+#endif  // #ifdef QPCV_FILTER_PIPELINE_H_
@@ -0,0 +1,527 @@
+// =============================================================================
+//  qpcv_generator.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_generator.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Synthetic point cloud generator (test and stress data)
+*/
+
+#ifndef QPCV_GENERATOR_H_
+#define QPCV_GENERATOR_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <new>
+#include <QString>
+#include <QFile>
+#include <QThread>
+#include <QElapsedTimer>
+#include "qpcv_parallel.h"
+#include "qpcv_bounds.h"
+#include "qpcv_lod.h"
+#include "qpcv_histogram.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvGenerator class
+// -----------------------------------------------------------------------------
+// Every point is made from its own random stream (seeded by the seed and the
+// point index), so the output only depends on the seed and the point number,
+// not on the number of threads
+class qpcvGenerator
+{
+public:
+  enum Distribution
+  {
+    DISTRIBUTION_SURFACE = 0,   // sinc surface (the old test data)
+    DISTRIBUTION_UNIFORM,       // uniform in a cube
+    DISTRIBUTION_CLUSTERED,     // gaussian clusters
+    DISTRIBUTION_SCAN_LINES,    // terrain sampled along noisy scan lines
+    DISTRIBUTION_NUM
+  };
+
+  // Constants -----------------------------------------------------------------
+  static const size_t DEFAULT_POINT_NUM = 640 * 480;
+  static const int    CLUSTER_NUM = 64;
+  static const size_t WRITE_BLOCK_NUM = 1024 * 1024;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getDistributionName
+  // ---------------------------------------------------------------------------
+  static const char *getDistributionName(int inDistribution)
+  {
+    static const char *nameTable[DISTRIBUTION_NUM] =
+    {
+      "surface", "uniform", "clustered", "scanlines"
+    };
+    if (inDistribution < 0 || inDistribution >= DISTRIBUTION_NUM)
+      return "";
+    return nameTable[inDistribution];
+  }
+  // ---------------------------------------------------------------------------
+  // findDistribution
+  // ---------------------------------------------------------------------------
+  // Returns -1 when inName is unknown
+  static int  findDistribution(const QString &inName)
+  {
+    for (int i = 0; i < DISTRIBUTION_NUM; i++)
+      if (inName.compare(getDistributionName(i), Qt::CaseInsensitive) == 0)
+        return i;
+    return -1;
+  }
+  // ---------------------------------------------------------------------------
+  // parsePointNum
+  // ---------------------------------------------------------------------------
+  // Accepts a k, M or G suffix (e.g. "250M"). Returns 0 on error
+  static size_t parsePointNum(const QString &inStr)
+  {
+    QString str = inStr.trimmed();
+    double  scale = 1;
+    if (str.endsWith('k', Qt::CaseInsensitive))
+      scale = 1000.0;
+    else if (str.endsWith('M', Qt::CaseInsensitive))
+      scale = 1000.0 * 1000.0;
+    else if (str.endsWith('G', Qt::CaseInsensitive) || str.endsWith('B', Qt::CaseInsensitive))
+      scale = 1000.0 * 1000.0 * 1000.0;
+    if (scale != 1)
+      str.chop(1);
+    bool  isOK;
+    double  num = str.toDouble(&isOK) * scale;
+    if (isOK == false || !(num >= 1))
+      return 0;
+    return (size_t )num;
+  }
+  // ---------------------------------------------------------------------------
+  // generate
+  // ---------------------------------------------------------------------------
+  // Fills outData (inNum points) in place. Returns false when canceled
+  static bool generate(ibc::gl::glXYZf_RGBAub *outData, size_t inNum,
+                       int inDistribution, uint64_t inSeed, int inThreadNum,
+                       const qpcvParallel::ProgressFunc &inProgressFunc = qpcvParallel::ProgressFunc())
+  {
+    // Shared parameters of the clusters
+    GLfloat clusterTable[CLUSTER_NUM][4];
+    for (int i = 0; i < CLUSTER_NUM; i++)
+    {
+      Random  random(inSeed ^ 0xC1C1C1C1C1C1C1C1ull, (uint64_t )i);
+      for (int j = 0; j < 3; j++)
+        clusterTable[i][j] = (GLfloat )random.getUniform(-1.0, 1.0);
+      clusterTable[i][3] = (GLfloat )random.getUniform(0.01, 0.1);   // sigma
+    }
+    size_t  lineNum = (size_t )sqrt((double )inNum);
+    if (lineNum < 1)
+      lineNum = 1;
+
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, inNum, 256 * 1024);
+    return qpcvParallel::forEachRange(
+      inNum, threadNum, 1024 * 1024,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+        {
+          Random  random(inSeed, (uint64_t )i);
+          ibc::gl::glXYZf_RGBAub  &p = outData[i];
+          double  x, y, z, c;
+          switch (inDistribution)
+          {
+            case DISTRIBUTION_UNIFORM:
+              x = random.getUniform(-1.0, 1.0);
+              y = random.getUniform(-1.0, 1.0);
+              z = random.getUniform(-1.0, 1.0);
+              setColor(p, (x + 1) / 2, (y + 1) / 2, (z + 1) / 2);
+              break;
+            case DISTRIBUTION_CLUSTERED:
+              {
+                int cluster = (int )(random.getNext() % CLUSTER_NUM);
+                const GLfloat *center = clusterTable[cluster];
+                x = center[0] + random.getGaussian() * center[3];
+                y = center[1] + random.getGaussian() * center[3];
+                z = center[2] + random.getGaussian() * center[3];
+                c = (double )cluster / (CLUSTER_NUM - 1);
+                setColor(p, c, 1.0 - c, 0.5 + 0.5 * sin(c * M_PI * 8));
+              }
+              break;
+            case DISTRIBUTION_SCAN_LINES:
+              {
+                // Consecutive points belong to the same line, like a scanner
+                size_t  line = i * lineNum / inNum;
+                y = -1.0 + 2.0 * (line + 0.5) / lineNum + random.getGaussian() * 0.002;
+                x = random.getUniform(-1.0, 1.0);
+                z = getTerrain(x, y) + random.getGaussian() * 0.01;
+                c = 0.25 + 0.5 * (z + 0.5) + random.getUniform(-0.1, 0.1);
+                setColor(p, c, c, c);
+              }
+              break;
+            //case DISTRIBUTION_SURFACE:
+            default:
+              {
+                x = random.getUniform(-1.0, 1.0);
+                y = random.getUniform(-1.0, 1.0);
+                double  k = (M_PI * 3.0) * (M_PI * 3.0);
+                double  d = sqrt(k*x*x + k*y*y);
+                z = (d == 0) ? 1 : sin(d) / d;
+                setColor(p, z, z, z);
+              }
+              break;
+          }
+          p.x = (GLfloat )x;
+          p.y = (GLfloat )y;
+          p.z = (GLfloat )z;
+        }
+      },
+      inProgressFunc);
+  }
+  // ---------------------------------------------------------------------------
+  // writePLY
+  // ---------------------------------------------------------------------------
+  // binary_little_endian, float x y z and uchar red green blue
+  static bool writePLY(const QString &inFileName,
+                       const ibc::gl::glXYZf_RGBAub *inData, size_t inNum)
+  {
+    QFile file(inFileName);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate) == false)
+      return false;
+    std::string header =
+      "ply\n"
+      "format binary_little_endian 1.0\n"
+      "comment generated by qpcv\n"
+      "element vertex " + std::to_string((unsigned long long )inNum) + "\n"
+      "property float x\n"
+      "property float y\n"
+      "property float z\n"
+      "property uchar red\n"
+      "property uchar green\n"
+      "property uchar blue\n"
+      "end_header\n";
+    if (file.write(header.data(), (qint64 )header.size()) != (qint64 )header.size())
+      return false;
+    const size_t  recordSize = sizeof(GLfloat) * 3 + 3;
+    std::vector<char> buf(WRITE_BLOCK_NUM * recordSize);
+    for (size_t block = 0; block < inNum; block += WRITE_BLOCK_NUM)
+    {
+      size_t  num = inNum - block;
+      if (num > WRITE_BLOCK_NUM)
+        num = WRITE_BLOCK_NUM;
+      char  *pos = buf.data();
+      for (size_t i = 0; i < num; i++)
+      {
+        const ibc::gl::glXYZf_RGBAub  &p = inData[block + i];
+        memcpy(pos, &(p.x), sizeof(GLfloat) * 3);   // Assumes a little endian host
+        pos[12] = (char )p.r;
+        pos[13] = (char )p.g;
+        pos[14] = (char )p.b;
+        pos += recordSize;
+      }
+      qint64  size = (qint64 )(num * recordSize);
+      if (file.write(buf.data(), size) != size)
+        return false;
+    }
+    return true;
+  }
+
+protected:
+  // ---------------------------------------------------------------------------
+  // Random class
+  // ---------------------------------------------------------------------------
+  // splitmix64. Cheap to create, so there is one per point
+  class Random
+  {
+  public:
+    Random(uint64_t inSeed, uint64_t inStream)
+    {
+      mState = inSeed * 0x9E3779B97F4A7C15ull + inStream * 0xD1B54A32D192ED03ull;
+      getNext();
+    }
+    uint64_t  getNext()
+    {
+      uint64_t  z = (mState += 0x9E3779B97F4A7C15ull);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      return z ^ (z >> 31);
+    }
+    // [0, 1)
+    double  getDouble()
+    {
+      return (getNext() >> 11) * (1.0 / 9007199254740992.0);
+    }
+    double  getUniform(double inMin, double inMax)
+    {
+      return inMin + (inMax - inMin) * getDouble();
+    }
+    // Box-Muller (mean 0, sigma 1)
+    double  getGaussian()
+    {
+      double  u = 1.0 - getDouble();    // (0, 1]
+      double  v = getDouble();
+      return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+    }
+
+  protected:
+    uint64_t  mState;
+  };
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getTerrain
+  // ---------------------------------------------------------------------------
+  static double getTerrain(double inX, double inY)
+  {
+    return 0.3 * sin(inX * 3.1) * cos(inY * 2.3) +
+           0.1 * sin(inX * 11.0 + inY * 7.0) +
+           0.05 * cos(inX * 23.0 - inY * 19.0);
+  }
+  // ---------------------------------------------------------------------------
+  // setColor
+  // ---------------------------------------------------------------------------
+  static void setColor(ibc::gl::glXYZf_RGBAub &outPoint, double inR, double inG, double inB)
+  {
+    outPoint.r = toByte(inR);
+    outPoint.g = toByte(inG);
+    outPoint.b = toByte(inB);
+    outPoint.a = 255;
+  }
+  // ---------------------------------------------------------------------------
+  // toByte
+  // ---------------------------------------------------------------------------
+  static GLubyte  toByte(double inValue)
+  {
+    if (!(inValue > 0))
+      return 0;
+    if (inValue >= 1)
+      return 255;
+    return (GLubyte )(inValue * 255);
+  }
+};
+
+// -----------------------------------------------------------------------------
+// qpcvGenerateJob class
+// -----------------------------------------------------------------------------
+// Generates the test data off the GUI thread, with the bounds, the qpcvLOD
+// order (from inLODMinNum points) and the histogram, like qpcvLoader does for
+// a file
+class qpcvGenerateJob : public QThread
+{
+Q_OBJECT
+
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvGenerateJob
+  // ---------------------------------------------------------------------------
+  qpcvGenerateJob(size_t inNum, int inDistribution, uint64_t inSeed, size_t inLODMinNum,
+                  int inThreadNum, QObject *parent = Q_NULLPTR)
+  : QThread(parent)
+  {
+    mDataNum = inNum;
+    mDistribution = inDistribution;
+    mSeed = inSeed;
+    mLODMinNum = inLODMinNum;
+    mThreadNum = inThreadNum;
+    mData = NULL;
+    mIsSucceeded = false;
+    for (int i = 0; i < 4; i++)
+      mParam[i] = 0;
+    for (int i = 0; i < 6; i++)
+      mMinMax[i] = 0;
+    mGenerateTime = 0;
+    mTime = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvGenerateJob
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvGenerateJob()
+  {
+    requestInterruption();
+    wait();
+    if (mData != NULL)
+      delete [] mData;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // isSucceeded
+  // ---------------------------------------------------------------------------
+  // Only valid after finished() was emitted (false when canceled or failed,
+  // see getErrorStr())
+  bool  isSucceeded() const
+  {
+    return mIsSucceeded;
+  }
+  // ---------------------------------------------------------------------------
+  // getErrorStr
+  // ---------------------------------------------------------------------------
+  // Empty when canceled
+  QString getErrorStr() const
+  {
+    return QString(mErrorStr.c_str());
+  }
+  // ---------------------------------------------------------------------------
+  // takeData
+  // ---------------------------------------------------------------------------
+  // The caller owns the data and releases it with delete []
+  ibc::gl::glXYZf_RGBAub  *takeData()
+  {
+    ibc::gl::glXYZf_RGBAub  *data = mData;
+    mData = NULL;
+    return data;
+  }
+  // ---------------------------------------------------------------------------
+  // getDataNum
+  // ---------------------------------------------------------------------------
+  size_t  getDataNum() const
+  {
+    return mDataNum;
+  }
+  // ---------------------------------------------------------------------------
+  // getDistribution
+  // ---------------------------------------------------------------------------
+  int getDistribution() const
+  {
+    return mDistribution;
+  }
+  // ---------------------------------------------------------------------------
+  // getSeed
+  // ---------------------------------------------------------------------------
+  uint64_t  getSeed() const
+  {
+    return mSeed;
+  }
+  // ---------------------------------------------------------------------------
+  // getParam
+  // ---------------------------------------------------------------------------
+  const GLfloat *getParam() const
+  {
+    return mParam;
+  }
+  // ---------------------------------------------------------------------------
+  // getMinMax
+  // ---------------------------------------------------------------------------
+  const GLfloat *getMinMax() const
+  {
+    return mMinMax;
+  }
+  // ---------------------------------------------------------------------------
+  // getLevelEndTable
+  // ---------------------------------------------------------------------------
+  // Empty when the data is not in the qpcvLOD order
+  const std::vector<size_t> &getLevelEndTable() const
+  {
+    return mLevelEndTable;
+  }
+  // ---------------------------------------------------------------------------
+  // getHistogram
+  // ---------------------------------------------------------------------------
+  const qpcvHistogram &getHistogram() const
+  {
+    return mHistogram;
+  }
+  // ---------------------------------------------------------------------------
+  // getGenerateTime
+  // ---------------------------------------------------------------------------
+  qint64  getGenerateTime() const
+  {
+    return mGenerateTime;
+  }
+  // ---------------------------------------------------------------------------
+  // getTime
+  // ---------------------------------------------------------------------------
+  // The bounds, the LOD order and the histogram
+  qint64  getTime() const
+  {
+    return mTime;
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  size_t  mDataNum;
+  int mDistribution;
+  uint64_t  mSeed;
+  size_t  mLODMinNum;
+  int mThreadNum;
+  ibc::gl::glXYZf_RGBAub  *mData;
+  bool  mIsSucceeded;
+  std::string mErrorStr;
+  GLfloat mParam[4];
+  GLfloat mMinMax[6];
+  std::vector<size_t> mLevelEndTable;
+  qpcvHistogram mHistogram;
+  qint64  mGenerateTime;
+  qint64  mTime;
+
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  virtual void  run()
+  {
+    QElapsedTimer timer;
+    timer.start();
+    qpcvParallel::ProgressFunc  progressFunc =
+      [&](size_t)
+      {
+        return !isInterruptionRequested();
+      };
+    mData = new (std::nothrow) ibc::gl::glXYZf_RGBAub[mDataNum];
+    if (mData == NULL)
+    {
+      mErrorStr = "Can't allocate the points";
+      return;
+    }
+    if (qpcvGenerator::generate(mData, mDataNum, mDistribution, mSeed, mThreadNum,
+                                progressFunc) == false)
+      return;
+    mGenerateTime = timer.restart();
+
+    qpcvBounds  bounds;
+    qpcvBounds::calcParallel(mData, mDataNum, mThreadNum, &bounds);
+    bounds.calcFitParam(mParam, mMinMax);
+
+    // Same level-of-detail order as the loaded files (kept as it is when the
+    // second buffer can't be allocated)
+    if (mDataNum >= mLODMinNum)
+    {
+      ibc::gl::glXYZf_RGBAub  *lodData = new (std::nothrow) ibc::gl::glXYZf_RGBAub[mDataNum];
+      qpcvLOD lod;
+      bool  isBuilt = (lodData != NULL &&
+                       lod.build(mData, mDataNum, mMinMax, mThreadNum, lodData,
+                                 [&](size_t, size_t)
+                                 {
+                                   return !isInterruptionRequested();
+                                 }));
+      if (isBuilt)
+      {
+        delete [] mData;
+        mData = lodData;
+        mLevelEndTable = lod.getLevelEndTable();
+      }
+      else if (lodData != NULL)
+        delete [] lodData;
+      if (isInterruptionRequested())
+        return;
+    }
+    if (qpcvHistogram::calcParallel(mData, mDataNum, mMinMax, mThreadNum,
+                                    &mHistogram, progressFunc) == false)
+      return;
+    mTime = timer.elapsed();
+    mIsSucceeded = true;
+  }
+};
+
+#endif  // #ifdef QPCV_GENERATOR_H_
@@ -0,0 +1,1357 @@
+// =============================================================================
+//  qpcv_gl_view.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_gl_view.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Point cloud view with level-of-detail drawing
+*/
+
+#ifndef QPCV_GL_VIEW_H_
+#define QPCV_GL_VIEW_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <QTimer>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QPainter>
+#include <QOpenGLContext>
+#include <QMatrix4x4>
+#include <QVector4D>
+#include <QToolTip>
+#include <QElapsedTimer>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLExtraFunctions>
+#include <stdint.h>
+#include <stddef.h>
+#include "qpcv_camera.h"
+#include "qpcv_chunk_layer.h"
+#include "qpcv_guide_layer.h"
+#include "qpcv_lod.h"
+#include "qpcv_parallel.h"
+#include "qpcv_perf_hud.h"
+#include "qpcv_point_layer.h"
+#include "qpcv_scalar_layer.h"
+#include "qpcv_spatial_index.h"
+#include "qpcv_stream_layer.h"
+// ibc related includes
+#include "ibc/qt/gl_point_cloud_view.h"
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvGLView class
+// -----------------------------------------------------------------------------
+// The view draws everything itself with the camera of mCamera (left drag :
+// orbit, right / middle or Shift + left drag : pan, wheel : dolly, double
+// click : reset), so getViewMatrix() and getProjectionMatrix() are the
+// matrices of the image. GLPointCloudView provides the GL widget and keeps the
+// display settings in mDataModel (color mode, color map, point size),
+// mCubeModel and mAxisModel, which the window edits as before; its own
+// drawing is not used.
+// When the data is stored in the qpcvLOD order, the cells of the order that
+// are outside of the view frustum are not drawn, and every other cell is drawn
+// down to the level where its octree nodes are about one pixel on the screen
+// at its nearest point (the screen space error of the current camera). While
+// the camera is moving, the levels are also limited by the point budget. Once
+// the camera stops, the levels are extended one by one up to the screen space
+// error. A point is uploaded to the GPU when it is drawn for the first time.
+// Ctrl + click picks a point and Ctrl + Shift + click picks a second one to
+// measure the distance (needs the spatial index, see setSpatialIndex()).
+// A triangle mesh on the point data (see setMeshData()) is drawn as a
+// wireframe or flat shaded with one indexed draw call instead of the points.
+// The color map by a scalar attribute of the file (see setScalarData()) is
+// drawn by mScalarLayer. The out-of-core mode (see setChunkStore()) draws the
+// frames of qpcvChunkPager with mChunkLayer and the live stream mode (see
+// setStreamFrame()) the frames of qpcvStreamReceiver with mStreamLayer
+// instead of the point data.
+// viewChanged() is emitted whenever the data matrix changes.
+class qpcvGLView : public ibc::qt::GLPointCloudView
+{
+Q_OBJECT
+
+public:
+  enum  RenderMode
+  {
+    RENDER_MODE_POINTS  = 0,
+    RENDER_MODE_WIREFRAME,    // Shaded on OpenGL ES (no glPolygonMode())
+    RENDER_MODE_SHADED,
+    RENDER_MODE_NUM
+  };
+
+  // Same order as the backdrop combo box of the window
+  enum  BackdropColorMode
+  {
+    BACKDROP_COLOR_MODE_SINGLE  = 0,
+    BACKDROP_COLOR_MODE_BLUE,
+    BACKDROP_COLOR_MODE_DARK_BLUE,
+    BACKDROP_COLOR_MODE_GRAY,
+    BACKDROP_COLOR_MODE_DARK_GRAY,
+    BACKDROP_COLOR_MODE_NUM
+  };
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvGLView
+  // ---------------------------------------------------------------------------
+  qpcvGLView()
+  : ibc::qt::GLPointCloudView(),
+    mMeshIndexBuffer(QOpenGLBuffer::IndexBuffer)
+  {
+    mData = NULL;
+    mDataNum = 0;
+    mDrawNum = 0;
+    mPointBudget = DEFAULT_POINT_BUDGET;
+    mIsInteracting = false;
+    mRefineLevel = qpcvLOD::LEVEL_NUM;
+    mInteractionLevel = 0;
+    mMaxCellLevel = 0;
+    mRootSize = 0;
+    mFitParam[0] = mFitParam[1] = mFitParam[2] = 0;
+    mFitParam[3] = 1;
+    mSpatialIndex = NULL;
+    mPickNum = 0;
+    mIsPickClick = false;
+    mMeshIndex = NULL;
+    mMeshTriangleNum = 0;
+    mRenderMode = RENDER_MODE_POINTS;
+    mIsMeshDirty = false;
+    mMeshProgram = NULL;
+    mIsMeshProgramFailed = false;
+    mMeshVRAMUsed = 0;
+    mPolygonModeFunc = NULL;
+    mIsTileEnabled = false;
+    mTileX = mTileY = 0;
+    mImageWidth = mImageHeight = 0;
+    mViewWidth = mViewHeight = 0;
+    mColorMapOffset = 0;
+    mColorMapGain = 0;
+    for (int i = 0; i < 3; i++)
+      mBackdropTopColor[i] = mBackdropBottomColor[i] = 0;
+
+    mSettleTimer.setSingleShot(true);
+    connect(&mSettleTimer, &QTimer::timeout,
+            this,
+            [=]()
+            {
+              mIsInteracting = false;
+              mRefineLevel = mInteractionLevel;
+              mRefineTimer.start(REFINE_INTERVAL_MSEC);
+              update();
+            });
+    connect(&mRefineTimer, &QTimer::timeout,
+            this,
+            [=]()
+            {
+              mRefineLevel++;
+              if (mRefineLevel >= mMaxCellLevel)
+                mRefineTimer.stop();
+              update();
+            });
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvGLView
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvGLView()
+  {
+    if (context() == NULL)
+      return;
+    makeCurrent();
+    mPerfHUD.release(context()->extraFunctions());
+    mPointLayer.release(context()->extraFunctions());
+    mScalarLayer.release(context()->extraFunctions());
+    mChunkLayer.release(context()->extraFunctions());
+    mStreamLayer.release(context()->extraFunctions());
+    releaseMeshBuffers();
+    mGuideLayer.release();
+    doneCurrent();
+  }
+
+  // Constants -----------------------------------------------------------------
+  static const size_t DEFAULT_POINT_BUDGET = 10 * 1000 * 1000;
+  static const int    SETTLE_MSEC = 250;
+  static const int    REFINE_INTERVAL_MSEC = 30;
+  static const int    PICK_RADIUS_PIXEL = 4;
+  // The color mode of mDataModel that uses the colors of the file
+  static const int    FILE_COLOR_MODE = qpcvPointLayer::COLOR_MODE_FILE;
+  // The color mode of mDataModel that uses the color map
+  static const int    SCALAR_COLOR_MODE = qpcvPointLayer::COLOR_MODE_MAP;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // setPointData
+  // ---------------------------------------------------------------------------
+  // inLevelEndTable is empty when the data is not in the qpcvLOD order
+  // (everything is drawn all the time then)
+  void  setPointData(ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                     const std::vector<size_t> &inLevelEndTable)
+  {
+    mData = inData;
+    mDataNum = inNum;
+    mLevelEndTable = inLevelEndTable;
+    mDrawNum = inNum;
+    mDrawRangeTable.clear();
+    if (inNum != 0)
+      mDrawRangeTable.push_back({0, inNum});
+    calcCellBoxes();
+    mIsInteracting = false;
+    // The first paint draws the coarsest level only and the refine timer
+    // adds a level at a time, as after an interaction
+    mRefineTimer.stop();
+    mRefineLevel = qpcvLOD::LEVEL_NUM;
+    if (hasLOD())
+    {
+      mRefineLevel = 0;
+      mMaxCellLevel = qpcvLOD::LEVEL_NUM;   // Until the first paint sets it
+      mRefineTimer.start(REFINE_INTERVAL_MSEC);
+    }
+    mPickNum = 0;
+    mMeshIndex = NULL;
+    mMeshTriangleNum = 0;
+    mIsMeshDirty = true;
+    mPointLayer.setPointData(inData, inNum);
+    mScalarLayer.setPointNum(inNum);
+  }
+  // ---------------------------------------------------------------------------
+  // setChunkStore
+  // ---------------------------------------------------------------------------
+  // Enters the out-of-core mode with the chunks of the store of a
+  // qpcvChunkPager (NULL : leaves it). The chunk buffers are deleted.
+  // Returns false before the GL context is created
+  bool  setChunkStore(const qpcvChunkStore *inStore, size_t inVRAMBudget)
+  {
+    if (context() == NULL)
+      return false;
+    makeCurrent();
+    mChunkLayer.setStore(context()->extraFunctions(), inStore, inVRAMBudget);
+    doneCurrent();
+    mDrawNum = 0;
+    update();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // setChunkFrame
+  // ---------------------------------------------------------------------------
+  // Uploads a frame of the pager right away (before the pager composes the
+  // next one). outReleaseTable gets the chunks to give to
+  // qpcvChunkPager::releaseChunks()
+  void  setChunkFrame(const qpcvChunkPager::Frame &inFrame, std::vector<size_t> *outReleaseTable)
+  {
+    outReleaseTable->clear();
+    if (context() == NULL || mChunkLayer.hasChunks() == false)
+      return;
+    makeCurrent();
+    mChunkLayer.applyFrame(context()->extraFunctions(), inFrame, outReleaseTable);
+    doneCurrent();
+    mDrawNum = mChunkLayer.getDrawNum();
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // setStreamFrame
+  // ---------------------------------------------------------------------------
+  // Shows a live stream frame (NULL : leaves the stream mode). inData is not
+  // owned and must stay until the next paint, which writes it into the
+  // buffer ring of mStreamLayer
+  void  setStreamFrame(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum)
+  {
+    mStreamLayer.setFrame(inData, inNum);
+    mDrawNum = (inData != NULL) ? inNum : 0;
+    if (inData == NULL && context() != NULL)
+    {
+      makeCurrent();
+      mStreamLayer.release(context()->extraFunctions());
+      doneCurrent();
+    }
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // getChunkVRAMUsed
+  // ---------------------------------------------------------------------------
+  size_t  getChunkVRAMUsed() const
+  {
+    return mChunkLayer.getVRAMUsed();
+  }
+  // ---------------------------------------------------------------------------
+  // setMeshData
+  // ---------------------------------------------------------------------------
+  // inIndex (3 indices per triangle into the current point data, NULL : no
+  // mesh) is not owned and must stay until the point data is replaced. It is
+  // uploaded at the next paint, so call this after setPointData()
+  void  setMeshData(const uint32_t *inIndex, size_t inTriangleNum)
+  {
+    mMeshIndex = inIndex;
+    mMeshTriangleNum = (inIndex != NULL) ? inTriangleNum : 0;
+    mIsMeshDirty = true;
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // hasMesh
+  // ---------------------------------------------------------------------------
+  bool  hasMesh() const
+  {
+    return (mMeshTriangleNum != 0);
+  }
+  // ---------------------------------------------------------------------------
+  // getMeshTriangleNum
+  // ---------------------------------------------------------------------------
+  size_t  getMeshTriangleNum() const
+  {
+    return mMeshTriangleNum;
+  }
+  // ---------------------------------------------------------------------------
+  // setRenderMode
+  // ---------------------------------------------------------------------------
+  // Without a mesh everything is drawn as points
+  void  setRenderMode(int inMode)
+  {
+    if (inMode < 0 || inMode >= RENDER_MODE_NUM)
+      inMode = RENDER_MODE_POINTS;
+    mRenderMode = inMode;
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // getRenderMode
+  // ---------------------------------------------------------------------------
+  int getRenderMode() const
+  {
+    return mRenderMode;
+  }
+  // ---------------------------------------------------------------------------
+  // isMeshShown
+  // ---------------------------------------------------------------------------
+  bool  isMeshShown() const
+  {
+    return (hasMesh() && mRenderMode != RENDER_MODE_POINTS && mIsMeshProgramFailed == false);
+  }
+  // ---------------------------------------------------------------------------
+  // getVRAMUsed
+  // ---------------------------------------------------------------------------
+  // Bytes allocated for the buffers of all the layers and of the mesh
+  size_t  getVRAMUsed() const
+  {
+    return mPointLayer.getVRAMUsed() + mScalarLayer.getVRAMUsed() +
+           mChunkLayer.getVRAMUsed() + mStreamLayer.getVRAMUsed() + mMeshVRAMUsed;
+  }
+  // ---------------------------------------------------------------------------
+  // setScalarData
+  // ---------------------------------------------------------------------------
+  // ioValues (one value per point of the current data) is taken over and
+  // kept on the GPU until the point data is replaced
+  void  setScalarData(int inIndex, std::vector<float> *ioValues)
+  {
+    mScalarLayer.setAttributeData(inIndex, ioValues);
+  }
+  // ---------------------------------------------------------------------------
+  // hasScalarData
+  // ---------------------------------------------------------------------------
+  bool  hasScalarData(int inIndex) const
+  {
+    return mScalarLayer.hasAttributeData(inIndex);
+  }
+  // ---------------------------------------------------------------------------
+  // setScalarAttribute
+  // ---------------------------------------------------------------------------
+  // The color map uses the attribute inIndex instead of the axis of
+  // mDataModel (-1 : the axis)
+  void  setScalarAttribute(int inIndex)
+  {
+    mScalarLayer.setCurrentAttribute(inIndex);
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // getScalarAttribute
+  // ---------------------------------------------------------------------------
+  int getScalarAttribute() const
+  {
+    return mScalarLayer.getCurrentAttribute();
+  }
+  // ---------------------------------------------------------------------------
+  // setColorMapRange
+  // ---------------------------------------------------------------------------
+  // The axis (or attribute) range mapped to the color map (inFrom >= inTo :
+  // one color)
+  void  setColorMapRange(double inFrom, double inTo)
+  {
+    mColorMapOffset = (float )inFrom;
+    mColorMapGain = (inFrom >= inTo) ? 0.0f : (float )(1.0 / (inTo - inFrom));
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // setBackdropColor
+  // ---------------------------------------------------------------------------
+  // A vertical gradient (3 floats each, see getBackdropColor())
+  void  setBackdropColor(const GLfloat *inTopColor, const GLfloat *inBottomColor)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      mBackdropTopColor[i] = inTopColor[i];
+      mBackdropBottomColor[i] = inBottomColor[i];
+    }
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // resetCamera
+  // ---------------------------------------------------------------------------
+  void  resetCamera()
+  {
+    mCamera.reset();
+    startInteraction();
+    update();
+    emit viewChanged();
+  }
+  // ---------------------------------------------------------------------------
+  // getViewMatrix
+  // ---------------------------------------------------------------------------
+  // Fitted model coordinates (see setModelFitParam()) to eye coordinates
+  QMatrix4x4  getViewMatrix() const
+  {
+    return mCamera.getViewMatrix();
+  }
+  // ---------------------------------------------------------------------------
+  // getProjectionMatrix
+  // ---------------------------------------------------------------------------
+  QMatrix4x4  getProjectionMatrix() const
+  {
+    return mCamera.getProjectionMatrix();
+  }
+  // ---------------------------------------------------------------------------
+  // getModelMatrix
+  // ---------------------------------------------------------------------------
+  // Data coordinates to the fitted model coordinates (scale * (p + offset))
+  QMatrix4x4  getModelMatrix() const
+  {
+    QMatrix4x4  model;
+    model.scale(mFitParam[3]);
+    model.translate(mFitParam[0], mFitParam[1], mFitParam[2]);
+    return model;
+  }
+  // ---------------------------------------------------------------------------
+  // getDataMatrix
+  // ---------------------------------------------------------------------------
+  // Data coordinates to clip coordinates: mCamera times the fit transform
+  QMatrix4x4  getDataMatrix() const
+  {
+    return getProjectionMatrix() * getViewMatrix() * getModelMatrix();
+  }
+  // ---------------------------------------------------------------------------
+  // getEyePosition
+  // ---------------------------------------------------------------------------
+  // The camera position in the data coordinates
+  void  getEyePosition(GLfloat *outPos) const
+  {
+    QVector4D eye = (getViewMatrix() * getModelMatrix()).inverted() * QVector4D(0, 0, 0, 1);
+    for (int i = 0; i < 3; i++)
+      outPos[i] = eye[i] / eye.w();
+  }
+  // ---------------------------------------------------------------------------
+  // isScalarShown
+  // ---------------------------------------------------------------------------
+  bool  isScalarShown() const
+  {
+    return (mScalarLayer.isEnabled() && mDataModel.getColorMode() == SCALAR_COLOR_MODE &&
+            isMeshShown() == false);
+  }
+  // ---------------------------------------------------------------------------
+  // setModelFitParam
+  // ---------------------------------------------------------------------------
+  // The transform from the data to the fitted model coordinates
+  // (scale * (p + offset))
+  void  setModelFitParam(const GLfloat *inParam)
+  {
+    for (int i = 0; i < 4; i++)
+      mFitParam[i] = inParam[i];
+    update();
+    emit viewChanged();
+  }
+  // ---------------------------------------------------------------------------
+  // setSpatialIndex
+  // ---------------------------------------------------------------------------
+  // inIndex (NULL disables picking) is not owned and must be built on the
+  // current data. The picked points are cleared
+  void  setSpatialIndex(const qpcvSpatialIndex *inIndex)
+  {
+    mSpatialIndex = inIndex;
+    clearPicks();
+  }
+  // ---------------------------------------------------------------------------
+  // clearPicks
+  // ---------------------------------------------------------------------------
+  void  clearPicks()
+  {
+    if (mPickNum == 0)
+      return;
+    mPickNum = 0;
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // setPointBudget
+  // ---------------------------------------------------------------------------
+  void  setPointBudget(size_t inBudget)
+  {
+    mPointBudget = inBudget;
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // getPointBudget
+  // ---------------------------------------------------------------------------
+  size_t  getPointBudget() const
+  {
+    return mPointBudget;
+  }
+  // ---------------------------------------------------------------------------
+  // getDrawNum
+  // ---------------------------------------------------------------------------
+  size_t  getDrawNum() const
+  {
+    return mDrawNum;
+  }
+  // ---------------------------------------------------------------------------
+  // hasLOD
+  // ---------------------------------------------------------------------------
+  bool  hasLOD() const
+  {
+    return (mLevelEndTable.size() != 0);
+  }
+  // ---------------------------------------------------------------------------
+  // setHUDEnabled
+  // ---------------------------------------------------------------------------
+  void  setHUDEnabled(bool inIsEnabled)
+  {
+    mPerfHUD.setEnabled(inIsEnabled);
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // isHUDEnabled
+  // ---------------------------------------------------------------------------
+  bool  isHUDEnabled() const
+  {
+    return mPerfHUD.isEnabled();
+  }
+  // ---------------------------------------------------------------------------
+  // setHUDInfo
+  // ---------------------------------------------------------------------------
+  // Lines shown below the frame timings (set by the window after a load)
+  void  setHUDInfo(const QStringList &inLines)
+  {
+    mPerfHUD.setInfoLines(inLines);
+    if (mPerfHUD.isEnabled())
+      update();
+  }
+  // ---------------------------------------------------------------------------
+  // setRenderTile
+  // ---------------------------------------------------------------------------
+  // Renders the part of an inImageWidth x inImageHeight image whose top left
+  // is (inX, inY) into the framebuffer of the view. The projection becomes
+  // the off-axis frustum of the tile (see qpcvCamera::setTile()), so the
+  // image size is not limited by the viewport and the view can have any size
+  void  setRenderTile(int inX, int inY, int inImageWidth, int inImageHeight)
+  {
+    mIsTileEnabled = true;
+    mTileX = inX;
+    mTileY = inY;
+    mImageWidth = inImageWidth;
+    mImageHeight = inImageHeight;
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // clearRenderTile
+  // ---------------------------------------------------------------------------
+  void  clearRenderTile()
+  {
+    mIsTileEnabled = false;
+    mCamera.clearTile();
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // getBackdropColor
+  // ---------------------------------------------------------------------------
+  // Top and bottom colors of a backdrop mode. The single color mode uses
+  // inSingleColor for both
+  static void getBackdropColor(int inMode, const GLfloat *inSingleColor,
+                               const GLfloat **outTopColor, const GLfloat **outBottomColor)
+  {
+    static const GLfloat  colorTable[] =
+    {
+      0.780f, 0.860f, 0.930f,
+      0.360f, 0.500f, 0.660f,
+      0.000f, 0.360f, 0.600f,
+      0.000f, 0.070f, 0.200f,
+      0.930f, 0.900f, 0.900f,
+      0.360f, 0.300f, 0.300f,
+      0.430f, 0.400f, 0.400f,
+      0.060f, 0.010f, 0.010f,
+    };
+
+    switch (inMode)
+    {
+      case BACKDROP_COLOR_MODE_BLUE:
+        *outTopColor = &(colorTable[0]);
+        *outBottomColor = &(colorTable[3]);
+        break;
+      case BACKDROP_COLOR_MODE_DARK_BLUE:
+        *outTopColor = &(colorTable[6]);
+        *outBottomColor = &(colorTable[9]);
+        break;
+      case BACKDROP_COLOR_MODE_GRAY:
+        *outTopColor = &(colorTable[12]);
+        *outBottomColor = &(colorTable[15]);
+        break;
+      case BACKDROP_COLOR_MODE_DARK_GRAY:
+        *outTopColor = &(colorTable[18]);
+        *outBottomColor = &(colorTable[21]);
+        break;
+      default:
+      //case BACKDROP_COLOR_MODE_SINGLE:
+        *outTopColor = inSingleColor;
+        *outBottomColor = inSingleColor;
+        break;
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // uploadData
+  // ---------------------------------------------------------------------------
+  // Uploads all points (and the mesh) now instead of at the paints and waits
+  // for the GPU, so the upload can be timed apart from the drawing
+  void  uploadData()
+  {
+    if (context() == NULL || mData == NULL)
+      return;
+    makeCurrent();
+    QOpenGLExtraFunctions *func = context()->extraFunctions();
+    std::vector<qpcvLOD::Range> rangeTable(1, qpcvLOD::Range({0, mDataNum}));
+    mPointLayer.prepare(context(), rangeTable);
+    if (hasMesh() && initMeshProgram() && mIsMeshDirty)
+      uploadMesh(func);
+    func->glFinish();
+    doneCurrent();
+  }
+  // ---------------------------------------------------------------------------
+  // renderFrame
+  // ---------------------------------------------------------------------------
+  // Paints a frame into the framebuffer of the widget and waits for the GPU
+  // with glFinish() (no read back like grabFramebuffer()). The HUD and the
+  // picks are not drawn (they need the paint event)
+  void  renderFrame()
+  {
+    if (context() == NULL)
+      return;
+    makeCurrent();
+    bool  isHUDEnabled = mPerfHUD.isEnabled();
+    int pickNum = mPickNum;
+    mPerfHUD.setEnabled(false);
+    mPickNum = 0;
+    paintGL();
+    mPerfHUD.setEnabled(isHUDEnabled);
+    mPickNum = pickNum;
+    context()->functions()->glFinish();
+    doneCurrent();
+  }
+  // ---------------------------------------------------------------------------
+  // exportPerfTrace
+  // ---------------------------------------------------------------------------
+  bool  exportPerfTrace(const QString &inFileName) const
+  {
+    return mPerfHUD.exportCSV(inFileName);
+  }
+
+signals:
+  void  drawNumChanged(size_t inDrawNum, size_t inDataNum);
+  // The text of the last pick (or measurement)
+  void  pickChanged(const QString &inText);
+  // The camera or the fit transform changed
+  void  viewChanged();
+
+protected:
+  struct Pick
+  {
+    size_t  index;
+    double  pos[3];
+    GLubyte color[3];
+  };
+
+  // Member variables ----------------------------------------------------------
+  ibc::gl::glXYZf_RGBAub  *mData;
+  size_t  mDataNum;
+  size_t  mDrawNum;
+  std::vector<qpcvLOD::Range> mDrawRangeTable;
+  std::vector<size_t> mLevelEndTable;
+  std::vector<GLfloat>  mCellBoxTable;    // Min / max of each qpcvLOD cell (6 floats)
+  GLfloat mRootSize;                      // The largest side of the data bounds
+  size_t  mPointBudget;
+  bool  mIsInteracting;
+  int   mRefineLevel;
+  int   mInteractionLevel;    // The finest level of the last budget limited draw
+  int   mMaxCellLevel;        // The finest level of the last cell level table
+  QTimer  mSettleTimer;
+  QTimer  mRefineTimer;
+  qpcvPerfHUD mPerfHUD;
+  GLfloat mFitParam[4];
+  const qpcvSpatialIndex  *mSpatialIndex;
+  Pick  mPickTable[2];
+  int   mPickNum;
+  bool  mIsPickClick;
+  const uint32_t  *mMeshIndex;
+  size_t  mMeshTriangleNum;
+  int   mRenderMode;
+  bool  mIsMeshDirty;       // The buffers need an upload
+  QOpenGLShaderProgram  *mMeshProgram;
+  bool  mIsMeshProgramFailed;
+  QOpenGLVertexArrayObject  mMeshVAO;
+  QOpenGLBuffer mMeshVertexBuffer;
+  QOpenGLBuffer mMeshIndexBuffer;
+  size_t  mMeshVRAMUsed;
+  void  (QOPENGLF_APIENTRYP mPolygonModeFunc)(GLenum, GLenum);  // NULL on OpenGL ES
+  bool  mIsTileEnabled;
+  int   mTileX, mTileY;
+  int   mImageWidth, mImageHeight;
+  int   mViewWidth, mViewHeight;    // Of the last paint
+  qpcvCamera  mCamera;
+  QPoint  mLastMousePos;
+  qpcvPointLayer  mPointLayer;
+  qpcvScalarLayer mScalarLayer;
+  qpcvChunkLayer  mChunkLayer;
+  qpcvStreamLayer mStreamLayer;
+  float mColorMapOffset;
+  float mColorMapGain;
+  qpcvGuideLayer  mGuideLayer;
+  GLfloat mBackdropTopColor[3];
+  GLfloat mBackdropBottomColor[3];
+
+  // Qt Event functions --------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // mousePressEvent
+  // ---------------------------------------------------------------------------
+  virtual void  mousePressEvent(QMouseEvent *event)
+  {
+    mIsPickClick = (event->button() == Qt::LeftButton &&
+                    (event->modifiers() & Qt::ControlModifier) != 0);
+    if (mIsPickClick)
+    {
+      pickPoint(event->pos(), (event->modifiers() & Qt::ShiftModifier) != 0);
+      return;
+    }
+    mLastMousePos = event->pos();
+    startInteraction();
+  }
+  // ---------------------------------------------------------------------------
+  // mouseMoveEvent
+  // ---------------------------------------------------------------------------
+  virtual void  mouseMoveEvent(QMouseEvent *event)
+  {
+    if (mIsPickClick || event->buttons() == Qt::NoButton)
+      return;
+    QPoint  delta = event->pos() - mLastMousePos;
+    mLastMousePos = event->pos();
+    mCamera.setViewportSize(width(), height());
+    if (event->buttons() == Qt::LeftButton &&
+        (event->modifiers() & Qt::ShiftModifier) == 0)
+      mCamera.orbit(delta.x(), delta.y());
+    else
+      mCamera.pan(delta.x(), delta.y());
+    startInteraction();
+    update();
+    emit viewChanged();
+  }
+  // ---------------------------------------------------------------------------
+  // mouseReleaseEvent
+  // ---------------------------------------------------------------------------
+  virtual void  mouseReleaseEvent(QMouseEvent *)
+  {
+    if (mIsPickClick)
+    {
+      mIsPickClick = false;
+      return;
+    }
+    startInteraction();
+  }
+  // ---------------------------------------------------------------------------
+  // mouseDoubleClickEvent
+  // ---------------------------------------------------------------------------
+  virtual void  mouseDoubleClickEvent(QMouseEvent *event)
+  {
+    if (event->button() == Qt::LeftButton &&
+        (event->modifiers() & Qt::ControlModifier) == 0)
+      resetCamera();
+  }
+  // ---------------------------------------------------------------------------
+  // wheelEvent
+  // ---------------------------------------------------------------------------
+  virtual void  wheelEvent(QWheelEvent *event)
+  {
+    mCamera.dolly(event->angleDelta().y() / 120.0);
+    startInteraction();
+    update();
+    emit viewChanged();
+  }
+  // ---------------------------------------------------------------------------
+  // paintGL
+  // ---------------------------------------------------------------------------
+  virtual void  paintGL()
+  {
+    QOpenGLExtraFunctions *func = context()->extraFunctions();
+    int width = (int )(this->width() * devicePixelRatioF() + 0.5);
+    int height = (int )(this->height() * devicePixelRatioF() + 0.5);
+    func->glViewport(0, 0, width, height);
+    mCamera.setViewportSize(this->width(), this->height());
+    if (mIsTileEnabled)
+      mCamera.setTile(mTileX, mTileY, width, height, mImageWidth, mImageHeight);
+    else
+      mCamera.clearTile();
+    if (this->width() != mViewWidth || this->height() != mViewHeight)
+    {
+      // The aspect ratio of the projection
+      mViewWidth = this->width();
+      mViewHeight = this->height();
+      emit viewChanged();
+    }
+    updateDrawRanges(height);
+    if (mPerfHUD.isEnabled() == false)
+    {
+      drawScene(func);
+      if (mPickNum != 0)
+      {
+        QPainter  painter(this);
+        drawPicks(&painter);
+      }
+      return;
+    }
+    mPerfHUD.beginFrame(func);
+    drawScene(func);
+    mPerfHUD.endFrame(func, isMeshShown() ? mDataNum : mDrawNum, mDataNum, getVRAMUsed());
+    QPainter  painter(this);
+    mPerfHUD.draw(&painter);
+    drawPicks(&painter);
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // startInteraction
+  // ---------------------------------------------------------------------------
+  void  startInteraction()
+  {
+    mRefineTimer.stop();
+    mSettleTimer.start(SETTLE_MSEC);
+    if (mIsInteracting)
+      return;
+    mIsInteracting = true;
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // calcCellBoxes
+  // ---------------------------------------------------------------------------
+  // The bounds of the points of each qpcvLOD cell (NaN points are skipped)
+  void  calcCellBoxes()
+  {
+    int cellNum = qpcvLOD::getCellNum(mLevelEndTable);
+    mCellBoxTable.assign(cellNum * 6, 0);
+    for (int cell = 0; cell < cellNum; cell++)
+      for (int i = 0; i < 3; i++)
+      {
+        mCellBoxTable[cell * 6 + i * 2] = HUGE_VALF;
+        mCellBoxTable[cell * 6 + i * 2 + 1] = -HUGE_VALF;
+      }
+    qpcvParallel::forEachRange(
+      cellNum, qpcvParallel::getThreadNum(0, cellNum, 1), 1,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t cell = inBegin; cell < inEnd; cell++)
+        {
+          GLfloat *box = &(mCellBoxTable[cell * 6]);
+          for (int level = 0; level < qpcvLOD::LEVEL_NUM; level++)
+          {
+            size_t  begin, end;
+            qpcvLOD::getBlockRange(mLevelEndTable, level, (int )cell, &begin, &end);
+            for (size_t j = begin; j < end && j < mDataNum; j++)
+            {
+              const GLfloat *v = &(mData[j].x);
+              for (int i = 0; i < 3; i++)
+              {
+                if (v[i] < box[i * 2])
+                  box[i * 2] = v[i];
+                if (v[i] > box[i * 2 + 1])
+                  box[i * 2 + 1] = v[i];
+              }
+            }
+          }
+        }
+      });
+    mRootSize = 0;
+    for (int i = 0; i < 3; i++)
+    {
+      GLfloat minValue = HUGE_VALF, maxValue = -HUGE_VALF;
+      for (int cell = 0; cell < cellNum; cell++)
+      {
+        minValue = std::min(minValue, mCellBoxTable[cell * 6 + i * 2]);
+        maxValue = std::max(maxValue, mCellBoxTable[cell * 6 + i * 2 + 1]);
+      }
+      if (maxValue > minValue)
+        mRootSize = std::max(mRootSize, maxValue - minValue);
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // getCellLevels
+  // ---------------------------------------------------------------------------
+  // The level of each cell where an octree node (the data bounds halved per
+  // level) is not larger than a pixel at the nearest corner of the cell, -1
+  // for the cells outside of the frustum. inViewportHeight is in pixels
+  void  getCellLevels(int inViewportHeight, int *outLevelTable) const
+  {
+    QMatrix4x4  modelView = getViewMatrix() * getModelMatrix();
+    QMatrix4x4  projection = getProjectionMatrix();
+    QMatrix4x4  matrix = projection * modelView;
+    // Pixels of a unit at the depth 1, and the units of the data
+    double  focal = projection(1, 1) * inViewportHeight / 2.0;
+    double  scale = modelView.column(0).toVector3D().length();
+    int cellNum = qpcvLOD::getCellNum(mLevelEndTable);
+    for (int cell = 0; cell < cellNum; cell++)
+    {
+      const GLfloat *box = &(mCellBoxTable[cell * 6]);
+      outLevelTable[cell] = -1;
+      if (!(box[0] <= box[1]))    // Empty
+        continue;
+      int outsideCount[6] = {0, 0, 0, 0, 0, 0};
+      double  minDepth = HUGE_VAL;
+      for (int i = 0; i < 8; i++)
+      {
+        QVector4D corner(box[0 + (i & 1)], box[2 + ((i >> 1) & 1)], box[4 + ((i >> 2) & 1)], 1.0f);
+        QVector4D clip = matrix * corner;
+        for (int j = 0; j < 3; j++)
+        {
+          if (clip[j] < -clip.w())
+            outsideCount[j * 2]++;
+          if (clip[j] > clip.w())
+            outsideCount[j * 2 + 1]++;
+        }
+        // The depth is linear, so its minimum over the box is at a corner
+        minDepth = std::min(minDepth, (double )-(modelView * corner).z());
+      }
+      bool  isOutside = false;
+      for (int j = 0; j < 6; j++)
+        if (outsideCount[j] == 8)
+          isOutside = true;
+      if (isOutside)
+        continue;
+      int level = qpcvLOD::LEVEL_NUM - 1;
+      if (minDepth > 0)
+      {
+        double  pixel = mRootSize * scale * focal / minDepth;
+        for (int i = 0; i <= qpcvLOD::MAX_DEPTH; i++, pixel /= 2)
+          if (pixel <= 1.0)
+          {
+            level = i;
+            break;
+          }
+      }
+      outLevelTable[cell] = level;
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // updateDrawRanges
+  // ---------------------------------------------------------------------------
+  // Called at every paint, since the ranges follow the camera
+  void  updateDrawRanges(int inViewportHeight)
+  {
+    if (mData == NULL || hasLOD() == false)
+      return;
+    std::vector<int>  levelTable(qpcvLOD::getCellNum(mLevelEndTable));
+    getCellLevels(inViewportHeight, levelTable.data());
+    mMaxCellLevel = 0;
+    for (size_t i = 0; i < levelTable.size(); i++)
+    {
+      mMaxCellLevel = std::max(mMaxCellLevel, levelTable[i]);
+      if (mIsInteracting == false)
+        levelTable[i] = std::min(levelTable[i], mRefineLevel);
+    }
+    size_t  num;
+    if (mIsInteracting)
+      num = qpcvLOD::selectRanges(mLevelEndTable, levelTable.data(), mPointBudget,
+                                  &mDrawRangeTable, &mInteractionLevel);
+    else
+      num = qpcvLOD::selectRanges(mLevelEndTable, levelTable.data(), (size_t )-1,
+                                  &mDrawRangeTable);
+    if (num == mDrawNum)
+      return;
+    mDrawNum = num;
+    emit drawNumChanged(mDrawNum, mDataNum);
+  }
+  // ---------------------------------------------------------------------------
+  // drawScene
+  // ---------------------------------------------------------------------------
+  // The boundary box and the axes follow mCubeModel and mAxisModel
+  void  drawScene(QOpenGLExtraFunctions *inFunc)
+  {
+    inFunc->glClearDepthf(1.0f);
+    inFunc->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // The part of the image gradient in the tile (see setRenderTile())
+    float bottom = 0.0f, top = 1.0f;
+    if (mIsTileEnabled)
+    {
+      int height = (int )(this->height() * devicePixelRatioF() + 0.5);
+      bottom = 1.0f - (float )(mTileY + height) / mImageHeight;
+      top = 1.0f - (float )mTileY / mImageHeight;
+    }
+    mGuideLayer.drawBackdrop(context(), mBackdropTopColor, mBackdropBottomColor, bottom, top);
+    if (mChunkLayer.hasChunks())
+      drawChunks();
+    else if (mStreamLayer.hasFrame())
+      drawStream();
+    else if (isMeshShown())
+      drawMesh();
+    else if (isScalarShown())
+      drawScalar();
+    else
+      drawPoints();
+    mGuideLayer.drawGuides(context(), getProjectionMatrix() * getViewMatrix(),
+                           mCubeModel.isEnabled(), mAxisModel.isEnabled());
+  }
+  // ---------------------------------------------------------------------------
+  // drawPoints
+  // ---------------------------------------------------------------------------
+  // The LOD ranges with the settings of mDataModel
+  void  drawPoints()
+  {
+    qpcvPointLayer::DrawParam param;
+    getDrawParam(&param);
+    mPointLayer.draw(context(), getDataMatrix(), mDrawRangeTable, param);
+  }
+  // ---------------------------------------------------------------------------
+  // drawChunks
+  // ---------------------------------------------------------------------------
+  // The chunk buffers of the out-of-core mode with the settings of mDataModel
+  void  drawChunks()
+  {
+    qpcvPointLayer::DrawParam param;
+    getDrawParam(&param);
+    mChunkLayer.draw(context(), getDataMatrix(), &mPointLayer, param);
+  }
+  // ---------------------------------------------------------------------------
+  // drawStream
+  // ---------------------------------------------------------------------------
+  // The last live stream frame with the settings of mDataModel
+  void  drawStream()
+  {
+    qpcvPointLayer::DrawParam param;
+    getDrawParam(&param);
+    mStreamLayer.draw(context(), getDataMatrix(), &mPointLayer, param);
+  }
+  // ---------------------------------------------------------------------------
+  // getDrawParam
+  // ---------------------------------------------------------------------------
+  void  getDrawParam(qpcvPointLayer::DrawParam *outParam) const
+  {
+    const float *color = mDataModel.getSingleColor();
+    outParam->colorMode = mDataModel.getColorMode();
+    for (int i = 0; i < 3; i++)
+      outParam->singleColor[i] = color[i];
+    outParam->colorMapAxis = mDataModel.getColorMapAxis();
+    outParam->colorMapOffset = mColorMapOffset;
+    outParam->colorMapGain = mColorMapGain;
+    outParam->colorMapRepeatNum = mDataModel.getColorMapRepeatNum();
+    outParam->isUnmappedShown = (mDataModel.getColorMapUnmapMode() != 0);
+    outParam->colorMapIndex = mDataModel.getColorMapIndex();
+    outParam->pointSize = mDataModel.getPointSize();
+  }
+  // ---------------------------------------------------------------------------
+  // initMeshProgram
+  // ---------------------------------------------------------------------------
+  // The normal of the flat shading comes from the screen space derivatives of
+  // the view position, so the mesh needs no normal buffer. Fails (once) when
+  // the context has no GLSL 3.30 / ES 3.00, the mesh is drawn as points then
+  bool  initMeshProgram()
+  {
+    if (mMeshProgram != NULL)
+      return true;
+    if (mIsMeshProgramFailed)
+      return false;
+    static const char *vertexShaderStr =
+      "in vec3 aPos;\n"
+      "in vec4 aColor;\n"
+      "uniform mat4 uMatrix;\n"
+      "uniform mat4 uViewMatrix;\n"
+      "out vec3 vViewPos;\n"
+      "out vec4 vColor;\n"
+      "void main()\n"
+      "{\n"
+      "  gl_Position = uMatrix * vec4(aPos, 1.0);\n"
+      "  vViewPos = (uViewMatrix * vec4(aPos, 1.0)).xyz;\n"
+      "  vColor = aColor;\n"
+      "}\n";
+    static const char *fragmentShaderStr =
+      "in vec3 vViewPos;\n"
+      "in vec4 vColor;\n"
+      "uniform vec4 uColor;\n"
+      "uniform bool uIsVertexColor;\n"
+      "uniform bool uIsShaded;\n"
+      "out vec4 fragColor;\n"
+      "void main()\n"
+      "{\n"
+      "  vec4 color = uIsVertexColor ? vColor : uColor;\n"
+      "  if (uIsShaded)\n"
+      "  {\n"
+      "    vec3 normal = normalize(cross(dFdx(vViewPos), dFdy(vViewPos)));\n"
+      "    color.rgb *= 0.25 + 0.75 * abs(normal.z);\n"   // Two sided head light
+      "  }\n"
+      "  fragColor = color;\n"
+      "}\n";
+    QByteArray  versionStr = context()->isOpenGLES() ?
+                               "#version 300 es\nprecision highp float;\n" : "#version 330 core\n";
+    QOpenGLShaderProgram  *program = new QOpenGLShaderProgram();
+    if (program->addShaderFromSourceCode(QOpenGLShader::Vertex, versionStr + vertexShaderStr) == false ||
+        program->addShaderFromSourceCode(QOpenGLShader::Fragment, versionStr + fragmentShaderStr) == false)
+    {
+      delete program;
+      mIsMeshProgramFailed = true;
+      update();
+      return false;
+    }
+    program->bindAttributeLocation("aPos", 0);
+    program->bindAttributeLocation("aColor", 1);
+    if (program->link() == false)
+    {
+      delete program;
+      mIsMeshProgramFailed = true;
+      update();
+      return false;
+    }
+    mMeshProgram = program;
+    if (context()->isOpenGLES() == false)
+      mPolygonModeFunc = reinterpret_cast<void (QOPENGLF_APIENTRYP)(GLenum, GLenum)>(
+                           context()->getProcAddress("glPolygonMode"));
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // uploadMesh
+  // ---------------------------------------------------------------------------
+  // The vertex buffer holds the whole point data (the glXYZf_RGBAub records as
+  // they are) and the index buffer the triangle list, both static
+  void  uploadMesh(QOpenGLExtraFunctions *inFunc)
+  {
+    mIsMeshDirty = false;
+    if (mMeshVAO.isCreated() == false)
+    {
+      mMeshVAO.create();
+      mMeshVertexBuffer.create();
+      mMeshIndexBuffer.create();
+    }
+    QOpenGLVertexArrayObject::Binder  binder(&mMeshVAO);
+    // glBufferData() directly, QOpenGLBuffer::allocate() takes an int size
+    mMeshVertexBuffer.bind();
+    inFunc->glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr )(mDataNum * sizeof(ibc::gl::glXYZf_RGBAub)),
+                         mData, GL_STATIC_DRAW);
+    inFunc->glEnableVertexAttribArray(0);
+    inFunc->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ibc::gl::glXYZf_RGBAub),
+                                  (const void *)offsetof(ibc::gl::glXYZf_RGBAub, x));
+    inFunc->glEnableVertexAttribArray(1);
+    inFunc->glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ibc::gl::glXYZf_RGBAub),
+                                  (const void *)offsetof(ibc::gl::glXYZf_RGBAub, r));
+    mMeshIndexBuffer.bind();
+    inFunc->glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr )(mMeshTriangleNum * 3 * sizeof(uint32_t)),
+                         mMeshIndex, GL_STATIC_DRAW);
+    mMeshVRAMUsed = mDataNum * sizeof(ibc::gl::glXYZf_RGBAub) + mMeshTriangleNum * 3 * sizeof(uint32_t);
+  }
+  // ---------------------------------------------------------------------------
+  // releaseMeshBuffers
+  // ---------------------------------------------------------------------------
+  // The context must be current
+  void  releaseMeshBuffers()
+  {
+    if (mMeshVAO.isCreated())
+    {
+      mMeshVAO.destroy();
+      mMeshVertexBuffer.destroy();
+      mMeshIndexBuffer.destroy();
+      mMeshVRAMUsed = 0;
+    }
+    if (mMeshProgram != NULL)
+    {
+      delete mMeshProgram;
+      mMeshProgram = NULL;
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // drawMesh
+  // ---------------------------------------------------------------------------
+  // Vertex colors with the file color mode, the single color otherwise
+  void  drawMesh()
+  {
+    if (initMeshProgram() == false)
+      return;
+    QOpenGLExtraFunctions *func = context()->extraFunctions();
+    if (mIsMeshDirty)
+      uploadMesh(func);
+
+    const float *color = mDataModel.getSingleColor();
+    bool  isWireframe = (mRenderMode == RENDER_MODE_WIREFRAME && mPolygonModeFunc != NULL);
+
+    func->glEnable(GL_DEPTH_TEST);
+    mMeshProgram->bind();
+    mMeshProgram->setUniformValue("uMatrix", getDataMatrix());
+    mMeshProgram->setUniformValue("uViewMatrix", getViewMatrix() * getModelMatrix());
+    mMeshProgram->setUniformValue("uColor", QVector4D(color[0], color[1], color[2], 1.0f));
+    mMeshProgram->setUniformValue("uIsVertexColor", mDataModel.getColorMode() == FILE_COLOR_MODE);
+    mMeshProgram->setUniformValue("uIsShaded", isWireframe == false);
+    if (isWireframe)
+      mPolygonModeFunc(GL_FRONT_AND_BACK, GL_LINE);
+    {
+      QOpenGLVertexArrayObject::Binder  binder(&mMeshVAO);
+      func->glDrawElements(GL_TRIANGLES, (GLsizei )(mMeshTriangleNum * 3), GL_UNSIGNED_INT, NULL);
+    }
+    if (isWireframe)
+      mPolygonModeFunc(GL_FRONT_AND_BACK, GL_FILL);
+    mMeshProgram->release();
+  }
+  // ---------------------------------------------------------------------------
+  // drawScalar
+  // ---------------------------------------------------------------------------
+  // The LOD ranges with the settings of the color map of mDataModel. When the
+  // program fails, the next paint draws the points with mPointLayer
+  void  drawScalar()
+  {
+    mScalarLayer.draw(context(), getDataMatrix(), &mPointLayer, mDrawRangeTable,
+                      mDataModel.getPointSize(),
+                      mColorMapOffset, mColorMapGain, mDataModel.getColorMapRepeatNum(),
+                      mDataModel.getColorMapIndex());
+    if (mScalarLayer.isEnabled() == false)
+      update();
+  }
+  // ---------------------------------------------------------------------------
+  // unproject
+  // ---------------------------------------------------------------------------
+  static void unproject(const QMatrix4x4 &inInverse, double inX, double inY, double inZ,
+                        double *outPos)
+  {
+    QVector4D v = inInverse * QVector4D((float )inX, (float )inY, (float )inZ, 1.0f);
+    for (int i = 0; i < 3; i++)
+      outPos[i] = v[i] / v.w();
+  }
+  // ---------------------------------------------------------------------------
+  // pickPoint
+  // ---------------------------------------------------------------------------
+  // inIsSecond : picks the second point of the measurement
+  void  pickPoint(const QPoint &inPos, bool inIsSecond)
+  {
+    if (mSpatialIndex == NULL || mSpatialIndex->isValid() == false)
+    {
+      QToolTip::showText(mapToGlobal(inPos), tr("The spatial index is not ready"), this);
+      return;
+    }
+    bool  isInvertible;
+    QMatrix4x4  inverse = getDataMatrix().inverted(&isInvertible);
+    if (isInvertible == false || width() <= 0 || height() <= 0)
+      return;
+
+    // The ray from the near plane to the far plane in data coordinates, and
+    // its pixel radius there (the slope is 0 for an orthographic camera)
+    double  x = 2.0 * (inPos.x() + 0.5) / width() - 1.0;
+    double  y = 1.0 - 2.0 * (inPos.y() + 0.5) / height();
+    double  dx = 2.0 * PICK_RADIUS_PIXEL / width();
+    double  nearPos[3], farPos[3], nearSide[3], farSide[3];
+    unproject(inverse, x, y, -1, nearPos);
+    unproject(inverse, x, y, 1, farPos);
+    unproject(inverse, x + dx, y, -1, nearSide);
+    unproject(inverse, x + dx, y, 1, farSide);
+    double  dir[3], length = 0, nearRadius = 0, farRadius = 0;
+    for (int i = 0; i < 3; i++)
+    {
+      dir[i] = farPos[i] - nearPos[i];
+      length += dir[i] * dir[i];
+      nearRadius += (nearSide[i] - nearPos[i]) * (nearSide[i] - nearPos[i]);
+      farRadius += (farSide[i] - farPos[i]) * (farSide[i] - farPos[i]);
+    }
+    length = sqrt(length);
+    if (!(length > 0))
+      return;
+    for (int i = 0; i < 3; i++)
+      dir[i] /= length;
+    nearRadius = sqrt(nearRadius);
+    double  slope = (sqrt(farRadius) - nearRadius) / length;
+
+    QElapsedTimer timer;
+    timer.start();
+    size_t  index;
+    bool  isFound = mSpatialIndex->pickRay(nearPos, dir, nearRadius, slope, &index);
+    double  queryTime = timer.nsecsElapsed() / 1000.0;
+    if (isFound == false || index >= mDataNum)
+    {
+      QToolTip::showText(mapToGlobal(inPos), tr("No point"), this);
+      return;
+    }
+
+    Pick  &pick = mPickTable[(inIsSecond && mPickNum != 0) ? 1 : 0];
+    mPickNum = (inIsSecond && mPickNum != 0) ? 2 : 1;
+    const ibc::gl::glXYZf_RGBAub  &p = mData[index];
+    pick.index = index;
+    pick.pos[0] = p.x;
+    pick.pos[1] = p.y;
+    pick.pos[2] = p.z;
+    pick.color[0] = p.r;
+    pick.color[1] = p.g;
+    pick.color[2] = p.b;
+
+    QString text = QString("#%1 (%2, %3, %4) RGB(%5, %6, %7)")
+                     .arg(index)
+                     .arg(pick.pos[0]).arg(pick.pos[1]).arg(pick.pos[2])
+                     .arg(pick.color[0]).arg(pick.color[1]).arg(pick.color[2]);
+    if (mPickNum == 2)
+    {
+      double  d[3], dist = 0;
+      for (int i = 0; i < 3; i++)
+      {
+        d[i] = mPickTable[1].pos[i] - mPickTable[0].pos[i];
+        dist += d[i] * d[i];
+      }
+      text += QString("\nDistance %1 (dx %2, dy %3, dz %4)")
+                .arg(sqrt(dist)).arg(d[0]).arg(d[1]).arg(d[2]);
+    }
+    text += QString("\nQuery %1 us").arg(queryTime, 0, 'f', 1);
+    QToolTip::showText(mapToGlobal(inPos), text, this);
+    emit pickChanged(QString(text).replace('\n', "  "));
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // drawPicks
+  // ---------------------------------------------------------------------------
+  void  drawPicks(QPainter *inPainter)
+  {
+    if (mPickNum == 0)
+      return;
+    QMatrix4x4  matrix = getDataMatrix();
+    QPointF posTable[2];
+    for (int i = 0; i < mPickNum; i++)
+    {
+      const double  *pos = mPickTable[i].pos;
+      QVector4D v = matrix * QVector4D((float )pos[0], (float )pos[1], (float )pos[2], 1.0f);
+      if (v.w() <= 0)
+        return;   // Behind the camera
+      posTable[i] = QPointF((v.x() / v.w() + 1.0) * width() / 2,
+                            (1.0 - v.y() / v.w()) * height() / 2);
+    }
+    inPainter->setRenderHint(QPainter::Antialiasing);
+    inPainter->setPen(QPen(Qt::yellow, 2));
+    inPainter->setBrush(Qt::NoBrush);
+    if (mPickNum == 2)
+      inPainter->drawLine(posTable[0], posTable[1]);
+    for (int i = 0; i < mPickNum; i++)
+    {
+      inPainter->drawEllipse(posTable[i], 5, 5);
+      inPainter->drawText(posTable[i] + QPointF(8, -8), (i == 0) ? "A" : "B");
+    }
+  }
+};
+
+#endif  // #ifdef QPCV_GL_VIEW_H_
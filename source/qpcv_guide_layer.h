@@ -0,0 +1,258 @@
+// =============================================================================
+//  qpcv_guide_layer.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_guide_layer.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Backdrop gradient, boundary box and axes of qpcvGLView
+*/
+
+#ifndef QPCV_GUIDE_LAYER_H_
+#define QPCV_GUIDE_LAYER_H_
+
+// Includes --------------------------------------------------------------------
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <QMatrix4x4>
+#include <QVector2D>
+#include <QVector3D>
+
+// -----------------------------------------------------------------------------
+// qpcvGuideLayer class
+// -----------------------------------------------------------------------------
+// The parts of the image besides the data. The box is the [-1, 1] cube of the
+// fitted model coordinates and the axes (x red, y green, z blue) start at
+// their origin, so both take the view projection matrix. When the programs
+// fail (no GLSL 3.30 / ES 3.00) the backdrop is a clear with the bottom color
+// and the guides are not drawn. The functions taking QOpenGLExtraFunctions
+// need the context current.
+class qpcvGuideLayer
+{
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvGuideLayer
+  // ---------------------------------------------------------------------------
+  qpcvGuideLayer()
+  {
+    mBackdropProgram = NULL;
+    mLineProgram = NULL;
+    mIsProgramFailed = false;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // drawBackdrop
+  // ---------------------------------------------------------------------------
+  // A vertical gradient over the viewport (3 floats per color).
+  // inBottom, inTop : the part of the gradient in the viewport (a tile of an
+  // image, see qpcvCamera::setTile())
+  void  drawBackdrop(QOpenGLContext *inContext, const float *inTopColor,
+                     const float *inBottomColor, float inBottom = 0.0f, float inTop = 1.0f)
+  {
+    QOpenGLExtraFunctions *func = inContext->extraFunctions();
+    if (initPrograms(inContext) == false)
+    {
+      func->glClearColor(inBottomColor[0], inBottomColor[1], inBottomColor[2], 1.0f);
+      func->glClear(GL_COLOR_BUFFER_BIT);
+      return;
+    }
+    func->glDisable(GL_DEPTH_TEST);
+    func->glDepthMask(GL_FALSE);
+    mBackdropProgram->bind();
+    mBackdropProgram->setUniformValue("uTopColor",
+                                      QVector3D(inTopColor[0], inTopColor[1], inTopColor[2]));
+    mBackdropProgram->setUniformValue("uBottomColor",
+                                      QVector3D(inBottomColor[0], inBottomColor[1], inBottomColor[2]));
+    mBackdropProgram->setUniformValue("uRange", QVector2D(inBottom, inTop));
+    {
+      QOpenGLVertexArrayObject::Binder  binder(&mBackdropVAO);
+      func->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+    mBackdropProgram->release();
+    func->glDepthMask(GL_TRUE);
+  }
+  // ---------------------------------------------------------------------------
+  // drawGuides
+  // ---------------------------------------------------------------------------
+  // inMatrix maps the fitted model coordinates to the clip coordinates
+  void  drawGuides(QOpenGLContext *inContext, const QMatrix4x4 &inMatrix,
+                   bool inIsBoxShown, bool inIsAxisShown)
+  {
+    if ((inIsBoxShown == false && inIsAxisShown == false) || initPrograms(inContext) == false)
+      return;
+    QOpenGLExtraFunctions *func = inContext->extraFunctions();
+    func->glEnable(GL_DEPTH_TEST);
+    mLineProgram->bind();
+    mLineProgram->setUniformValue("uMatrix", inMatrix);
+    {
+      QOpenGLVertexArrayObject::Binder  binder(&mLineVAO);
+      if (inIsBoxShown)
+        func->glDrawArrays(GL_LINES, 0, BOX_VERTEX_NUM);
+      if (inIsAxisShown)
+        func->glDrawArrays(GL_LINES, BOX_VERTEX_NUM, AXIS_VERTEX_NUM);
+    }
+    mLineProgram->release();
+  }
+  // ---------------------------------------------------------------------------
+  // release
+  // ---------------------------------------------------------------------------
+  void  release()
+  {
+    if (mLineVAO.isCreated())
+    {
+      mLineVAO.destroy();
+      mLineBuffer.destroy();
+    }
+    if (mBackdropVAO.isCreated())
+      mBackdropVAO.destroy();
+    delete mBackdropProgram;
+    mBackdropProgram = NULL;
+    delete mLineProgram;
+    mLineProgram = NULL;
+  }
+
+protected:
+  // Constants -----------------------------------------------------------------
+  static const int  BOX_VERTEX_NUM = 24;
+  static const int  AXIS_VERTEX_NUM = 6;
+
+  // Member variables ----------------------------------------------------------
+  QOpenGLShaderProgram  *mBackdropProgram;
+  QOpenGLShaderProgram  *mLineProgram;
+  bool  mIsProgramFailed;
+  QOpenGLVertexArrayObject  mBackdropVAO;   // Empty, the quad comes from gl_VertexID
+  QOpenGLVertexArrayObject  mLineVAO;
+  QOpenGLBuffer mLineBuffer;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // initPrograms
+  // ---------------------------------------------------------------------------
+  bool  initPrograms(QOpenGLContext *inContext)
+  {
+    if (mLineProgram != NULL)
+      return true;
+    if (mIsProgramFailed)
+      return false;
+    static const char *backdropVertexShaderStr =
+      "uniform vec2 uRange;\n"
+      "out float vY;\n"
+      "void main()\n"
+      "{\n"
+      "  vec2 pos = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0 - 1.0;\n"
+      "  gl_Position = vec4(pos, 0.0, 1.0);\n"
+      "  vY = mix(uRange.x, uRange.y, pos.y * 0.5 + 0.5);\n"
+      "}\n";
+    static const char *backdropFragmentShaderStr =
+      "in float vY;\n"
+      "uniform vec3 uTopColor;\n"
+      "uniform vec3 uBottomColor;\n"
+      "out vec4 fragColor;\n"
+      "void main()\n"
+      "{\n"
+      "  fragColor = vec4(mix(uBottomColor, uTopColor, vY), 1.0);\n"
+      "}\n";
+    static const char *lineVertexShaderStr =
+      "in vec3 aPos;\n"
+      "in vec3 aColor;\n"
+      "uniform mat4 uMatrix;\n"
+      "out vec3 vColor;\n"
+      "void main()\n"
+      "{\n"
+      "  gl_Position = uMatrix * vec4(aPos, 1.0);\n"
+      "  vColor = aColor;\n"
+      "}\n";
+    static const char *lineFragmentShaderStr =
+      "in vec3 vColor;\n"
+      "out vec4 fragColor;\n"
+      "void main()\n"
+      "{\n"
+      "  fragColor = vec4(vColor, 1.0);\n"
+      "}\n";
+    QByteArray  versionStr = inContext->isOpenGLES() ?
+                               "#version 300 es\nprecision highp float;\n" : "#version 330 core\n";
+    mBackdropProgram = new QOpenGLShaderProgram();
+    mLineProgram = new QOpenGLShaderProgram();
+    mLineProgram->bindAttributeLocation("aPos", 0);
+    mLineProgram->bindAttributeLocation("aColor", 1);
+    if (mBackdropProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, versionStr + backdropVertexShaderStr) == false ||
+        mBackdropProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, versionStr + backdropFragmentShaderStr) == false ||
+        mBackdropProgram->link() == false ||
+        mLineProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, versionStr + lineVertexShaderStr) == false ||
+        mLineProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, versionStr + lineFragmentShaderStr) == false ||
+        mLineProgram->link() == false)
+    {
+      release();
+      mIsProgramFailed = true;
+      return false;
+    }
+    mBackdropVAO.create();
+    initLineBuffer(inContext->extraFunctions());
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // initLineBuffer
+  // ---------------------------------------------------------------------------
+  // x, y, z, r, g, b per vertex: the 12 box edges, then the 3 axes
+  void  initLineBuffer(QOpenGLExtraFunctions *inFunc)
+  {
+    GLfloat table[(BOX_VERTEX_NUM + AXIS_VERTEX_NUM) * 6];
+    GLfloat *ptr = table;
+    auto  addVertex = [&](float inX, float inY, float inZ, float inR, float inG, float inB)
+    {
+      *ptr++ = inX;
+      *ptr++ = inY;
+      *ptr++ = inZ;
+      *ptr++ = inR;
+      *ptr++ = inG;
+      *ptr++ = inB;
+    };
+    // The edges along each axis (the other two coordinates are +-1)
+    for (int axis = 0; axis < 3; axis++)
+      for (int i = 0; i < 4; i++)
+      {
+        float v[3];
+        v[(axis + 1) % 3] = (i & 1) ? 1.0f : -1.0f;
+        v[(axis + 2) % 3] = (i & 2) ? 1.0f : -1.0f;
+        for (int j = 0; j < 2; j++)
+        {
+          v[axis] = j ? 1.0f : -1.0f;
+          addVertex(v[0], v[1], v[2], 0.8f, 0.8f, 0.8f);
+        }
+      }
+    for (int axis = 0; axis < 3; axis++)
+    {
+      float c[3] = {0, 0, 0};
+      c[axis] = 1.0f;
+      addVertex(0, 0, 0, c[0], c[1], c[2]);
+      addVertex(c[0], c[1], c[2], c[0], c[1], c[2]);
+    }
+    mLineVAO.create();
+    mLineBuffer.create();
+    QOpenGLVertexArrayObject::Binder  binder(&mLineVAO);
+    mLineBuffer.bind();
+    inFunc->glBufferData(GL_ARRAY_BUFFER, sizeof(table), table, GL_STATIC_DRAW);
+    inFunc->glEnableVertexAttribArray(0);
+    inFunc->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat), NULL);
+    inFunc->glEnableVertexAttribArray(1);
+    inFunc->glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(GLfloat),
+                                  (const void *)(3 * sizeof(GLfloat)));
+  }
+};
+
+#endif  // #ifdef QPCV_GUIDE_LAYER_H_
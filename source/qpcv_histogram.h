@@ -0,0 +1,459 @@
+// =============================================================================
+//  qpcv_histogram.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_histogram.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Per-axis coordinate histogram and percentiles
+*/
+
+#ifndef QPCV_HISTOGRAM_H_
+#define QPCV_HISTOGRAM_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <QThread>
+#include <QElapsedTimer>
+#include "qpcv_parallel.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvHistogram class
+// -----------------------------------------------------------------------------
+// Like qpcvBounds, one object per thread merged at the end (no sort, one pass).
+// The values outside of the range are counted as well, so the percentiles stay
+// correct when an axis is refined to a narrower range (see calcPercentileRange())
+class qpcvHistogram
+{
+public:
+  // Constants -----------------------------------------------------------------
+  static const int  BIN_NUM = 1024;
+  static const int  REFINE_RANGE_BIN_NUM = 100000;   // Default resolution of a percentile range
+  static const int  REFINE_MAX_NUM = 2;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvHistogram
+  // ---------------------------------------------------------------------------
+  qpcvHistogram()
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      mFrom[i] = 0;
+      mTo[i] = 0;
+    }
+    clear();
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // clear
+  // ---------------------------------------------------------------------------
+  // The counts only (the range is kept)
+  void  clear()
+  {
+    memset(mCount, 0, sizeof(mCount));
+    for (int i = 0; i < 3; i++)
+    {
+      mUnderNum[i] = 0;
+      mOverNum[i] = 0;
+      mTotalNum[i] = 0;
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // setRange
+  // ---------------------------------------------------------------------------
+  void  setRange(int inAxis, double inFrom, double inTo)
+  {
+    mFrom[inAxis] = inFrom;
+    mTo[inAxis] = inTo;
+  }
+  // ---------------------------------------------------------------------------
+  // getFrom
+  // ---------------------------------------------------------------------------
+  double  getFrom(int inAxis) const
+  {
+    return mFrom[inAxis];
+  }
+  // ---------------------------------------------------------------------------
+  // getTo
+  // ---------------------------------------------------------------------------
+  double  getTo(int inAxis) const
+  {
+    return mTo[inAxis];
+  }
+  // ---------------------------------------------------------------------------
+  // getBinCount
+  // ---------------------------------------------------------------------------
+  uint64_t  getBinCount(int inAxis, int inBin) const
+  {
+    return mCount[inAxis][inBin];
+  }
+  // ---------------------------------------------------------------------------
+  // getMaxBinCount
+  // ---------------------------------------------------------------------------
+  uint64_t  getMaxBinCount(int inAxis) const
+  {
+    uint64_t  maxCount = 0;
+    for (int i = 0; i < BIN_NUM; i++)
+      if (mCount[inAxis][i] > maxCount)
+        maxCount = mCount[inAxis][i];
+    return maxCount;
+  }
+  // ---------------------------------------------------------------------------
+  // getTotalNum
+  // ---------------------------------------------------------------------------
+  // Includes the values outside of the range (NaN is not counted)
+  uint64_t  getTotalNum(int inAxis) const
+  {
+    return mTotalNum[inAxis];
+  }
+  // ---------------------------------------------------------------------------
+  // add
+  // ---------------------------------------------------------------------------
+  // inAxisMask : bit 0 = x, bit 1 = y, bit 2 = z
+  void  add(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum, int inAxisMask = 7)
+  {
+    // One pass over the points for all the axes
+    int axisTable[3], axisNum = 0;
+    double  scale[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+      if ((inAxisMask & (1 << axis)) == 0)
+        continue;
+      axisTable[axisNum++] = axis;
+      scale[axis] = 0;
+      if (mTo[axis] > mFrom[axis])
+        scale[axis] = BIN_NUM / (mTo[axis] - mFrom[axis]);
+    }
+    for (size_t i = 0; i < inNum; i++)
+    {
+      const GLfloat *pos = &(inData[i].x);
+      for (int j = 0; j < axisNum; j++)
+      {
+        int axis = axisTable[j];
+        double  v = pos[axis];
+        if (v != v)   // NaN
+          continue;
+        mTotalNum[axis]++;
+        double  d = (v - mFrom[axis]) * scale[axis];
+        if (d < 0)
+          mUnderNum[axis]++;
+        else if (v > mTo[axis])
+          mOverNum[axis]++;
+        else if (d >= BIN_NUM)
+          mCount[axis][BIN_NUM - 1]++;
+        else
+          mCount[axis][(int )d]++;
+      }
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // merge
+  // ---------------------------------------------------------------------------
+  // inHistogram must have the same ranges
+  void  merge(const qpcvHistogram &inHistogram)
+  {
+    for (int axis = 0; axis < 3; axis++)
+    {
+      for (int i = 0; i < BIN_NUM; i++)
+        mCount[axis][i] += inHistogram.mCount[axis][i];
+      mUnderNum[axis] += inHistogram.mUnderNum[axis];
+      mOverNum[axis] += inHistogram.mOverNum[axis];
+      mTotalNum[axis] += inHistogram.mTotalNum[axis];
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // getPercentile
+  // ---------------------------------------------------------------------------
+  // inPercent : 0 - 100. Linear inside a bin. Clamped to the range when the
+  // percentile falls outside of it
+  double  getPercentile(int inAxis, double inPercent) const
+  {
+    if (mTotalNum[inAxis] == 0)
+      return mFrom[inAxis];
+    double  target = mTotalNum[inAxis] * inPercent / 100.0;
+    double  sum = (double )mUnderNum[inAxis];
+    if (target <= sum)
+      return mFrom[inAxis];
+    double  width = (mTo[inAxis] - mFrom[inAxis]) / BIN_NUM;
+    for (int i = 0; i < BIN_NUM; i++)
+    {
+      double  count = (double )mCount[inAxis][i];
+      if (count > 0 && sum + count >= target)
+        return mFrom[inAxis] + (i + (target - sum) / count) * width;
+      sum += count;
+    }
+    return mTo[inAxis];
+  }
+  // ---------------------------------------------------------------------------
+  // calcParallel
+  // ---------------------------------------------------------------------------
+  // inMinMax : x min, x max, y min, ... (the ranges of the bins).
+  // Returns false when canceled
+  static bool calcParallel(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                           const GLfloat *inMinMax, int inThreadNum,
+                           qpcvHistogram *outHistogram,
+                           const qpcvParallel::ProgressFunc &inProgressFunc = qpcvParallel::ProgressFunc())
+  {
+    for (int i = 0; i < 3; i++)
+      outHistogram->setRange(i, inMinMax[i * 2 + 0], inMinMax[i * 2 + 1]);
+    return calcAxesParallel(inData, inNum, 7, inThreadNum, outHistogram, inProgressFunc);
+  }
+  // ---------------------------------------------------------------------------
+  // calcPercentileRange
+  // ---------------------------------------------------------------------------
+  // The inLowPercent - inHighPercent range of inAxis. While the bins of
+  // inHistogram are coarser than 1 / inRangeBinNum of the range, the bin
+  // holding each percentile is histogrammed again in an extra pass over the
+  // data (also when the raw range is stretched by an outlier). With the
+  // default, the range matches a full sort to about 1e-4 of it.
+  // Returns false when canceled
+  static bool calcPercentileRange(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                                  const qpcvHistogram &inHistogram, int inAxis,
+                                  double inLowPercent, double inHighPercent, int inThreadNum,
+                                  double *outFrom, double *outTo,
+                                  int inRangeBinNum = REFINE_RANGE_BIN_NUM,
+                                  const qpcvParallel::ProgressFunc &inProgressFunc = qpcvParallel::ProgressFunc())
+  {
+    *outFrom = inHistogram.getPercentile(inAxis, inLowPercent);
+    *outTo = inHistogram.getPercentile(inAxis, inHighPercent);
+    if (inData == NULL)
+      return true;
+    if (refinePercentile(inData, inNum, inHistogram, inAxis, inLowPercent,
+                         (*outTo - *outFrom) / inRangeBinNum, inThreadNum,
+                         outFrom, inProgressFunc) == false)
+      return false;
+    return refinePercentile(inData, inNum, inHistogram, inAxis, inHighPercent,
+                            (*outTo - *outFrom) / inRangeBinNum, inThreadNum,
+                            outTo, inProgressFunc);
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  uint64_t  mCount[3][BIN_NUM];
+  uint64_t  mUnderNum[3];
+  uint64_t  mOverNum[3];
+  uint64_t  mTotalNum[3];
+  double  mFrom[3];
+  double  mTo[3];
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // calcAxesParallel
+  // ---------------------------------------------------------------------------
+  // The axes in inAxisMask are counted again with the current ranges of
+  // ioHistogram (the other axes are kept)
+  static bool calcAxesParallel(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                               int inAxisMask, int inThreadNum,
+                               qpcvHistogram *ioHistogram,
+                               const qpcvParallel::ProgressFunc &inProgressFunc = qpcvParallel::ProgressFunc())
+  {
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, inNum, 1024 * 1024);
+    qpcvHistogram empty;
+    for (int i = 0; i < 3; i++)
+      empty.setRange(i, ioHistogram->mFrom[i], ioHistogram->mTo[i]);
+    std::vector<qpcvHistogram>  histogramTable(threadNum, empty);
+    if (qpcvParallel::forEachRange(
+          inNum, threadNum, 1024 * 1024,
+          [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+          {
+            histogramTable[inThreadIndex].add(inData + inBegin, inEnd - inBegin, inAxisMask);
+          },
+          inProgressFunc) == false)
+      return false;
+    for (int axis = 0; axis < 3; axis++)
+    {
+      if ((inAxisMask & (1 << axis)) == 0)
+        continue;
+      memset(ioHistogram->mCount[axis], 0, sizeof(ioHistogram->mCount[axis]));
+      ioHistogram->mUnderNum[axis] = 0;
+      ioHistogram->mOverNum[axis] = 0;
+      ioHistogram->mTotalNum[axis] = 0;
+    }
+    // The unmasked axes of the thread histograms are all 0
+    for (size_t i = 0; i < histogramTable.size(); i++)
+      ioHistogram->merge(histogramTable[i]);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // refinePercentile
+  // ---------------------------------------------------------------------------
+  // ioValue : inPercent of inHistogram. Narrowed to the bin holding it until
+  // the bins are not wider than inMinWidth (at most REFINE_MAX_NUM passes)
+  static bool refinePercentile(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                               const qpcvHistogram &inHistogram, int inAxis,
+                               double inPercent, double inMinWidth, int inThreadNum,
+                               double *ioValue,
+                               const qpcvParallel::ProgressFunc &inProgressFunc)
+  {
+    qpcvHistogram histogram = inHistogram;
+    for (int i = 0; i < REFINE_MAX_NUM; i++)
+    {
+      double  rangeFrom = histogram.mFrom[inAxis];
+      double  rangeTo = histogram.mTo[inAxis];
+      double  width = (rangeTo - rangeFrom) / BIN_NUM;
+      if (!(width > inMinWidth))
+        break;
+      double  bin = std::min(floor((*ioValue - rangeFrom) / width), BIN_NUM - 1.0);
+      double  from = rangeFrom + std::max(bin, 0.0) * width;
+      double  to = std::min(from + width, rangeTo);
+      if (!(to > from))   // No finer than the double
+        break;
+      histogram.setRange(inAxis, from, to);
+      if (calcAxesParallel(inData, inNum, 1 << inAxis, inThreadNum,
+                           &histogram, inProgressFunc) == false)
+        return false;
+      *ioValue = histogram.getPercentile(inAxis, inPercent);
+    }
+    return true;
+  }
+};
+
+// -----------------------------------------------------------------------------
+// qpcvPercentileRangeJob class
+// -----------------------------------------------------------------------------
+// qpcvHistogram::calcPercentileRange() on a worker thread (the refine passes
+// read all the points). Without a histogram, the one of the data is built
+// first over inMinMax and can be taken with getHistogram() for the next run.
+// The data must not be released before the job finished (or was deleted,
+// which waits for it)
+class qpcvPercentileRangeJob : public QThread
+{
+Q_OBJECT
+
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvPercentileRangeJob
+  // ---------------------------------------------------------------------------
+  // inHistogram : NULL to build it
+  qpcvPercentileRangeJob(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                         const qpcvHistogram *inHistogram, const GLfloat *inMinMax,
+                         int inAxis, double inLowPercent, double inHighPercent,
+                         int inThreadNum, QObject *parent = Q_NULLPTR)
+  : QThread(parent)
+  {
+    mData = inData;
+    mDataNum = inNum;
+    mHasHistogram = (inHistogram != NULL);
+    if (mHasHistogram)
+      mHistogram = *inHistogram;
+    for (int i = 0; i < 6; i++)
+      mMinMax[i] = inMinMax[i];
+    mAxis = inAxis;
+    mLowPercent = inLowPercent;
+    mHighPercent = inHighPercent;
+    mThreadNum = inThreadNum;
+    mIsSucceeded = false;
+    mFrom = 0;
+    mTo = 0;
+    mTime = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvPercentileRangeJob
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvPercentileRangeJob()
+  {
+    requestInterruption();
+    wait();
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // isSucceeded
+  // ---------------------------------------------------------------------------
+  // Only valid after finished() was emitted (false when canceled)
+  bool  isSucceeded() const
+  {
+    return mIsSucceeded;
+  }
+  // ---------------------------------------------------------------------------
+  // getRange
+  // ---------------------------------------------------------------------------
+  void  getRange(double *outFrom, double *outTo) const
+  {
+    *outFrom = mFrom;
+    *outTo = mTo;
+  }
+  // ---------------------------------------------------------------------------
+  // getHistogram
+  // ---------------------------------------------------------------------------
+  const qpcvHistogram &getHistogram() const
+  {
+    return mHistogram;
+  }
+  // ---------------------------------------------------------------------------
+  // getAxis
+  // ---------------------------------------------------------------------------
+  int getAxis() const
+  {
+    return mAxis;
+  }
+  // ---------------------------------------------------------------------------
+  // getTime
+  // ---------------------------------------------------------------------------
+  qint64  getTime() const
+  {
+    return mTime;
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  const ibc::gl::glXYZf_RGBAub  *mData;
+  size_t  mDataNum;
+  qpcvHistogram mHistogram;
+  bool  mHasHistogram;
+  GLfloat mMinMax[6];
+  int mAxis;
+  double  mLowPercent;
+  double  mHighPercent;
+  int mThreadNum;
+  bool  mIsSucceeded;
+  double  mFrom;
+  double  mTo;
+  qint64  mTime;
+
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  virtual void  run()
+  {
+    QElapsedTimer timer;
+    timer.start();
+    qpcvParallel::ProgressFunc  progressFunc =
+      [&](size_t)
+      {
+        return !isInterruptionRequested();
+      };
+    if (mHasHistogram == false &&
+        qpcvHistogram::calcParallel(mData, mDataNum, mMinMax, mThreadNum,
+                                    &mHistogram, progressFunc) == false)
+      return;
+    if (qpcvHistogram::calcPercentileRange(mData, mDataNum, mHistogram, mAxis,
+                                           mLowPercent, mHighPercent, mThreadNum,
+                                           &mFrom, &mTo, qpcvHistogram::REFINE_RANGE_BIN_NUM,
+                                           progressFunc) == false)
+      return;
+    mTime = timer.elapsed();
+    mIsSucceeded = true;
+  }
+};
+
+#endif  // #ifdef QPCV_HISTOGRAM_H_
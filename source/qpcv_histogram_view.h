@@ -0,0 +1,160 @@
+// =============================================================================
+//  qpcv_histogram_view.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_histogram_view.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Small plot of a qpcvHistogram axis with the color map range
+*/
+
+#ifndef QPCV_HISTOGRAM_VIEW_H_
+#define QPCV_HISTOGRAM_VIEW_H_
+
+// Includes --------------------------------------------------------------------
+#include <math.h>
+#include <QWidget>
+#include <QPainter>
+#include "qpcv_histogram.h"
+
+// -----------------------------------------------------------------------------
+// qpcvHistogramView class
+// -----------------------------------------------------------------------------
+// The counts are shown in a log scale (a few dense bins would flatten the rest)
+// and the part outside of the color map range is shaded
+class qpcvHistogramView : public QWidget
+{
+Q_OBJECT
+
+public:
+  // Constants -----------------------------------------------------------------
+  static const int  PLOT_BIN_NUM = 128;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvHistogramView
+  // ---------------------------------------------------------------------------
+  qpcvHistogramView(QWidget *parent = Q_NULLPTR)
+  : QWidget(parent)
+  {
+    mHistogram = NULL;
+    mAxis = 2;
+    mFrom = 0;
+    mTo = 0;
+    setMinimumHeight(48);
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // setHistogram
+  // ---------------------------------------------------------------------------
+  // inHistogram (NULL : nothing is shown) is not owned
+  void  setHistogram(const qpcvHistogram *inHistogram)
+  {
+    mHistogram = inHistogram;
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // setAxis
+  // ---------------------------------------------------------------------------
+  void  setAxis(int inAxis)
+  {
+    mAxis = inAxis;
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // setRange
+  // ---------------------------------------------------------------------------
+  void  setRange(double inFrom, double inTo)
+  {
+    mFrom = inFrom;
+    mTo = inTo;
+    update();
+  }
+  // ---------------------------------------------------------------------------
+  // sizeHint
+  // ---------------------------------------------------------------------------
+  virtual QSize sizeHint() const
+  {
+    return QSize(200, 64);
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  const qpcvHistogram *mHistogram;
+  int mAxis;
+  double  mFrom;
+  double  mTo;
+
+  // Qt Event functions --------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // paintEvent
+  // ---------------------------------------------------------------------------
+  virtual void  paintEvent(QPaintEvent *)
+  {
+    QPainter  painter(this);
+    QRectF  rect = QRectF(this->rect()).adjusted(0.5, 0.5, -0.5, -0.5);
+    painter.fillRect(rect, palette().base());
+    if (mHistogram == NULL || mHistogram->getTotalNum(mAxis) == 0)
+    {
+      painter.setPen(palette().color(QPalette::Disabled, QPalette::Text));
+      painter.drawText(rect, Qt::AlignCenter, tr("No histogram"));
+      return;
+    }
+
+    // The bins are summed up to PLOT_BIN_NUM columns
+    const int binNum = qpcvHistogram::BIN_NUM / PLOT_BIN_NUM;
+    double  countTable[PLOT_BIN_NUM];
+    double  maxCount = 0;
+    for (int i = 0; i < PLOT_BIN_NUM; i++)
+    {
+      double  count = 0;
+      for (int j = 0; j < binNum; j++)
+        count += (double )mHistogram->getBinCount(mAxis, i * binNum + j);
+      countTable[i] = log(1.0 + count);
+      if (countTable[i] > maxCount)
+        maxCount = countTable[i];
+    }
+    double  columnWidth = rect.width() / PLOT_BIN_NUM;
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(palette().color(QPalette::Highlight));
+    for (int i = 0; i < PLOT_BIN_NUM && maxCount > 0; i++)
+    {
+      double  h = rect.height() * countTable[i] / maxCount;
+      painter.drawRect(QRectF(rect.left() + i * columnWidth, rect.bottom() - h, columnWidth, h));
+    }
+
+    // Color map range
+    double  from = mHistogram->getFrom(mAxis);
+    double  to = mHistogram->getTo(mAxis);
+    if (to > from && mTo > mFrom)
+    {
+      double  x0 = rect.left() + rect.width() * (mFrom - from) / (to - from);
+      double  x1 = rect.left() + rect.width() * (mTo - from) / (to - from);
+      x0 = qBound(rect.left(), x0, rect.right());
+      x1 = qBound(rect.left(), x1, rect.right());
+      QColor  shade(0, 0, 0, 96);
+      painter.setBrush(shade);
+      painter.drawRect(QRectF(rect.left(), rect.top(), x0 - rect.left(), rect.height()));
+      painter.drawRect(QRectF(x1, rect.top(), rect.right() - x1, rect.height()));
+      painter.setPen(QPen(palette().color(QPalette::Text), 1));
+      painter.drawLine(QPointF(x0, rect.top()), QPointF(x0, rect.bottom()));
+      painter.drawLine(QPointF(x1, rect.top()), QPointF(x1, rect.bottom()));
+    }
+    painter.setPen(palette().color(QPalette::Mid));
+    painter.setBrush(Qt::NoBrush);
+    painter.drawRect(rect);
+  }
+};
+
+#endif  // #ifdef QPCV_HISTOGRAM_VIEW_H_
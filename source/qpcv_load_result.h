@@ -0,0 +1,133 @@
+// =============================================================================
+//  qpcv_load_result.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_load_result.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Result of a (background) PLY load
+*/
+
+#ifndef QPCV_LOAD_RESULT_H_
+#define QPCV_LOAD_RESULT_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <QFile>
+#include "qpcv_histogram.h"
+#include "qpcv_attribute_store.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvLoadResult struct
+// -----------------------------------------------------------------------------
+// Everything readPLY() needs to update the window. Filled by the worker thread
+// and handed over to the GUI thread as a whole once the load is finished.
+struct qpcvLoadResult
+{
+  // Constructors and Destructor -----------------------------------------------
+  qpcvLoadResult()
+  {
+    data = NULL;
+    dataNum = 0;
+    mappedFile = NULL;
+    attributeStore = NULL;
+    hasFace = false;
+    faceNum = 0;
+    faceTime = 0;
+    faceACMR[0] = faceACMR[1] = 0;
+    fileSize = 0;
+    headerTime = 0;
+    decodeTime = 0;
+    boundsTime = 0;
+    lodTime = 0;
+    histogramTime = 0;
+    cacheTime = 0;
+    isFromCache = false;
+    for (int i = 0; i < 4; i++)
+      param[i] = 0;
+    for (int i = 0; i < 6; i++)
+      minMax[i] = 0;
+  }
+  ~qpcvLoadResult()
+  {
+    if (mappedFile != NULL)
+      delete mappedFile;  // data points into the mapping in this case
+    else if (data != NULL)
+      delete [] data;
+    if (attributeStore != NULL)
+      delete attributeStore;
+  }
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // takeData
+  // ---------------------------------------------------------------------------
+  // When outMappedFile returns non-NULL, the data points into the file mapping
+  // and stays valid until the QFile object is deleted (do not delete [] the data)
+  ibc::gl::glXYZf_RGBAub *takeData(QFile **outMappedFile)
+  {
+    ibc::gl::glXYZf_RGBAub  *ptr = data;
+    *outMappedFile = mappedFile;
+    data = NULL;
+    mappedFile = NULL;
+    return ptr;
+  }
+  // ---------------------------------------------------------------------------
+  // takeAttributeStore
+  // ---------------------------------------------------------------------------
+  // NULL when the file has no other vertex properties
+  qpcvAttributeStore  *takeAttributeStore()
+  {
+    qpcvAttributeStore  *store = attributeStore;
+    attributeStore = NULL;
+    return store;
+  }
+  // Member variables ----------------------------------------------------------
+  std::string fileName;
+  qint64  fileSize;
+  ibc::gl::glXYZf_RGBAub *data;
+  size_t  dataNum;
+  QFile *mappedFile;
+  GLfloat param[4], minMax[6];
+  std::string headerStr;
+  std::string formatStr;
+  std::string colorFormatStr;
+  bool  hasFace;
+  // Triangle list into data (3 indices per triangle), empty when the faces
+  // can't be drawn. Remapped along with the LOD reorder
+  std::vector<uint32_t> faceIndex;
+  size_t  faceNum;      // Faces (polygons) in the file
+  double  faceACMR[2];  // Vertex cache miss ratio before / after the reorder (0 : unknown)
+  std::string faceErrorStr;   // Why the faces were dropped (the vertices are still loaded)
+  std::string errorStr;
+  // Timings of each stage (msec)
+  qint64  headerTime;
+  qint64  decodeTime;
+  qint64  boundsTime;
+  qint64  faceTime;     // Face decode and triangle reorder
+  qint64  lodTime;
+  qint64  histogramTime;
+  qint64  cacheTime;    // Reading or writing the sidecar cache
+  bool  isFromCache;
+  // Not empty when the data is stored in the qpcvLOD order
+  std::vector<size_t> lodLevelEndTable;
+  // Coordinate histogram over minMax (for the color map range)
+  qpcvHistogram histogram;
+  // The vertex properties other than the position and the color (PLY only)
+  qpcvAttributeStore  *attributeStore;
+};
+
+#endif  // #ifdef QPCV_LOAD_RESULT_H_
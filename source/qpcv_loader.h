@@ -0,0 +1,838 @@
+// =============================================================================
+//  qpcv_loader.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_loader.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Background (worker thread) PLY / PCD / XYZ loader
+*/
+
+#ifndef QPCV_LOADER_H_
+#define QPCV_LOADER_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+#include <QThread>
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include "qpcv_ply_layout.h"
+#include "qpcv_ply_decoder.h"
+#include "qpcv_ply_ascii_decoder.h"
+#include "qpcv_ply_face_decoder.h"
+#include "qpcv_mesh_optimizer.h"
+#include "qpcv_pcd_decoder.h"
+#include "qpcv_text_decoder.h"
+#include "qpcv_ply_stream_decoder.h"
+#include "qpcv_decompress_stream.h"
+#include "qpcv_bounds.h"
+#include "qpcv_lod.h"
+#include "qpcv_histogram.h"
+#include "qpcv_load_result.h"
+#include "qpcv_cache.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+#include "ibc/gl/file/ply.h"
+
+// -----------------------------------------------------------------------------
+// qpcvLoader class
+// -----------------------------------------------------------------------------
+class qpcvLoader : public QThread
+{
+Q_OBJECT
+
+public:
+  enum  LoadStage
+  {
+    LOAD_STAGE_IDLE   = 0,
+    LOAD_STAGE_HEADER,
+    LOAD_STAGE_DECODE,
+    LOAD_STAGE_FACE,
+    LOAD_STAGE_BOUNDS,
+    LOAD_STAGE_LOD,
+    LOAD_STAGE_HISTOGRAM,
+    LOAD_STAGE_CACHE,
+    LOAD_STAGE_DONE
+  };
+
+  // Clouds with more points than this are stored in the LOD order by default
+  static const size_t DEFAULT_LOD_MIN_POINT_NUM = 4 * 1000 * 1000;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvLoader
+  // ---------------------------------------------------------------------------
+  // inDecodeThreadNum <= 0 uses all cores. The LOD order is built when the
+  // data has inLODMinPointNum points or more (0 : never)
+  qpcvLoader(const QString &inFileName, int inDecodeThreadNum = 0,
+             size_t inLODMinPointNum = 0, QObject *parent = Q_NULLPTR)
+  : QThread(parent)
+  {
+    mFileName = inFileName;
+    mDecodeThreadNum = inDecodeThreadNum;
+    mLODMinPointNum = inLODMinPointNum;
+    mResult = NULL;
+    mIsCanceled = false;
+    mIsCacheEnabled = false;
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvLoader
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvLoader()
+  {
+    requestInterruption();
+    wait();
+    if (mResult != NULL)
+      delete mResult;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // setCache
+  // ---------------------------------------------------------------------------
+  // Enables the qpcvCache sidecar cache (inCacheDir empty : next to the file).
+  // Must be called before start()
+  void  setCache(bool inIsEnabled, const QString &inCacheDir)
+  {
+    mIsCacheEnabled = inIsEnabled;
+    mCacheDir = inCacheDir;
+  }
+  // ---------------------------------------------------------------------------
+  // getFileName
+  // ---------------------------------------------------------------------------
+  const QString &getFileName() const
+  {
+    return mFileName;
+  }
+  // ---------------------------------------------------------------------------
+  // isCanceled
+  // ---------------------------------------------------------------------------
+  bool  isCanceled() const
+  {
+    return mIsCanceled;
+  }
+  // ---------------------------------------------------------------------------
+  // takeResult
+  // ---------------------------------------------------------------------------
+  // Only valid after finished() was emitted. Returns NULL on failure or cancel.
+  // The caller owns the returned object
+  qpcvLoadResult  *takeResult()
+  {
+    qpcvLoadResult  *result = mResult;
+    mResult = NULL;
+    return result;
+  }
+  // ---------------------------------------------------------------------------
+  // getErrorStr
+  // ---------------------------------------------------------------------------
+  const QString &getErrorStr() const
+  {
+    return mErrorStr;
+  }
+
+signals:
+  // inDoneBytes / inTotalBytes are in the file size domain so the receiver can
+  // compute the throughput directly
+  void  progressChanged(int inStage, qint64 inDoneBytes, qint64 inTotalBytes);
+
+protected:
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  virtual void  run()
+  {
+    qpcvLoadResult  *result = new qpcvLoadResult();
+    if (load(result) == false)
+    {
+      mErrorStr = QString(result->errorStr.c_str());
+      delete result;
+      return;
+    }
+    mResult = result;
+  }
+
+private:
+  // Member variables ----------------------------------------------------------
+  QString mFileName;
+  QString mErrorStr;
+  int mDecodeThreadNum;
+  size_t  mLODMinPointNum;
+  qpcvLoadResult  *mResult;
+  bool  mIsCanceled;
+  bool  mIsCacheEnabled;
+  QString mCacheDir;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // checkCanceled
+  // ---------------------------------------------------------------------------
+  bool  checkCanceled()
+  {
+    if (isInterruptionRequested() == false)
+      return false;
+    mIsCanceled = true;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // load
+  // ---------------------------------------------------------------------------
+  bool  load(qpcvLoadResult *outResult)
+  {
+    if (mIsCacheEnabled && loadCache(outResult))
+    {
+      if (calcHistogram(outResult) == false)
+        return false;
+      emit progressChanged(LOAD_STAGE_DONE, outResult->fileSize, outResult->fileSize);
+      return true;
+    }
+    bool  isHandled;
+    bool  result = loadMapped(outResult, &isHandled);
+    if (isHandled == false)
+      result = loadPLYFile(outResult);
+    if (result == false)
+      return false;
+    if (buildLOD(outResult) == false)
+      return false;
+    if (calcHistogram(outResult) == false)
+      return false;
+    if (mIsCacheEnabled && writeCache(outResult) == false && checkCanceled())
+      return false;
+    emit progressChanged(LOAD_STAGE_DONE, outResult->fileSize, outResult->fileSize);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // loadCache
+  // ---------------------------------------------------------------------------
+  bool  loadCache(qpcvLoadResult *outResult)
+  {
+    QElapsedTimer timer;
+    timer.start();
+    if (qpcvCache::read(mFileName, mCacheDir, outResult) == false)
+      return false;
+    outResult->cacheTime = timer.elapsed();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // writeCache
+  // ---------------------------------------------------------------------------
+  // A failed write only costs the cache (the loaded data is still fine)
+  bool  writeCache(qpcvLoadResult *ioResult)
+  {
+    QElapsedTimer timer;
+    timer.start();
+    qint64  fileSize = ioResult->fileSize;
+    emit progressChanged(LOAD_STAGE_CACHE, 0, fileSize);
+    bool  result = qpcvCache::write(
+                      mFileName, mCacheDir, *ioResult,
+                      [&](qint64 inDoneBytes, qint64 inTotalBytes)
+                      {
+                        emit progressChanged(LOAD_STAGE_CACHE,
+                                             (qint64 )((double )fileSize * inDoneBytes / inTotalBytes),
+                                             fileSize);
+                        return !checkCanceled();
+                      });
+    ioResult->cacheTime = timer.elapsed();
+    return result;
+  }
+  // ---------------------------------------------------------------------------
+  // buildLOD
+  // ---------------------------------------------------------------------------
+  // Reorders the data into the qpcvLOD order (a copy is made, so a zero copy
+  // mapping is released here)
+  bool  buildLOD(qpcvLoadResult *ioResult)
+  {
+    if (mLODMinPointNum == 0 || ioResult->dataNum < mLODMinPointNum)
+      return true;
+    QElapsedTimer timer;
+    timer.start();
+    qint64  fileSize = ioResult->fileSize;
+    emit progressChanged(LOAD_STAGE_LOD, 0, fileSize);
+    ibc::gl::glXYZf_RGBAub  *data = new ibc::gl::glXYZf_RGBAub[ioResult->dataNum];
+    std::vector<uint32_t> sourceIndex;
+    if (ioResult->faceIndex.size() != 0 || ioResult->attributeStore != NULL)
+      sourceIndex.resize(ioResult->dataNum);
+    qpcvLOD lod;
+    if (lod.build(ioResult->data, ioResult->dataNum, ioResult->minMax, mDecodeThreadNum, data,
+                  [&](size_t inDoneNum, size_t inTotalNum)
+                  {
+                    emit progressChanged(LOAD_STAGE_LOD, fileSize * inDoneNum / inTotalNum, fileSize);
+                    return !checkCanceled();
+                  },
+                  sourceIndex.size() != 0 ? sourceIndex.data() : NULL) == false)
+    {
+      delete [] data;
+      return false;
+    }
+    if (ioResult->faceIndex.size() != 0)
+      remapFaceIndex(sourceIndex, &(ioResult->faceIndex));
+    if (ioResult->attributeStore != NULL)
+      ioResult->attributeStore->setSourceIndex(&sourceIndex);
+    if (ioResult->mappedFile != NULL)
+    {
+      delete ioResult->mappedFile;
+      ioResult->mappedFile = NULL;
+    }
+    else
+      delete [] ioResult->data;
+    ioResult->data = data;
+    ioResult->lodLevelEndTable = lod.getLevelEndTable();
+    ioResult->lodTime = timer.elapsed();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // remapFaceIndex
+  // ---------------------------------------------------------------------------
+  // inSourceIndex is the source of each reordered point. Its inverse gives
+  // the new index of every face index
+  void  remapFaceIndex(const std::vector<uint32_t> &inSourceIndex, std::vector<uint32_t> *ioFaceIndex)
+  {
+    size_t  num = inSourceIndex.size();
+    std::vector<uint32_t> newIndex(num);
+    int threadNum = qpcvParallel::getThreadNum(mDecodeThreadNum, num, 1024 * 1024);
+    qpcvParallel::forEachRange(
+      num, threadNum, num,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+          newIndex[inSourceIndex[i]] = (uint32_t )i;
+      });
+    uint32_t  *index = ioFaceIndex->data();
+    size_t  indexNum = ioFaceIndex->size();
+    threadNum = qpcvParallel::getThreadNum(mDecodeThreadNum, indexNum, 1024 * 1024);
+    qpcvParallel::forEachRange(
+      indexNum, threadNum, indexNum,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+          index[i] = newIndex[index[i]];
+      });
+  }
+  // ---------------------------------------------------------------------------
+  // calcHistogram
+  // ---------------------------------------------------------------------------
+  bool  calcHistogram(qpcvLoadResult *ioResult)
+  {
+    QElapsedTimer timer;
+    timer.start();
+    qint64  fileSize = ioResult->fileSize;
+    size_t  dataNum = ioResult->dataNum;
+    emit progressChanged(LOAD_STAGE_HISTOGRAM, 0, fileSize);
+    if (qpcvHistogram::calcParallel(
+          ioResult->data, dataNum, ioResult->minMax, mDecodeThreadNum, &(ioResult->histogram),
+          [&](size_t inDoneNum)
+          {
+            if (dataNum != 0)
+              emit progressChanged(LOAD_STAGE_HISTOGRAM, fileSize * inDoneNum / dataNum, fileSize);
+            return !checkCanceled();
+          }) == false)
+      return false;
+    ioResult->histogramTime = timer.elapsed();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // loadMapped
+  // ---------------------------------------------------------------------------
+  // PLY reader working on a read-only file mapping. When the vertex records
+  // already are glXYZf_RGBAub, the mapping itself is handed over as the data
+  // (no copy at all). Otherwise the vertices (binary or ascii) are decoded
+  // straight from the mapping, so only the decoded array consumes anonymous memory.
+  // PCD and XYZ files are detected by their contents and decoded the same way.
+  // gzip / zstd compressed PLY files are decompressed on the fly.
+  // outIsHandled returns false when the file should be read by loadPLYFile()
+  bool  loadMapped(qpcvLoadResult *outResult, bool *outIsHandled)
+  {
+    QElapsedTimer timer;
+    qpcvPLYLayout layout;
+
+    *outIsHandled = false;
+    timer.start();
+    QFile *file = new QFile(mFileName);
+    if (file->open(QIODevice::ReadOnly) == false || file->size() == 0)
+    {
+      delete file;
+      return false;
+    }
+    qint64  fileSize = file->size();
+    const unsigned char *filePtr = file->map(0, fileSize);
+    if (filePtr == NULL)
+    {
+      delete file;
+      return false;
+    }
+    emit progressChanged(LOAD_STAGE_HEADER, 0, fileSize);
+
+    // Compressed PLY files
+    qpcvDecompressStream::Format  compressFormat =
+      qpcvDecompressStream::detectFormat(filePtr, (size_t )fileSize);
+    if (compressFormat != qpcvDecompressStream::FORMAT_NONE)
+    {
+      *outIsHandled = true;
+      bool  result = loadMappedCompressed(filePtr, fileSize, compressFormat, &timer, outResult);
+      delete file;
+      return result;
+    }
+    // PCD and XYZ files (the decoded data is a copy, so the mapping is
+    // released right after the decode)
+    if (qpcvPCDDecoder::isPCD(filePtr, (size_t )fileSize))
+    {
+      *outIsHandled = true;
+      bool  result = loadMappedPCD(filePtr, fileSize, &timer, outResult);
+      delete file;
+      return result;
+    }
+    qpcvTextDecoder::ColumnMap  columnMap;
+    size_t  xyzOffset, xyzSkippedLineNum;
+    if ((fileSize < 3 || memcmp(filePtr, "ply", 3) != 0) &&
+        qpcvTextDecoder::prepareXYZColumnMap(filePtr, (size_t )fileSize, &columnMap,
+                                             &xyzOffset, &xyzSkippedLineNum))
+    {
+      *outIsHandled = true;
+      bool  result = loadMappedXYZ(filePtr, fileSize, columnMap, xyzOffset, xyzSkippedLineNum,
+                                   &timer, outResult);
+      delete file;
+      return result;
+    }
+
+    size_t  vertexIndex, vertexOffset = 0;
+    qpcvPLYDecoder::VertexMap vertexMap;
+    if (layout.parse(filePtr, (size_t )fileSize) == false ||
+        layout.findElementIndex("vertex", &vertexIndex) == false ||
+        (layout.isBinary() &&
+         layout.getBinaryElementOffset(vertexIndex, &vertexOffset) == false) ||
+        qpcvPLYDecoder::prepareVertexMap(layout.getElement(vertexIndex), &vertexMap) == false)
+    {
+      delete file;
+      return false;
+    }
+
+    *outIsHandled = true;
+    const qpcvPLYLayout::Element  &vertex = layout.getElement(vertexIndex);
+    size_t  bodyOffset = layout.getHeaderSize() + vertexOffset;
+    if (layout.isBinary() && vertex.recordSize == 0)
+    {
+      outResult->errorStr = "Binary vertices with list properties are not supported";
+      delete file;
+      return false;
+    }
+    // Division, so a huge vertex count in the header can not wrap around
+    if (layout.isBinary() &&
+        (bodyOffset > (size_t )fileSize ||
+         vertex.count > ((size_t )fileSize - bodyOffset) / vertex.recordSize))
+    {
+      outResult->errorStr = "The PLY file is truncated";
+      delete file;
+      return false;
+    }
+    size_t  index;
+    outResult->fileName = mFileName.toStdString();
+    outResult->fileSize = fileSize;
+    outResult->headerStr = layout.getHeaderStr();
+    outResult->formatStr = layout.getFormatStr();
+    outResult->colorFormatStr = qpcvPLYDecoder::getColorFormatStr(vertex, vertexMap);
+    outResult->hasFace = layout.findElementIndex("face", &index);
+    outResult->dataNum = vertex.count;
+    // The other vertex properties are decoded when they are used
+    qpcvAttributeStore  *store = new qpcvAttributeStore();
+    if (vertex.count <= UINT32_MAX &&
+        store->init(outResult->fileName, fileSize,
+                    QFileInfo(*file).lastModified().toMSecsSinceEpoch(),
+                    layout, vertexIndex, vertexMap))
+      outResult->attributeStore = store;
+    else
+      delete store;
+    outResult->headerTime = timer.restart();
+
+    const unsigned char *records = filePtr + bodyOffset;
+    qpcvBounds  bounds;
+    bool  result = true;
+    if (qpcvPLYDecoder::isDirectLayout(layout, vertex) &&
+        ((uintptr_t )records % sizeof(GLfloat)) == 0)
+    {
+      // Zero copy (the bounds pass is the only pass over the data)
+      outResult->data = (ibc::gl::glXYZf_RGBAub *)records;
+      outResult->mappedFile = file;
+      emit progressChanged(LOAD_STAGE_BOUNDS, bodyOffset, fileSize);
+      qpcvBounds::calcParallel(outResult->data, outResult->dataNum, mDecodeThreadNum, &bounds);
+    }
+    else
+    {
+#if defined(__unix__) || defined(__APPLE__)
+      posix_madvise((void *)filePtr, (size_t )fileSize, POSIX_MADV_SEQUENTIAL);
+#endif
+      emit progressChanged(LOAD_STAGE_DECODE, bodyOffset, fileSize);
+      outResult->data = new ibc::gl::glXYZf_RGBAub[vertex.count];
+      qint64  decodeSize = fileSize - bodyOffset;
+      auto  progressFunc = [&](size_t inDoneNum)
+      {
+        qint64  doneSize = decodeSize;
+        if (vertex.count != 0)
+          doneSize = (qint64 )((double )decodeSize * inDoneNum / vertex.count);
+        emit progressChanged(LOAD_STAGE_DECODE, bodyOffset + doneSize, fileSize);
+        return !checkCanceled();
+      };
+      if (layout.isBinary())
+      {
+        result = qpcvPLYDecoder::decodeBinaryVerticesParallel(
+                    vertexMap, records, layout.needsByteSwap(),
+                    vertex.count, outResult->data, &bounds, mDecodeThreadNum, progressFunc);
+      }
+      else
+      {
+        const std::string &headerStr = layout.getHeaderStr();
+        size_t  firstLineNum = std::count(headerStr.begin(), headerStr.end(), '\n') + 1;
+        result = qpcvPLYAsciiDecoder::decodeVerticesParallel(
+                    layout, vertexIndex, vertexMap,
+                    records, fileSize - bodyOffset, firstLineNum,
+                    outResult->data, &bounds, mDecodeThreadNum, progressFunc,
+                    &(outResult->errorStr));
+      }
+    }
+    outResult->decodeTime = timer.restart();
+    if (result && checkCanceled() == false)
+      result = decodeFaces(layout, filePtr, fileSize, outResult);
+    if (outResult->mappedFile != file)
+      delete file;
+    if (result == false || checkCanceled())
+      return false;
+
+    // The bounds were computed during the decode
+    bounds.calcFitParam(outResult->param, outResult->minMax);
+    outResult->boundsTime = timer.restart();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // loadMappedCompressed
+  // ---------------------------------------------------------------------------
+  // The decompressed file is never in memory as a whole: a worker thread
+  // decompresses a few blocks ahead while the vertices are decoded block by
+  // block, so the peak is the decoded cloud plus the block queue. The faces
+  // are not read (the file is shown as points)
+  bool  loadMappedCompressed(const unsigned char *inFilePtr, qint64 inFileSize,
+                             qpcvDecompressStream::Format inFormat,
+                             QElapsedTimer *ioTimer, qpcvLoadResult *outResult)
+  {
+    const char  *formatStr = qpcvDecompressStream::getFormatStr(inFormat);
+    if (qpcvDecompressStream::isSupported(inFormat) == false)
+    {
+      outResult->errorStr = std::string("qpcv is built without ") + formatStr + " support";
+      return false;
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    posix_madvise((void *)inFilePtr, (size_t )inFileSize, POSIX_MADV_SEQUENTIAL);
+#endif
+    qpcvDecompressStream  stream;
+    stream.start(inFilePtr, (size_t )inFileSize, inFormat, mDecodeThreadNum);
+    qpcvPLYStreamDecoder  decoder(&stream);
+    qpcvPLYLayout layout;
+    if (decoder.readHeader(&layout, &(outResult->errorStr)) == false)
+      return false;
+    size_t  vertexIndex, index;
+    qpcvPLYDecoder::VertexMap vertexMap;
+    if (layout.findElementIndex("vertex", &vertexIndex) == false ||
+        qpcvPLYDecoder::prepareVertexMap(layout.getElement(vertexIndex), &vertexMap) == false)
+    {
+      outResult->errorStr = "The PLY file has no usable vertex element";
+      return false;
+    }
+    const qpcvPLYLayout::Element  &vertex = layout.getElement(vertexIndex);
+    outResult->fileName = mFileName.toStdString();
+    outResult->fileSize = inFileSize;
+    outResult->headerStr = layout.getHeaderStr();
+    outResult->formatStr = layout.getFormatStr() + " (" + formatStr + ")";
+    outResult->colorFormatStr = qpcvPLYDecoder::getColorFormatStr(vertex, vertexMap);
+    outResult->hasFace = layout.findElementIndex("face", &index);
+    outResult->dataNum = vertex.count;
+    outResult->headerTime = ioTimer->restart();
+
+    // The progress is the share of the compressed data consumed
+    emit progressChanged(LOAD_STAGE_DECODE, (qint64 )stream.getReadBytes(), inFileSize);
+    outResult->data = new ibc::gl::glXYZf_RGBAub[vertex.count];
+    qpcvBounds  bounds;
+    if (decoder.decodeVertices(
+          layout, vertexIndex, vertexMap, outResult->data, &bounds, mDecodeThreadNum,
+          [&](size_t)
+          {
+            emit progressChanged(LOAD_STAGE_DECODE, (qint64 )stream.getReadBytes(), inFileSize);
+            return !checkCanceled();
+          },
+          &(outResult->errorStr)) == false || checkCanceled())
+      return false;
+    stream.stop();
+    outResult->decodeTime = ioTimer->restart();
+
+    // The bounds were computed during the decode
+    bounds.calcFitParam(outResult->param, outResult->minMax);
+    outResult->boundsTime = ioTimer->restart();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // loadMappedPCD
+  // ---------------------------------------------------------------------------
+  bool  loadMappedPCD(const unsigned char *inFilePtr, qint64 inFileSize,
+                      QElapsedTimer *ioTimer, qpcvLoadResult *outResult)
+  {
+    qpcvPCDDecoder::Header  header;
+    qpcvPLYLayout::Element  element;
+    qpcvPLYDecoder::VertexMap vertexMap;
+    if (qpcvPCDDecoder::parseHeader(inFilePtr, (size_t )inFileSize, &header,
+                                    &(outResult->errorStr)) == false)
+      return false;
+    if (qpcvPCDDecoder::prepareVertexMap(header, &element, &vertexMap) == false)
+    {
+      outResult->errorStr = "The PCD file has no usable x, y and z fields";
+      return false;
+    }
+    outResult->fileName = mFileName.toStdString();
+    outResult->fileSize = inFileSize;
+    outResult->headerStr = header.headerStr;
+    outResult->formatStr = qpcvPCDDecoder::getFormatStr(header);
+    outResult->colorFormatStr = qpcvPCDDecoder::getColorFormatStr(header, vertexMap);
+    outResult->hasFace = false;
+    outResult->headerTime = ioTimer->restart();
+
+#if defined(__unix__) || defined(__APPLE__)
+    posix_madvise((void *)inFilePtr, (size_t )inFileSize, POSIX_MADV_SEQUENTIAL);
+#endif
+    qint64  bodyOffset = (qint64 )header.headerSize;
+    qint64  decodeSize = inFileSize - bodyOffset;
+    size_t  pointNum = header.pointNum;
+    emit progressChanged(LOAD_STAGE_DECODE, bodyOffset, inFileSize);
+    qpcvBounds  bounds;
+    if (qpcvPCDDecoder::decodeParallel(
+          header, vertexMap, inFilePtr, (size_t )inFileSize,
+          &(outResult->data), &(outResult->dataNum), &bounds, mDecodeThreadNum,
+          [&](size_t inDoneNum)
+          {
+            if (pointNum != 0)
+              emit progressChanged(LOAD_STAGE_DECODE,
+                                   bodyOffset + (qint64 )((double )decodeSize * inDoneNum / pointNum),
+                                   inFileSize);
+            return !checkCanceled();
+          },
+          &(outResult->errorStr)) == false || checkCanceled())
+      return false;
+    outResult->decodeTime = ioTimer->restart();
+
+    // The bounds were computed during the decode
+    bounds.calcFitParam(outResult->param, outResult->minMax);
+    outResult->boundsTime = ioTimer->restart();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // loadMappedXYZ
+  // ---------------------------------------------------------------------------
+  // inBodyOffset is the first data line (inSkippedLineNum title lines before it)
+  bool  loadMappedXYZ(const unsigned char *inFilePtr, qint64 inFileSize,
+                      const qpcvTextDecoder::ColumnMap &inColumnMap,
+                      size_t inBodyOffset, size_t inSkippedLineNum,
+                      QElapsedTimer *ioTimer, qpcvLoadResult *outResult)
+  {
+    outResult->fileName = mFileName.toStdString();
+    outResult->fileSize = inFileSize;
+    outResult->headerStr = std::string((const char *)inFilePtr, inBodyOffset);
+    outResult->formatStr = "XYZ ascii";
+    outResult->colorFormatStr = qpcvTextDecoder::getColorFormatStr(inColumnMap);
+    outResult->hasFace = false;
+    outResult->headerTime = ioTimer->restart();
+
+#if defined(__unix__) || defined(__APPLE__)
+    posix_madvise((void *)inFilePtr, (size_t )inFileSize, POSIX_MADV_SEQUENTIAL);
+#endif
+    // The number of points is only known after the line count, so the
+    // progress is the share of the parsed chunks
+    qint64  bodyOffset = (qint64 )inBodyOffset;
+    qint64  decodeSize = inFileSize - bodyOffset;
+    emit progressChanged(LOAD_STAGE_DECODE, bodyOffset, inFileSize);
+    qpcvBounds  bounds;
+    size_t  lineNum = 0;
+    if (qpcvTextDecoder::decodeParallel(
+          inColumnMap, inFilePtr + inBodyOffset, (size_t )decodeSize, inSkippedLineNum + 1, 0,
+          "XYZ", &(outResult->data), &(outResult->dataNum), &lineNum, &bounds, mDecodeThreadNum,
+          [&](size_t inDoneNum)
+          {
+            if (lineNum != 0)
+              emit progressChanged(LOAD_STAGE_DECODE,
+                                   bodyOffset + (qint64 )((double )decodeSize * inDoneNum / lineNum),
+                                   inFileSize);
+            return !checkCanceled();
+          },
+          &(outResult->errorStr)) == false || checkCanceled())
+      return false;
+    outResult->decodeTime = ioTimer->restart();
+
+    bounds.calcFitParam(outResult->param, outResult->minMax);
+    outResult->boundsTime = ioTimer->restart();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeFaces
+  // ---------------------------------------------------------------------------
+  // Decodes the face element (if any) into ioResult->faceIndex and reorders
+  // the triangles for the vertex cache. Faces that can't be drawn (no vertex
+  // index list, a binary element after a list element or more than 2^32
+  // vertices) are skipped and the file is shown as points. So are malformed
+  // faces (truncated data or an index out of range), whose error goes to
+  // ioResult->faceErrorStr. Returns false only when canceled
+  bool  decodeFaces(const qpcvPLYLayout &inLayout, const unsigned char *inFilePtr,
+                    qint64 inFileSize, qpcvLoadResult *ioResult)
+  {
+    size_t  faceIndex, vertexIndex, faceOffset = 0;
+    qpcvPLYFaceDecoder::FaceMap faceMap;
+    if (inLayout.findElementIndex("face", &faceIndex) == false ||
+        inLayout.findElementIndex("vertex", &vertexIndex) == false ||
+        qpcvPLYFaceDecoder::prepareFaceMap(inLayout.getElement(faceIndex), &faceMap) == false ||
+        (inLayout.isBinary() &&
+         inLayout.getBinaryElementOffset(faceIndex, &faceOffset) == false) ||
+        ioResult->dataNum > (size_t )0xFFFFFFFF)
+      return true;
+
+    QElapsedTimer timer;
+    timer.start();
+    const qpcvPLYLayout::Element  &face = inLayout.getElement(faceIndex);
+    const size_t  faceNum = face.count;
+    const size_t  bodyOffset = inLayout.getHeaderSize();
+    emit progressChanged(LOAD_STAGE_FACE, 0, inFileSize);
+    auto  progressFunc = [&](size_t inDoneNum)
+    {
+      // The first half is the decode, the second half the reorder
+      if (faceNum != 0)
+        emit progressChanged(LOAD_STAGE_FACE,
+                             (qint64 )((double )inFileSize * inDoneNum / faceNum / 2), inFileSize);
+      return !checkCanceled();
+    };
+    bool  result;
+    std::string errorStr;
+    if (inLayout.isBinary())
+    {
+      result = qpcvPLYFaceDecoder::decodeBinaryFacesParallel(
+                  face, faceMap, inFilePtr + bodyOffset + faceOffset,
+                  (size_t )inFileSize - bodyOffset - faceOffset, inLayout.needsByteSwap(),
+                  ioResult->dataNum, &(ioResult->faceIndex), mDecodeThreadNum,
+                  progressFunc, &errorStr);
+    }
+    else
+    {
+      const std::string &headerStr = inLayout.getHeaderStr();
+      size_t  firstLineNum = std::count(headerStr.begin(), headerStr.end(), '\n') + 1;
+      result = qpcvPLYFaceDecoder::decodeAsciiFacesParallel(
+                  inLayout, faceIndex, faceMap, inFilePtr + bodyOffset,
+                  (size_t )inFileSize - bodyOffset, firstLineNum,
+                  ioResult->dataNum, &(ioResult->faceIndex), mDecodeThreadNum,
+                  progressFunc, &errorStr);
+    }
+    if (result == false)
+    {
+      std::vector<uint32_t>().swap(ioResult->faceIndex);
+      if (checkCanceled())
+        return false;
+      ioResult->faceNum = faceNum;
+      ioResult->faceErrorStr = errorStr;
+      ioResult->faceTime = timer.elapsed();
+      return true;
+    }
+
+    uint32_t  *index = ioResult->faceIndex.data();
+    size_t  triangleNum = ioResult->faceIndex.size() / 3;
+    ioResult->faceNum = faceNum;
+    ioResult->faceACMR[0] = qpcvMeshOptimizer::calcACMR(index, triangleNum, mDecodeThreadNum);
+    if (qpcvMeshOptimizer::optimize(index, triangleNum, ioResult->data, mDecodeThreadNum,
+                                    [&](size_t inDoneNum)
+                                    {
+                                      emit progressChanged(LOAD_STAGE_FACE,
+                                                           (qint64 )((double )inFileSize *
+                                                                     (triangleNum + inDoneNum) /
+                                                                     triangleNum / 2),
+                                                           inFileSize);
+                                      return !checkCanceled();
+                                    }) == false)
+      return false;
+    ioResult->faceACMR[1] = qpcvMeshOptimizer::calcACMR(index, triangleNum, mDecodeThreadNum);
+    ioResult->faceTime = timer.elapsed();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // loadPLYFile
+  // ---------------------------------------------------------------------------
+  // Reads the file through ibc::gl::file::PLYFile (ascii files etc.)
+  bool  loadPLYFile(qpcvLoadResult *outResult)
+  {
+    ibc::gl::file::PLYHeader  *header;
+    unsigned char *fileDataPtr;
+    size_t  fileDataSize;
+    char  *headerStrBufPtr = NULL;
+    QElapsedTimer timer;
+
+    QFileInfo fileInfo(mFileName);
+    std::string fileName = mFileName.toStdString();
+    qint64  fileSize = fileInfo.size();
+    outResult->fileName = fileName;
+    outResult->fileSize = fileSize;
+
+    // Header (the whole file body is read here)
+    emit progressChanged(LOAD_STAGE_HEADER, 0, fileSize);
+    timer.start();
+    if (ibc::gl::file::PLYFile::readHeader(fileName.c_str(), &header, &fileDataPtr,
+                                           &fileDataSize, &headerStrBufPtr) == false)
+    {
+      outResult->errorStr = "Can't read the PLY header";
+      return false;
+    }
+    outResult->headerTime = timer.restart();
+    outResult->headerStr = std::string(headerStrBufPtr);
+    outResult->formatStr = header->getFormatStr();
+    outResult->colorFormatStr = header->getColorFormatStr(ibc::gl::file::PLYHeader::ELEMENT_TYPE_VERTEX);
+    size_t  index;
+    outResult->hasFace = header->findElementIndex(ibc::gl::file::PLYHeader::ELEMENT_TYPE_FACE, &index);
+    delete headerStrBufPtr;
+    if (checkCanceled())
+    {
+      delete fileDataPtr;
+      delete header;
+      return false;
+    }
+
+    // Decode
+    emit progressChanged(LOAD_STAGE_DECODE, fileSize - (qint64 )fileDataSize, fileSize);
+    bool  result = ibc::gl::file::PLYFile::get_glXYZf_RGBAub(*header, fileDataPtr, fileDataSize,
+                                                            &(outResult->data), &(outResult->dataNum));
+    delete fileDataPtr;
+    delete header;
+    if (result == false)
+    {
+      outResult->errorStr = "Can't decode the PLY vertex data";
+      return false;
+    }
+    outResult->decodeTime = timer.restart();
+    if (checkCanceled())
+      return false;
+
+    // Bounds
+    emit progressChanged(LOAD_STAGE_BOUNDS, fileSize, fileSize);
+    qpcvBounds  bounds;
+    qpcvBounds::calcParallel(outResult->data, outResult->dataNum, mDecodeThreadNum, &bounds);
+    bounds.calcFitParam(outResult->param, outResult->minMax);
+    outResult->boundsTime = timer.restart();
+    if (checkCanceled())
+      return false;
+    return true;
+  }
+};
+
+#endif  // #ifdef QPCV_LOADER_H_
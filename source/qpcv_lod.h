@@ -0,0 +1,405 @@
+// =============================================================================
+//  qpcv_lod.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_lod.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Octree level-of-detail ordering of glXYZf_RGBAub data
+*/
+
+#ifndef QPCV_LOD_H_
+#define QPCV_LOD_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <functional>
+#include <stdint.h>
+#include "qpcv_parallel.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvLOD class
+// -----------------------------------------------------------------------------
+// The octree is implicit: the points are sorted by their Morton code, and the
+// first point of every octree node (in that order) is the representative of the
+// node. A point belongs to the coarsest level where it is a representative.
+// The points are then stored level by level (coarse first), so drawing the
+// first getLevelEnd(n) points draws exactly one point per octree node down to
+// level n. Inside a level the points are grouped by cell (the CELL_NUM octree
+// nodes of the level CELL_DEPTH), so a view can skip the cells outside of the
+// frustum and stop at a different level for each cell (see selectRanges()).
+// Inside a block (the points of one level in one cell) the points are
+// interleaved (bit reversed order), so any prefix of a block also is spread
+// over the whole cell and the point budget does not need to be a level
+// boundary.
+// The level end table has LEVEL_NUM x CELL_NUM entries (the end of each
+// block, level major). A table of LEVEL_NUM entries (one cell, e.g. merged
+// tiles, an old cache or qpcvLOD(0)) is accepted by all the functions taking
+// a table.
+class qpcvLOD
+{
+public:
+  typedef std::function<bool(size_t inDoneNum, size_t inTotalNum)> ProgressFunc;
+
+  // 21 bits per axis fit in a 64 bit Morton code
+  static const int  MAX_DEPTH = 21;
+  // Levels 0 .. MAX_DEPTH plus one more for the points sharing a finest node
+  static const int  LEVEL_NUM = MAX_DEPTH + 2;
+  // The cells are the 4 x 4 x 4 nodes of the level 2
+  static const int  CELL_DEPTH = 2;
+  static const int  CELL_NUM = 1 << (3 * CELL_DEPTH);
+
+  // Points [begin, end) of the data
+  struct Range
+  {
+    size_t  begin;
+    size_t  end;
+  };
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvLOD
+  // ---------------------------------------------------------------------------
+  // inCellDepth 0 gives a single cell (the old order, where any prefix of
+  // the data is a uniform subsample)
+  qpcvLOD(int inCellDepth = CELL_DEPTH)
+  {
+    mCellDepth = inCellDepth;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // build
+  // ---------------------------------------------------------------------------
+  // inMinMax is the bounds of inData (see qpcvBounds). outData must have
+  // inNum elements and must not overlap inData. outSourceIndex (can be NULL,
+  // inNum elements) returns the index in inData of each output point, e.g. to
+  // remap mesh indices (inNum must fit in 32 bits then). Returns false when canceled
+  bool  build(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum, const GLfloat *inMinMax,
+              int inThreadNum, ibc::gl::glXYZf_RGBAub *outData,
+              const ProgressFunc &inProgressFunc = ProgressFunc(),
+              uint32_t *outSourceIndex = NULL)
+  {
+    const int cellNum = 1 << (3 * mCellDepth);
+    mLevelEnd.assign(LEVEL_NUM * cellNum, 0);
+    if (inNum == 0)
+      return true;
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, inNum, 256 * 1024);
+    const size_t  stepNum = 4;
+    if (inProgressFunc && inProgressFunc(0, stepNum) == false)
+      return false;
+
+    // Morton codes
+    double  scale[3];
+    for (int i = 0; i < 3; i++)
+    {
+      double  range = inMinMax[i * 2 + 1] - inMinMax[i * 2 + 0];
+      if (range <= 0)
+        scale[i] = 0;
+      else
+        scale[i] = ((1 << MAX_DEPTH) - 1) / range;
+    }
+    std::vector<CodeIndex>  codeTable(inNum);
+    qpcvParallel::forEachRange(
+      inNum, threadNum, 1024 * 1024,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+        {
+          const GLfloat *v = &(inData[i].x);
+          uint32_t  q[3];
+          for (int j = 0; j < 3; j++)
+          {
+            double  d = (v[j] - inMinMax[j * 2]) * scale[j];
+            if (!(d > 0))   // Also catches NaN
+              d = 0;
+            if (d > (1 << MAX_DEPTH) - 1)
+              d = (1 << MAX_DEPTH) - 1;
+            q[j] = (uint32_t )d;
+          }
+          codeTable[i].code = encodeMorton(q[0], q[1], q[2]);
+          codeTable[i].index = i;
+        }
+      });
+    if (inProgressFunc && inProgressFunc(1, stepNum) == false)
+      return false;
+
+    // Sort
+    qpcvParallel::sort(codeTable.data(), inNum, threadNum,
+                       [](const CodeIndex &a, const CodeIndex &b)
+                       {
+                         return a.code < b.code;
+                       });
+    if (inProgressFunc && inProgressFunc(2, stepNum) == false)
+      return false;
+
+    // Level of each point and the histogram of the blocks
+    const int blockNum = LEVEL_NUM * cellNum;
+    std::vector<std::vector<size_t> > countTable(threadNum, std::vector<size_t>(blockNum, 0));
+    std::vector<uint8_t>  levelTable(inNum);
+    qpcvParallel::forEachRange(
+      inNum, threadNum, inNum,
+      [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+        {
+          int level;
+          if (i == 0)
+            level = 0;
+          else
+            level = getFirstDifferentLevel(codeTable[i - 1].code, codeTable[i].code);
+          levelTable[i] = (uint8_t )level;
+          countTable[inThreadIndex][level * cellNum + getCell(codeTable[i].code)]++;
+        }
+      });
+    std::vector<size_t> blockCount(blockNum, 0);
+    for (int t = 0; t < threadNum; t++)
+      for (int i = 0; i < blockNum; i++)
+        blockCount[i] += countTable[t][i];
+    size_t  total = 0;
+    for (int i = 0; i < blockNum; i++)
+    {
+      total += blockCount[i];
+      mLevelEnd[i] = total;
+    }
+    if (inProgressFunc && inProgressFunc(3, stepNum) == false)
+      return false;
+
+    // Gather the points of each level (Morton order, so also in cell order),
+    // then write out each block in bit reversed order. Each level is an
+    // independent job
+    std::vector<std::vector<size_t> > levelIndexTable(LEVEL_NUM);
+    for (int i = 0; i < LEVEL_NUM; i++)
+      levelIndexTable[i].reserve(getLevelEnd(mLevelEnd, i) - getLevelEnd(mLevelEnd, i - 1));
+    for (size_t i = 0; i < inNum; i++)
+      levelIndexTable[levelTable[i]].push_back(codeTable[i].index);
+    std::vector<CodeIndex>().swap(codeTable);
+    qpcvParallel::forEachRange(
+      LEVEL_NUM, threadNum, 1,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t level = inBegin; level < inEnd; level++)
+        {
+          const size_t  *indexTable = levelIndexTable[level].data();
+          for (int cell = 0; cell < cellNum; cell++)
+          {
+            size_t  blockBegin, blockEnd;
+            getBlockRange(mLevelEnd, (int )level, cell, &blockBegin, &blockEnd);
+            size_t  num = blockEnd - blockBegin;
+            ibc::gl::glXYZf_RGBAub  *out = outData + blockBegin;
+            int bitNum = 0;
+            while (((size_t )1 << bitNum) < num)
+              bitNum++;
+            size_t  pos = 0;
+            for (size_t k = 0; pos < num; k++)
+            {
+              size_t  r = reverseBits(k, bitNum);
+              if (r >= num)
+                continue;
+              if (outSourceIndex != NULL)
+                outSourceIndex[blockBegin + pos] = (uint32_t )indexTable[r];
+              out[pos++] = inData[indexTable[r]];
+            }
+            indexTable += num;
+          }
+        }
+      });
+    if (inProgressFunc && inProgressFunc(stepNum, stepNum) == false)
+      return false;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // isValid
+  // ---------------------------------------------------------------------------
+  bool  isValid() const
+  {
+    return (mLevelEnd.size() != 0);
+  }
+  // ---------------------------------------------------------------------------
+  // getLevelEndTable
+  // ---------------------------------------------------------------------------
+  const std::vector<size_t> &getLevelEndTable() const
+  {
+    return mLevelEnd;
+  }
+  // ---------------------------------------------------------------------------
+  // getCellNum
+  // ---------------------------------------------------------------------------
+  // CELL_NUM by default, 1 for the one cell tables (see the class comment)
+  static int  getCellNum(const std::vector<size_t> &inLevelEndTable)
+  {
+    return (int )(inLevelEndTable.size() / LEVEL_NUM);
+  }
+  // ---------------------------------------------------------------------------
+  // getLevelEnd
+  // ---------------------------------------------------------------------------
+  // Number of points in the levels 0 ... inLevel
+  static size_t getLevelEnd(const std::vector<size_t> &inLevelEndTable, int inLevel)
+  {
+    int cellNum = getCellNum(inLevelEndTable);
+    if (cellNum == 0)
+      return 0;
+    if (inLevel < 0)
+      return 0;
+    if (inLevel >= LEVEL_NUM)
+      inLevel = LEVEL_NUM - 1;
+    return inLevelEndTable[(size_t )inLevel * cellNum + cellNum - 1];
+  }
+  // ---------------------------------------------------------------------------
+  // getBlockRange
+  // ---------------------------------------------------------------------------
+  // The points of the level inLevel in the cell inCell
+  static void getBlockRange(const std::vector<size_t> &inLevelEndTable, int inLevel, int inCell,
+                            size_t *outBegin, size_t *outEnd)
+  {
+    size_t  index = (size_t )inLevel * getCellNum(inLevelEndTable) + inCell;
+    *outBegin = (index == 0) ? 0 : inLevelEndTable[index - 1];
+    *outEnd = inLevelEndTable[index];
+  }
+  // ---------------------------------------------------------------------------
+  // selectRanges
+  // ---------------------------------------------------------------------------
+  // The points to draw when the cell c is drawn down to the level
+  // inCellLevelTable[c] (-1 : not drawn, getCellNum() entries). The levels
+  // are filled coarse first while they fit in inBudget. The first level that
+  // does not fit is drawn partially (the same fraction of every block, which
+  // is spread over the cell thanks to the bit reversed order) and the finer
+  // levels are not drawn. Adjacent ranges are merged. Returns the number of
+  // the points in outRangeTable. outFullLevel (can be NULL) returns the finest
+  // level that was not cut by the budget
+  static size_t selectRanges(const std::vector<size_t> &inLevelEndTable,
+                             const int *inCellLevelTable, size_t inBudget,
+                             std::vector<Range> *outRangeTable, int *outFullLevel = NULL)
+  {
+    outRangeTable->clear();
+    if (outFullLevel != NULL)
+      *outFullLevel = LEVEL_NUM - 1;
+    int cellNum = getCellNum(inLevelEndTable);
+    size_t  total = 0;
+    for (int level = 0; level < LEVEL_NUM; level++)
+    {
+      size_t  levelNum = 0;
+      for (int cell = 0; cell < cellNum; cell++)
+      {
+        if (inCellLevelTable[cell] < level)
+          continue;
+        size_t  begin, end;
+        getBlockRange(inLevelEndTable, level, cell, &begin, &end);
+        levelNum += end - begin;
+      }
+      if (levelNum == 0)
+        continue;
+      double  ratio = 1.0;
+      if (total + levelNum > inBudget)
+        ratio = (double )(inBudget - total) / levelNum;
+      for (int cell = 0; cell < cellNum; cell++)
+      {
+        if (inCellLevelTable[cell] < level)
+          continue;
+        size_t  begin, end;
+        getBlockRange(inLevelEndTable, level, cell, &begin, &end);
+        if (ratio < 1.0)
+          end = begin + (size_t )((end - begin) * ratio);
+        if (end <= begin)
+          continue;
+        total += end - begin;
+        if (outRangeTable->size() != 0 && outRangeTable->back().end == begin)
+          outRangeTable->back().end = end;
+        else
+          outRangeTable->push_back({begin, end});
+      }
+      if (ratio < 1.0)
+      {
+        if (outFullLevel != NULL)
+          *outFullLevel = level - 1;
+        break;
+      }
+    }
+    return total;
+  }
+  // ---------------------------------------------------------------------------
+  // encodeMorton
+  // ---------------------------------------------------------------------------
+  // Lower MAX_DEPTH bits of each axis (also used by qpcvMeshOptimizer)
+  static uint64_t encodeMorton(uint32_t inX, uint32_t inY, uint32_t inZ)
+  {
+    return (splitBits(inX) << 2) | (splitBits(inY) << 1) | splitBits(inZ);
+  }
+
+protected:
+  struct CodeIndex
+  {
+    uint64_t  code;
+    size_t    index;
+  };
+
+  // Member variables ----------------------------------------------------------
+  int mCellDepth;
+  std::vector<size_t> mLevelEnd;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // splitBits
+  // ---------------------------------------------------------------------------
+  // Inserts two zero bits between each of the lower 21 bits
+  static uint64_t splitBits(uint32_t inValue)
+  {
+    uint64_t  x = inValue & 0x1FFFFF;
+    x = (x | x << 32) & 0x1F00000000FFFFULL;
+    x = (x | x << 16) & 0x1F0000FF0000FFULL;
+    x = (x | x << 8)  & 0x100F00F00F00F00FULL;
+    x = (x | x << 4)  & 0x10C30C30C30C30C3ULL;
+    x = (x | x << 2)  & 0x1249249249249249ULL;
+    return x;
+  }
+  // ---------------------------------------------------------------------------
+  // getCell
+  // ---------------------------------------------------------------------------
+  // The node of the level mCellDepth (the top bits of the code)
+  int getCell(uint64_t inCode) const
+  {
+    return (int )(inCode >> (3 * (MAX_DEPTH - mCellDepth)));
+  }
+  // ---------------------------------------------------------------------------
+  // getFirstDifferentLevel
+  // ---------------------------------------------------------------------------
+  // The coarsest level where the two (sorted) codes are in different nodes
+  static int  getFirstDifferentLevel(uint64_t inPrevCode, uint64_t inCode)
+  {
+    uint64_t  diff = inPrevCode ^ inCode;
+    if (diff == 0)
+      return MAX_DEPTH + 1;
+    int highBit = 63;
+    while ((diff & ((uint64_t )1 << highBit)) == 0)
+      highBit--;
+    // Level 1 uses the bits 62..60, level 2 the bits 59..57 and so on
+    return (3 * MAX_DEPTH - 1 - highBit) / 3 + 1;
+  }
+  // ---------------------------------------------------------------------------
+  // reverseBits
+  // ---------------------------------------------------------------------------
+  static size_t reverseBits(size_t inValue, int inBitNum)
+  {
+    size_t  result = 0;
+    for (int i = 0; i < inBitNum; i++)
+    {
+      result = (result << 1) | (inValue & 1);
+      inValue >>= 1;
+    }
+    return result;
+  }
+};
+
+#endif  // #ifdef QPCV_LOD_H_
@@ -0,0 +1,329 @@
+// =============================================================================
+//  qpcv_lzf.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_lzf.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Parallel LZF decompressor (PCD binary_compressed)
+*/
+
+#ifndef QPCV_LZF_H_
+#define QPCV_LZF_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+#include <string.h>
+#include "qpcv_parallel.h"
+
+// -----------------------------------------------------------------------------
+// qpcvLZF class
+// -----------------------------------------------------------------------------
+// An LZF stream is a sequence of literal runs and back references of up to
+// MAX_DISTANCE bytes, so it has no independent blocks. decompressParallel()
+// first walks the control bytes only (literals are skipped, not copied) to
+// find token boundaries at even output intervals and to validate the stream.
+// The segments are then decoded in parallel. A back reference that reaches
+// into the previous segment (or copies bytes that depend on one) can't be
+// resolved yet, so it is recorded and replayed in stream order after the
+// previous segments are complete. Those usually are a few references at the
+// top of each segment.
+class qpcvLZF
+{
+public:
+  // Called with the number of decompressed bytes. Return false to cancel
+  typedef std::function<bool(size_t inDoneBytes)> ProgressFunc;
+
+  // Constants -----------------------------------------------------------------
+  static const size_t MAX_DISTANCE = 8192;
+  // Output smaller than this (per thread) is decompressed on the calling thread only
+  static const size_t PARALLEL_MIN_BYTES = 4 * 1024 * 1024;
+  static const size_t SEGMENT_BYTES = 1024 * 1024;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // decompress
+  // ---------------------------------------------------------------------------
+  // Fails unless the stream decodes to exactly inOutSize bytes
+  static bool decompress(const unsigned char *inData, size_t inSize,
+                         unsigned char *outData, size_t inOutSize)
+  {
+    const unsigned char *ip = inData;
+    const unsigned char *inEnd = inData + inSize;
+    unsigned char *op = outData;
+    unsigned char *outEnd = outData + inOutSize;
+
+    while (ip < inEnd)
+    {
+      unsigned int  ctrl = *ip++;
+      if (ctrl < 32)
+      {
+        size_t  len = ctrl + 1;
+        if ((size_t )(inEnd - ip) < len || (size_t )(outEnd - op) < len)
+          return false;
+        memcpy(op, ip, len);
+        ip += len;
+        op += len;
+        continue;
+      }
+      size_t  len = ctrl >> 5;
+      size_t  distance = (ctrl & 0x1F) << 8;
+      if (len == 7)
+      {
+        if (ip >= inEnd)
+          return false;
+        len += *ip++;
+      }
+      if (ip >= inEnd)
+        return false;
+      distance += *ip++ + 1;
+      len += 2;
+      if ((size_t )(op - outData) < distance || (size_t )(outEnd - op) < len)
+        return false;
+      copyMatch(op, op - distance, len);
+      op += len;
+    }
+    return (op == outEnd);
+  }
+  // ---------------------------------------------------------------------------
+  // decompressParallel
+  // ---------------------------------------------------------------------------
+  // inThreadNum <= 0 uses all cores. Small outputs fall back to decompress().
+  // Returns false on a broken stream or when canceled (check the progress func)
+  static bool decompressParallel(const unsigned char *inData, size_t inSize,
+                                 unsigned char *outData, size_t inOutSize,
+                                 int inThreadNum,
+                                 const ProgressFunc &inProgressFunc = ProgressFunc())
+  {
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, inOutSize, PARALLEL_MIN_BYTES);
+    if (threadNum <= 1)
+    {
+      if (decompress(inData, inSize, outData, inOutSize) == false)
+        return false;
+      return !inProgressFunc || inProgressFunc(inOutSize);
+    }
+
+    // Token boundaries (validates the whole stream, so the segment decoder
+    // does not need any bounds check)
+    std::vector<Segment>  segmentTable;
+    if (scan(inData, inSize, inOutSize, &segmentTable) == false)
+      return false;
+
+    size_t  segmentNum = segmentTable.size() - 1;
+    std::vector<std::vector<Match>> deferredTable(segmentNum);
+    bool  result = qpcvParallel::forEachRange(
+      segmentNum, threadNum, 1,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+          decodeSegment(inData, outData, segmentTable[i], segmentTable[i + 1],
+                        &(deferredTable[i]));
+      },
+      [&](size_t inDoneNum)
+      {
+        if (!inProgressFunc)
+          return true;
+        return inProgressFunc(segmentTable[inDoneNum].outPos);
+      });
+    if (result == false)
+      return false;
+
+    // The first segment never defers anything
+    for (size_t i = 1; i < segmentNum; i++)
+    {
+      const std::vector<Match>  &deferred = deferredTable[i];
+      for (size_t j = 0; j < deferred.size(); j++)
+        copyMatch(outData + deferred[j].outPos,
+                  outData + deferred[j].outPos - deferred[j].distance, deferred[j].len);
+    }
+    return true;
+  }
+
+protected:
+  // Segment boundary (a token boundary)
+  struct Segment
+  {
+    size_t  inPos;
+    size_t  outPos;
+  };
+
+  // Back reference that depends on an unfinished segment
+  struct Match
+  {
+    size_t  outPos;
+    uint32_t  distance;
+    uint32_t  len;
+  };
+
+  // Output range whose contents depend on an unfinished segment
+  struct Range
+  {
+    size_t  begin;
+    size_t  end;
+  };
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // scan
+  // ---------------------------------------------------------------------------
+  // outSegmentTable returns the segment boundaries followed by the end of the stream
+  static bool scan(const unsigned char *inData, size_t inSize, size_t inOutSize,
+                   std::vector<Segment> *outSegmentTable)
+  {
+    size_t  ip = 0, op = 0;
+    size_t  nextOutPos = SEGMENT_BYTES;
+    Segment segment = {0, 0};
+
+    outSegmentTable->clear();
+    outSegmentTable->push_back(segment);
+    while (ip < inSize)
+    {
+      if (op >= nextOutPos)
+      {
+        segment.inPos = ip;
+        segment.outPos = op;
+        outSegmentTable->push_back(segment);
+        nextOutPos = op + SEGMENT_BYTES;
+      }
+      unsigned int  ctrl = inData[ip++];
+      if (ctrl < 32)
+      {
+        size_t  len = ctrl + 1;
+        if (inSize - ip < len || inOutSize - op < len)
+          return false;
+        ip += len;
+        op += len;
+        continue;
+      }
+      size_t  len = ctrl >> 5;
+      size_t  distance = (ctrl & 0x1F) << 8;
+      if (len == 7)
+      {
+        if (ip >= inSize)
+          return false;
+        len += inData[ip++];
+      }
+      if (ip >= inSize)
+        return false;
+      distance += inData[ip++] + 1;
+      len += 2;
+      if (op < distance || inOutSize - op < len)
+        return false;
+      op += len;
+    }
+    if (op != inOutSize)
+      return false;
+    segment.inPos = ip;
+    segment.outPos = op;
+    outSegmentTable->push_back(segment);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeSegment
+  // ---------------------------------------------------------------------------
+  // Bytes before inBegin.outPos are not written yet (another thread works on
+  // them), so the references to them and to the bytes copied from them go
+  // to outDeferred. taintTable holds those output ranges (sorted, disjoint);
+  // ranges older than MAX_DISTANCE can't be referenced and are dropped
+  static void decodeSegment(const unsigned char *inData, unsigned char *outData,
+                            const Segment &inBegin, const Segment &inEnd,
+                            std::vector<Match> *outDeferred)
+  {
+    const unsigned char *ip = inData + inBegin.inPos;
+    const unsigned char *inEndPtr = inData + inEnd.inPos;
+    size_t  op = inBegin.outPos;
+    const size_t  segmentTop = inBegin.outPos;
+    std::vector<Range>  taintTable;
+    size_t  taintHead = 0;
+
+    outDeferred->clear();
+    while (ip < inEndPtr)
+    {
+      unsigned int  ctrl = *ip++;
+      if (ctrl < 32)
+      {
+        size_t  len = ctrl + 1;
+        memcpy(outData + op, ip, len);
+        ip += len;
+        op += len;
+        continue;
+      }
+      size_t  len = ctrl >> 5;
+      size_t  distance = (ctrl & 0x1F) << 8;
+      if (len == 7)
+        len += *ip++;
+      distance += *ip++ + 1;
+      len += 2;
+      size_t  src = op - distance;
+
+      // Is any source byte unresolved? (an overlapping copy only reads
+      // [src, op) from outside of its own output)
+      bool  isTainted = (src < segmentTop);
+      if (isTainted == false && taintHead < taintTable.size())
+      {
+        while (taintHead < taintTable.size() &&
+               taintTable[taintHead].end + MAX_DISTANCE <= op)
+          taintHead++;
+        size_t  srcEnd = std::min(src + len, op);
+        std::vector<Range>::const_iterator  it = std::upper_bound(
+          taintTable.begin() + taintHead, taintTable.end(), src,
+          [](size_t inPos, const Range &inRange)
+          {
+            return inPos < inRange.end;
+          });
+        isTainted = (it != taintTable.end() && it->begin < srcEnd);
+      }
+      if (isTainted)
+      {
+        Match match = {op, (uint32_t )distance, (uint32_t )len};
+        outDeferred->push_back(match);
+        if (taintTable.size() > taintHead && taintTable.back().end == op)
+          taintTable.back().end = op + len;
+        else
+        {
+          Range range = {op, op + len};
+          taintTable.push_back(range);
+        }
+      }
+      else
+        copyMatch(outData + op, outData + src, len);
+      op += len;
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // copyMatch
+  // ---------------------------------------------------------------------------
+  // inSrc may overlap outDst (a run), so the copy goes forward in steps of
+  // at most the distance
+  static void copyMatch(unsigned char *outDst, const unsigned char *inSrc, size_t inLen)
+  {
+    size_t  distance = outDst - inSrc;
+    if (distance >= inLen)
+    {
+      memcpy(outDst, inSrc, inLen);
+      return;
+    }
+    if (distance == 1)
+    {
+      memset(outDst, *inSrc, inLen);
+      return;
+    }
+    for (size_t i = 0; i < inLen; i++)
+      outDst[i] = inSrc[i];
+  }
+};
+
+#endif  // #ifdef QPCV_LZF_H_
@@ -0,0 +1,396 @@
+// =============================================================================
+//  qpcv_mesh_optimizer.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_mesh_optimizer.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Vertex cache friendly triangle reordering
+*/
+
+#ifndef QPCV_MESH_OPTIMIZER_H_
+#define QPCV_MESH_OPTIMIZER_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include "qpcv_parallel.h"
+#include "qpcv_lod.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvMeshOptimizer class
+// -----------------------------------------------------------------------------
+// Reorders the triangles of an index buffer with Tipsify (Sander, Nehab and
+// Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw",
+// 2007): the triangles around a fanning vertex are emitted together and the
+// next fanning vertex is the neighbor that still is in the cache. The index
+// buffer is split into chunks that are reordered independently (and in
+// parallel) with a chunk local vertex numbering, so the work memory does not
+// depend on the vertex number. The triangles are first sorted by the Morton
+// code of their centroid, so a chunk is a compact patch of the surface even
+// when the file order is random (Tipsify can't do much on a chunk of
+// scattered triangles). Only the triangle order changes, the vertex order is
+// kept (it is the qpcvLOD order for large clouds).
+class qpcvMeshOptimizer
+{
+public:
+  // Called with the number of processed triangles. Return false to cancel
+  typedef std::function<bool(size_t inDoneNum)> ProgressFunc;
+
+  // Constants -----------------------------------------------------------------
+  // Post transform cache size assumed by the reordering and by calcACMR()
+  static const int    CACHE_SIZE = 16;
+  static const size_t CHUNK_TRIANGLE_NUM = 64 * 1024;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // optimize
+  // ---------------------------------------------------------------------------
+  // ioIndex has 3 * inTriangleNum indices into inVertex. inVertex can be NULL
+  // (the spatial sort is skipped then). inThreadNum <= 0 uses all cores.
+  // Returns false when canceled (ioIndex is still a valid permutation)
+  static bool optimize(uint32_t *ioIndex, size_t inTriangleNum,
+                       const ibc::gl::glXYZf_RGBAub *inVertex, int inThreadNum,
+                       const ProgressFunc &inProgressFunc = ProgressFunc())
+  {
+    if (inVertex != NULL)
+      sortSpatially(ioIndex, inTriangleNum, inVertex, inThreadNum);
+    if (inProgressFunc && inProgressFunc(0) == false)
+      return false;
+    size_t  chunkNum = (inTriangleNum + CHUNK_TRIANGLE_NUM - 1) / CHUNK_TRIANGLE_NUM;
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, chunkNum, 1);
+    return qpcvParallel::forEachRange(
+      chunkNum, threadNum, 1,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        Work  work;
+        for (size_t i = inBegin; i < inEnd; i++)
+        {
+          size_t  begin = i * CHUNK_TRIANGLE_NUM;
+          size_t  num = std::min(inTriangleNum - begin, CHUNK_TRIANGLE_NUM);
+          optimizeChunk(ioIndex + begin * 3, num, &work);
+        }
+      },
+      [&](size_t inDoneNum)
+      {
+        if (!inProgressFunc)
+          return true;
+        return inProgressFunc(std::min(inDoneNum * CHUNK_TRIANGLE_NUM, inTriangleNum));
+      });
+  }
+  // ---------------------------------------------------------------------------
+  // calcACMR
+  // ---------------------------------------------------------------------------
+  // Average cache miss ratio (transformed vertices per triangle) with a FIFO
+  // cache of CACHE_SIZE entries: 3 for an unordered soup, about 0.6 - 0.7 for
+  // a well ordered regular mesh. Each thread simulates the cache on its own
+  // slice, so the result is slightly pessimistic at the slice boundaries
+  static double calcACMR(const uint32_t *inIndex, size_t inTriangleNum, int inThreadNum)
+  {
+    if (inTriangleNum == 0)
+      return 0;
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, inTriangleNum, 1024 * 1024);
+    std::vector<size_t> missTable(threadNum, 0);
+    qpcvParallel::forEachRange(
+      inTriangleNum, threadNum, inTriangleNum,
+      [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+      {
+        uint32_t  cache[CACHE_SIZE];
+        int cacheNum = 0, cachePos = 0;
+        size_t  missNum = 0;
+        for (size_t i = inBegin * 3; i < inEnd * 3; i++)
+        {
+          bool  isHit = false;
+          for (int j = 0; j < cacheNum; j++)
+            if (cache[j] == inIndex[i])
+            {
+              isHit = true;
+              break;
+            }
+          if (isHit)
+            continue;
+          missNum++;
+          cache[cachePos] = inIndex[i];
+          cachePos = (cachePos + 1) % CACHE_SIZE;
+          if (cacheNum < CACHE_SIZE)
+            cacheNum++;
+        }
+        missTable[inThreadIndex] = missNum;
+      });
+    size_t  missNum = 0;
+    for (size_t i = 0; i < missTable.size(); i++)
+      missNum += missTable[i];
+    return (double )missNum / inTriangleNum;
+  }
+
+protected:
+  struct CodeIndex
+  {
+    uint64_t  code;
+    uint32_t  triangle;
+  };
+  // Buffers reused over the chunks of one thread
+  struct Work
+  {
+    std::vector<uint32_t> hashKey;        // Vertex -> chunk local index
+    std::vector<uint32_t> hashValue;
+    std::vector<uint32_t> localIndex;
+    std::vector<uint32_t> adjacencyOffset;
+    std::vector<uint32_t> adjacency;      // Triangles of each local vertex
+    std::vector<uint32_t> liveNum;        // Triangles not emitted yet
+    std::vector<uint32_t> cacheTime;
+    std::vector<uint8_t>  isEmitted;
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidate;
+    std::vector<uint32_t> triangleOrder;
+    std::vector<uint32_t> result;
+  };
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // sortSpatially
+  // ---------------------------------------------------------------------------
+  // Sorts the triangles by the Morton code of their centroid (quantized in the
+  // bounds of the centroids). NaN centroids go to the first cell
+  static void sortSpatially(uint32_t *ioIndex, size_t inTriangleNum,
+                            const ibc::gl::glXYZf_RGBAub *inVertex, int inThreadNum)
+  {
+    if (inTriangleNum < 2 || inTriangleNum > (size_t )0xFFFFFFFF)
+      return;
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, inTriangleNum, 256 * 1024);
+    auto  getCentroid = [&](size_t inTriangle, int inAxis)
+    {
+      const uint32_t  *index = ioIndex + inTriangle * 3;
+      return ((&(inVertex[index[0]].x))[inAxis] +
+              (&(inVertex[index[1]].x))[inAxis] +
+              (&(inVertex[index[2]].x))[inAxis]) / 3.0f;
+    };
+
+    // Bounds of the centroids
+    std::vector<float>  minMaxTable(threadNum * 6);
+    qpcvParallel::forEachRange(
+      inTriangleNum, threadNum, inTriangleNum,
+      [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+      {
+        float *minMax = &(minMaxTable[inThreadIndex * 6]);
+        for (int j = 0; j < 3; j++)
+        {
+          minMax[j * 2 + 0] = FLT_MAX;
+          minMax[j * 2 + 1] = -FLT_MAX;
+        }
+        for (size_t i = inBegin; i < inEnd; i++)
+          for (int j = 0; j < 3; j++)
+          {
+            float v = getCentroid(i, j);
+            if (v < minMax[j * 2 + 0])
+              minMax[j * 2 + 0] = v;
+            if (v > minMax[j * 2 + 1])
+              minMax[j * 2 + 1] = v;
+          }
+      });
+    float minMax[6];
+    double  scale[3];
+    for (int j = 0; j < 3; j++)
+    {
+      minMax[j * 2 + 0] = FLT_MAX;
+      minMax[j * 2 + 1] = -FLT_MAX;
+      for (int t = 0; t < threadNum; t++)
+      {
+        minMax[j * 2 + 0] = std::min(minMax[j * 2 + 0], minMaxTable[t * 6 + j * 2 + 0]);
+        minMax[j * 2 + 1] = std::max(minMax[j * 2 + 1], minMaxTable[t * 6 + j * 2 + 1]);
+      }
+      double  range = (double )minMax[j * 2 + 1] - minMax[j * 2 + 0];
+      if (!(range > 0))
+        scale[j] = 0;
+      else
+        scale[j] = ((1 << qpcvLOD::MAX_DEPTH) - 1) / range;
+    }
+
+    // Codes and the sort
+    std::vector<CodeIndex>  codeTable(inTriangleNum);
+    qpcvParallel::forEachRange(
+      inTriangleNum, threadNum, inTriangleNum,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+        {
+          uint32_t  q[3];
+          for (int j = 0; j < 3; j++)
+          {
+            double  d = (getCentroid(i, j) - minMax[j * 2]) * scale[j];
+            if (!(d > 0))   // Also catches NaN
+              d = 0;
+            if (d > (1 << qpcvLOD::MAX_DEPTH) - 1)
+              d = (1 << qpcvLOD::MAX_DEPTH) - 1;
+            q[j] = (uint32_t )d;
+          }
+          codeTable[i].code = qpcvLOD::encodeMorton(q[0], q[1], q[2]);
+          codeTable[i].triangle = (uint32_t )i;
+        }
+      });
+    qpcvParallel::sort(codeTable.data(), inTriangleNum, threadNum,
+                       [](const CodeIndex &a, const CodeIndex &b)
+                       {
+                         return a.code < b.code;
+                       });
+
+    // Permutation
+    std::vector<uint32_t> source(ioIndex, ioIndex + inTriangleNum * 3);
+    qpcvParallel::forEachRange(
+      inTriangleNum, threadNum, inTriangleNum,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+          memcpy(ioIndex + i * 3, &(source[codeTable[i].triangle * (size_t )3]),
+                 3 * sizeof(uint32_t));
+      });
+  }
+  // ---------------------------------------------------------------------------
+  // optimizeChunk
+  // ---------------------------------------------------------------------------
+  static void optimizeChunk(uint32_t *ioIndex, size_t inTriangleNum, Work *ioWork)
+  {
+    const size_t  indexNum = inTriangleNum * 3;
+
+    // Chunk local vertex numbering in the order of the first use (open
+    // addressing hash, 0xFFFFFFFF is never a valid index)
+    size_t  hashSize = 1;
+    while (hashSize < indexNum * 2)
+      hashSize <<= 1;
+    const uint32_t  hashMask = (uint32_t )(hashSize - 1);
+    std::vector<uint32_t> &hashKey = ioWork->hashKey;
+    std::vector<uint32_t> &hashValue = ioWork->hashValue;
+    hashKey.assign(hashSize, 0xFFFFFFFF);
+    hashValue.resize(hashSize);
+    std::vector<uint32_t> &localIndex = ioWork->localIndex;
+    localIndex.resize(indexNum);
+    size_t  vertexNum = 0;
+    for (size_t i = 0; i < indexNum; i++)
+    {
+      uint32_t  v = ioIndex[i];
+      uint32_t  h = (v * 2654435761u) & hashMask;
+      while (hashKey[h] != v && hashKey[h] != 0xFFFFFFFF)
+        h = (h + 1) & hashMask;
+      if (hashKey[h] != v)
+      {
+        hashKey[h] = v;
+        hashValue[h] = (uint32_t )(vertexNum++);
+      }
+      localIndex[i] = hashValue[h];
+    }
+
+    // Vertex to triangle adjacency
+    std::vector<uint32_t> &offset = ioWork->adjacencyOffset;
+    std::vector<uint32_t> &liveNum = ioWork->liveNum;
+    offset.assign(vertexNum + 1, 0);
+    for (size_t i = 0; i < indexNum; i++)
+      offset[localIndex[i] + 1]++;
+    liveNum.resize(vertexNum);
+    for (size_t i = 0; i < vertexNum; i++)
+    {
+      liveNum[i] = offset[i + 1];
+      offset[i + 1] += offset[i];
+    }
+    std::vector<uint32_t> &adjacency = ioWork->adjacency;
+    adjacency.resize(indexNum);
+    std::vector<uint32_t> &fillPos = ioWork->cacheTime;   // Used as the fill position first
+    fillPos.assign(offset.begin(), offset.end() - 1);
+    for (size_t i = 0; i < indexNum; i++)
+      adjacency[fillPos[localIndex[i]]++] = (uint32_t )(i / 3);
+
+    // Tipsify
+    std::vector<uint32_t> &cacheTime = ioWork->cacheTime;
+    std::vector<uint8_t>  &isEmitted = ioWork->isEmitted;
+    std::vector<uint32_t> &deadEnd = ioWork->deadEnd;
+    std::vector<uint32_t> &candidate = ioWork->candidate;
+    std::vector<uint32_t> &triangleOrder = ioWork->triangleOrder;
+    cacheTime.assign(vertexNum, 0);
+    isEmitted.assign(inTriangleNum, 0);
+    deadEnd.clear();
+    triangleOrder.clear();
+    uint32_t  time = CACHE_SIZE + 1;
+    size_t  cursor = 0;
+    int64_t fanning = (vertexNum != 0) ? 0 : -1;
+    while (fanning >= 0)
+    {
+      candidate.clear();
+      for (uint32_t k = offset[fanning]; k < offset[fanning + 1]; k++)
+      {
+        uint32_t  triangle = adjacency[k];
+        if (isEmitted[triangle])
+          continue;
+        isEmitted[triangle] = 1;
+        triangleOrder.push_back(triangle);
+        for (int j = 0; j < 3; j++)
+        {
+          uint32_t  v = localIndex[triangle * 3 + j];
+          deadEnd.push_back(v);
+          candidate.push_back(v);
+          liveNum[v]--;
+          if (time - cacheTime[v] > (uint32_t )CACHE_SIZE)
+            cacheTime[v] = time++;
+        }
+      }
+      // The candidate still in the cache after its remaining fan is emitted
+      // and with the oldest entry (so it is used before it is evicted)
+      fanning = -1;
+      int64_t best = -1;
+      for (size_t i = 0; i < candidate.size(); i++)
+      {
+        uint32_t  v = candidate[i];
+        if (liveNum[v] == 0)
+          continue;
+        int64_t priority = 0;
+        if (time - cacheTime[v] + 2 * liveNum[v] <= (uint32_t )CACHE_SIZE)
+          priority = time - cacheTime[v];
+        if (priority > best)
+        {
+          best = priority;
+          fanning = v;
+        }
+      }
+      if (fanning >= 0)
+        continue;
+      // Dead end : the most recent vertex with live triangles, then the
+      // next one in the numbering
+      while (deadEnd.size() != 0 && fanning < 0)
+      {
+        uint32_t  v = deadEnd.back();
+        deadEnd.pop_back();
+        if (liveNum[v] != 0)
+          fanning = v;
+      }
+      while (fanning < 0 && cursor < vertexNum)
+      {
+        if (liveNum[cursor] != 0)
+          fanning = (int64_t )cursor;
+        else
+          cursor++;
+      }
+    }
+
+    std::vector<uint32_t> &result = ioWork->result;
+    result.resize(indexNum);
+    for (size_t i = 0; i < inTriangleNum; i++)
+      memcpy(&(result[i * 3]), ioIndex + triangleOrder[i] * 3, 3 * sizeof(uint32_t));
+    memcpy(ioIndex, result.data(), indexNum * sizeof(uint32_t));
+  }
+};
+
+#endif  // #ifdef QPCV_MESH_OPTIMIZER_H_
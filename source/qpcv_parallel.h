@@ -0,0 +1,194 @@
+// =============================================================================
+//  qpcv_parallel.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_parallel.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Splits an index range over worker threads
+*/
+
+#ifndef QPCV_PARALLEL_H_
+#define QPCV_PARALLEL_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// -----------------------------------------------------------------------------
+// qpcvParallel class
+// -----------------------------------------------------------------------------
+class qpcvParallel
+{
+public:
+  // Called as inFunc(inThreadIndex, inBegin, inEnd). Must not throw
+  typedef std::function<void(int inThreadIndex, size_t inBegin, size_t inEnd)> RangeFunc;
+  // Called with the number of processed items. Return false to cancel
+  typedef std::function<bool(size_t inDoneNum)> ProgressFunc;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getThreadNum
+  // ---------------------------------------------------------------------------
+  // inRequestedNum <= 0 means "all cores". Small jobs run on one thread since
+  // starting the threads costs more than the work itself
+  static int  getThreadNum(int inRequestedNum, size_t inItemNum, size_t inMinItemNumPerThread)
+  {
+    int threadNum = inRequestedNum;
+    if (threadNum <= 0)
+      threadNum = (int )std::thread::hardware_concurrency();
+    if (threadNum <= 0)
+      threadNum = 1;
+    if (inMinItemNumPerThread == 0)
+      inMinItemNumPerThread = 1;
+    size_t  maxNum = inItemNum / inMinItemNumPerThread;
+    if (maxNum < 1)
+      maxNum = 1;
+    if ((size_t )threadNum > maxNum)
+      threadNum = (int )maxNum;
+    return threadNum;
+  }
+  // ---------------------------------------------------------------------------
+  // forEachRange
+  // ---------------------------------------------------------------------------
+  // Splits [0, inItemNum) into inThreadNum even slices. Each slice is processed
+  // in inBlockNum sized blocks so cancel and progress have a fine granularity.
+  // inProgressFunc is only called from the calling thread. Returns false when canceled
+  static bool forEachRange(size_t inItemNum, int inThreadNum, size_t inBlockNum,
+                           const RangeFunc &inFunc,
+                           const ProgressFunc &inProgressFunc = ProgressFunc())
+  {
+    if (inThreadNum < 1)
+      inThreadNum = 1;
+    if (inBlockNum == 0)
+      inBlockNum = inItemNum;
+    std::atomic<size_t> doneNum(0);
+    std::atomic<bool> isCanceled(false);
+    std::mutex  mutex;
+    std::condition_variable condition;
+    int finishedNum = 0;
+
+    auto  sliceFunc = [&](int inThreadIndex)
+    {
+      size_t  begin = inItemNum * inThreadIndex / inThreadNum;
+      size_t  end   = inItemNum * (inThreadIndex + 1) / inThreadNum;
+      for (size_t block = begin; block < end; block += inBlockNum)
+      {
+        if (isCanceled)
+          break;
+        size_t  blockEnd = block + inBlockNum;
+        if (blockEnd > end)
+          blockEnd = end;
+        inFunc(inThreadIndex, block, blockEnd);
+        doneNum += blockEnd - block;
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      finishedNum++;
+      condition.notify_one();
+    };
+
+    if (inThreadNum == 1)
+    {
+      size_t  done = 0;
+      for (size_t block = 0; block < inItemNum; block += inBlockNum)
+      {
+        size_t  blockEnd = block + inBlockNum;
+        if (blockEnd > inItemNum)
+          blockEnd = inItemNum;
+        inFunc(0, block, blockEnd);
+        done = blockEnd;
+        if (inProgressFunc && inProgressFunc(done) == false)
+          return false;
+      }
+      return true;
+    }
+
+    std::vector<std::thread>  threads;
+    for (int i = 0; i < inThreadNum; i++)
+      threads.push_back(std::thread(sliceFunc, i));
+    {
+      std::unique_lock<std::mutex>  lock(mutex);
+      while (finishedNum < inThreadNum)
+      {
+        condition.wait_for(lock, std::chrono::milliseconds(50));
+        if (finishedNum >= inThreadNum || isCanceled || !inProgressFunc)
+          continue;
+        lock.unlock();
+        if (inProgressFunc(doneNum) == false)
+          isCanceled = true;
+        lock.lock();
+      }
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+      threads[i].join();
+    if (isCanceled)
+      return false;
+    if (inProgressFunc)
+      return inProgressFunc(inItemNum);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // sort
+  // ---------------------------------------------------------------------------
+  // Each thread sorts one slice, then the slices are merged pairwise (the
+  // merges of one round run in parallel)
+  template <typename T, typename Compare>
+  static void sort(T *ioData, size_t inNum, int inThreadNum, Compare inComp)
+  {
+    int threadNum = getThreadNum(inThreadNum, inNum, 64 * 1024);
+    if (threadNum <= 1)
+    {
+      std::sort(ioData, ioData + inNum, inComp);
+      return;
+    }
+    std::vector<size_t> boundaryTable;
+    for (int i = 0; i <= threadNum; i++)
+      boundaryTable.push_back(inNum * i / threadNum);
+    forEachRange(inNum, threadNum, inNum,
+                 [&](int, size_t inBegin, size_t inEnd)
+                 {
+                   std::sort(ioData + inBegin, ioData + inEnd, inComp);
+                 });
+    while (boundaryTable.size() > 2)
+    {
+      std::vector<size_t> nextTable;
+      std::vector<std::thread>  threads;
+      for (size_t i = 0; i + 2 < boundaryTable.size(); i += 2)
+      {
+        size_t  begin  = boundaryTable[i];
+        size_t  middle = boundaryTable[i + 1];
+        size_t  end    = boundaryTable[i + 2];
+        threads.push_back(std::thread(
+          [=]()
+          {
+            std::inplace_merge(ioData + begin, ioData + middle, ioData + end, inComp);
+          }));
+        nextTable.push_back(begin);
+      }
+      if (boundaryTable.size() % 2 == 0)   // Odd number of slices
+        nextTable.push_back(boundaryTable[boundaryTable.size() - 2]);
+      nextTable.push_back(inNum);
+      for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+      boundaryTable = nextTable;
+    }
+  }
+};
+
+#endif  // #ifdef QPCV_PARALLEL_H_
@@ -0,0 +1,648 @@
+// =============================================================================
+//  qpcv_pcd_decoder.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_pcd_decoder.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    PCL PCD decoder (ascii, binary and binary_compressed)
+*/
+
+#ifndef QPCV_PCD_DECODER_H_
+#define QPCV_PCD_DECODER_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <sstream>
+#include <stdint.h>
+#include <string.h>
+#include "qpcv_ply_layout.h"
+#include "qpcv_ply_decoder.h"
+#include "qpcv_text_decoder.h"
+#include "qpcv_lzf.h"
+#include "qpcv_parallel.h"
+#include "qpcv_bounds.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvPCDDecoder class
+// -----------------------------------------------------------------------------
+// The PCD fields are described as a PLY vertex element (the packed rgb / rgba
+// field becomes blue, green, red and alpha uchar properties, which is its
+// little endian byte order), so binary records go through the same
+// qpcvPLYDecoder loops as a binary PLY file. binary_compressed data is one
+// LZF stream of the fields stored one after another (structure of arrays);
+// it is decompressed with qpcvLZF::decompressParallel() and transposed in
+// parallel. ascii data goes through qpcvTextDecoder.
+class qpcvPCDDecoder
+{
+public:
+  typedef qpcvPLYDecoder::ProgressFunc  ProgressFunc;
+
+  enum  DataType
+  {
+    DATA_TYPE_UNKNOWN = 0,
+    DATA_TYPE_ASCII,
+    DATA_TYPE_BINARY,
+    DATA_TYPE_BINARY_COMPRESSED
+  };
+
+  struct Field
+  {
+    std::string name;
+    char    type;       // 'I', 'U' or 'F'
+    size_t  size;
+    size_t  count;
+    size_t  offset;     // Byte offset in the record
+  };
+
+  struct Header
+  {
+    std::string versionStr;
+    std::vector<Field>  fields;
+    size_t  width;
+    size_t  height;
+    size_t  pointNum;
+    size_t  recordSize;
+    DataType  dataType;
+    size_t  headerSize;   // The data starts here
+    std::string headerStr;
+  };
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // isPCD
+  // ---------------------------------------------------------------------------
+  // The first line that is not a comment starts with VERSION or FIELDS
+  static bool isPCD(const unsigned char *inPtr, size_t inSize)
+  {
+    const char  *ptr = (const char *)inPtr;
+    const char  *end = ptr + std::min(inSize, (size_t )4096);
+    while (ptr < end)
+    {
+      const char  *lineEnd = (const char *)memchr(ptr, '\n', end - ptr);
+      if (lineEnd == NULL)
+        return false;
+      if (*ptr != '#')
+        return (lineEnd - ptr >= 6 &&
+                (memcmp(ptr, "VERSION", 7) == 0 || memcmp(ptr, "FIELDS", 6) == 0));
+      ptr = lineEnd + 1;
+    }
+    return false;
+  }
+  // ---------------------------------------------------------------------------
+  // parseHeader
+  // ---------------------------------------------------------------------------
+  // Only the header part is accessed
+  static bool parseHeader(const unsigned char *inPtr, size_t inSize, Header *outHeader,
+                          std::string *outErrorStr)
+  {
+    const char  *ptr = (const char *)inPtr;
+    const char  *end = ptr + inSize;
+    size_t  lineNum = 0;
+    std::vector<size_t> sizeTable, countTable;
+    std::vector<char> typeTable;
+    bool  hasPointNum = false;
+
+    outHeader->versionStr.clear();
+    outHeader->fields.clear();
+    outHeader->width = 0;
+    outHeader->height = 1;
+    outHeader->pointNum = 0;
+    outHeader->recordSize = 0;
+    outHeader->dataType = DATA_TYPE_UNKNOWN;
+    while (ptr < end)
+    {
+      const char  *lineEnd = (const char *)memchr(ptr, '\n', end - ptr);
+      if (lineEnd == NULL)
+        break;
+      std::string line(ptr, lineEnd - ptr);
+      ptr = lineEnd + 1;
+      lineNum++;
+      if (line.size() != 0 && line[line.size() - 1] == '\r')
+        line.erase(line.size() - 1);
+      if (line.size() == 0 || line[0] == '#')
+        continue;
+
+      std::istringstream  stream(line);
+      std::string keyword, str;
+      stream >> keyword;
+      if (keyword == "VERSION")
+        stream >> outHeader->versionStr;
+      else if (keyword == "FIELDS" || keyword == "COLUMNS")
+      {
+        while (stream >> str)
+        {
+          Field field = {str, 'F', 4, 1, 0};
+          outHeader->fields.push_back(field);
+        }
+      }
+      else if (keyword == "SIZE")
+      {
+        size_t  value;
+        while (stream >> value)
+          sizeTable.push_back(value);
+      }
+      else if (keyword == "TYPE")
+      {
+        while (stream >> str)
+          typeTable.push_back(str[0]);
+      }
+      else if (keyword == "COUNT")
+      {
+        size_t  value;
+        while (stream >> value)
+          countTable.push_back(value);
+      }
+      else if (keyword == "WIDTH")
+        stream >> outHeader->width;
+      else if (keyword == "HEIGHT")
+        stream >> outHeader->height;
+      else if (keyword == "POINTS")
+      {
+        stream >> outHeader->pointNum;
+        hasPointNum = true;
+      }
+      else if (keyword == "DATA")
+      {
+        stream >> str;
+        if (str == "ascii")
+          outHeader->dataType = DATA_TYPE_ASCII;
+        else if (str == "binary")
+          outHeader->dataType = DATA_TYPE_BINARY;
+        else if (str == "binary_compressed")
+          outHeader->dataType = DATA_TYPE_BINARY_COMPRESSED;
+        else
+          return setError(lineNum, "unknown DATA type", outErrorStr);
+        break;
+      }
+      else if (keyword != "VIEWPOINT")
+        return setError(lineNum, "unknown keyword", outErrorStr);
+    }
+    if (outHeader->dataType == DATA_TYPE_UNKNOWN)
+      return setError(lineNum, "DATA is missing", outErrorStr);
+    if (outHeader->fields.size() == 0)
+      return setError(lineNum, "FIELDS is missing", outErrorStr);
+    if ((sizeTable.size() != 0 && sizeTable.size() != outHeader->fields.size()) ||
+        (typeTable.size() != 0 && typeTable.size() != outHeader->fields.size()) ||
+        (countTable.size() != 0 && countTable.size() != outHeader->fields.size()))
+      return setError(lineNum, "the number of SIZE, TYPE or COUNT entries does not match FIELDS",
+                      outErrorStr);
+    for (size_t i = 0; i < outHeader->fields.size(); i++)
+    {
+      Field &field = outHeader->fields[i];
+      if (sizeTable.size() != 0)
+        field.size = sizeTable[i];
+      if (typeTable.size() != 0)
+        field.type = typeTable[i];
+      if (countTable.size() != 0)
+        field.count = countTable[i];
+      if (field.size == 0 || field.size > 8 || field.count == 0 ||
+          (field.type != 'I' && field.type != 'U' && field.type != 'F'))
+        return setError(lineNum, "bad SIZE, TYPE or COUNT", outErrorStr);
+      field.offset = outHeader->recordSize;
+      outHeader->recordSize += field.size * field.count;
+    }
+    if (hasPointNum == false)
+      outHeader->pointNum = outHeader->width * outHeader->height;
+    outHeader->headerSize = ptr - (const char *)inPtr;
+    outHeader->headerStr = std::string((const char *)inPtr, outHeader->headerSize);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // getFormatStr
+  // ---------------------------------------------------------------------------
+  static std::string  getFormatStr(const Header &inHeader)
+  {
+    std::string str = "PCD ";
+    switch (inHeader.dataType)
+    {
+      case DATA_TYPE_ASCII:
+        str += "ascii";
+        break;
+      case DATA_TYPE_BINARY:
+        str += "binary";
+        break;
+      case DATA_TYPE_BINARY_COMPRESSED:
+        str += "binary_compressed";
+        break;
+      default:
+        str += "unknown";
+        break;
+    }
+    if (inHeader.versionStr.size() != 0)
+      str += " " + inHeader.versionStr;
+    return str;
+  }
+  // ---------------------------------------------------------------------------
+  // makeElement
+  // ---------------------------------------------------------------------------
+  // The record as a PLY vertex element (for qpcvPLYDecoder::prepareVertexMap()).
+  // Fields with COUNT > 1 become name_0, name_1 ... and the fields without a
+  // PLY type (64 bit integers) get PROPERTY_TYPE_UNKNOWN
+  static void makeElement(const Header &inHeader, qpcvPLYLayout::Element *outElement)
+  {
+    outElement->name = "vertex";
+    outElement->count = inHeader.pointNum;
+    outElement->recordSize = inHeader.recordSize;
+    outElement->properties.clear();
+    for (size_t i = 0; i < inHeader.fields.size(); i++)
+    {
+      const Field &field = inHeader.fields[i];
+      qpcvPLYLayout::Property property;
+      property.isList = false;
+      property.listCountType = qpcvPLYLayout::PROPERTY_TYPE_UNKNOWN;
+      if (isPackedColor(field))
+      {
+        static const char *nameTable[] = {"blue", "green", "red", "alpha"};
+        int num = (field.name == "rgba") ? 4 : 3;
+        for (int j = 0; j < num; j++)
+        {
+          property.name = nameTable[j];
+          property.type = qpcvPLYLayout::PROPERTY_TYPE_UCHAR;
+          property.offset = field.offset + j;
+          outElement->properties.push_back(property);
+        }
+        continue;
+      }
+      property.type = getPropertyType(field);
+      for (size_t j = 0; j < field.count; j++)
+      {
+        property.name = field.name;
+        if (field.count > 1)
+          property.name += "_" + std::to_string(j);
+        property.offset = field.offset + field.size * j;
+        outElement->properties.push_back(property);
+      }
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // prepareVertexMap
+  // ---------------------------------------------------------------------------
+  // Fails when x, y or z is missing or has no usable type
+  static bool prepareVertexMap(const Header &inHeader, qpcvPLYLayout::Element *outElement,
+                               qpcvPLYDecoder::VertexMap *outMap)
+  {
+    makeElement(inHeader, outElement);
+    if (qpcvPLYDecoder::prepareVertexMap(*outElement, outMap) == false)
+      return false;
+    for (int i = 0; i < qpcvPLYDecoder::VERTEX_FIELD_NUM; i++)
+      if (outMap->isValid[i] && outMap->type[i] == qpcvPLYLayout::PROPERTY_TYPE_UNKNOWN)
+      {
+        if (i <= qpcvPLYDecoder::VERTEX_FIELD_Z)
+          return false;
+        outMap->isValid[i] = false;
+      }
+    outMap->hasColor = (outMap->isValid[qpcvPLYDecoder::VERTEX_FIELD_R] &&
+                        outMap->isValid[qpcvPLYDecoder::VERTEX_FIELD_G] &&
+                        outMap->isValid[qpcvPLYDecoder::VERTEX_FIELD_B]);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // getColorFormatStr
+  // ---------------------------------------------------------------------------
+  static std::string  getColorFormatStr(const Header &inHeader, const qpcvPLYDecoder::VertexMap &inMap)
+  {
+    if (inMap.hasColor == false)
+      return std::string();
+    for (size_t i = 0; i < inHeader.fields.size(); i++)
+      if (isPackedColor(inHeader.fields[i]))
+        return inHeader.fields[i].name + (inHeader.fields[i].type == 'F' ? " (packed float)" : " (packed uint)");
+    qpcvPLYLayout::Element  element;
+    makeElement(inHeader, &element);
+    return qpcvPLYDecoder::getColorFormatStr(element, inMap);
+  }
+  // ---------------------------------------------------------------------------
+  // decodeParallel
+  // ---------------------------------------------------------------------------
+  // inFilePtr is the whole file. Allocates *outData (new []) with *outNum
+  // points (the points with a NaN coordinate are dropped). inThreadNum <= 0
+  // uses all cores. inProgressFunc gets [0, inHeader.pointNum]
+  static bool decodeParallel(const Header &inHeader, const qpcvPLYDecoder::VertexMap &inMap,
+                             const unsigned char *inFilePtr, size_t inFileSize,
+                             ibc::gl::glXYZf_RGBAub **outData, size_t *outNum,
+                             qpcvBounds *outBounds,
+                             int inThreadNum,
+                             const ProgressFunc &inProgressFunc,
+                             std::string *outErrorStr)
+  {
+    const unsigned char *body = inFilePtr + inHeader.headerSize;
+    size_t  bodySize = inFileSize - inHeader.headerSize;
+    const size_t  pointNum = inHeader.pointNum;
+    *outData = NULL;
+    *outNum = 0;
+
+    if (inHeader.dataType == DATA_TYPE_ASCII)
+    {
+      qpcvTextDecoder::ColumnMap  columnMap;
+      makeColumnMap(inHeader, &columnMap);
+      size_t  firstLineNum = std::count(inHeader.headerStr.begin(), inHeader.headerStr.end(), '\n') + 1;
+      size_t  lineNum;
+      if (qpcvTextDecoder::decodeParallel(columnMap, body, bodySize, firstLineNum, pointNum,
+                                          "PCD", outData, outNum, &lineNum, outBounds, inThreadNum,
+                                          inProgressFunc, outErrorStr) == false)
+        return false;
+      if (lineNum < pointNum)
+      {
+        delete [] *outData;
+        *outData = NULL;
+        *outNum = 0;
+        return setError("the point data is too short", outErrorStr);
+      }
+      return true;
+    }
+
+    const bool  swap = !qpcvPLYLayout::isHostLittleEndian();
+    if (inHeader.dataType == DATA_TYPE_BINARY)
+    {
+      if (inHeader.recordSize == 0 || pointNum > bodySize / inHeader.recordSize)
+        return setError("the file is truncated", outErrorStr);
+      ibc::gl::glXYZf_RGBAub  *data = new ibc::gl::glXYZf_RGBAub[pointNum];
+      if (decodeBlocks(pointNum, data, outBounds, outNum, inThreadNum, inProgressFunc,
+                       [&](size_t inBegin, size_t inEnd)
+                       {
+                         qpcvPLYDecoder::decodeBinaryRange(inMap, body, swap, inBegin, inEnd, data, NULL);
+                       }) == false)
+      {
+        delete [] data;
+        return false;
+      }
+      *outData = data;
+      return true;
+    }
+
+    // binary_compressed : compressed size, uncompressed size, LZF stream
+    uint32_t  sizeTable[2];
+    if (bodySize < sizeof(sizeTable))
+      return setError("the file is truncated", outErrorStr);
+    memcpy(sizeTable, body, sizeof(sizeTable));
+    if (swap)
+    {
+      sizeTable[0] = qpcvPLYDecoder::swapBytes(sizeTable[0]);
+      sizeTable[1] = qpcvPLYDecoder::swapBytes(sizeTable[1]);
+    }
+    if (sizeTable[0] > bodySize - sizeof(sizeTable))
+      return setError("the file is truncated", outErrorStr);
+    if (inHeader.recordSize == 0 || pointNum > sizeTable[1] / inHeader.recordSize ||
+        sizeTable[1] != inHeader.recordSize * pointNum)
+      return setError("the uncompressed size does not match the fields", outErrorStr);
+    std::vector<unsigned char>  buf(sizeTable[1]);
+    if (qpcvLZF::decompressParallel(
+          body + sizeof(sizeTable), sizeTable[0], buf.data(), buf.size(), inThreadNum,
+          [&](size_t inDoneBytes)
+          {
+            // The first half is the decompression, the second half the transpose
+            if (!inProgressFunc || buf.size() == 0)
+              return true;
+            return inProgressFunc((size_t )((double )pointNum * inDoneBytes / buf.size() / 2));
+          }) == false)
+    {
+      if (inProgressFunc && inProgressFunc(pointNum / 2) == false)
+        return false;
+      return setError("the compressed data is broken", outErrorStr);
+    }
+
+    // Where the first byte of each property of point 0 is (the fields are
+    // stored one after another, each field with a stride of its own size)
+    qpcvPLYLayout::Element  element;
+    makeElement(inHeader, &element);
+    Column  columnTable[qpcvPLYDecoder::VERTEX_FIELD_NUM];
+    for (int i = 0; i < qpcvPLYDecoder::VERTEX_FIELD_NUM; i++)
+    {
+      columnTable[i].ptr = NULL;
+      if (inMap.isValid[i] == false)
+        continue;
+      size_t  offset = element.properties[inMap.propertyIndex[i]].offset;
+      for (size_t j = 0; j < inHeader.fields.size(); j++)
+      {
+        const Field &field = inHeader.fields[j];
+        size_t  fieldSize = field.size * field.count;
+        if (offset < field.offset || offset >= field.offset + fieldSize)
+          continue;
+        columnTable[i].ptr = buf.data() + field.offset * pointNum + (offset - field.offset);
+        columnTable[i].stride = fieldSize;
+        columnTable[i].type = inMap.type[i];
+        break;
+      }
+    }
+    ibc::gl::glXYZf_RGBAub  *data = new ibc::gl::glXYZf_RGBAub[pointNum];
+    if (decodeBlocks(pointNum, data, outBounds, outNum, inThreadNum,
+                     [&](size_t inDoneNum)
+                     {
+                       return !inProgressFunc || inProgressFunc(pointNum / 2 + inDoneNum / 2);
+                     },
+                     [&](size_t inBegin, size_t inEnd)
+                     {
+                       transposeRange(columnTable, inMap.hasColor, swap, inBegin, inEnd, data);
+                     }) == false)
+    {
+      delete [] data;
+      return false;
+    }
+    *outData = data;
+    return true;
+  }
+
+protected:
+  // A field column of binary_compressed data
+  struct Column
+  {
+    const unsigned char *ptr;   // Point 0
+    size_t  stride;
+    qpcvPLYLayout::PropertyType type;
+  };
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // decodeBlocks
+  // ---------------------------------------------------------------------------
+  // Runs inDecodeFunc(begin, end) over [0, inNum) in parallel blocks, drops
+  // the NaN points of each block and closes the gaps at the end.
+  // *outNum returns the number of the remaining points
+  template <typename DecodeFunc>
+  static bool decodeBlocks(size_t inNum, ibc::gl::glXYZf_RGBAub *ioData,
+                           qpcvBounds *outBounds, size_t *outNum,
+                           int inThreadNum, const ProgressFunc &inProgressFunc,
+                           const DecodeFunc &inDecodeFunc)
+  {
+    const size_t  BLOCK_NUM = 64 * 1024;
+    size_t  blockNum = (inNum + BLOCK_NUM - 1) / BLOCK_NUM;
+    int threadNum = qpcvParallel::getThreadNum(
+                      inThreadNum, inNum, qpcvPLYDecoder::PARALLEL_MIN_VERTEX_NUM);
+    std::vector<qpcvBounds> boundsTable(threadNum);
+    std::vector<size_t> beginTable(blockNum), keptTable(blockNum);
+    bool  result = qpcvParallel::forEachRange(
+      blockNum, threadNum, 1,
+      [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+        {
+          size_t  begin = i * BLOCK_NUM;
+          size_t  end = std::min(begin + BLOCK_NUM, inNum);
+          inDecodeFunc(begin, end);
+          beginTable[i] = begin;
+          keptTable[i] = qpcvTextDecoder::removeNaN(ioData + begin, end - begin);
+          boundsTable[inThreadIndex].add(ioData + begin, keptTable[i]);
+        }
+      },
+      [&](size_t inDoneNum)
+      {
+        if (!inProgressFunc)
+          return true;
+        return inProgressFunc(std::min(inDoneNum * BLOCK_NUM, inNum));
+      });
+    if (result == false)
+      return false;
+    if (outBounds != NULL)
+      for (size_t i = 0; i < boundsTable.size(); i++)
+        outBounds->merge(boundsTable[i]);
+    *outNum = qpcvTextDecoder::joinBlocks(ioData, beginTable, keptTable);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // transposeRange
+  // ---------------------------------------------------------------------------
+  static void transposeRange(const Column *inColumnTable, bool inHasColor, bool inSwap,
+                             size_t inBegin, size_t inEnd, ibc::gl::glXYZf_RGBAub *outData)
+  {
+    GLfloat *posTable[3];
+    for (size_t i = inBegin; i < inEnd; i++)
+    {
+      posTable[0] = &(outData[i].x);
+      posTable[1] = &(outData[i].y);
+      posTable[2] = &(outData[i].z);
+      for (int j = 0; j < 3; j++)
+      {
+        const Column  &column = inColumnTable[qpcvPLYDecoder::VERTEX_FIELD_X + j];
+        const unsigned char *ptr = column.ptr + i * column.stride;
+        if (column.type == qpcvPLYLayout::PROPERTY_TYPE_FLOAT)
+          *(posTable[j]) = qpcvPLYDecoder::load<float>(ptr, inSwap);
+        else
+          *(posTable[j]) = (GLfloat )qpcvPLYDecoder::readValue(column.type, ptr, inSwap);
+      }
+    }
+    GLubyte *colorTable[4];
+    for (size_t i = inBegin; i < inEnd; i++)
+    {
+      colorTable[0] = &(outData[i].r);
+      colorTable[1] = &(outData[i].g);
+      colorTable[2] = &(outData[i].b);
+      colorTable[3] = &(outData[i].a);
+      for (int j = 0; j < 4; j++)
+      {
+        const Column  &column = inColumnTable[qpcvPLYDecoder::VERTEX_FIELD_R + j];
+        if (inHasColor == false || column.ptr == NULL)
+          *(colorTable[j]) = 255;
+        else
+          *(colorTable[j]) = qpcvPLYDecoder::readColor(column.type, column.ptr + i * column.stride, inSwap);
+      }
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // makeColumnMap
+  // ---------------------------------------------------------------------------
+  // Text columns of ascii data (one column per field element)
+  static void makeColumnMap(const Header &inHeader, qpcvTextDecoder::ColumnMap *outMap)
+  {
+    static const char *nameTable[] = {"x", "y", "z", "r", "g", "b", "a"};
+    outMap->columnTable.clear();
+    outMap->isColorFloat = false;
+    outMap->hasAlpha = false;
+    for (size_t i = 0; i < inHeader.fields.size(); i++)
+    {
+      const Field &field = inHeader.fields[i];
+      qpcvTextDecoder::ColumnType type = qpcvTextDecoder::COLUMN_TYPE_SKIP;
+      if (isPackedColor(field))
+      {
+        type = (field.type == 'F') ? qpcvTextDecoder::COLUMN_TYPE_RGB_FLOAT :
+                                     qpcvTextDecoder::COLUMN_TYPE_RGB_UINT;
+        outMap->hasAlpha = (field.name == "rgba");
+      }
+      else
+        for (int j = 0; j < 7; j++)
+          if (field.name == nameTable[j])
+            type = (qpcvTextDecoder::ColumnType )(qpcvTextDecoder::COLUMN_TYPE_X + j);
+      if (type >= qpcvTextDecoder::COLUMN_TYPE_R && type <= qpcvTextDecoder::COLUMN_TYPE_A &&
+          field.type == 'F')
+        outMap->isColorFloat = true;
+      outMap->columnTable.push_back(type);
+      for (size_t j = 1; j < field.count; j++)
+        outMap->columnTable.push_back(qpcvTextDecoder::COLUMN_TYPE_SKIP);
+    }
+    // Trailing columns that are not used are not parsed at all
+    while (outMap->columnTable.size() != 0 &&
+           outMap->columnTable.back() == qpcvTextDecoder::COLUMN_TYPE_SKIP)
+      outMap->columnTable.pop_back();
+  }
+  // ---------------------------------------------------------------------------
+  // isPackedColor
+  // ---------------------------------------------------------------------------
+  static bool isPackedColor(const Field &inField)
+  {
+    return ((inField.name == "rgb" || inField.name == "rgba") &&
+            inField.size == 4 && inField.count == 1);
+  }
+  // ---------------------------------------------------------------------------
+  // getPropertyType
+  // ---------------------------------------------------------------------------
+  static qpcvPLYLayout::PropertyType getPropertyType(const Field &inField)
+  {
+    switch (inField.type)
+    {
+      case 'I':
+        if (inField.size == 1)
+          return qpcvPLYLayout::PROPERTY_TYPE_CHAR;
+        if (inField.size == 2)
+          return qpcvPLYLayout::PROPERTY_TYPE_SHORT;
+        if (inField.size == 4)
+          return qpcvPLYLayout::PROPERTY_TYPE_INT;
+        break;
+      case 'U':
+        if (inField.size == 1)
+          return qpcvPLYLayout::PROPERTY_TYPE_UCHAR;
+        if (inField.size == 2)
+          return qpcvPLYLayout::PROPERTY_TYPE_USHORT;
+        if (inField.size == 4)
+          return qpcvPLYLayout::PROPERTY_TYPE_UINT;
+        break;
+      case 'F':
+        if (inField.size == 4)
+          return qpcvPLYLayout::PROPERTY_TYPE_FLOAT;
+        if (inField.size == 8)
+          return qpcvPLYLayout::PROPERTY_TYPE_DOUBLE;
+        break;
+      default:
+        break;
+    }
+    return qpcvPLYLayout::PROPERTY_TYPE_UNKNOWN;
+  }
+  // ---------------------------------------------------------------------------
+  // setError
+  // ---------------------------------------------------------------------------
+  static bool setError(size_t inLineNum, const char *inStr, std::string *outErrorStr)
+  {
+    std::ostringstream  stream;
+    stream << "PCD line " << inLineNum << ": " << inStr;
+    *outErrorStr = stream.str();
+    return false;
+  }
+  static bool setError(const char *inStr, std::string *outErrorStr)
+  {
+    *outErrorStr = std::string("PCD: ") + inStr;
+    return false;
+  }
+};
+
+#endif  // #ifdef QPCV_PCD_DECODER_H_
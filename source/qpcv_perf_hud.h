@@ -0,0 +1,278 @@
+// =============================================================================
+//  qpcv_perf_hud.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_perf_hud.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Frame timing (CPU and GL_TIME_ELAPSED) overlay and CSV trace
+*/
+
+#ifndef QPCV_PERF_HUD_H_
+#define QPCV_PERF_HUD_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QTextStream>
+#include <QPainter>
+#include <QElapsedTimer>
+#include <QOpenGLExtraFunctions>
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+
+// -----------------------------------------------------------------------------
+// qpcvPerfHUD class
+// -----------------------------------------------------------------------------
+// beginFrame() / endFrame() are called around the scene drawing (with the GL
+// context current). The GPU time comes from a small ring of GL_TIME_ELAPSED
+// queries whose results are collected a few frames later, so the CPU never
+// waits for the GPU. Nothing is done while the HUD is disabled.
+class qpcvPerfHUD
+{
+public:
+  struct FrameRecord
+  {
+    qint64  frameNo;
+    double  timeMs;     // Since the HUD was enabled
+    double  frameMs;    // Since the previous frame
+    double  cpuMs;      // Scene drawing (CPU side)
+    double  gpuMs;      // Scene drawing (GPU side, < 0 : not available)
+    size_t  drawNum;
+    size_t  dataNum;
+    size_t  vramUsed;   // Bytes of the buffers of the view
+  };
+
+  // Constants -----------------------------------------------------------------
+  static const int  HISTORY_NUM = 4096;
+  static const int  QUERY_NUM = 4;
+  static const int  AVERAGE_NUM = 30;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvPerfHUD
+  // ---------------------------------------------------------------------------
+  qpcvPerfHUD()
+  {
+    mIsEnabled = false;
+    mFrameNo = 0;
+    mIsQueryInitialized = false;
+    for (int i = 0; i < QUERY_NUM; i++)
+    {
+      mQuery[i] = 0;
+      mQueryFrameNo[i] = -1;
+    }
+    mQueryIndex = -1;
+    mHistory.resize(HISTORY_NUM);
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // setEnabled
+  // ---------------------------------------------------------------------------
+  void  setEnabled(bool inIsEnabled)
+  {
+    if (inIsEnabled && mIsEnabled == false)
+    {
+      mFrameNo = 0;
+      mClock.start();
+    }
+    mIsEnabled = inIsEnabled;
+  }
+  // ---------------------------------------------------------------------------
+  // isEnabled
+  // ---------------------------------------------------------------------------
+  bool  isEnabled() const
+  {
+    return mIsEnabled;
+  }
+  // ---------------------------------------------------------------------------
+  // setInfoLines
+  // ---------------------------------------------------------------------------
+  // Extra lines shown below the frame timings (memory, last load etc.)
+  void  setInfoLines(const QStringList &inLines)
+  {
+    mInfoLines = inLines;
+  }
+  // ---------------------------------------------------------------------------
+  // beginFrame
+  // ---------------------------------------------------------------------------
+  void  beginFrame(QOpenGLExtraFunctions *inFunc)
+  {
+    if (mIsEnabled == false)
+      return;
+    if (mIsQueryInitialized == false)
+    {
+      inFunc->glGenQueries(QUERY_NUM, mQuery);
+      mIsQueryInitialized = true;
+    }
+    collectQueries(inFunc);
+    // Use the next query object only if its previous result was collected
+    mQueryIndex = -1;
+    int index = (int )(mFrameNo % QUERY_NUM);
+    if (mQueryFrameNo[index] < 0)
+    {
+      mQueryIndex = index;
+      mQueryFrameNo[index] = mFrameNo;
+      inFunc->glBeginQuery(GL_TIME_ELAPSED, mQuery[index]);
+    }
+    mFrameTimer.start();
+  }
+  // ---------------------------------------------------------------------------
+  // endFrame
+  // ---------------------------------------------------------------------------
+  void  endFrame(QOpenGLExtraFunctions *inFunc, size_t inDrawNum, size_t inDataNum,
+                 size_t inVRAMUsed)
+  {
+    if (mIsEnabled == false)
+      return;
+    if (mQueryIndex >= 0)
+      inFunc->glEndQuery(GL_TIME_ELAPSED);
+    FrameRecord &record = mHistory[mFrameNo % HISTORY_NUM];
+    record.frameNo = mFrameNo;
+    record.cpuMs = mFrameTimer.nsecsElapsed() / 1000000.0;
+    record.timeMs = mClock.nsecsElapsed() / 1000000.0;
+    record.frameMs = 0;
+    if (mFrameNo > 0)
+      record.frameMs = record.timeMs - mHistory[(mFrameNo - 1) % HISTORY_NUM].timeMs;
+    record.gpuMs = -1;
+    record.drawNum = inDrawNum;
+    record.dataNum = inDataNum;
+    record.vramUsed = inVRAMUsed;
+    mFrameNo++;
+  }
+  // ---------------------------------------------------------------------------
+  // draw
+  // ---------------------------------------------------------------------------
+  void  draw(QPainter *inPainter)
+  {
+    if (mIsEnabled == false || mFrameNo == 0)
+      return;
+    double  frameMs = 0, cpuMs = 0, gpuMs = 0;
+    int frameNum = 0, gpuNum = 0;
+    for (qint64 i = mFrameNo - 1; i >= 0 && i >= mFrameNo - AVERAGE_NUM; i--)
+    {
+      const FrameRecord &record = mHistory[i % HISTORY_NUM];
+      frameMs += record.frameMs;
+      cpuMs += record.cpuMs;
+      frameNum++;
+      if (record.gpuMs >= 0)
+      {
+        gpuMs += record.gpuMs;
+        gpuNum++;
+      }
+    }
+    const FrameRecord &last = mHistory[(mFrameNo - 1) % HISTORY_NUM];
+    QStringList lines;
+    lines << QString("Frame %1 ms (%2 fps)")
+               .arg(frameMs / frameNum, 0, 'f', 2)
+               .arg(frameMs > 0 ? 1000.0 * frameNum / frameMs : 0, 0, 'f', 1);
+    lines << QString("CPU %1 ms  GPU %2")
+               .arg(cpuMs / frameNum, 0, 'f', 2)
+               .arg(gpuNum == 0 ? QString("n/a") : QString("%1 ms").arg(gpuMs / gpuNum, 0, 'f', 2));
+    lines << QString("Points drawn %1 / %2").arg(last.drawNum).arg(last.dataNum);
+    lines << QString("GPU buffers %1 MB").arg(last.vramUsed / (1024.0 * 1024.0), 0, 'f', 1);
+    lines << mInfoLines;
+
+    QFontMetrics  metrics(inPainter->font());
+    int lineHeight = metrics.height();
+    int width = 0;
+    for (int i = 0; i < lines.size(); i++)
+      width = std::max(width, metrics.horizontalAdvance(lines[i]));
+    QRect rect(8, 8, width + 12, lineHeight * lines.size() + 8);
+    inPainter->fillRect(rect, QColor(0, 0, 0, 160));
+    inPainter->setPen(Qt::white);
+    for (int i = 0; i < lines.size(); i++)
+      inPainter->drawText(rect.left() + 6, rect.top() + 4 + lineHeight * i + metrics.ascent(), lines[i]);
+  }
+  // ---------------------------------------------------------------------------
+  // exportCSV
+  // ---------------------------------------------------------------------------
+  // Writes the last (up to HISTORY_NUM) frames
+  bool  exportCSV(const QString &inFileName) const
+  {
+    QFile file(inFileName);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text) == false)
+      return false;
+    QTextStream stream(&file);
+    stream << "frame,time_ms,frame_ms,cpu_ms,gpu_ms,draw_points,data_points\n";
+    qint64  begin = mFrameNo - HISTORY_NUM;
+    if (begin < 0)
+      begin = 0;
+    for (qint64 i = begin; i < mFrameNo; i++)
+    {
+      const FrameRecord &record = mHistory[i % HISTORY_NUM];
+      stream << record.frameNo << "," << record.timeMs << "," << record.frameMs << ","
+             << record.cpuMs << ",";
+      if (record.gpuMs >= 0)
+        stream << record.gpuMs;
+      stream << "," << record.drawNum << "," << record.dataNum << "\n";
+    }
+    stream.flush();
+    return (file.error() == QFile::NoError);
+  }
+  // ---------------------------------------------------------------------------
+  // release
+  // ---------------------------------------------------------------------------
+  // Call with the GL context current
+  void  release(QOpenGLExtraFunctions *inFunc)
+  {
+    if (mIsQueryInitialized == false)
+      return;
+    inFunc->glDeleteQueries(QUERY_NUM, mQuery);
+    mIsQueryInitialized = false;
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  bool  mIsEnabled;
+  qint64  mFrameNo;
+  QElapsedTimer mClock;
+  QElapsedTimer mFrameTimer;
+  std::vector<FrameRecord>  mHistory;
+  QStringList mInfoLines;
+  bool  mIsQueryInitialized;
+  GLuint  mQuery[QUERY_NUM];
+  qint64  mQueryFrameNo[QUERY_NUM];   // -1 : free
+  int mQueryIndex;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // collectQueries
+  // ---------------------------------------------------------------------------
+  // Reads the results which are available (never blocks)
+  void  collectQueries(QOpenGLExtraFunctions *inFunc)
+  {
+    for (int i = 0; i < QUERY_NUM; i++)
+    {
+      if (mQueryFrameNo[i] < 0)
+        continue;
+      GLuint  isAvailable = 0;
+      inFunc->glGetQueryObjectuiv(mQuery[i], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+      if (isAvailable == 0)
+        continue;
+      GLuint  nsec = 0;
+      inFunc->glGetQueryObjectuiv(mQuery[i], GL_QUERY_RESULT, &nsec);
+      qint64  frameNo = mQueryFrameNo[i];
+      if (frameNo > mFrameNo - HISTORY_NUM)
+        mHistory[frameNo % HISTORY_NUM].gpuMs = nsec / 1000000.0;
+      mQueryFrameNo[i] = -1;
+    }
+  }
+};
+
+#endif  // #ifdef QPCV_PERF_HUD_H_
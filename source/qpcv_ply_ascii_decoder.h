@@ -0,0 +1,562 @@
+// =============================================================================
+//  qpcv_ply_ascii_decoder.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_ply_ascii_decoder.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Multi-threaded "format ascii 1.0" PLY vertex decoder
+*/
+
+#ifndef QPCV_PLY_ASCII_DECODER_H_
+#define QPCV_PLY_ASCII_DECODER_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <sstream>
+#include <charconv>
+#include <algorithm>
+#include <mutex>
+#include <string.h>
+#include "qpcv_ply_layout.h"
+#include "qpcv_ply_decoder.h"
+#include "qpcv_parallel.h"
+#include "qpcv_bounds.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvPLYAsciiDecoder class
+// -----------------------------------------------------------------------------
+// The body is split into line aligned chunks. The newlines of all the chunks
+// are counted in parallel first, which gives the vertex index of the first line
+// of each chunk, then the chunks are parsed in parallel straight into the
+// output array.
+class qpcvPLYAsciiDecoder
+{
+public:
+  typedef qpcvPLYDecoder::ProgressFunc  ProgressFunc;
+
+  // Bodies smaller than this (per thread) are parsed on the calling thread only
+  static const size_t PARALLEL_MIN_BYTES = 4 * 1024 * 1024;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // decodeVerticesParallel
+  // ---------------------------------------------------------------------------
+  // inBody points to the first byte after end_header. inFirstLineNum is the
+  // (1 based) line number of that byte and is used for the error message only.
+  // On malformed input, outErrorStr returns the first bad line of the file.
+  // The decoded points are added to outBounds (can be NULL)
+  static bool decodeVerticesParallel(const qpcvPLYLayout &inLayout, size_t inVertexIndex,
+                                     const qpcvPLYDecoder::VertexMap &inMap,
+                                     const unsigned char *inBody, size_t inBodySize,
+                                     size_t inFirstLineNum,
+                                     ibc::gl::glXYZf_RGBAub *outData,
+                                     qpcvBounds *outBounds,
+                                     int inThreadNum,
+                                     const ProgressFunc &inProgressFunc,
+                                     std::string *outErrorStr)
+  {
+    const char  *ptr = (const char *)inBody;
+    const char  *end = ptr + inBodySize;
+    size_t  lineNum = inFirstLineNum;
+
+    // Skip the elements before the vertex element (one line per record)
+    for (size_t i = 0; i < inVertexIndex; i++)
+      if (skipLines(&ptr, end, inLayout.getElement(i).count, &lineNum) == false)
+        return setError(lineNum, "unexpected end of file", outErrorStr);
+
+    const qpcvPLYLayout::Element  &vertex = inLayout.getElement(inVertexIndex);
+    return decodeLinesParallel(vertex, inMap, ptr, end, 0, vertex.count, lineNum,
+                               outData, outBounds, inThreadNum, inProgressFunc, outErrorStr);
+  }
+  // ---------------------------------------------------------------------------
+  // decodeLinesParallel
+  // ---------------------------------------------------------------------------
+  // Parses the first inNum lines of [inPtr, inEnd) as the vertices
+  // inFirstIndex, inFirstIndex + 1 ... (qpcvPLYStreamDecoder calls this for
+  // each decompressed block). inFirstLineNum is the line number of inPtr.
+  // inProgressFunc gets the number of parsed lines
+  static bool decodeLinesParallel(const qpcvPLYLayout::Element &inVertex,
+                                  const qpcvPLYDecoder::VertexMap &inMap,
+                                  const char *inPtr, const char *inEnd,
+                                  size_t inFirstIndex, size_t inNum, size_t inFirstLineNum,
+                                  ibc::gl::glXYZf_RGBAub *outData,
+                                  qpcvBounds *outBounds,
+                                  int inThreadNum,
+                                  const ProgressFunc &inProgressFunc,
+                                  std::string *outErrorStr)
+  {
+    const char  *ptr = inPtr;
+    const char  *end = inEnd;
+    const size_t  lineNum = inFirstLineNum;
+    const size_t  vertexNum = inFirstIndex + inNum;
+    if (inNum == 0)
+      return true;
+    std::vector<int>  fieldTable;
+    makeFieldTable(inVertex, inMap, &fieldTable);
+
+    // Line aligned chunks
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, end - ptr, PARALLEL_MIN_BYTES);
+    std::vector<const char *> chunkTable;
+    makeLineChunks(ptr, end, (size_t )threadNum * 8, &chunkTable);
+    size_t  chunkNum = chunkTable.size() - 1;
+
+    // Pass 1 : count the lines of each chunk
+    std::vector<size_t> lineTable(chunkNum + 1, 0);
+    qpcvParallel::forEachRange(
+      chunkNum, threadNum, 1,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+          lineTable[i + 1] = std::count(chunkTable[i], chunkTable[i + 1], '\n');
+      });
+    for (size_t i = 0; i < chunkNum; i++)
+      lineTable[i + 1] += lineTable[i];
+    // The last line of the file may not have '\n'
+    if (lineTable[chunkNum] < inNum &&
+        !(lineTable[chunkNum] + 1 == inNum && end > ptr && end[-1] != '\n'))
+      return setError(lineNum + lineTable[chunkNum], "unexpected end of file (vertex data is too short)",
+                      outErrorStr);
+
+    // Pass 2 : parse
+    std::mutex  errorMutex;
+    size_t  errorLineNum = (size_t )-1;
+    std::string errorStr;
+    std::vector<qpcvBounds> boundsTable(threadNum);
+    bool  result = qpcvParallel::forEachRange(
+      chunkNum, threadNum, 1,
+      [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+        {
+          size_t  index = inFirstIndex + lineTable[i];
+          if (index >= vertexNum)
+            return;
+          size_t  badIndex;
+          std::string str;
+          if (parseChunk(inVertex, fieldTable, chunkTable[i], chunkTable[i + 1],
+                         index, vertexNum, outData, &badIndex, &str) == false)
+          {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (lineNum + badIndex - inFirstIndex < errorLineNum)
+            {
+              errorLineNum = lineNum + badIndex - inFirstIndex;
+              errorStr = str;
+            }
+            return;
+          }
+          size_t  indexEnd = inFirstIndex + lineTable[i + 1];
+          if (indexEnd > vertexNum || i + 1 == chunkNum)
+            indexEnd = vertexNum;
+          boundsTable[inThreadIndex].add(outData + index, indexEnd - index);
+        }
+      },
+      [&](size_t inDoneNum)
+      {
+        if (!inProgressFunc)
+          return true;
+        return inProgressFunc(inNum * inDoneNum / chunkNum);
+      });
+    if (errorLineNum != (size_t )-1)
+      return setError(errorLineNum, errorStr.c_str(), outErrorStr);
+    if (outBounds != NULL)
+      for (size_t i = 0; i < boundsTable.size(); i++)
+        outBounds->merge(boundsTable[i]);
+    return result;
+  }
+
+  // ---------------------------------------------------------------------------
+  // decodeColumnParallel
+  // ---------------------------------------------------------------------------
+  // One scalar property (inPropertyIndex of the vertex element) of every
+  // vertex into outValues (vertex.count floats). The values before it are
+  // skipped without conversion and the rest of each line is not read (the
+  // loader has validated the lines). The arguments are the ones of
+  // decodeVerticesParallel()
+  static bool decodeColumnParallel(const qpcvPLYLayout &inLayout, size_t inVertexIndex,
+                                   size_t inPropertyIndex,
+                                   const unsigned char *inBody, size_t inBodySize,
+                                   size_t inFirstLineNum,
+                                   float *outValues,
+                                   int inThreadNum,
+                                   const ProgressFunc &inProgressFunc,
+                                   std::string *outErrorStr)
+  {
+    const char  *ptr = (const char *)inBody;
+    const char  *end = ptr + inBodySize;
+    size_t  lineNum = inFirstLineNum;
+    for (size_t i = 0; i < inVertexIndex; i++)
+      if (skipLines(&ptr, end, inLayout.getElement(i).count, &lineNum) == false)
+        return setError(lineNum, "unexpected end of file", outErrorStr);
+
+    const qpcvPLYLayout::Element  &vertex = inLayout.getElement(inVertexIndex);
+    const size_t  vertexNum = vertex.count;
+    if (vertexNum == 0)
+      return true;
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, end - ptr, PARALLEL_MIN_BYTES);
+    std::vector<const char *> chunkTable;
+    makeLineChunks(ptr, end, (size_t )threadNum * 8, &chunkTable);
+    size_t  chunkNum = chunkTable.size() - 1;
+
+    // Pass 1 : count the lines of each chunk
+    std::vector<size_t> lineTable(chunkNum + 1, 0);
+    qpcvParallel::forEachRange(
+      chunkNum, threadNum, 1,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+          lineTable[i + 1] = std::count(chunkTable[i], chunkTable[i + 1], '\n');
+      });
+    for (size_t i = 0; i < chunkNum; i++)
+      lineTable[i + 1] += lineTable[i];
+    if (lineTable[chunkNum] < vertexNum &&
+        !(lineTable[chunkNum] + 1 == vertexNum && end > ptr && end[-1] != '\n'))
+      return setError(lineNum + lineTable[chunkNum], "unexpected end of file (vertex data is too short)",
+                      outErrorStr);
+
+    // Pass 2 : parse the column
+    std::mutex  errorMutex;
+    size_t  errorLineNum = (size_t )-1;
+    std::string errorStr;
+    bool  result = qpcvParallel::forEachRange(
+      chunkNum, threadNum, 1,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+        {
+          size_t  index = lineTable[i];
+          if (index >= vertexNum)
+            return;
+          size_t  badIndex;
+          std::string str;
+          if (parseColumnChunk(vertex, inPropertyIndex, chunkTable[i], chunkTable[i + 1],
+                               index, vertexNum, outValues, &badIndex, &str) == false)
+          {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (lineNum + badIndex < errorLineNum)
+            {
+              errorLineNum = lineNum + badIndex;
+              errorStr = str;
+            }
+            return;
+          }
+        }
+      },
+      [&](size_t inDoneNum)
+      {
+        if (!inProgressFunc)
+          return true;
+        return inProgressFunc(vertexNum * inDoneNum / chunkNum);
+      });
+    if (errorLineNum != (size_t )-1)
+      return setError(errorLineNum, errorStr.c_str(), outErrorStr);
+    return result;
+  }
+
+protected:
+  // qpcvPLYFaceDecoder, qpcvTextDecoder and qpcvPLYStreamDecoder share the
+  // line splitting and the error message (and the face decoder the value parser)
+  friend class qpcvPLYFaceDecoder;
+  friend class qpcvTextDecoder;
+  friend class qpcvPLYStreamDecoder;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // skipLines
+  // ---------------------------------------------------------------------------
+  // Skips inNum lines (one record each). ioLineNum is advanced by the number
+  // of skipped lines. Fails at the end of the data
+  static bool skipLines(const char **ioPtr, const char *inEnd, size_t inNum, size_t *ioLineNum)
+  {
+    const char  *ptr = *ioPtr;
+    for (size_t i = 0; i < inNum; i++)
+    {
+      const char  *lineEnd = (const char *)memchr(ptr, '\n', inEnd - ptr);
+      if (lineEnd == NULL)
+      {
+        *ioPtr = ptr;
+        return false;
+      }
+      ptr = lineEnd + 1;
+      (*ioLineNum)++;
+    }
+    *ioPtr = ptr;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // makeLineChunks
+  // ---------------------------------------------------------------------------
+  // Splits [inPtr, inEnd) into at most inChunkNum line aligned chunks of about
+  // the same size. outChunkTable returns the start of each chunk followed by inEnd
+  static void makeLineChunks(const char *inPtr, const char *inEnd, size_t inChunkNum,
+                             std::vector<const char *> *outChunkTable)
+  {
+    size_t  chunkSize = (inEnd - inPtr) / inChunkNum + 1;
+    outChunkTable->clear();
+    outChunkTable->push_back(inPtr);
+    for (size_t i = 1; i < inChunkNum; i++)
+    {
+      const char  *pos = outChunkTable->back() + chunkSize;
+      if (pos >= inEnd)
+        break;
+      const char  *lineEnd = (const char *)memchr(pos, '\n', inEnd - pos);
+      if (lineEnd == NULL || lineEnd + 1 >= inEnd)
+        break;
+      outChunkTable->push_back(lineEnd + 1);
+    }
+    outChunkTable->push_back(inEnd);
+  }
+  // ---------------------------------------------------------------------------
+  // makeFieldTable
+  // ---------------------------------------------------------------------------
+  // VertexField of each property (-1 : not used)
+  static void makeFieldTable(const qpcvPLYLayout::Element &inElement,
+                             const qpcvPLYDecoder::VertexMap &inMap,
+                             std::vector<int> *outTable)
+  {
+    outTable->assign(inElement.properties.size(), -1);
+    for (int i = 0; i < qpcvPLYDecoder::VERTEX_FIELD_NUM; i++)
+    {
+      if (inMap.isValid[i] == false)
+        continue;
+      if (i >= qpcvPLYDecoder::VERTEX_FIELD_R && inMap.hasColor == false)
+        continue;
+      (*outTable)[inMap.propertyIndex[i]] = i;
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // parseChunk
+  // ---------------------------------------------------------------------------
+  // Parses the lines in [inPtr, inEnd) as vertices inIndex, inIndex + 1, ...
+  // (stops at inVertexNum). outBadIndex returns the line offset from the top
+  // of the vertex data on error
+  static bool parseChunk(const qpcvPLYLayout::Element &inElement,
+                         const std::vector<int> &inFieldTable,
+                         const char *inPtr, const char *inEnd,
+                         size_t inIndex, size_t inVertexNum,
+                         ibc::gl::glXYZf_RGBAub *outData,
+                         size_t *outBadIndex, std::string *outErrorStr)
+  {
+    const char  *ptr = inPtr;
+    size_t  propertyNum = inElement.properties.size();
+
+    for (size_t index = inIndex; index < inVertexNum && ptr < inEnd; index++)
+    {
+      const char  *lineEnd = (const char *)memchr(ptr, '\n', inEnd - ptr);
+      if (lineEnd == NULL)
+        lineEnd = inEnd;
+      ibc::gl::glXYZf_RGBAub  &out = outData[index];
+      out.r = 255;
+      out.g = 255;
+      out.b = 255;
+      out.a = 255;
+      for (size_t j = 0; j < propertyNum; j++)
+      {
+        const qpcvPLYLayout::Property &property = inElement.properties[j];
+        if (property.isList)
+        {
+          double  count;
+          if (parseValue(property.listCountType, &ptr, lineEnd, &count) == false || count < 0)
+            return parseError(index, property, outBadIndex, outErrorStr);
+          for (size_t k = 0; k < (size_t )count; k++)
+          {
+            double  dummy;
+            if (parseValue(property.type, &ptr, lineEnd, &dummy) == false)
+              return parseError(index, property, outBadIndex, outErrorStr);
+          }
+          continue;
+        }
+        double  value;
+        if (parseValue(property.type, &ptr, lineEnd, &value) == false)
+          return parseError(index, property, outBadIndex, outErrorStr);
+        switch (inFieldTable[j])
+        {
+          case qpcvPLYDecoder::VERTEX_FIELD_X:
+            out.x = (GLfloat )value;
+            break;
+          case qpcvPLYDecoder::VERTEX_FIELD_Y:
+            out.y = (GLfloat )value;
+            break;
+          case qpcvPLYDecoder::VERTEX_FIELD_Z:
+            out.z = (GLfloat )value;
+            break;
+          case qpcvPLYDecoder::VERTEX_FIELD_R:
+            out.r = convertColor(property.type, value);
+            break;
+          case qpcvPLYDecoder::VERTEX_FIELD_G:
+            out.g = convertColor(property.type, value);
+            break;
+          case qpcvPLYDecoder::VERTEX_FIELD_B:
+            out.b = convertColor(property.type, value);
+            break;
+          case qpcvPLYDecoder::VERTEX_FIELD_A:
+            out.a = convertColor(property.type, value);
+            break;
+          default:
+            break;
+        }
+      }
+      skipSpace(&ptr, lineEnd);
+      if (ptr != lineEnd)
+      {
+        *outBadIndex = index;
+        *outErrorStr = "too many values in the vertex line";
+        return false;
+      }
+      ptr = lineEnd + 1;
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // parseColumnChunk
+  // ---------------------------------------------------------------------------
+  // parseChunk() for the property inPropertyIndex only
+  static bool parseColumnChunk(const qpcvPLYLayout::Element &inElement, size_t inPropertyIndex,
+                               const char *inPtr, const char *inEnd,
+                               size_t inIndex, size_t inVertexNum,
+                               float *outValues,
+                               size_t *outBadIndex, std::string *outErrorStr)
+  {
+    const char  *ptr = inPtr;
+    const qpcvPLYLayout::Property &column = inElement.properties[inPropertyIndex];
+
+    for (size_t index = inIndex; index < inVertexNum && ptr < inEnd; index++)
+    {
+      const char  *lineEnd = (const char *)memchr(ptr, '\n', inEnd - ptr);
+      if (lineEnd == NULL)
+        lineEnd = inEnd;
+      for (size_t j = 0; j < inPropertyIndex; j++)
+      {
+        const qpcvPLYLayout::Property &property = inElement.properties[j];
+        size_t  tokenNum = 1;
+        if (property.isList)
+        {
+          double  count;
+          if (parseValue(property.listCountType, &ptr, lineEnd, &count) == false || count < 0)
+            return parseError(index, property, outBadIndex, outErrorStr);
+          tokenNum = (size_t )count;
+        }
+        for (size_t k = 0; k < tokenNum; k++)
+          if (skipToken(&ptr, lineEnd) == false)
+            return parseError(index, property, outBadIndex, outErrorStr);
+      }
+      double  value;
+      if (parseValue(column.type, &ptr, lineEnd, &value) == false)
+        return parseError(index, column, outBadIndex, outErrorStr);
+      outValues[index] = (float )value;
+      ptr = lineEnd + 1;
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // skipToken
+  // ---------------------------------------------------------------------------
+  // false when the line has no more values
+  static bool skipToken(const char **ioPtr, const char *inLineEnd)
+  {
+    skipSpace(ioPtr, inLineEnd);
+    const char  *ptr = *ioPtr;
+    if (ptr == inLineEnd)
+      return false;
+    while (ptr < inLineEnd && isSpace(*ptr) == false)
+      ptr++;
+    *ioPtr = ptr;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // parseValue
+  // ---------------------------------------------------------------------------
+  static bool parseValue(qpcvPLYLayout::PropertyType inType,
+                         const char **ioPtr, const char *inLineEnd, double *outValue)
+  {
+    skipSpace(ioPtr, inLineEnd);
+    const char  *ptr = *ioPtr;
+    if (ptr < inLineEnd && *ptr == '+')   // std::from_chars() does not accept '+'
+      ptr++;
+    std::from_chars_result  result;
+    if (inType == qpcvPLYLayout::PROPERTY_TYPE_FLOAT)
+    {
+      float value;
+      result = std::from_chars(ptr, inLineEnd, value);
+      *outValue = value;
+    }
+    else
+      result = std::from_chars(ptr, inLineEnd, *outValue);
+    if (result.ec != std::errc() || result.ptr == ptr)
+      return false;
+    if (result.ptr != inLineEnd && isSpace(*result.ptr) == false)
+      return false;
+    *ioPtr = result.ptr;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // skipSpace
+  // ---------------------------------------------------------------------------
+  static void skipSpace(const char **ioPtr, const char *inLineEnd)
+  {
+    const char  *ptr = *ioPtr;
+    while (ptr < inLineEnd && isSpace(*ptr))
+      ptr++;
+    *ioPtr = ptr;
+  }
+  // ---------------------------------------------------------------------------
+  // isSpace
+  // ---------------------------------------------------------------------------
+  static bool isSpace(char inChar)
+  {
+    return (inChar == ' ' || inChar == '\t' || inChar == '\r');
+  }
+  // ---------------------------------------------------------------------------
+  // convertColor
+  // ---------------------------------------------------------------------------
+  // Same conversion as qpcvPLYDecoder::readColor()
+  static GLubyte  convertColor(qpcvPLYLayout::PropertyType inType, double inValue)
+  {
+    switch (inType)
+    {
+      case qpcvPLYLayout::PROPERTY_TYPE_USHORT:
+        return qpcvPLYDecoder::clampColor((double )(((unsigned int )inValue) >> 8));
+      case qpcvPLYLayout::PROPERTY_TYPE_FLOAT:
+      case qpcvPLYLayout::PROPERTY_TYPE_DOUBLE:
+        return qpcvPLYDecoder::clampColor(inValue * 255.0 + 0.5);
+      default:
+        break;
+    }
+    return qpcvPLYDecoder::clampColor(inValue);
+  }
+  // ---------------------------------------------------------------------------
+  // parseError
+  // ---------------------------------------------------------------------------
+  static bool parseError(size_t inIndex, const qpcvPLYLayout::Property &inProperty,
+                         size_t *outBadIndex, std::string *outErrorStr)
+  {
+    *outBadIndex = inIndex;
+    *outErrorStr = "malformed or missing value for property \"" + inProperty.name + "\"";
+    return false;
+  }
+  // ---------------------------------------------------------------------------
+  // setError
+  // ---------------------------------------------------------------------------
+  static bool setError(size_t inLineNum, const char *inStr, std::string *outErrorStr)
+  {
+    std::ostringstream  stream;
+    stream << "PLY line " << inLineNum << ": " << inStr;
+    *outErrorStr = stream.str();
+    return false;
+  }
+};
+
+#endif  // #ifdef QPCV_PLY_ASCII_DECODER_H_
@@ -0,0 +1,475 @@
+// =============================================================================
+//  qpcv_ply_decoder.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_ply_decoder.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    PLY vertex decoder working directly on a memory block
+*/
+
+#ifndef QPCV_PLY_DECODER_H_
+#define QPCV_PLY_DECODER_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <functional>
+#include <stdint.h>
+#include <string.h>
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+#include "qpcv_ply_layout.h"
+#include "qpcv_parallel.h"
+#include "qpcv_bounds.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvPLYDecoder class
+// -----------------------------------------------------------------------------
+class qpcvPLYDecoder
+{
+public:
+  // Called with the number of decoded vertices. Return false to cancel
+  typedef std::function<bool(size_t inDoneNum)> ProgressFunc;
+
+  // Files with less vertices than this are decoded on the calling thread only
+  static const size_t PARALLEL_MIN_VERTEX_NUM = 256 * 1024;
+
+  enum  VertexField
+  {
+    VERTEX_FIELD_X  = 0,
+    VERTEX_FIELD_Y,
+    VERTEX_FIELD_Z,
+    VERTEX_FIELD_R,
+    VERTEX_FIELD_G,
+    VERTEX_FIELD_B,
+    VERTEX_FIELD_A,
+    VERTEX_FIELD_NUM
+  };
+
+  // Where each glXYZf_RGBAub field comes from in the vertex record
+  struct VertexMap
+  {
+    bool  isValid[VERTEX_FIELD_NUM];
+    qpcvPLYLayout::PropertyType type[VERTEX_FIELD_NUM];
+    size_t  offset[VERTEX_FIELD_NUM];
+    size_t  propertyIndex[VERTEX_FIELD_NUM];
+    size_t  recordSize;
+    bool  hasColor;
+  };
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // prepareVertexMap
+  // ---------------------------------------------------------------------------
+  static bool prepareVertexMap(const qpcvPLYLayout::Element &inElement, VertexMap *outMap)
+  {
+    static const char *nameTable[VERTEX_FIELD_NUM][3] =
+    {
+      {"x", "x", "x"},
+      {"y", "y", "y"},
+      {"z", "z", "z"},
+      {"red",   "diffuse_red",   "r"},
+      {"green", "diffuse_green", "g"},
+      {"blue",  "diffuse_blue",  "b"},
+      {"alpha", "diffuse_alpha", "a"}
+    };
+
+    for (int i = 0; i < VERTEX_FIELD_NUM; i++)
+    {
+      outMap->isValid[i] = false;
+      outMap->type[i] = qpcvPLYLayout::PROPERTY_TYPE_UNKNOWN;
+      outMap->offset[i] = 0;
+      outMap->propertyIndex[i] = 0;
+      for (int j = 0; j < 3; j++)
+      {
+        size_t  index;
+        if (qpcvPLYLayout::findPropertyIndex(inElement, nameTable[i][j], &index) == false)
+          continue;
+        const qpcvPLYLayout::Property &property = inElement.properties[index];
+        if (property.isList)
+          return false;
+        outMap->isValid[i] = true;
+        outMap->type[i] = property.type;
+        outMap->offset[i] = property.offset;
+        outMap->propertyIndex[i] = index;
+        break;
+      }
+    }
+    if (outMap->isValid[VERTEX_FIELD_X] == false ||
+        outMap->isValid[VERTEX_FIELD_Y] == false ||
+        outMap->isValid[VERTEX_FIELD_Z] == false)
+      return false;
+    outMap->hasColor = (outMap->isValid[VERTEX_FIELD_R] &&
+                        outMap->isValid[VERTEX_FIELD_G] &&
+                        outMap->isValid[VERTEX_FIELD_B]);
+    outMap->recordSize = inElement.recordSize;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // getColorFormatStr
+  // ---------------------------------------------------------------------------
+  static std::string  getColorFormatStr(const qpcvPLYLayout::Element &inElement,
+                                        const VertexMap &inMap)
+  {
+    std::string str;
+    if (inMap.hasColor == false)
+      return str;
+    for (int i = VERTEX_FIELD_R; i < VERTEX_FIELD_NUM; i++)
+    {
+      if (inMap.isValid[i] == false)
+        continue;
+      const qpcvPLYLayout::Property &property = inElement.properties[inMap.propertyIndex[i]];
+      if (str.size() != 0)
+        str += ", ";
+      str += property.name + " (" + qpcvPLYLayout::getPropertyTypeStr(property.type) + ")";
+    }
+    return str;
+  }
+  // ---------------------------------------------------------------------------
+  // isDirectLayout
+  // ---------------------------------------------------------------------------
+  // true when the on-disk vertex records are bit-identical to glXYZf_RGBAub,
+  // i.e. float x, y, z followed by uchar red, green, blue, alpha in host byte order
+  static bool isDirectLayout(const qpcvPLYLayout &inLayout, const qpcvPLYLayout::Element &inElement)
+  {
+    static const char *nameTable[] = {"x", "y", "z", "red", "green", "blue", "alpha"};
+    static const qpcvPLYLayout::PropertyType  typeTable[] =
+    {
+      qpcvPLYLayout::PROPERTY_TYPE_FLOAT,
+      qpcvPLYLayout::PROPERTY_TYPE_FLOAT,
+      qpcvPLYLayout::PROPERTY_TYPE_FLOAT,
+      qpcvPLYLayout::PROPERTY_TYPE_UCHAR,
+      qpcvPLYLayout::PROPERTY_TYPE_UCHAR,
+      qpcvPLYLayout::PROPERTY_TYPE_UCHAR,
+      qpcvPLYLayout::PROPERTY_TYPE_UCHAR
+    };
+
+    if (inLayout.isBinary() == false || inLayout.needsByteSwap())
+      return false;
+    if (inElement.properties.size() != 7 ||
+        inElement.recordSize != sizeof(ibc::gl::glXYZf_RGBAub))
+      return false;
+    for (size_t i = 0; i < 7; i++)
+      if (inElement.properties[i].name != nameTable[i] ||
+          inElement.properties[i].type != typeTable[i] ||
+          inElement.properties[i].isList)
+        return false;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeBinaryVertices
+  // ---------------------------------------------------------------------------
+  // Decodes [inBegin, inEnd) records. inRecords points to the first vertex record.
+  // The output is written to outData[inBegin] ... outData[inEnd - 1].
+  // The decoded points are added to outBounds (can be NULL)
+  static bool decodeBinaryVertices(const VertexMap &inMap, const unsigned char *inRecords,
+                                   bool inSwap, size_t inBegin, size_t inEnd,
+                                   ibc::gl::glXYZf_RGBAub *outData,
+                                   qpcvBounds *outBounds,
+                                   const ProgressFunc &inProgressFunc = ProgressFunc())
+  {
+    const size_t  blockNum = 1024 * 1024;
+    for (size_t block = inBegin; block < inEnd; block += blockNum)
+    {
+      size_t  blockEnd = block + blockNum;
+      if (blockEnd > inEnd)
+        blockEnd = inEnd;
+      decodeBinaryRange(inMap, inRecords, inSwap, block, blockEnd, outData, outBounds);
+      if (inProgressFunc && inProgressFunc(blockEnd - inBegin) == false)
+        return false;
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeBinaryVerticesParallel
+  // ---------------------------------------------------------------------------
+  // Binary records have a fixed size, so [0, inNum) is split evenly over the
+  // threads. inThreadNum <= 0 uses all cores. Small files fall back to
+  // decodeBinaryVertices(). inProgressFunc is called from the calling thread only
+  static bool decodeBinaryVerticesParallel(const VertexMap &inMap, const unsigned char *inRecords,
+                                           bool inSwap, size_t inNum,
+                                           ibc::gl::glXYZf_RGBAub *outData,
+                                           qpcvBounds *outBounds,
+                                           int inThreadNum,
+                                           const ProgressFunc &inProgressFunc = ProgressFunc())
+  {
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, inNum, PARALLEL_MIN_VERTEX_NUM);
+    if (threadNum <= 1)
+      return decodeBinaryVertices(inMap, inRecords, inSwap, 0, inNum, outData, outBounds, inProgressFunc);
+    std::vector<qpcvBounds> boundsTable(threadNum);
+    bool  result = qpcvParallel::forEachRange(
+              inNum, threadNum, 256 * 1024,
+              [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+              {
+                decodeBinaryRange(inMap, inRecords, inSwap, inBegin, inEnd, outData,
+                                  &(boundsTable[inThreadIndex]));
+              },
+              inProgressFunc);
+    if (outBounds != NULL)
+      for (size_t i = 0; i < boundsTable.size(); i++)
+        outBounds->merge(boundsTable[i]);
+    return result;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeBinaryRange
+  // ---------------------------------------------------------------------------
+  // Picks a specialized loop for the common layouts (x, y, z of the same
+  // float / double type with no or uchar colors) and the generic one otherwise.
+  // The range is processed in small sub blocks, so the bounds are computed
+  // while the decoded points still are in the cache
+  static void decodeBinaryRange(const VertexMap &inMap, const unsigned char *inRecords,
+                                bool inSwap, size_t inBegin, size_t inEnd,
+                                ibc::gl::glXYZf_RGBAub *outData,
+                                qpcvBounds *outBounds)
+  {
+    const size_t  SUB_BLOCK_NUM = 4096;   // 64KB of output
+    for (size_t block = inBegin; block < inEnd; block += SUB_BLOCK_NUM)
+    {
+      size_t  blockEnd = block + SUB_BLOCK_NUM;
+      if (blockEnd > inEnd)
+        blockEnd = inEnd;
+      decodeBinarySubBlock(inMap, inRecords, inSwap, block, blockEnd, outData);
+      if (outBounds != NULL)
+        outBounds->add(outData + block, blockEnd - block);
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // decodeBinarySubBlock
+  // ---------------------------------------------------------------------------
+  static void decodeBinarySubBlock(const VertexMap &inMap, const unsigned char *inRecords,
+                                   bool inSwap, size_t inBegin, size_t inEnd,
+                                   ibc::gl::glXYZf_RGBAub *outData)
+  {
+    qpcvPLYLayout::PropertyType type = inMap.type[VERTEX_FIELD_X];
+    bool  isFast = (inMap.type[VERTEX_FIELD_Y] == type && inMap.type[VERTEX_FIELD_Z] == type);
+    if (inMap.hasColor)
+      for (int i = VERTEX_FIELD_R; i < VERTEX_FIELD_NUM; i++)
+        if (inMap.isValid[i] && inMap.type[i] != qpcvPLYLayout::PROPERTY_TYPE_UCHAR)
+          isFast = false;
+    if (isFast && type == qpcvPLYLayout::PROPERTY_TYPE_FLOAT)
+    {
+      if (inSwap)
+        decodeBinaryRangeFast<float, uint32_t, true>(inMap, inRecords, inBegin, inEnd, outData);
+      else
+        decodeBinaryRangeFast<float, uint32_t, false>(inMap, inRecords, inBegin, inEnd, outData);
+      return;
+    }
+    if (isFast && type == qpcvPLYLayout::PROPERTY_TYPE_DOUBLE)
+    {
+      if (inSwap)
+        decodeBinaryRangeFast<double, uint64_t, true>(inMap, inRecords, inBegin, inEnd, outData);
+      else
+        decodeBinaryRangeFast<double, uint64_t, false>(inMap, inRecords, inBegin, inEnd, outData);
+      return;
+    }
+    const unsigned char *ptr = inRecords + inBegin * inMap.recordSize;
+    for (size_t i = inBegin; i < inEnd; i++, ptr += inMap.recordSize)
+      decodeBinaryVertex(inMap, ptr, inSwap, &(outData[i]));
+  }
+  // ---------------------------------------------------------------------------
+  // decodeBinaryRangeFast
+  // ---------------------------------------------------------------------------
+  // T is the position type and U the unsigned integer of the same size.
+  // All the branches are resolved at compile time, so the compiler can turn
+  // the byte swaps into bswap / byte shuffle instructions
+  template <typename T, typename U, bool SWAP>
+  static void decodeBinaryRangeFast(const VertexMap &inMap, const unsigned char *inRecords,
+                                    size_t inBegin, size_t inEnd,
+                                    ibc::gl::glXYZf_RGBAub *outData)
+  {
+    const size_t  recordSize = inMap.recordSize;
+    const size_t  xOffset = inMap.offset[VERTEX_FIELD_X];
+    const size_t  yOffset = inMap.offset[VERTEX_FIELD_Y];
+    const size_t  zOffset = inMap.offset[VERTEX_FIELD_Z];
+    const unsigned char *ptr = inRecords + inBegin * recordSize;
+    ibc::gl::glXYZf_RGBAub  *out = outData + inBegin;
+    const size_t  num = inEnd - inBegin;
+
+    for (size_t i = 0; i < num; i++, ptr += recordSize)
+    {
+      out[i].x = (GLfloat )loadFast<T, U, SWAP>(ptr + xOffset);
+      out[i].y = (GLfloat )loadFast<T, U, SWAP>(ptr + yOffset);
+      out[i].z = (GLfloat )loadFast<T, U, SWAP>(ptr + zOffset);
+    }
+    if (inMap.hasColor == false)
+    {
+      for (size_t i = 0; i < num; i++)
+      {
+        out[i].r = 255;
+        out[i].g = 255;
+        out[i].b = 255;
+        out[i].a = 255;
+      }
+      return;
+    }
+    const size_t  rOffset = inMap.offset[VERTEX_FIELD_R];
+    const size_t  gOffset = inMap.offset[VERTEX_FIELD_G];
+    const size_t  bOffset = inMap.offset[VERTEX_FIELD_B];
+    const size_t  aOffset = inMap.offset[VERTEX_FIELD_A];
+    const bool  hasAlpha = inMap.isValid[VERTEX_FIELD_A];
+    ptr = inRecords + inBegin * recordSize;
+    for (size_t i = 0; i < num; i++, ptr += recordSize)
+    {
+      out[i].r = ptr[rOffset];
+      out[i].g = ptr[gOffset];
+      out[i].b = ptr[bOffset];
+      out[i].a = hasAlpha ? ptr[aOffset] : 255;
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // decodeBinaryVertex
+  // ---------------------------------------------------------------------------
+  static void decodeBinaryVertex(const VertexMap &inMap, const unsigned char *inRecord,
+                                 bool inSwap, ibc::gl::glXYZf_RGBAub *outVertex)
+  {
+    outVertex->x = (GLfloat )readValue(inMap.type[VERTEX_FIELD_X], inRecord + inMap.offset[VERTEX_FIELD_X], inSwap);
+    outVertex->y = (GLfloat )readValue(inMap.type[VERTEX_FIELD_Y], inRecord + inMap.offset[VERTEX_FIELD_Y], inSwap);
+    outVertex->z = (GLfloat )readValue(inMap.type[VERTEX_FIELD_Z], inRecord + inMap.offset[VERTEX_FIELD_Z], inSwap);
+    if (inMap.hasColor == false)
+    {
+      outVertex->r = 255;
+      outVertex->g = 255;
+      outVertex->b = 255;
+      outVertex->a = 255;
+      return;
+    }
+    outVertex->r = readColor(inMap.type[VERTEX_FIELD_R], inRecord + inMap.offset[VERTEX_FIELD_R], inSwap);
+    outVertex->g = readColor(inMap.type[VERTEX_FIELD_G], inRecord + inMap.offset[VERTEX_FIELD_G], inSwap);
+    outVertex->b = readColor(inMap.type[VERTEX_FIELD_B], inRecord + inMap.offset[VERTEX_FIELD_B], inSwap);
+    if (inMap.isValid[VERTEX_FIELD_A])
+      outVertex->a = readColor(inMap.type[VERTEX_FIELD_A], inRecord + inMap.offset[VERTEX_FIELD_A], inSwap);
+    else
+      outVertex->a = 255;
+  }
+  // ---------------------------------------------------------------------------
+  // readValue
+  // ---------------------------------------------------------------------------
+  static double readValue(qpcvPLYLayout::PropertyType inType, const unsigned char *inPtr, bool inSwap)
+  {
+    switch (inType)
+    {
+      case qpcvPLYLayout::PROPERTY_TYPE_CHAR:
+        return (double )(*((const int8_t *)inPtr));
+      case qpcvPLYLayout::PROPERTY_TYPE_UCHAR:
+        return (double )(*inPtr);
+      case qpcvPLYLayout::PROPERTY_TYPE_SHORT:
+        return (double )load<int16_t>(inPtr, inSwap);
+      case qpcvPLYLayout::PROPERTY_TYPE_USHORT:
+        return (double )load<uint16_t>(inPtr, inSwap);
+      case qpcvPLYLayout::PROPERTY_TYPE_INT:
+        return (double )load<int32_t>(inPtr, inSwap);
+      case qpcvPLYLayout::PROPERTY_TYPE_UINT:
+        return (double )load<uint32_t>(inPtr, inSwap);
+      case qpcvPLYLayout::PROPERTY_TYPE_FLOAT:
+        return (double )load<float>(inPtr, inSwap);
+      case qpcvPLYLayout::PROPERTY_TYPE_DOUBLE:
+        return load<double>(inPtr, inSwap);
+      default:
+        break;
+    }
+    return 0;
+  }
+  // ---------------------------------------------------------------------------
+  // readColor
+  // ---------------------------------------------------------------------------
+  // Integer colors wider than 8 bits are narrowed by dropping the low bits,
+  // float colors are expected in the [0, 1] range
+  static GLubyte  readColor(qpcvPLYLayout::PropertyType inType, const unsigned char *inPtr, bool inSwap)
+  {
+    switch (inType)
+    {
+      case qpcvPLYLayout::PROPERTY_TYPE_UCHAR:
+        return *inPtr;
+      case qpcvPLYLayout::PROPERTY_TYPE_USHORT:
+        return (GLubyte )(load<uint16_t>(inPtr, inSwap) >> 8);
+      case qpcvPLYLayout::PROPERTY_TYPE_FLOAT:
+      case qpcvPLYLayout::PROPERTY_TYPE_DOUBLE:
+        return clampColor(readValue(inType, inPtr, inSwap) * 255.0 + 0.5);
+      default:
+        break;
+    }
+    return clampColor(readValue(inType, inPtr, inSwap));
+  }
+  // ---------------------------------------------------------------------------
+  // clampColor
+  // ---------------------------------------------------------------------------
+  static GLubyte  clampColor(double inValue)
+  {
+    if (inValue <= 0)
+      return 0;
+    if (inValue >= 255)
+      return 255;
+    return (GLubyte )inValue;
+  }
+  // ---------------------------------------------------------------------------
+  // loadFast
+  // ---------------------------------------------------------------------------
+  template <typename T, typename U, bool SWAP> static T  loadFast(const unsigned char *inPtr)
+  {
+    U bits;
+    memcpy(&bits, inPtr, sizeof(U));
+    if (SWAP)
+      bits = swapBytes(bits);
+    T value;
+    memcpy(&value, &bits, sizeof(T));
+    return value;
+  }
+  // ---------------------------------------------------------------------------
+  // swapBytes
+  // ---------------------------------------------------------------------------
+  static uint32_t swapBytes(uint32_t inValue)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap32(inValue);
+#elif defined(_MSC_VER)
+    return _byteswap_ulong(inValue);
+#else
+    return ((inValue >> 24) & 0xFF) | ((inValue >> 8) & 0xFF00) |
+           ((inValue << 8) & 0xFF0000) | (inValue << 24);
+#endif
+  }
+  static uint64_t swapBytes(uint64_t inValue)
+  {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap64(inValue);
+#elif defined(_MSC_VER)
+    return _byteswap_uint64(inValue);
+#else
+    return ((uint64_t )swapBytes((uint32_t )inValue) << 32) |
+           swapBytes((uint32_t )(inValue >> 32));
+#endif
+  }
+  // ---------------------------------------------------------------------------
+  // load
+  // ---------------------------------------------------------------------------
+  // memcpy() is used since the records are not aligned in general
+  template <typename T> static T  load(const unsigned char *inPtr, bool inSwap)
+  {
+    T value;
+    if (inSwap == false)
+    {
+      memcpy(&value, inPtr, sizeof(T));
+      return value;
+    }
+    unsigned char buf[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); i++)
+      buf[i] = inPtr[sizeof(T) - 1 - i];
+    memcpy(&value, buf, sizeof(T));
+    return value;
+  }
+};
+
+#endif  // #ifdef QPCV_PLY_DECODER_H_
@@ -0,0 +1,637 @@
+// =============================================================================
+//  qpcv_ply_face_decoder.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_ply_face_decoder.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    PLY face decoder producing 32 bit triangle index buffers
+*/
+
+#ifndef QPCV_PLY_FACE_DECODER_H_
+#define QPCV_PLY_FACE_DECODER_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <sstream>
+#include <mutex>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include "qpcv_ply_layout.h"
+#include "qpcv_ply_decoder.h"
+#include "qpcv_ply_ascii_decoder.h"
+#include "qpcv_parallel.h"
+
+// -----------------------------------------------------------------------------
+// qpcvPLYFaceDecoder class
+// -----------------------------------------------------------------------------
+// Decodes the vertex_indices list of the face element into a triangle list
+// (polygons are split into fans, faces with less than 3 vertices are dropped).
+// Binary files are first tried as all-triangle files: the records then have a
+// fixed size and are decoded in parallel in a single pass, which also checks
+// that every list has 3 entries. Otherwise one sequential pass over the list
+// lengths finds where each chunk of faces starts and how many triangles it
+// makes, and the chunks are decoded in parallel. Every index is checked
+// against the vertex number, so the result is safe to draw.
+class qpcvPLYFaceDecoder
+{
+public:
+  typedef qpcvPLYDecoder::ProgressFunc  ProgressFunc;   // inDoneNum : faces
+
+  // Files with less faces than this are decoded on the calling thread only
+  static const size_t PARALLEL_MIN_FACE_NUM = 256 * 1024;
+  // Faces per chunk of the polygon (variable size record) path
+  static const size_t CHUNK_FACE_NUM = 64 * 1024;
+
+  // Where the vertex index list is in the face record
+  struct FaceMap
+  {
+    size_t  listIndex;    // Property index of vertex_indices
+    qpcvPLYLayout::PropertyType countType;
+    qpcvPLYLayout::PropertyType indexType;
+    bool  hasOtherList;   // The records have a variable size even for triangles
+    size_t  countOffset;  // Byte offset of the list count (valid if hasOtherList == false)
+    size_t  triangleRecordSize;   // Record size of a triangle (same)
+  };
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // prepareFaceMap
+  // ---------------------------------------------------------------------------
+  // Fails when the element has no integer vertex_indices (or vertex_index) list
+  static bool prepareFaceMap(const qpcvPLYLayout::Element &inElement, FaceMap *outMap)
+  {
+    if (qpcvPLYLayout::findPropertyIndex(inElement, "vertex_indices", &(outMap->listIndex)) == false &&
+        qpcvPLYLayout::findPropertyIndex(inElement, "vertex_index", &(outMap->listIndex)) == false)
+      return false;
+    const qpcvPLYLayout::Property &list = inElement.properties[outMap->listIndex];
+    if (list.isList == false ||
+        isIntegerType(list.listCountType) == false || isIntegerType(list.type) == false)
+      return false;
+    outMap->countType = list.listCountType;
+    outMap->indexType = list.type;
+    outMap->hasOtherList = false;
+    outMap->countOffset = 0;
+    outMap->triangleRecordSize = 0;
+    for (size_t i = 0; i < inElement.properties.size(); i++)
+    {
+      const qpcvPLYLayout::Property &property = inElement.properties[i];
+      if (i == outMap->listIndex)
+      {
+        outMap->countOffset = outMap->triangleRecordSize;
+        outMap->triangleRecordSize += qpcvPLYLayout::getPropertyTypeSize(property.listCountType) +
+                                      3 * qpcvPLYLayout::getPropertyTypeSize(property.type);
+        continue;
+      }
+      if (property.isList)
+        outMap->hasOtherList = true;
+      outMap->triangleRecordSize += qpcvPLYLayout::getPropertyTypeSize(property.type);
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeBinaryFacesParallel
+  // ---------------------------------------------------------------------------
+  // inRecords points to the first face record and inSize is the number of
+  // bytes from there to the end of the file. inThreadNum <= 0 uses all cores.
+  // inProgressFunc is called from the calling thread only
+  static bool decodeBinaryFacesParallel(const qpcvPLYLayout::Element &inElement,
+                                        const FaceMap &inMap,
+                                        const unsigned char *inRecords, size_t inSize,
+                                        bool inSwap, size_t inVertexNum,
+                                        std::vector<uint32_t> *outIndex,
+                                        int inThreadNum,
+                                        const ProgressFunc &inProgressFunc,
+                                        std::string *outErrorStr)
+  {
+    const size_t  faceNum = inElement.count;
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, faceNum, PARALLEL_MIN_FACE_NUM);
+    bool  isTriangleFile;
+    if (decodeBinaryTriangles(inMap, inRecords, inSize, faceNum, inSwap, inVertexNum,
+                              outIndex, threadNum, inProgressFunc, &isTriangleFile, outErrorStr))
+      return true;
+    if (isTriangleFile)
+      return false;   // Canceled or a bad index
+
+    // Chunk offsets (the only sequential pass)
+    std::vector<size_t> offsetTable, triangleTable;
+    size_t  offset = 0, triangleNum = 0;
+    for (size_t i = 0; i < faceNum; i++)
+    {
+      if (i % CHUNK_FACE_NUM == 0)
+      {
+        offsetTable.push_back(offset);
+        triangleTable.push_back(triangleNum);
+      }
+      size_t  vertexNum;
+      if (skipBinaryRecord(inElement, inMap, inRecords, inSize, inSwap, &offset, &vertexNum) == false)
+        return setError(i, "the face data is truncated", outErrorStr);
+      if (vertexNum >= 3)
+        triangleNum += vertexNum - 2;
+    }
+    offsetTable.push_back(offset);
+    triangleTable.push_back(triangleNum);
+
+    // Decode
+    size_t  chunkNum = offsetTable.size() - 1;
+    outIndex->resize(triangleNum * 3);
+    std::mutex  errorMutex;
+    size_t  errorFaceIndex = (size_t )-1;
+    std::string errorStr;
+    bool  result = qpcvParallel::forEachRange(
+      chunkNum, threadNum, 1,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+        {
+          size_t  badIndex;
+          if (decodeBinaryChunk(inElement, inMap, inRecords, inSwap, inVertexNum,
+                                offsetTable[i], i * CHUNK_FACE_NUM,
+                                std::min((i + 1) * CHUNK_FACE_NUM, faceNum),
+                                outIndex->data() + triangleTable[i] * 3, &badIndex) == false)
+          {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            errorFaceIndex = std::min(errorFaceIndex, badIndex);
+            return;
+          }
+        }
+      },
+      [&](size_t inDoneNum)
+      {
+        if (!inProgressFunc)
+          return true;
+        return inProgressFunc(faceNum * inDoneNum / chunkNum);
+      });
+    if (errorFaceIndex != (size_t )-1)
+      return setError(errorFaceIndex, "vertex index out of range", outErrorStr);
+    return result;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeAsciiFacesParallel
+  // ---------------------------------------------------------------------------
+  // Same arguments as qpcvPLYAsciiDecoder::decodeVerticesParallel(). Each
+  // chunk is parsed into its own triangle list, the lists are joined at the end
+  static bool decodeAsciiFacesParallel(const qpcvPLYLayout &inLayout, size_t inFaceIndex,
+                                       const FaceMap &inMap,
+                                       const unsigned char *inBody, size_t inBodySize,
+                                       size_t inFirstLineNum, size_t inVertexNum,
+                                       std::vector<uint32_t> *outIndex,
+                                       int inThreadNum,
+                                       const ProgressFunc &inProgressFunc,
+                                       std::string *outErrorStr)
+  {
+    const char  *ptr = (const char *)inBody;
+    const char  *end = ptr + inBodySize;
+    size_t  lineNum = inFirstLineNum;
+
+    outIndex->clear();
+    for (size_t i = 0; i < inFaceIndex; i++)
+      if (qpcvPLYAsciiDecoder::skipLines(&ptr, end, inLayout.getElement(i).count, &lineNum) == false)
+        return qpcvPLYAsciiDecoder::setError(lineNum, "unexpected end of file", outErrorStr);
+
+    const qpcvPLYLayout::Element  &face = inLayout.getElement(inFaceIndex);
+    const size_t  faceNum = face.count;
+    if (faceNum == 0)
+      return true;
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, end - ptr,
+                                               qpcvPLYAsciiDecoder::PARALLEL_MIN_BYTES);
+    std::vector<const char *> chunkTable;
+    qpcvPLYAsciiDecoder::makeLineChunks(ptr, end, (size_t )threadNum * 8, &chunkTable);
+    size_t  chunkNum = chunkTable.size() - 1;
+
+    // Pass 1 : the face index of the first line of each chunk
+    std::vector<size_t> lineTable(chunkNum + 1, 0);
+    qpcvParallel::forEachRange(
+      chunkNum, threadNum, 1,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+          lineTable[i + 1] = std::count(chunkTable[i], chunkTable[i + 1], '\n');
+      });
+    for (size_t i = 0; i < chunkNum; i++)
+      lineTable[i + 1] += lineTable[i];
+    if (lineTable[chunkNum] < faceNum &&
+        !(lineTable[chunkNum] + 1 == faceNum && end > ptr && end[-1] != '\n'))
+      return qpcvPLYAsciiDecoder::setError(lineNum + lineTable[chunkNum],
+                                           "unexpected end of file (face data is too short)",
+                                           outErrorStr);
+
+    // Pass 2 : parse
+    std::vector<std::vector<uint32_t> > chunkIndexTable(chunkNum);
+    std::mutex  errorMutex;
+    size_t  errorLineNum = (size_t )-1;
+    std::string errorStr;
+    bool  result = qpcvParallel::forEachRange(
+      chunkNum, threadNum, 1,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd && lineTable[i] < faceNum; i++)
+        {
+          size_t  badIndex;
+          std::string str;
+          if (parseAsciiChunk(face, inMap, chunkTable[i], chunkTable[i + 1],
+                              lineTable[i], faceNum, inVertexNum,
+                              &(chunkIndexTable[i]), &badIndex, &str) == false)
+          {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (lineNum + badIndex < errorLineNum)
+            {
+              errorLineNum = lineNum + badIndex;
+              errorStr = str;
+            }
+            return;
+          }
+        }
+      },
+      [&](size_t inDoneNum)
+      {
+        if (!inProgressFunc)
+          return true;
+        return inProgressFunc(faceNum * inDoneNum / chunkNum);
+      });
+    if (errorLineNum != (size_t )-1)
+      return qpcvPLYAsciiDecoder::setError(errorLineNum, errorStr.c_str(), outErrorStr);
+    if (result == false)
+      return false;
+
+    // Join
+    std::vector<size_t> offsetTable(chunkNum + 1, 0);
+    for (size_t i = 0; i < chunkNum; i++)
+      offsetTable[i + 1] = offsetTable[i] + chunkIndexTable[i].size();
+    outIndex->resize(offsetTable[chunkNum]);
+    qpcvParallel::forEachRange(
+      chunkNum, threadNum, 1,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+        {
+          if (chunkIndexTable[i].size() != 0)
+            memcpy(outIndex->data() + offsetTable[i], chunkIndexTable[i].data(),
+                   chunkIndexTable[i].size() * sizeof(uint32_t));
+          std::vector<uint32_t>().swap(chunkIndexTable[i]);
+        }
+      });
+    return true;
+  }
+
+protected:
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // decodeBinaryTriangles
+  // ---------------------------------------------------------------------------
+  // The all-triangle fast path. outIsTriangleFile returns false (and nothing
+  // is decoded) when the records do not have the triangle layout, so the
+  // caller should try the polygon path
+  static bool decodeBinaryTriangles(const FaceMap &inMap,
+                                    const unsigned char *inRecords, size_t inSize,
+                                    size_t inFaceNum, bool inSwap, size_t inVertexNum,
+                                    std::vector<uint32_t> *outIndex,
+                                    int inThreadNum,
+                                    const ProgressFunc &inProgressFunc,
+                                    bool *outIsTriangleFile, std::string *outErrorStr)
+  {
+    *outIsTriangleFile = false;
+    if (inMap.hasOtherList || inFaceNum * inMap.triangleRecordSize > inSize)
+      return false;
+    // Only the first list count is checked here, the others while decoding
+    if (inFaceNum != 0 &&
+        readInteger(inMap.countType, inRecords + inMap.countOffset, inSwap) != 3)
+      return false;
+
+    outIndex->resize(inFaceNum * 3);
+    std::vector<size_t> badTable(inThreadNum > 0 ? inThreadNum : 1, (size_t )-1);
+    std::vector<char> isPolygonTable(badTable.size(), 0);
+    bool  result = qpcvParallel::forEachRange(
+      inFaceNum, (int )badTable.size(), 256 * 1024,
+      [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+      {
+        size_t  badIndex;
+        int resultCode = decodeTriangleRange(inMap, inRecords, inSwap, inVertexNum,
+                                             inBegin, inEnd, outIndex->data(), &badIndex);
+        if (resultCode == TRIANGLE_RESULT_POLYGON)
+          isPolygonTable[inThreadIndex] = 1;
+        else if (resultCode == TRIANGLE_RESULT_BAD_INDEX &&
+                 badIndex < badTable[inThreadIndex])
+          badTable[inThreadIndex] = badIndex;
+      },
+      inProgressFunc);
+    for (size_t i = 0; i < isPolygonTable.size(); i++)
+      if (isPolygonTable[i] != 0)
+      {
+        outIndex->clear();
+        return false;
+      }
+    *outIsTriangleFile = true;
+    size_t  badIndex = *std::min_element(badTable.begin(), badTable.end());
+    if (badIndex != (size_t )-1)
+      return setError(badIndex, "vertex index out of range", outErrorStr);
+    return result;
+  }
+
+  enum  TriangleResult
+  {
+    TRIANGLE_RESULT_OK  = 0,
+    TRIANGLE_RESULT_POLYGON,
+    TRIANGLE_RESULT_BAD_INDEX
+  };
+
+  // ---------------------------------------------------------------------------
+  // decodeTriangleRange
+  // ---------------------------------------------------------------------------
+  // Picks the specialized loop for uchar counts with 32 bit indices (what
+  // most writers produce) and the generic one otherwise
+  static int  decodeTriangleRange(const FaceMap &inMap, const unsigned char *inRecords,
+                                  bool inSwap, size_t inVertexNum,
+                                  size_t inBegin, size_t inEnd,
+                                  uint32_t *outIndex, size_t *outBadIndex)
+  {
+    if (inMap.countType == qpcvPLYLayout::PROPERTY_TYPE_UCHAR &&
+        (inMap.indexType == qpcvPLYLayout::PROPERTY_TYPE_INT ||
+         inMap.indexType == qpcvPLYLayout::PROPERTY_TYPE_UINT))
+    {
+      if (inSwap)
+        return decodeTriangleRangeFast<true>(inMap, inRecords, inVertexNum,
+                                             inBegin, inEnd, outIndex, outBadIndex);
+      return decodeTriangleRangeFast<false>(inMap, inRecords, inVertexNum,
+                                            inBegin, inEnd, outIndex, outBadIndex);
+    }
+    const size_t  recordSize = inMap.triangleRecordSize;
+    const size_t  indexSize = qpcvPLYLayout::getPropertyTypeSize(inMap.indexType);
+    const size_t  listOffset = inMap.countOffset +
+                               qpcvPLYLayout::getPropertyTypeSize(inMap.countType);
+    const unsigned char *ptr = inRecords + inBegin * recordSize;
+    for (size_t i = inBegin; i < inEnd; i++, ptr += recordSize)
+    {
+      if (readInteger(inMap.countType, ptr + inMap.countOffset, inSwap) != 3)
+        return TRIANGLE_RESULT_POLYGON;
+      for (size_t j = 0; j < 3; j++)
+      {
+        int64_t index = readInteger(inMap.indexType, ptr + listOffset + j * indexSize, inSwap);
+        if (index < 0 || (uint64_t )index >= inVertexNum)
+        {
+          *outBadIndex = i;
+          return TRIANGLE_RESULT_BAD_INDEX;
+        }
+        outIndex[i * 3 + j] = (uint32_t )index;
+      }
+    }
+    return TRIANGLE_RESULT_OK;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeTriangleRangeFast
+  // ---------------------------------------------------------------------------
+  // A negative int index becomes >= 2^31 as uint32_t, which is never a valid
+  // index since the vertex number fits in 32 bits
+  template <bool SWAP>
+  static int  decodeTriangleRangeFast(const FaceMap &inMap, const unsigned char *inRecords,
+                                      size_t inVertexNum, size_t inBegin, size_t inEnd,
+                                      uint32_t *outIndex, size_t *outBadIndex)
+  {
+    const size_t  recordSize = inMap.triangleRecordSize;
+    const size_t  countOffset = inMap.countOffset;
+    const unsigned char *ptr = inRecords + inBegin * recordSize;
+    uint32_t  *out = outIndex + inBegin * 3;
+    const size_t  num = inEnd - inBegin;
+    uint32_t  maxIndex = 0;
+    for (size_t i = 0; i < num; i++, ptr += recordSize)
+    {
+      if (ptr[countOffset] != 3)
+        return TRIANGLE_RESULT_POLYGON;
+      for (size_t j = 0; j < 3; j++)
+      {
+        uint32_t  index = qpcvPLYDecoder::loadFast<uint32_t, uint32_t, SWAP>(
+                            ptr + countOffset + 1 + j * sizeof(uint32_t));
+        out[i * 3 + j] = index;
+        maxIndex = std::max(maxIndex, index);
+      }
+    }
+    if (maxIndex < inVertexNum)
+      return TRIANGLE_RESULT_OK;
+    // Rare, so the bad face is looked up afterwards
+    for (size_t i = 0; i < num * 3; i++)
+      if (out[i] >= inVertexNum)
+      {
+        *outBadIndex = inBegin + i / 3;
+        return TRIANGLE_RESULT_BAD_INDEX;
+      }
+    return TRIANGLE_RESULT_OK;
+  }
+  // ---------------------------------------------------------------------------
+  // skipBinaryRecord
+  // ---------------------------------------------------------------------------
+  // Advances ioOffset over one face record. outVertexNum returns the length
+  // of the vertex index list. Fails when the record runs over inSize
+  static bool skipBinaryRecord(const qpcvPLYLayout::Element &inElement, const FaceMap &inMap,
+                               const unsigned char *inRecords, size_t inSize, bool inSwap,
+                               size_t *ioOffset, size_t *outVertexNum)
+  {
+    size_t  offset = *ioOffset;
+    *outVertexNum = 0;
+    for (size_t i = 0; i < inElement.properties.size(); i++)
+    {
+      const qpcvPLYLayout::Property &property = inElement.properties[i];
+      size_t  typeSize = qpcvPLYLayout::getPropertyTypeSize(property.type);
+      if (property.isList == false)
+      {
+        offset += typeSize;
+        continue;
+      }
+      size_t  countSize = qpcvPLYLayout::getPropertyTypeSize(property.listCountType);
+      if (offset + countSize > inSize)
+        return false;
+      int64_t count = readInteger(property.listCountType, inRecords + offset, inSwap);
+      if (count < 0)
+        return false;
+      offset += countSize + (size_t )count * typeSize;
+      if (i == inMap.listIndex)
+        *outVertexNum = (size_t )count;
+    }
+    if (offset > inSize)
+      return false;
+    *ioOffset = offset;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeBinaryChunk
+  // ---------------------------------------------------------------------------
+  // Decodes the faces [inBegin, inEnd) starting at inOffset (already checked
+  // by skipBinaryRecord()) as triangle fans
+  static bool decodeBinaryChunk(const qpcvPLYLayout::Element &inElement, const FaceMap &inMap,
+                                const unsigned char *inRecords, bool inSwap, size_t inVertexNum,
+                                size_t inOffset, size_t inBegin, size_t inEnd,
+                                uint32_t *outIndex, size_t *outBadIndex)
+  {
+    size_t  offset = inOffset;
+    const size_t  indexSize = qpcvPLYLayout::getPropertyTypeSize(inMap.indexType);
+    uint32_t  *out = outIndex;
+    for (size_t face = inBegin; face < inEnd; face++)
+    {
+      for (size_t i = 0; i < inElement.properties.size(); i++)
+      {
+        const qpcvPLYLayout::Property &property = inElement.properties[i];
+        size_t  typeSize = qpcvPLYLayout::getPropertyTypeSize(property.type);
+        if (property.isList == false)
+        {
+          offset += typeSize;
+          continue;
+        }
+        size_t  count = (size_t )readInteger(property.listCountType, inRecords + offset, inSwap);
+        offset += qpcvPLYLayout::getPropertyTypeSize(property.listCountType);
+        if (i == inMap.listIndex)
+        {
+          const unsigned char *list = inRecords + offset;
+          int64_t first = 0, prev = 0;
+          for (size_t j = 0; j < count; j++)
+          {
+            int64_t index = readInteger(inMap.indexType, list + j * indexSize, inSwap);
+            if (index < 0 || (uint64_t )index >= inVertexNum)
+            {
+              *outBadIndex = face;
+              return false;
+            }
+            if (j == 0)
+              first = index;
+            else if (j >= 2)
+            {
+              *(out++) = (uint32_t )first;
+              *(out++) = (uint32_t )prev;
+              *(out++) = (uint32_t )index;
+            }
+            prev = index;
+          }
+        }
+        offset += count * typeSize;
+      }
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // parseAsciiChunk
+  // ---------------------------------------------------------------------------
+  // Parses the lines in [inPtr, inEnd) as faces inIndex, inIndex + 1, ...
+  // (stops at inFaceNum) and appends the triangles to outIndex. outBadIndex
+  // returns the line offset from the top of the face data on error
+  static bool parseAsciiChunk(const qpcvPLYLayout::Element &inElement, const FaceMap &inMap,
+                              const char *inPtr, const char *inEnd,
+                              size_t inIndex, size_t inFaceNum, size_t inVertexNum,
+                              std::vector<uint32_t> *outIndex,
+                              size_t *outBadIndex, std::string *outErrorStr)
+  {
+    const char  *ptr = inPtr;
+    size_t  propertyNum = inElement.properties.size();
+
+    // Assume triangles for the first guess of the size
+    outIndex->reserve((inEnd - inPtr) / 8);
+    for (size_t index = inIndex; index < inFaceNum && ptr < inEnd; index++)
+    {
+      const char  *lineEnd = (const char *)memchr(ptr, '\n', inEnd - ptr);
+      if (lineEnd == NULL)
+        lineEnd = inEnd;
+      for (size_t j = 0; j < propertyNum; j++)
+      {
+        const qpcvPLYLayout::Property &property = inElement.properties[j];
+        double  value;
+        if (property.isList == false)
+        {
+          if (qpcvPLYAsciiDecoder::parseValue(property.type, &ptr, lineEnd, &value) == false)
+            return qpcvPLYAsciiDecoder::parseError(index, property, outBadIndex, outErrorStr);
+          continue;
+        }
+        if (qpcvPLYAsciiDecoder::parseValue(property.listCountType, &ptr, lineEnd, &value) == false ||
+            value < 0 || value != (double )(size_t )value)
+          return qpcvPLYAsciiDecoder::parseError(index, property, outBadIndex, outErrorStr);
+        size_t  count = (size_t )value;
+        uint32_t  first = 0, prev = 0;
+        for (size_t k = 0; k < count; k++)
+        {
+          if (qpcvPLYAsciiDecoder::parseValue(property.type, &ptr, lineEnd, &value) == false)
+            return qpcvPLYAsciiDecoder::parseError(index, property, outBadIndex, outErrorStr);
+          if (j != inMap.listIndex)
+            continue;
+          if (!(value >= 0 && value < (double )inVertexNum) || value != (double )(uint32_t )value)
+          {
+            *outBadIndex = index;
+            *outErrorStr = "vertex index out of range";
+            return false;
+          }
+          uint32_t  vertex = (uint32_t )value;
+          if (k == 0)
+            first = vertex;
+          else if (k >= 2)
+          {
+            outIndex->push_back(first);
+            outIndex->push_back(prev);
+            outIndex->push_back(vertex);
+          }
+          prev = vertex;
+        }
+      }
+      qpcvPLYAsciiDecoder::skipSpace(&ptr, lineEnd);
+      if (ptr != lineEnd)
+      {
+        *outBadIndex = index;
+        *outErrorStr = "too many values in the face line";
+        return false;
+      }
+      ptr = lineEnd + 1;
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // readInteger
+  // ---------------------------------------------------------------------------
+  static int64_t  readInteger(qpcvPLYLayout::PropertyType inType, const unsigned char *inPtr,
+                              bool inSwap)
+  {
+    switch (inType)
+    {
+      case qpcvPLYLayout::PROPERTY_TYPE_CHAR:
+        return *((const int8_t *)inPtr);
+      case qpcvPLYLayout::PROPERTY_TYPE_UCHAR:
+        return *inPtr;
+      case qpcvPLYLayout::PROPERTY_TYPE_SHORT:
+        return qpcvPLYDecoder::load<int16_t>(inPtr, inSwap);
+      case qpcvPLYLayout::PROPERTY_TYPE_USHORT:
+        return qpcvPLYDecoder::load<uint16_t>(inPtr, inSwap);
+      case qpcvPLYLayout::PROPERTY_TYPE_INT:
+        return qpcvPLYDecoder::load<int32_t>(inPtr, inSwap);
+      case qpcvPLYLayout::PROPERTY_TYPE_UINT:
+        return qpcvPLYDecoder::load<uint32_t>(inPtr, inSwap);
+      default:
+        break;
+    }
+    return -1;
+  }
+  // ---------------------------------------------------------------------------
+  // isIntegerType
+  // ---------------------------------------------------------------------------
+  static bool isIntegerType(qpcvPLYLayout::PropertyType inType)
+  {
+    return (inType >= qpcvPLYLayout::PROPERTY_TYPE_CHAR &&
+            inType <= qpcvPLYLayout::PROPERTY_TYPE_UINT);
+  }
+  // ---------------------------------------------------------------------------
+  // setError
+  // ---------------------------------------------------------------------------
+  static bool setError(size_t inFaceIndex, const char *inStr, std::string *outErrorStr)
+  {
+    std::ostringstream  stream;
+    stream << "PLY face " << inFaceIndex << ": " << inStr;
+    *outErrorStr = stream.str();
+    return false;
+  }
+};
+
+#endif  // #ifdef QPCV_PLY_FACE_DECODER_H_
@@ -0,0 +1,426 @@
+// =============================================================================
+//  qpcv_ply_layout.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_ply_layout.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    PLY header parser that describes the on-disk record layout
+*/
+
+#ifndef QPCV_PLY_LAYOUT_H_
+#define QPCV_PLY_LAYOUT_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <sstream>
+#include <stdint.h>
+#include <string.h>
+
+// -----------------------------------------------------------------------------
+// qpcvPLYLayout class
+// -----------------------------------------------------------------------------
+// Unlike ibc::gl::file::PLYHeader, this class works directly on a memory block
+// (e.g. a mapped file) and computes the byte offset of every fixed size property,
+// so the vertex records can be decoded in place.
+class qpcvPLYLayout
+{
+public:
+  enum  Format
+  {
+    FORMAT_UNKNOWN   = 0,
+    FORMAT_ASCII,
+    FORMAT_BINARY_LITTLE_ENDIAN,
+    FORMAT_BINARY_BIG_ENDIAN
+  };
+
+  enum  PropertyType
+  {
+    PROPERTY_TYPE_UNKNOWN   = 0,
+    PROPERTY_TYPE_CHAR,
+    PROPERTY_TYPE_UCHAR,
+    PROPERTY_TYPE_SHORT,
+    PROPERTY_TYPE_USHORT,
+    PROPERTY_TYPE_INT,
+    PROPERTY_TYPE_UINT,
+    PROPERTY_TYPE_FLOAT,
+    PROPERTY_TYPE_DOUBLE
+  };
+
+  struct Property
+  {
+    std::string   name;
+    PropertyType  type;
+    bool          isList;
+    PropertyType  listCountType;
+    size_t        offset;   // Byte offset in the record (valid only when the element has fixed size records)
+  };
+
+  struct Element
+  {
+    std::string   name;
+    size_t        count;
+    std::vector<Property> properties;
+    size_t        recordSize;   // 0 when the element has a list property
+  };
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvPLYLayout
+  // ---------------------------------------------------------------------------
+  qpcvPLYLayout()
+  {
+    clear();
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // clear
+  // ---------------------------------------------------------------------------
+  void  clear()
+  {
+    mFormat = FORMAT_UNKNOWN;
+    mVersionStr.clear();
+    mHeaderSize = 0;
+    mHeaderStr.clear();
+    mElements.clear();
+    mErrorStr.clear();
+  }
+  // ---------------------------------------------------------------------------
+  // parse
+  // ---------------------------------------------------------------------------
+  // inPtr points to the top of the file. Only the header part is accessed
+  bool  parse(const unsigned char *inPtr, size_t inSize)
+  {
+    clear();
+    const char  *ptr = (const char *)inPtr;
+    const char  *end = ptr + inSize;
+    size_t  lineNum = 0;
+    bool  isEndFound = false;
+
+    while (ptr < end)
+    {
+      const char  *lineEnd = (const char *)memchr(ptr, '\n', end - ptr);
+      if (lineEnd == NULL)
+        break;
+      std::string line(ptr, lineEnd - ptr);
+      ptr = lineEnd + 1;
+      lineNum++;
+      if (line.size() != 0 && line[line.size() - 1] == '\r')
+        line.erase(line.size() - 1);
+
+      if (lineNum == 1)
+      {
+        if (line != "ply")
+          return setError(lineNum, "not a PLY file");
+        continue;
+      }
+      std::istringstream  stream(line);
+      std::string keyword;
+      stream >> keyword;
+      if (keyword == "end_header")
+      {
+        isEndFound = true;
+        break;
+      }
+      if (keyword.size() == 0 || keyword == "comment" || keyword == "obj_info")
+        continue;
+      if (keyword == "format")
+      {
+        std::string formatStr;
+        stream >> formatStr >> mVersionStr;
+        if (formatStr == "ascii")
+          mFormat = FORMAT_ASCII;
+        else if (formatStr == "binary_little_endian")
+          mFormat = FORMAT_BINARY_LITTLE_ENDIAN;
+        else if (formatStr == "binary_big_endian")
+          mFormat = FORMAT_BINARY_BIG_ENDIAN;
+        else
+          return setError(lineNum, "unknown format");
+        continue;
+      }
+      if (keyword == "element")
+      {
+        Element element;
+        unsigned long long  count = 0;
+        stream >> element.name >> count;
+        if (stream.fail())
+          return setError(lineNum, "bad element line");
+        element.count = (size_t )count;
+        element.recordSize = 0;
+        mElements.push_back(element);
+        continue;
+      }
+      if (keyword == "property")
+      {
+        if (mElements.size() == 0)
+          return setError(lineNum, "property without element");
+        Property  property;
+        std::string typeStr;
+        stream >> typeStr;
+        property.isList = false;
+        property.listCountType = PROPERTY_TYPE_UNKNOWN;
+        property.offset = 0;
+        if (typeStr == "list")
+        {
+          std::string countTypeStr;
+          property.isList = true;
+          stream >> countTypeStr >> typeStr;
+          property.listCountType = getPropertyType(countTypeStr);
+          if (property.listCountType == PROPERTY_TYPE_UNKNOWN)
+            return setError(lineNum, "unknown list count type");
+        }
+        property.type = getPropertyType(typeStr);
+        if (property.type == PROPERTY_TYPE_UNKNOWN)
+          return setError(lineNum, "unknown property type");
+        stream >> property.name;
+        if (property.name.size() == 0)
+          return setError(lineNum, "property without name");
+        mElements.back().properties.push_back(property);
+        continue;
+      }
+      return setError(lineNum, "unknown keyword");
+    }
+    if (isEndFound == false)
+      return setError(lineNum, "end_header not found");
+    if (mFormat == FORMAT_UNKNOWN)
+      return setError(lineNum, "format not found");
+
+    mHeaderSize = ptr - (const char *)inPtr;
+    mHeaderStr = std::string((const char *)inPtr, mHeaderSize);
+
+    // Record layout
+    for (size_t i = 0; i < mElements.size(); i++)
+    {
+      size_t  offset = 0;
+      bool  isFixed = true;
+      for (size_t j = 0; j < mElements[i].properties.size(); j++)
+      {
+        Property  &property = mElements[i].properties[j];
+        property.offset = offset;
+        if (property.isList)
+          isFixed = false;
+        offset += getPropertyTypeSize(property.type);
+      }
+      if (isFixed)
+        mElements[i].recordSize = offset;
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // getFormat
+  // ---------------------------------------------------------------------------
+  Format  getFormat() const
+  {
+    return mFormat;
+  }
+  // ---------------------------------------------------------------------------
+  // getFormatStr
+  // ---------------------------------------------------------------------------
+  std::string getFormatStr() const
+  {
+    std::string str;
+    switch (mFormat)
+    {
+      case FORMAT_ASCII:
+        str = "ascii";
+        break;
+      case FORMAT_BINARY_LITTLE_ENDIAN:
+        str = "binary_little_endian";
+        break;
+      case FORMAT_BINARY_BIG_ENDIAN:
+        str = "binary_big_endian";
+        break;
+      default:
+        return std::string("unknown");
+    }
+    return str + " " + mVersionStr;
+  }
+  // ---------------------------------------------------------------------------
+  // isBinary
+  // ---------------------------------------------------------------------------
+  bool  isBinary() const
+  {
+    return (mFormat == FORMAT_BINARY_LITTLE_ENDIAN || mFormat == FORMAT_BINARY_BIG_ENDIAN);
+  }
+  // ---------------------------------------------------------------------------
+  // needsByteSwap
+  // ---------------------------------------------------------------------------
+  bool  needsByteSwap() const
+  {
+    if (mFormat == FORMAT_BINARY_LITTLE_ENDIAN)
+      return !isHostLittleEndian();
+    if (mFormat == FORMAT_BINARY_BIG_ENDIAN)
+      return isHostLittleEndian();
+    return false;
+  }
+  // ---------------------------------------------------------------------------
+  // getHeaderSize
+  // ---------------------------------------------------------------------------
+  size_t  getHeaderSize() const
+  {
+    return mHeaderSize;
+  }
+  // ---------------------------------------------------------------------------
+  // getHeaderStr
+  // ---------------------------------------------------------------------------
+  const std::string &getHeaderStr() const
+  {
+    return mHeaderStr;
+  }
+  // ---------------------------------------------------------------------------
+  // getErrorStr
+  // ---------------------------------------------------------------------------
+  const std::string &getErrorStr() const
+  {
+    return mErrorStr;
+  }
+  // ---------------------------------------------------------------------------
+  // getElementNum
+  // ---------------------------------------------------------------------------
+  size_t  getElementNum() const
+  {
+    return mElements.size();
+  }
+  // ---------------------------------------------------------------------------
+  // getElement
+  // ---------------------------------------------------------------------------
+  const Element &getElement(size_t inIndex) const
+  {
+    return mElements[inIndex];
+  }
+  // ---------------------------------------------------------------------------
+  // findElementIndex
+  // ---------------------------------------------------------------------------
+  bool  findElementIndex(const char *inName, size_t *outIndex) const
+  {
+    for (size_t i = 0; i < mElements.size(); i++)
+      if (mElements[i].name == inName)
+      {
+        *outIndex = i;
+        return true;
+      }
+    return false;
+  }
+  // ---------------------------------------------------------------------------
+  // findPropertyIndex
+  // ---------------------------------------------------------------------------
+  static bool findPropertyIndex(const Element &inElement, const char *inName, size_t *outIndex)
+  {
+    for (size_t i = 0; i < inElement.properties.size(); i++)
+      if (inElement.properties[i].name == inName)
+      {
+        *outIndex = i;
+        return true;
+      }
+    return false;
+  }
+  // ---------------------------------------------------------------------------
+  // getBinaryElementOffset
+  // ---------------------------------------------------------------------------
+  // Byte offset of the element data from the top of the body (binary only).
+  // Fails when a preceding element has variable size records or the offset
+  // does not fit in size_t (a broken count in the header)
+  bool  getBinaryElementOffset(size_t inIndex, size_t *outOffset) const
+  {
+    size_t  offset = 0;
+    for (size_t i = 0; i < inIndex; i++)
+    {
+      if (mElements[i].count == 0)
+        continue;
+      if (mElements[i].recordSize == 0 ||
+          mElements[i].count > (SIZE_MAX - offset) / mElements[i].recordSize)
+        return false;
+      offset += mElements[i].count * mElements[i].recordSize;
+    }
+    *outOffset = offset;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // getPropertyType
+  // ---------------------------------------------------------------------------
+  static PropertyType getPropertyType(const std::string &inTypeStr)
+  {
+    if (inTypeStr == "char" || inTypeStr == "int8")
+      return PROPERTY_TYPE_CHAR;
+    if (inTypeStr == "uchar" || inTypeStr == "uint8")
+      return PROPERTY_TYPE_UCHAR;
+    if (inTypeStr == "short" || inTypeStr == "int16")
+      return PROPERTY_TYPE_SHORT;
+    if (inTypeStr == "ushort" || inTypeStr == "uint16")
+      return PROPERTY_TYPE_USHORT;
+    if (inTypeStr == "int" || inTypeStr == "int32")
+      return PROPERTY_TYPE_INT;
+    if (inTypeStr == "uint" || inTypeStr == "uint32")
+      return PROPERTY_TYPE_UINT;
+    if (inTypeStr == "float" || inTypeStr == "float32")
+      return PROPERTY_TYPE_FLOAT;
+    if (inTypeStr == "double" || inTypeStr == "float64")
+      return PROPERTY_TYPE_DOUBLE;
+    return PROPERTY_TYPE_UNKNOWN;
+  }
+  // ---------------------------------------------------------------------------
+  // getPropertyTypeStr
+  // ---------------------------------------------------------------------------
+  static const char *getPropertyTypeStr(PropertyType inType)
+  {
+    static const char *strTable[] =
+    {
+      "unknown", "char", "uchar", "short", "ushort", "int", "uint", "float", "double"
+    };
+    return strTable[inType];
+  }
+  // ---------------------------------------------------------------------------
+  // getPropertyTypeSize
+  // ---------------------------------------------------------------------------
+  static size_t getPropertyTypeSize(PropertyType inType)
+  {
+    static const size_t sizeTable[] =
+    {
+      0, 1, 1, 2, 2, 4, 4, 4, 8
+    };
+    return sizeTable[inType];
+  }
+  // ---------------------------------------------------------------------------
+  // isHostLittleEndian
+  // ---------------------------------------------------------------------------
+  static bool isHostLittleEndian()
+  {
+    const uint16_t  value = 1;
+    return (*((const uint8_t *)&value) == 1);
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  Format  mFormat;
+  std::string mVersionStr;
+  size_t  mHeaderSize;
+  std::string mHeaderStr;
+  std::vector<Element>  mElements;
+  std::string mErrorStr;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // setError
+  // ---------------------------------------------------------------------------
+  bool  setError(size_t inLineNum, const char *inStr)
+  {
+    std::ostringstream  stream;
+    stream << "PLY header line " << inLineNum << ": " << inStr;
+    mErrorStr = stream.str();
+    return false;
+  }
+};
+
+#endif  // #ifdef QPCV_PLY_LAYOUT_H_
@@ -0,0 +1,349 @@
+// =============================================================================
+//  qpcv_ply_stream_decoder.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_ply_stream_decoder.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    PLY vertex decoder for compressed (gzip / zstd) files
+*/
+
+#ifndef QPCV_PLY_STREAM_DECODER_H_
+#define QPCV_PLY_STREAM_DECODER_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include "qpcv_ply_layout.h"
+#include "qpcv_ply_decoder.h"
+#include "qpcv_ply_ascii_decoder.h"
+#include "qpcv_decompress_stream.h"
+#include "qpcv_bounds.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvPLYStreamDecoder class
+// -----------------------------------------------------------------------------
+// Reads the header and the vertex element from a qpcvDecompressStream one
+// block at a time, so the decompressed file never is in memory as a whole.
+// Each block is decoded in place with the same decoders as a mapped file;
+// only a record (binary) or a line (ascii) that straddles two blocks is
+// copied into a carry buffer. The data after the vertex element is not read
+class qpcvPLYStreamDecoder
+{
+public:
+  typedef qpcvPLYDecoder::ProgressFunc  ProgressFunc;
+
+  // Constants -----------------------------------------------------------------
+  // A header larger than this is not a PLY header
+  static const size_t MAX_HEADER_BYTES = 1024 * 1024;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvPLYStreamDecoder
+  // ---------------------------------------------------------------------------
+  // inStream must be started
+  qpcvPLYStreamDecoder(qpcvDecompressStream *inStream)
+  {
+    mStream = inStream;
+    mBlock = NULL;
+    mBlockSize = 0;
+    mBlockPos = 0;
+    mLineNum = 1;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // readHeader
+  // ---------------------------------------------------------------------------
+  bool  readHeader(qpcvPLYLayout *outLayout, std::string *outErrorStr)
+  {
+    std::string buf;
+    while (true)
+    {
+      if (nextBlock() == false)
+        return setStreamError("The PLY header is truncated", outErrorStr);
+      size_t  searchPos = buf.size() < 16 ? 0 : buf.size() - 16;
+      buf.append((const char *)mBlock, mBlockSize);
+      size_t  pos = buf.find("end_header", searchPos);
+      if (pos != std::string::npos && buf.find('\n', pos) != std::string::npos)
+        break;
+      if (buf.size() > MAX_HEADER_BYTES)
+      {
+        *outErrorStr = "Not a PLY file (end_header is not found)";
+        return false;
+      }
+    }
+    if (outLayout->parse((const unsigned char *)buf.data(), buf.size()) == false)
+    {
+      *outErrorStr = outLayout->getErrorStr();
+      return false;
+    }
+
+    // The body starts in the current block
+    size_t  headerSize = outLayout->getHeaderSize();
+    mBlockPos = mBlockSize - (buf.size() - headerSize);
+    mLineNum = std::count(buf.begin(), buf.begin() + headerSize, '\n') + 1;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeVertices
+  // ---------------------------------------------------------------------------
+  // Call after readHeader(). inProgressFunc gets the number of decoded vertices.
+  // The decoded points are added to outBounds (can be NULL)
+  bool  decodeVertices(const qpcvPLYLayout &inLayout, size_t inVertexIndex,
+                       const qpcvPLYDecoder::VertexMap &inMap,
+                       ibc::gl::glXYZf_RGBAub *outData,
+                       qpcvBounds *outBounds,
+                       int inThreadNum,
+                       const ProgressFunc &inProgressFunc,
+                       std::string *outErrorStr)
+  {
+    if (inLayout.isBinary())
+      return decodeBinary(inLayout, inVertexIndex, inMap, outData, outBounds,
+                          inThreadNum, inProgressFunc, outErrorStr);
+    return decodeAscii(inLayout, inVertexIndex, inMap, outData, outBounds,
+                       inThreadNum, inProgressFunc, outErrorStr);
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  qpcvDecompressStream  *mStream;
+  const unsigned char *mBlock;
+  size_t  mBlockSize;
+  size_t  mBlockPos;
+  size_t  mLineNum;       // Line number of mBlockPos (ascii)
+  std::vector<char> mCarry;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // nextBlock
+  // ---------------------------------------------------------------------------
+  bool  nextBlock()
+  {
+    mBlockPos = 0;
+    mBlockSize = 0;
+    if (mStream->next(&mBlock, &mBlockSize) == false)
+    {
+      mBlock = NULL;
+      mBlockSize = 0;
+      return false;
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeBinary
+  // ---------------------------------------------------------------------------
+  bool  decodeBinary(const qpcvPLYLayout &inLayout, size_t inVertexIndex,
+                     const qpcvPLYDecoder::VertexMap &inMap,
+                     ibc::gl::glXYZf_RGBAub *outData,
+                     qpcvBounds *outBounds,
+                     int inThreadNum,
+                     const ProgressFunc &inProgressFunc,
+                     std::string *outErrorStr)
+  {
+    const qpcvPLYLayout::Element  &vertex = inLayout.getElement(inVertexIndex);
+    const size_t  recordSize = vertex.recordSize;
+    const bool  swap = inLayout.needsByteSwap();
+    size_t  skipSize;
+    if (inLayout.getBinaryElementOffset(inVertexIndex, &skipSize) == false)
+    {
+      *outErrorStr = "Unsupported PLY file (variable size records before the vertices)";
+      return false;
+    }
+
+    size_t  index = 0;
+    mCarry.clear();
+    while (index < vertex.count)
+    {
+      if (mBlockPos == mBlockSize && nextBlock() == false)
+        return setStreamError("The PLY file is truncated", outErrorStr);
+      const unsigned char *ptr = mBlock + mBlockPos;
+      size_t  size = mBlockSize - mBlockPos;
+
+      // The elements before the vertex element
+      if (skipSize != 0)
+      {
+        size_t  len = std::min(skipSize, size);
+        skipSize -= len;
+        mBlockPos += len;
+        continue;
+      }
+      // A record across the blocks
+      if (mCarry.size() != 0)
+      {
+        size_t  len = std::min(recordSize - mCarry.size(), size);
+        mCarry.insert(mCarry.end(), ptr, ptr + len);
+        mBlockPos += len;
+        if (mCarry.size() < recordSize)
+          continue;
+        qpcvPLYDecoder::decodeBinaryRange(inMap, (const unsigned char *)mCarry.data(), swap,
+                                          0, 1, outData + index, outBounds);
+        mCarry.clear();
+        index++;
+        continue;
+      }
+
+      size_t  num = std::min(size / recordSize, vertex.count - index);
+      if (num != 0 &&
+          qpcvPLYDecoder::decodeBinaryVerticesParallel(inMap, ptr, swap, num,
+                                                       outData + index, outBounds,
+                                                       inThreadNum) == false)
+        return false;
+      index += num;
+      mBlockPos += num * recordSize;
+      if (index < vertex.count && mBlockPos < mBlockSize)
+      {
+        mCarry.assign(mBlock + mBlockPos, mBlock + mBlockSize);
+        mBlockPos = mBlockSize;
+      }
+      if (inProgressFunc && inProgressFunc(index) == false)
+        return false;
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeAscii
+  // ---------------------------------------------------------------------------
+  bool  decodeAscii(const qpcvPLYLayout &inLayout, size_t inVertexIndex,
+                    const qpcvPLYDecoder::VertexMap &inMap,
+                    ibc::gl::glXYZf_RGBAub *outData,
+                    qpcvBounds *outBounds,
+                    int inThreadNum,
+                    const ProgressFunc &inProgressFunc,
+                    std::string *outErrorStr)
+  {
+    const qpcvPLYLayout::Element  &vertex = inLayout.getElement(inVertexIndex);
+    size_t  skipNum = 0;
+    for (size_t i = 0; i < inVertexIndex; i++)
+      skipNum += inLayout.getElement(i).count;
+
+    size_t  index = 0;
+    mCarry.clear();
+    while (index < vertex.count)
+    {
+      if (mBlockPos == mBlockSize && nextBlock() == false)
+      {
+        std::string errorStr = mStream->getErrorStr();
+        if (errorStr.size() != 0)
+        {
+          *outErrorStr = errorStr;
+          return false;
+        }
+        // The last line of the file may not have '\n'
+        if (skipNum == 0 && mCarry.size() != 0 && index + 1 == vertex.count)
+          return decodeCarry(vertex, inMap, index, outData, outBounds, outErrorStr);
+        return qpcvPLYAsciiDecoder::setError(mLineNum, "unexpected end of file", outErrorStr);
+      }
+      const char  *ptr = (const char *)mBlock + mBlockPos;
+      const char  *end = (const char *)mBlock + mBlockSize;
+
+      // A line across the blocks
+      if (mCarry.size() != 0)
+      {
+        const char  *lineEnd = (const char *)memchr(ptr, '\n', end - ptr);
+        if (lineEnd == NULL)
+        {
+          mCarry.insert(mCarry.end(), ptr, end);
+          mBlockPos = mBlockSize;
+          continue;
+        }
+        mCarry.insert(mCarry.end(), ptr, lineEnd + 1);
+        mBlockPos += lineEnd + 1 - ptr;
+        if (skipNum != 0)
+        {
+          skipNum--;
+          mLineNum++;
+          mCarry.clear();
+          continue;
+        }
+        if (decodeCarry(vertex, inMap, index, outData, outBounds, outErrorStr) == false)
+          return false;
+        index++;
+        continue;
+      }
+
+      // Complete lines of the block
+      const char  *last = end;
+      while (last > ptr && last[-1] != '\n')
+        last--;
+      size_t  lineNum = std::count(ptr, last, '\n');
+      if (skipNum != 0)
+      {
+        size_t  num = std::min(lineNum, skipNum);
+        const char  *p = ptr;
+        for (size_t i = 0; i < num; i++)
+          p = (const char *)memchr(p, '\n', last - p) + 1;
+        skipNum -= num;
+        mLineNum += num;
+        mBlockPos += p - ptr;
+        if (skipNum != 0 && mBlockPos < mBlockSize)
+        {
+          mCarry.assign(mBlock + mBlockPos, mBlock + mBlockSize);
+          mBlockPos = mBlockSize;
+        }
+        continue;
+      }
+      size_t  num = std::min(lineNum, vertex.count - index);
+      if (num != 0 &&
+          qpcvPLYAsciiDecoder::decodeLinesParallel(vertex, inMap, ptr, last, index, num, mLineNum,
+                                                   outData, outBounds, inThreadNum,
+                                                   ProgressFunc(), outErrorStr) == false)
+        return false;
+      index += num;
+      mLineNum += num;
+      mBlockPos = mBlockSize;
+      if (index < vertex.count && last < end)
+        mCarry.assign(last, end);
+      if (inProgressFunc && inProgressFunc(index) == false)
+        return false;
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeCarry
+  // ---------------------------------------------------------------------------
+  // Decodes the line in mCarry as the vertex inIndex
+  bool  decodeCarry(const qpcvPLYLayout::Element &inVertex,
+                    const qpcvPLYDecoder::VertexMap &inMap,
+                    size_t inIndex,
+                    ibc::gl::glXYZf_RGBAub *outData,
+                    qpcvBounds *outBounds,
+                    std::string *outErrorStr)
+  {
+    const char  *ptr = mCarry.data();
+    if (qpcvPLYAsciiDecoder::decodeLinesParallel(inVertex, inMap, ptr, ptr + mCarry.size(),
+                                                 inIndex, 1, mLineNum, outData, outBounds, 1,
+                                                 ProgressFunc(), outErrorStr) == false)
+      return false;
+    mLineNum++;
+    mCarry.clear();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // setStreamError
+  // ---------------------------------------------------------------------------
+  // The decompressor error (broken data) takes priority over inStr
+  bool  setStreamError(const char *inStr, std::string *outErrorStr)
+  {
+    *outErrorStr = mStream->getErrorStr();
+    if (outErrorStr->size() == 0)
+      *outErrorStr = inStr;
+    return false;
+  }
+};
+
+#endif  // #ifdef QPCV_PLY_STREAM_DECODER_H_
@@ -0,0 +1,566 @@
+// =============================================================================
+//  qpcv_ply_writer.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_ply_writer.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Parallel binary / ASCII PLY writer
+*/
+
+#ifndef QPCV_PLY_WRITER_H_
+#define QPCV_PLY_WRITER_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <charconv>
+#include <stdint.h>
+#include <string.h>
+#include <QFile>
+#include <QThread>
+#include <QElapsedTimer>
+#include "qpcv_ply_layout.h"
+#include "qpcv_parallel.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvPLYWriter class
+// -----------------------------------------------------------------------------
+// The points are encoded in blocks by all the threads while the previous
+// batch of blocks is written by the calling thread, so the disk never waits
+// for the encoder. Records that are bit-identical to glXYZf_RGBAub are
+// written straight from the data without encoding
+class qpcvPLYWriter
+{
+public:
+  // Called with the number of written points. Return false to cancel
+  typedef std::function<bool(size_t inDoneNum, size_t inTotalNum)> ProgressFunc;
+
+  enum  Format
+  {
+    FORMAT_BINARY = 0,    // binary_little_endian
+    FORMAT_ASCII,
+    FORMAT_NUM
+  };
+
+  enum  ColorChannel
+  {
+    COLOR_CHANNEL_R = 0,
+    COLOR_CHANNEL_G,
+    COLOR_CHANNEL_B,
+    COLOR_CHANNEL_A
+  };
+
+  // One color property of the vertex element (after x, y, z)
+  struct ColorProperty
+  {
+    std::string name;
+    qpcvPLYLayout::PropertyType type;
+    int channel;    // ColorChannel
+  };
+
+  // Constants -----------------------------------------------------------------
+  static const size_t BLOCK_POINT_NUM = 256 * 1024;
+  static const qint64 DIRECT_WRITE_SIZE = 64 * 1024 * 1024;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getFormatName
+  // ---------------------------------------------------------------------------
+  static const char *getFormatName(int inFormat)
+  {
+    static const char *nameTable[FORMAT_NUM] =
+    {
+      "Binary PLY", "ASCII PLY"
+    };
+    if (inFormat < 0 || inFormat >= FORMAT_NUM)
+      return "";
+    return nameTable[inFormat];
+  }
+  // ---------------------------------------------------------------------------
+  // getDefaultColorProperties
+  // ---------------------------------------------------------------------------
+  // uchar red, green, blue, alpha (the layout of glXYZf_RGBAub)
+  static std::vector<ColorProperty> getDefaultColorProperties()
+  {
+    static const char *nameTable[] = {"red", "green", "blue", "alpha"};
+    std::vector<ColorProperty>  propertyTable;
+    for (int i = 0; i < 4; i++)
+    {
+      ColorProperty property;
+      property.name = nameTable[i];
+      property.type = qpcvPLYLayout::PROPERTY_TYPE_UCHAR;
+      property.channel = i;
+      propertyTable.push_back(property);
+    }
+    return propertyTable;
+  }
+  // ---------------------------------------------------------------------------
+  // parseColorFormatStr
+  // ---------------------------------------------------------------------------
+  // Reads back the "red (uchar), green (uchar), ..." string reported by
+  // qpcvPLYDecoder::getColorFormatStr() on load. Returns false when the
+  // string does not describe the color channels
+  static bool parseColorFormatStr(const std::string &inStr, std::vector<ColorProperty> *outTable)
+  {
+    static const char *nameTable[4][3] =
+    {
+      {"red",   "diffuse_red",   "r"},
+      {"green", "diffuse_green", "g"},
+      {"blue",  "diffuse_blue",  "b"},
+      {"alpha", "diffuse_alpha", "a"}
+    };
+    outTable->clear();
+    size_t  pos = 0;
+    while (pos < inStr.size())
+    {
+      size_t  end = inStr.find(',', pos);
+      if (end == std::string::npos)
+        end = inStr.size();
+      std::string item = inStr.substr(pos, end - pos);
+      pos = end + 1;
+      size_t  open = item.find('(');
+      size_t  close = item.find(')', open);
+      if (open == std::string::npos || close == std::string::npos)
+        return false;
+      ColorProperty property;
+      property.name = trim(item.substr(0, open));
+      property.type = qpcvPLYLayout::getPropertyType(trim(item.substr(open + 1, close - open - 1)));
+      property.channel = -1;
+      for (int i = 0; i < 4 && property.channel < 0; i++)
+        for (int j = 0; j < 3; j++)
+          if (property.name == nameTable[i][j])
+            property.channel = i;
+      if (property.channel < 0 || property.type == qpcvPLYLayout::PROPERTY_TYPE_UNKNOWN)
+        return false;
+      outTable->push_back(property);
+    }
+    return (outTable->size() >= 3);
+  }
+  // ---------------------------------------------------------------------------
+  // makeHeader
+  // ---------------------------------------------------------------------------
+  static std::string  makeHeader(size_t inNum, int inFormat,
+                                 const std::vector<ColorProperty> &inColorTable)
+  {
+    std::string header = "ply\n";
+    header += (inFormat == FORMAT_ASCII) ? "format ascii 1.0\n" : "format binary_little_endian 1.0\n";
+    header += "comment Written by qpcv\n";
+    header += "element vertex " + std::to_string(inNum) + "\n";
+    header += "property float x\nproperty float y\nproperty float z\n";
+    for (size_t i = 0; i < inColorTable.size(); i++)
+      header += std::string("property ") + qpcvPLYLayout::getPropertyTypeStr(inColorTable[i].type) +
+                " " + inColorTable[i].name + "\n";
+    header += "end_header\n";
+    return header;
+  }
+  // ---------------------------------------------------------------------------
+  // write
+  // ---------------------------------------------------------------------------
+  // inColorTable empty : x, y, z only. Written to a temporary file which is
+  // renamed at the end, so a canceled or failed write never replaces the file.
+  // char color properties are written as uchar (see getWritableColorTable()).
+  // Returns false on cancel or error (outErrorStr is set on error)
+  static bool write(const QString &inFileName,
+                    const ibc::gl::glXYZf_RGBAub *inData, size_t inNum, int inFormat,
+                    const std::vector<ColorProperty> &inColorTable, int inThreadNum,
+                    std::string *outErrorStr,
+                    const ProgressFunc &inProgressFunc = ProgressFunc())
+  {
+    std::vector<ColorProperty>  colorTable = getWritableColorTable(inColorTable);
+    QFile file(inFileName + ".tmp");
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered) == false)
+    {
+      *outErrorStr = "Can't open " + (inFileName + ".tmp").toStdString();
+      return false;
+    }
+    std::string header = makeHeader(inNum, inFormat, colorTable);
+    bool  result = (file.write(header.data(), (qint64 )header.size()) == (qint64 )header.size());
+    if (result)
+    {
+      if (inFormat == FORMAT_BINARY && isDirectLayout(colorTable))
+        result = writeDirect(&file, inData, inNum, inProgressFunc);
+      else
+        result = writeBlocks(&file, inData, inNum, inFormat, colorTable, inThreadNum,
+                             inProgressFunc);
+    }
+    if (result == false && outErrorStr->empty() &&
+        file.error() != QFileDevice::NoError)
+      *outErrorStr = file.errorString().toStdString();
+    file.close();
+    if (result)
+    {
+      QFile::remove(inFileName);
+      result = file.rename(inFileName);
+      if (result == false)
+        *outErrorStr = "Can't rename to " + inFileName.toStdString();
+    }
+    if (result == false)
+      file.remove();
+    return result;
+  }
+
+protected:
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getWritableColorTable
+  // ---------------------------------------------------------------------------
+  // The decoder keeps the 0 - 255 range of the color channels, which a signed
+  // char can't hold (128 - 255 would be clamped), so char properties are
+  // promoted to uchar. The values are written unchanged
+  static std::vector<ColorProperty> getWritableColorTable(const std::vector<ColorProperty> &inColorTable)
+  {
+    std::vector<ColorProperty>  propertyTable = inColorTable;
+    for (size_t i = 0; i < propertyTable.size(); i++)
+      if (propertyTable[i].type == qpcvPLYLayout::PROPERTY_TYPE_CHAR)
+        propertyTable[i].type = qpcvPLYLayout::PROPERTY_TYPE_UCHAR;
+    return propertyTable;
+  }
+  // ---------------------------------------------------------------------------
+  // isDirectLayout
+  // ---------------------------------------------------------------------------
+  // true when a record is bit-identical to glXYZf_RGBAub
+  static bool isDirectLayout(const std::vector<ColorProperty> &inColorTable)
+  {
+    if (qpcvPLYLayout::isHostLittleEndian() == false || inColorTable.size() != 4)
+      return false;
+    for (int i = 0; i < 4; i++)
+      if (inColorTable[i].channel != i ||
+          inColorTable[i].type != qpcvPLYLayout::PROPERTY_TYPE_UCHAR)
+        return false;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // writeDirect
+  // ---------------------------------------------------------------------------
+  static bool writeDirect(QFile *inFile, const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                          const ProgressFunc &inProgressFunc)
+  {
+    const char  *data = (const char *)inData;
+    qint64  dataSize = (qint64 )(inNum * sizeof(ibc::gl::glXYZf_RGBAub));
+    for (qint64 done = 0; done < dataSize; done += DIRECT_WRITE_SIZE)
+    {
+      qint64  size = dataSize - done;
+      if (size > DIRECT_WRITE_SIZE)
+        size = DIRECT_WRITE_SIZE;
+      if (inFile->write(data + done, size) != size)
+        return false;
+      if (inProgressFunc &&
+          inProgressFunc((size_t )((done + size) / sizeof(ibc::gl::glXYZf_RGBAub)), inNum) == false)
+        return false;
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // writeBlocks
+  // ---------------------------------------------------------------------------
+  // Batches of one block per thread. Batch n + 1 is encoded on a helper thread
+  // (which fans out to the encoder threads) while batch n is written
+  static bool writeBlocks(QFile *inFile, const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                          int inFormat, const std::vector<ColorProperty> &inColorTable,
+                          int inThreadNum, const ProgressFunc &inProgressFunc)
+  {
+    size_t  blockCount = (inNum + BLOCK_POINT_NUM - 1) / BLOCK_POINT_NUM;
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, inNum, BLOCK_POINT_NUM);
+    size_t  batchNum = (size_t )threadNum;
+    std::vector<std::vector<char> > bufferTable[2];
+    bufferTable[0].resize(batchNum);
+    bufferTable[1].resize(batchNum);
+    bool  swap = !qpcvPLYLayout::isHostLittleEndian();
+
+    auto  encodeBatch = [&](size_t inFirstBlock, std::vector<std::vector<char> > *outBuffers)
+    {
+      size_t  num = std::min(batchNum, blockCount - inFirstBlock);
+      qpcvParallel::forEachRange(
+        num, qpcvParallel::getThreadNum(threadNum, num, 1), 1,
+        [&](int, size_t inBegin, size_t inEnd)
+        {
+          for (size_t i = inBegin; i < inEnd; i++)
+          {
+            size_t  begin = (inFirstBlock + i) * BLOCK_POINT_NUM;
+            size_t  end = std::min(inNum, begin + BLOCK_POINT_NUM);
+            if (inFormat == FORMAT_ASCII)
+              encodeASCII(inData + begin, end - begin, inColorTable, &((*outBuffers)[i]));
+            else
+              encodeBinary(inData + begin, end - begin, inColorTable, swap, &((*outBuffers)[i]));
+          }
+        });
+    };
+
+    if (blockCount == 0)
+      return true;
+    encodeBatch(0, &(bufferTable[0]));
+    bool  result = true;
+    for (size_t first = 0, batch = 0; first < blockCount; first += batchNum, batch++)
+    {
+      std::vector<std::vector<char> > &buffers = bufferTable[batch % 2];
+      std::thread encoder;
+      if (first + batchNum < blockCount)
+        encoder = std::thread(encodeBatch, first + batchNum, &(bufferTable[(batch + 1) % 2]));
+      size_t  num = std::min(batchNum, blockCount - first);
+      for (size_t i = 0; i < num && result; i++)
+      {
+        qint64  size = (qint64 )buffers[i].size();
+        if (inFile->write(buffers[i].data(), size) != size)
+          result = false;
+        else if (inProgressFunc &&
+                 inProgressFunc(std::min(inNum, (first + i + 1) * BLOCK_POINT_NUM), inNum) == false)
+          result = false;
+      }
+      if (encoder.joinable())
+        encoder.join();
+      if (result == false)
+        break;
+    }
+    return result;
+  }
+  // ---------------------------------------------------------------------------
+  // encodeBinary
+  // ---------------------------------------------------------------------------
+  static void encodeBinary(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                           const std::vector<ColorProperty> &inColorTable, bool inSwap,
+                           std::vector<char> *outBuffer)
+  {
+    size_t  recordSize = 3 * sizeof(float);
+    for (size_t i = 0; i < inColorTable.size(); i++)
+      recordSize += getTypeSize(inColorTable[i].type);
+    outBuffer->resize(recordSize * inNum);
+    char  *ptr = outBuffer->data();
+    for (size_t i = 0; i < inNum; i++)
+    {
+      const GLubyte *color = &(inData[i].r);
+      ptr = store(ptr, inData[i].x, inSwap);
+      ptr = store(ptr, inData[i].y, inSwap);
+      ptr = store(ptr, inData[i].z, inSwap);
+      for (size_t j = 0; j < inColorTable.size(); j++)
+      {
+        GLubyte v = color[inColorTable[j].channel];
+        switch (inColorTable[j].type)
+        {
+          case qpcvPLYLayout::PROPERTY_TYPE_UCHAR:
+            *ptr++ = (char )v;
+            break;
+          case qpcvPLYLayout::PROPERTY_TYPE_SHORT:
+            ptr = store(ptr, (int16_t )v, inSwap);
+            break;
+          case qpcvPLYLayout::PROPERTY_TYPE_USHORT:
+            ptr = store(ptr, (uint16_t )(v * 257), inSwap);   // The high byte is read back
+            break;
+          case qpcvPLYLayout::PROPERTY_TYPE_INT:
+            ptr = store(ptr, (int32_t )v, inSwap);
+            break;
+          case qpcvPLYLayout::PROPERTY_TYPE_UINT:
+            ptr = store(ptr, (uint32_t )v, inSwap);
+            break;
+          case qpcvPLYLayout::PROPERTY_TYPE_FLOAT:
+            ptr = store(ptr, (float )(v / 255.0), inSwap);
+            break;
+          case qpcvPLYLayout::PROPERTY_TYPE_DOUBLE:
+            ptr = store(ptr, (double )(v / 255.0), inSwap);
+            break;
+          default:
+            break;
+        }
+      }
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // encodeASCII
+  // ---------------------------------------------------------------------------
+  // The coordinates are written in the shortest form that reads back to the
+  // same float (std::to_chars)
+  static void encodeASCII(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                          const std::vector<ColorProperty> &inColorTable,
+                          std::vector<char> *outBuffer)
+  {
+    const size_t  maxLineSize = 3 * 16 + inColorTable.size() * 32 + 1;
+    outBuffer->resize(maxLineSize * inNum);
+    char  *ptr = outBuffer->data();
+    for (size_t i = 0; i < inNum; i++)
+    {
+      char  *end = ptr + maxLineSize;
+      const GLubyte *color = &(inData[i].r);
+      ptr = std::to_chars(ptr, end, inData[i].x).ptr;
+      *ptr++ = ' ';
+      ptr = std::to_chars(ptr, end, inData[i].y).ptr;
+      *ptr++ = ' ';
+      ptr = std::to_chars(ptr, end, inData[i].z).ptr;
+      for (size_t j = 0; j < inColorTable.size(); j++)
+      {
+        GLubyte v = color[inColorTable[j].channel];
+        *ptr++ = ' ';
+        switch (inColorTable[j].type)
+        {
+          case qpcvPLYLayout::PROPERTY_TYPE_USHORT:
+            ptr = std::to_chars(ptr, end, (int )v * 257).ptr;
+            break;
+          case qpcvPLYLayout::PROPERTY_TYPE_FLOAT:
+            ptr = std::to_chars(ptr, end, (float )(v / 255.0)).ptr;
+            break;
+          case qpcvPLYLayout::PROPERTY_TYPE_DOUBLE:
+            ptr = std::to_chars(ptr, end, v / 255.0).ptr;
+            break;
+          default:
+            ptr = std::to_chars(ptr, end, (int )v).ptr;
+            break;
+        }
+      }
+      *ptr++ = '\n';
+    }
+    outBuffer->resize(ptr - outBuffer->data());
+  }
+  // ---------------------------------------------------------------------------
+  // store
+  // ---------------------------------------------------------------------------
+  // Little endian
+  template <typename T> static char  *store(char *outPtr, T inValue, bool inSwap)
+  {
+    memcpy(outPtr, &inValue, sizeof(T));
+    if (inSwap)
+      for (size_t i = 0; i < sizeof(T) / 2; i++)
+        std::swap(outPtr[i], outPtr[sizeof(T) - 1 - i]);
+    return outPtr + sizeof(T);
+  }
+  // ---------------------------------------------------------------------------
+  // getTypeSize
+  // ---------------------------------------------------------------------------
+  static size_t getTypeSize(qpcvPLYLayout::PropertyType inType)
+  {
+    static const size_t sizeTable[] = {0, 1, 1, 2, 2, 4, 4, 4, 8};
+    return sizeTable[inType];
+  }
+  // ---------------------------------------------------------------------------
+  // trim
+  // ---------------------------------------------------------------------------
+  static std::string  trim(const std::string &inStr)
+  {
+    size_t  begin = inStr.find_first_not_of(" \t");
+    if (begin == std::string::npos)
+      return std::string();
+    size_t  end = inStr.find_last_not_of(" \t");
+    return inStr.substr(begin, end - begin + 1);
+  }
+};
+
+// -----------------------------------------------------------------------------
+// qpcvPLYWriterJob class
+// -----------------------------------------------------------------------------
+// Runs qpcvPLYWriter::write() on a worker thread. The data must not be
+// released before the job finished (deleting the job cancels and waits)
+class qpcvPLYWriterJob : public QThread
+{
+Q_OBJECT
+
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvPLYWriterJob
+  // ---------------------------------------------------------------------------
+  qpcvPLYWriterJob(const QString &inFileName,
+                   const ibc::gl::glXYZf_RGBAub *inData, size_t inNum, int inFormat,
+                   const std::vector<qpcvPLYWriter::ColorProperty> &inColorTable,
+                   int inThreadNum, QObject *parent = Q_NULLPTR)
+  : QThread(parent)
+  {
+    mFileName = inFileName;
+    mData = inData;
+    mDataNum = inNum;
+    mFormat = inFormat;
+    mColorTable = inColorTable;
+    mThreadNum = inThreadNum;
+    mIsSucceeded = false;
+    mTime = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvPLYWriterJob
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvPLYWriterJob()
+  {
+    requestInterruption();
+    wait();
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // isSucceeded
+  // ---------------------------------------------------------------------------
+  bool  isSucceeded() const
+  {
+    return mIsSucceeded;
+  }
+  // ---------------------------------------------------------------------------
+  // getFileName
+  // ---------------------------------------------------------------------------
+  const QString &getFileName() const
+  {
+    return mFileName;
+  }
+  // ---------------------------------------------------------------------------
+  // getErrorStr
+  // ---------------------------------------------------------------------------
+  QString getErrorStr() const
+  {
+    return QString(mErrorStr.c_str());
+  }
+  // ---------------------------------------------------------------------------
+  // getTime
+  // ---------------------------------------------------------------------------
+  qint64  getTime() const
+  {
+    return mTime;
+  }
+
+signals:
+  void  progressChanged(int inPercent);
+
+protected:
+  // Member variables ----------------------------------------------------------
+  QString mFileName;
+  const ibc::gl::glXYZf_RGBAub  *mData;
+  size_t  mDataNum;
+  int mFormat;
+  std::vector<qpcvPLYWriter::ColorProperty> mColorTable;
+  int mThreadNum;
+  bool  mIsSucceeded;
+  std::string mErrorStr;
+  qint64  mTime;
+
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  virtual void  run()
+  {
+    QElapsedTimer timer;
+    timer.start();
+    int lastPercent = -1;
+    mIsSucceeded = qpcvPLYWriter::write(
+      mFileName, mData, mDataNum, mFormat, mColorTable, mThreadNum, &mErrorStr,
+      [&](size_t inDoneNum, size_t inTotalNum)
+      {
+        int percent = (inTotalNum == 0) ? 100 : (int )(inDoneNum * 100 / inTotalNum);
+        if (percent != lastPercent)
+        {
+          lastPercent = percent;
+          emit progressChanged(percent);
+        }
+        return !isInterruptionRequested();
+      });
+    mTime = timer.elapsed();
+  }
+};
+
+#endif  // #ifdef QPCV_PLY_WRITER_H_
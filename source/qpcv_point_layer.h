@@ -0,0 +1,490 @@
+// =============================================================================
+//  qpcv_point_layer.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_point_layer.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Point drawing of qpcvGLView (single color, color map, file colors)
+*/
+
+#ifndef QPCV_POINT_LAYER_H_
+#define QPCV_POINT_LAYER_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QVector4D>
+#include "qpcv_lod.h"
+#include "qpcv_quantize.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+#include "ibc/image/color_map.h"
+
+#ifndef GL_PROGRAM_POINT_SIZE
+#define GL_PROGRAM_POINT_SIZE 0x8642
+#endif
+
+// -----------------------------------------------------------------------------
+// qpcvPointLayer class
+// -----------------------------------------------------------------------------
+// Draws ranges of the glXYZf_RGBAub records (the LOD selection of qpcvGLView)
+// with the camera of qpcvGLView. The color modes are the ones of the data
+// model of GLPointCloudView (0 : single color, 1 : color map of an axis, 2 :
+// the colors of the file), so the window keeps its settings there. The buffer
+// is allocated for the whole data, but a record is uploaded (as it is) only
+// when it is drawn for the first time, so refining the LOD uploads just the
+// new points. The functions taking QOpenGLExtraFunctions need the context
+// current.
+class qpcvPointLayer
+{
+public:
+  // Constants -----------------------------------------------------------------
+  static const int  COLOR_MAP_SIZE = 256;
+
+  enum  ColorMode
+  {
+    COLOR_MODE_SINGLE = 0,
+    COLOR_MODE_MAP,
+    COLOR_MODE_FILE
+  };
+
+  // The settings of one draw
+  struct DrawParam
+  {
+    int   colorMode;
+    float singleColor[3];
+    int   colorMapAxis;
+    float colorMapOffset;     // (v - offset) * gain maps to 0 .. 1
+    float colorMapGain;
+    int   colorMapRepeatNum;
+    bool  isUnmappedShown;    // Out of range points in the single color
+    ibc::image::ColorMap::ColorMapIndex colorMapIndex;
+    float pointSize;
+  };
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvPointLayer
+  // ---------------------------------------------------------------------------
+  qpcvPointLayer()
+  {
+    mData = NULL;
+    mDataNum = 0;
+    mIsDataDirty = false;
+    mVRAMUsed = 0;
+    mProgram = NULL;
+    mIsProgramFailed = false;
+    mColorMapTexture = 0;
+    mIsColorMapValid = false;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // setPointData
+  // ---------------------------------------------------------------------------
+  // inData is not owned and must stay until the next setPointData()
+  void  setPointData(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum)
+  {
+    mData = inData;
+    mDataNum = inNum;
+    mIsDataDirty = true;
+    mUploadedTable.clear();
+  }
+  // ---------------------------------------------------------------------------
+  // isEnabled
+  // ---------------------------------------------------------------------------
+  // false once the program failed (no GLSL 3.30 / ES 3.00)
+  bool  isEnabled() const
+  {
+    return (mIsProgramFailed == false);
+  }
+  // ---------------------------------------------------------------------------
+  // draw
+  // ---------------------------------------------------------------------------
+  // inMatrix maps the data coordinates to the clip coordinates
+  void  draw(QOpenGLContext *inContext, const QMatrix4x4 &inMatrix,
+             const std::vector<qpcvLOD::Range> &inRangeTable, const DrawParam &inParam)
+  {
+    QOpenGLExtraFunctions *func = inContext->extraFunctions();
+    if (prepare(inContext, inRangeTable) == false || inRangeTable.size() == 0)
+      return;
+    bindProgram(inContext, inMatrix, inParam);
+    {
+      QOpenGLVertexArrayObject::Binder  binder(&mVAO);
+      for (size_t i = 0; i < inRangeTable.size(); i++)
+      {
+        const qpcvLOD::Range  &range = inRangeTable[i];
+        size_t  end = std::min(range.end, mDataNum);
+        if (end > range.begin)
+          func->glDrawArrays(GL_POINTS, (GLint )range.begin, (GLsizei )(end - range.begin));
+      }
+    }
+    releaseProgram(func);
+  }
+  // ---------------------------------------------------------------------------
+  // prepare
+  // ---------------------------------------------------------------------------
+  // Builds the program and uploads the parts of inRangeTable that are not on
+  // the GPU yet (draw() does it too). false when the program failed
+  bool  prepare(QOpenGLContext *inContext, const std::vector<qpcvLOD::Range> &inRangeTable)
+  {
+    if (initProgram(inContext) == false)
+      return false;
+    upload(inContext->extraFunctions(), inRangeTable);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // getVRAMUsed
+  // ---------------------------------------------------------------------------
+  // Bytes allocated for the records (the whole data once uploaded)
+  size_t  getVRAMUsed() const
+  {
+    return mVRAMUsed;
+  }
+  // ---------------------------------------------------------------------------
+  // getVertexBufferId
+  // ---------------------------------------------------------------------------
+  // The buffer of the records (0 before the first prepare()). Only the ranges
+  // given to prepare() or draw() are on it. Other layers draw the positions
+  // from it with their own vertex arrays (see qpcvScalarLayer)
+  GLuint  getVertexBufferId() const
+  {
+    if (mVAO.isCreated() == false)
+      return 0;
+    return mVertexBuffer.bufferId();
+  }
+  // ---------------------------------------------------------------------------
+  // bindProgram
+  // ---------------------------------------------------------------------------
+  // Sets up the program and the color map for other buffers of glXYZf_RGBAub
+  // or qpcvCompactPoint records (see setVertexFormat()), e.g. the chunks of
+  // qpcvChunkLayer. Call releaseProgram() after the draw calls. false when
+  // the program failed
+  bool  bindProgram(QOpenGLContext *inContext, const QMatrix4x4 &inMatrix,
+                    const DrawParam &inParam)
+  {
+    QOpenGLExtraFunctions *func = inContext->extraFunctions();
+    if (initProgram(inContext) == false)
+      return false;
+    if (inParam.colorMode == COLOR_MODE_MAP)
+      updateColorMap(func, inParam.colorMapIndex);
+
+    QVector3D axisMask(inParam.colorMapAxis == 0 ? 1.0f : 0.0f,
+                       inParam.colorMapAxis == 1 ? 1.0f : 0.0f,
+                       inParam.colorMapAxis == 2 ? 1.0f : 0.0f);
+    const float *color = inParam.singleColor;
+    func->glEnable(GL_DEPTH_TEST);
+    if (inContext->isOpenGLES() == false)
+      func->glEnable(GL_PROGRAM_POINT_SIZE);
+    func->glActiveTexture(GL_TEXTURE0);
+    func->glBindTexture(GL_TEXTURE_2D, mColorMapTexture);
+    mProgram->bind();
+    mProgram->setUniformValue("uMatrix", inMatrix);
+    mProgram->setUniformValue("uPointSize", inParam.pointSize);
+    mProgram->setUniformValue("uColorMode", inParam.colorMode);
+    mProgram->setUniformValue("uColor", QVector4D(color[0], color[1], color[2], 1.0f));
+    mProgram->setUniformValue("uAxisMask", axisMask);
+    mProgram->setUniformValue("uOffset", inParam.colorMapOffset);
+    mProgram->setUniformValue("uGain", inParam.colorMapGain);
+    mProgram->setUniformValue("uRepeatNum", (float )std::max(inParam.colorMapRepeatNum, 1));
+    mProgram->setUniformValue("uIsUnmappedShown", inParam.isUnmappedShown);
+    mProgram->setUniformValue("uColorMap", 0);
+    mProgram->setUniformValue("uIsCompact", false);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // setCompactTransform
+  // ---------------------------------------------------------------------------
+  // For the following draw calls of compact points (see setVertexFormat()),
+  // position = inOrigin + q * inStep. Call between bindProgram() and
+  // releaseProgram()
+  void  setCompactTransform(const GLfloat *inOrigin, const GLfloat *inStep)
+  {
+    mProgram->setUniformValue("uIsCompact", true);
+    mProgram->setUniformValue("uOrigin", QVector3D(inOrigin[0], inOrigin[1], inOrigin[2]));
+    mProgram->setUniformValue("uStep", QVector3D(inStep[0], inStep[1], inStep[2]));
+  }
+  // ---------------------------------------------------------------------------
+  // releaseProgram
+  // ---------------------------------------------------------------------------
+  void  releaseProgram(QOpenGLExtraFunctions *inFunc)
+  {
+    mProgram->release();
+    inFunc->glBindTexture(GL_TEXTURE_2D, 0);
+  }
+  // ---------------------------------------------------------------------------
+  // setVertexFormat
+  // ---------------------------------------------------------------------------
+  // The attributes of the program for the bound VAO and array buffer
+  static void setVertexFormat(QOpenGLExtraFunctions *inFunc, bool inIsCompact = false)
+  {
+    if (inIsCompact)
+    {
+      inFunc->glEnableVertexAttribArray(0);
+      inFunc->glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(qpcvCompactPoint),
+                                    (const void *)offsetof(qpcvCompactPoint, x));
+      inFunc->glEnableVertexAttribArray(1);
+      inFunc->glVertexAttribPointer(1, 1, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(qpcvCompactPoint),
+                                    (const void *)offsetof(qpcvCompactPoint, rgb));
+      return;
+    }
+    inFunc->glEnableVertexAttribArray(0);
+    inFunc->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ibc::gl::glXYZf_RGBAub),
+                                  (const void *)offsetof(ibc::gl::glXYZf_RGBAub, x));
+    inFunc->glEnableVertexAttribArray(1);
+    inFunc->glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ibc::gl::glXYZf_RGBAub),
+                                  (const void *)offsetof(ibc::gl::glXYZf_RGBAub, r));
+  }
+  // ---------------------------------------------------------------------------
+  // release
+  // ---------------------------------------------------------------------------
+  void  release(QOpenGLExtraFunctions *inFunc)
+  {
+    if (mVAO.isCreated())
+    {
+      mVAO.destroy();
+      mVertexBuffer.destroy();
+    }
+    mIsDataDirty = true;
+    mVRAMUsed = 0;
+    mUploadedTable.clear();
+    if (mColorMapTexture != 0)
+    {
+      inFunc->glDeleteTextures(1, &mColorMapTexture);
+      mColorMapTexture = 0;
+      mIsColorMapValid = false;
+    }
+    if (mProgram != NULL)
+    {
+      delete mProgram;
+      mProgram = NULL;
+    }
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  const ibc::gl::glXYZf_RGBAub  *mData;
+  size_t  mDataNum;
+  bool  mIsDataDirty;                           // The buffer needs an allocation
+  size_t  mVRAMUsed;
+  std::vector<qpcvLOD::Range> mUploadedTable;   // Sorted, not adjacent
+  QOpenGLShaderProgram  *mProgram;
+  bool  mIsProgramFailed;
+  QOpenGLVertexArrayObject  mVAO;
+  QOpenGLBuffer mVertexBuffer;
+  GLuint  mColorMapTexture;
+  bool  mIsColorMapValid;
+  ibc::image::ColorMap::ColorMapIndex mColorMapIndex;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // initProgram
+  // ---------------------------------------------------------------------------
+  bool  initProgram(QOpenGLContext *inContext)
+  {
+    if (mProgram != NULL)
+      return true;
+    if (mIsProgramFailed)
+      return false;
+    // A compact point (qpcvCompactPoint) has the 16 bit positions in aPos
+    // and the RGB565 color in aColor.x, both as unnormalized floats
+    static const char *vertexShaderStr =
+      "in vec3 aPos;\n"
+      "in vec4 aColor;\n"
+      "uniform mat4 uMatrix;\n"
+      "uniform float uPointSize;\n"
+      "uniform vec3 uAxisMask;\n"
+      "uniform float uOffset;\n"
+      "uniform float uGain;\n"
+      "uniform bool uIsCompact;\n"
+      "uniform vec3 uOrigin;\n"
+      "uniform vec3 uStep;\n"
+      "out vec4 vColor;\n"
+      "out float vValue;\n"
+      "void main()\n"
+      "{\n"
+      "  vec3 pos = aPos;\n"
+      "  vColor = aColor;\n"
+      "  if (uIsCompact)\n"
+      "  {\n"
+      "    pos = uOrigin + aPos * uStep;\n"
+      "    float rgb = aColor.x;\n"
+      "    vColor = vec4(floor(rgb / 2048.0) / 31.0, mod(floor(rgb / 32.0), 64.0) / 63.0,\n"
+      "                  mod(rgb, 32.0) / 31.0, 1.0);\n"
+      "  }\n"
+      "  gl_Position = uMatrix * vec4(pos, 1.0);\n"
+      "  gl_PointSize = uPointSize;\n"
+      "  vValue = (dot(pos, uAxisMask) - uOffset) * uGain;\n"
+      "}\n";
+    static const char *fragmentShaderStr =
+      "in vec4 vColor;\n"
+      "in float vValue;\n"
+      "uniform int uColorMode;\n"
+      "uniform vec4 uColor;\n"
+      "uniform float uRepeatNum;\n"
+      "uniform bool uIsUnmappedShown;\n"
+      "uniform sampler2D uColorMap;\n"
+      "out vec4 fragColor;\n"
+      "void main()\n"
+      "{\n"
+      "  if (uColorMode == 2)\n"
+      "  {\n"
+      "    fragColor = vec4(vColor.rgb, 1.0);\n"
+      "    return;\n"
+      "  }\n"
+      "  if (uColorMode != 1)\n"
+      "  {\n"
+      "    fragColor = uColor;\n"
+      "    return;\n"
+      "  }\n"
+      "  if (isnan(vValue))\n"
+      "    discard;\n"
+      "  if (vValue < 0.0 || vValue > 1.0)\n"
+      "  {\n"
+      "    if (uIsUnmappedShown == false)\n"
+      "      discard;\n"
+      "    fragColor = uColor;\n"
+      "    return;\n"
+      "  }\n"
+      "  float t = vValue;\n"
+      "  if (uRepeatNum > 1.0)\n"
+      "    t = fract(t * uRepeatNum);\n"
+      "  float size = float(textureSize(uColorMap, 0).x);\n"
+      "  fragColor = vec4(texture(uColorMap, vec2((t * (size - 1.0) + 0.5) / size, 0.5)).rgb, 1.0);\n"
+      "}\n";
+    QByteArray  versionStr = inContext->isOpenGLES() ?
+                               "#version 300 es\nprecision highp float;\n" : "#version 330 core\n";
+    QOpenGLShaderProgram  *program = new QOpenGLShaderProgram();
+    if (program->addShaderFromSourceCode(QOpenGLShader::Vertex, versionStr + vertexShaderStr) == false ||
+        program->addShaderFromSourceCode(QOpenGLShader::Fragment, versionStr + fragmentShaderStr) == false)
+    {
+      delete program;
+      mIsProgramFailed = true;
+      return false;
+    }
+    program->bindAttributeLocation("aPos", 0);
+    program->bindAttributeLocation("aColor", 1);
+    if (program->link() == false)
+    {
+      delete program;
+      mIsProgramFailed = true;
+      return false;
+    }
+    mProgram = program;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // upload
+  // ---------------------------------------------------------------------------
+  // Uploads the parts of inRangeTable that are not on the GPU yet
+  void  upload(QOpenGLExtraFunctions *inFunc, const std::vector<qpcvLOD::Range> &inRangeTable)
+  {
+    if (mVAO.isCreated() == false)
+    {
+      mVAO.create();
+      mVertexBuffer.create();
+      QOpenGLVertexArrayObject::Binder  binder(&mVAO);
+      mVertexBuffer.bind();
+      setVertexFormat(inFunc);
+    }
+    mVertexBuffer.bind();
+    if (mIsDataDirty)
+    {
+      // glBufferData() directly, QOpenGLBuffer::allocate() takes an int size
+      mIsDataDirty = false;
+      mUploadedTable.clear();
+      inFunc->glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr )(mDataNum * sizeof(ibc::gl::glXYZf_RGBAub)),
+                           NULL, GL_STATIC_DRAW);
+      mVRAMUsed = mDataNum * sizeof(ibc::gl::glXYZf_RGBAub);
+    }
+    for (size_t i = 0; i < inRangeTable.size(); i++)
+    {
+      qpcvLOD::Range  range = inRangeTable[i];
+      range.end = std::min(range.end, mDataNum);
+      if (range.end <= range.begin)
+        continue;
+      // The uploaded ranges overlapping or touching the range are merged into it
+      auto  first = std::lower_bound(mUploadedTable.begin(), mUploadedTable.end(), range.begin,
+                                     [](const qpcvLOD::Range &inUploaded, size_t inBegin)
+                                     {
+                                       return inUploaded.end < inBegin;
+                                     });
+      auto  last = first;
+      size_t  pos = range.begin;
+      while (last != mUploadedTable.end() && last->begin <= range.end)
+      {
+        if (last->begin > pos)
+          uploadRecords(inFunc, pos, last->begin);
+        pos = std::max(pos, last->end);
+        range.begin = std::min(range.begin, last->begin);
+        range.end = std::max(range.end, last->end);
+        last++;
+      }
+      if (pos < range.end)
+        uploadRecords(inFunc, pos, range.end);
+      first = mUploadedTable.erase(first, last);
+      mUploadedTable.insert(first, range);
+    }
+    mVertexBuffer.release();
+  }
+  // ---------------------------------------------------------------------------
+  // uploadRecords
+  // ---------------------------------------------------------------------------
+  // The buffer must be bound
+  void  uploadRecords(QOpenGLExtraFunctions *inFunc, size_t inBegin, size_t inEnd)
+  {
+    inFunc->glBufferSubData(GL_ARRAY_BUFFER,
+                            (GLintptr )(inBegin * sizeof(ibc::gl::glXYZf_RGBAub)),
+                            (GLsizeiptr )((inEnd - inBegin) * sizeof(ibc::gl::glXYZf_RGBAub)),
+                            mData + inBegin);
+  }
+  // ---------------------------------------------------------------------------
+  // updateColorMap
+  // ---------------------------------------------------------------------------
+  // The same table as GLPointCloudView (COLOR_MAP_SIZE x 1 RGB texture)
+  void  updateColorMap(QOpenGLExtraFunctions *inFunc, ibc::image::ColorMap::ColorMapIndex inIndex)
+  {
+    if (mIsColorMapValid && mColorMapIndex == inIndex)
+      return;
+    unsigned char table[COLOR_MAP_SIZE * 3];
+    ibc::image::ColorMap::getColorMap(inIndex, COLOR_MAP_SIZE, table);
+    if (mColorMapTexture == 0)
+    {
+      inFunc->glGenTextures(1, &mColorMapTexture);
+      inFunc->glBindTexture(GL_TEXTURE_2D, mColorMapTexture);
+      inFunc->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      inFunc->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      inFunc->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      inFunc->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    else
+      inFunc->glBindTexture(GL_TEXTURE_2D, mColorMapTexture);
+    inFunc->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    inFunc->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, COLOR_MAP_SIZE, 1, 0,
+                         GL_RGB, GL_UNSIGNED_BYTE, table);
+    inFunc->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    mColorMapIndex = inIndex;
+    mIsColorMapValid = true;
+  }
+};
+
+#endif  // #ifdef QPCV_POINT_LAYER_H_
@@ -0,0 +1,135 @@
+// =============================================================================
+//  qpcv_quantize.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_quantize.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    8 byte quantized point format
+*/
+
+#ifndef QPCV_QUANTIZE_H_
+#define QPCV_QUANTIZE_H_
+
+// Includes --------------------------------------------------------------------
+#include <math.h>
+#include <stdint.h>
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvCompactPoint struct
+// -----------------------------------------------------------------------------
+// 16 bit positions relative to an origin (see qpcvQuantizer) and a RGB565
+// color. Half the size of glXYZf_RGBAub (alpha is always 255)
+struct qpcvCompactPoint
+{
+  uint16_t  x, y, z;
+  uint16_t  rgb;
+};
+
+// -----------------------------------------------------------------------------
+// qpcvQuantizer class
+// -----------------------------------------------------------------------------
+// position = origin + q * step, where the origin and the step come from the
+// bounding box of a block of points (a chunk). The error of each axis is at
+// most step / 2
+class qpcvQuantizer
+{
+public:
+  static const int  MAX_VALUE = 65535;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // calcStep
+  // ---------------------------------------------------------------------------
+  static void calcStep(const GLfloat *inMinMax, GLfloat *outOrigin, GLfloat *outStep)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      outOrigin[i] = inMinMax[i * 2 + 0];
+      double  range = inMinMax[i * 2 + 1] - inMinMax[i * 2 + 0];
+      if (!(range > 0))
+        range = 0;
+      outStep[i] = (GLfloat )(range / MAX_VALUE);
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // getMaxError
+  // ---------------------------------------------------------------------------
+  static double getMaxError(const GLfloat *inStep)
+  {
+    double  error = 0;
+    for (int i = 0; i < 3; i++)
+      if (inStep[i] / 2.0 > error)
+        error = inStep[i] / 2.0;
+    return error;
+  }
+  // ---------------------------------------------------------------------------
+  // encode
+  // ---------------------------------------------------------------------------
+  // Points outside the box are clamped to it
+  static void encode(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                     const GLfloat *inOrigin, const GLfloat *inStep,
+                     qpcvCompactPoint *outData)
+  {
+    double  scale[3];
+    for (int i = 0; i < 3; i++)
+      scale[i] = (inStep[i] > 0) ? 1.0 / inStep[i] : 0;
+    for (size_t i = 0; i < inNum; i++)
+    {
+      const GLfloat *v = &(inData[i].x);
+      uint16_t  q[3];
+      for (int j = 0; j < 3; j++)
+      {
+        double  d = (v[j] - inOrigin[j]) * scale[j] + 0.5;
+        if (!(d > 0))   // Also catches NaN
+          d = 0;
+        if (d > MAX_VALUE)
+          d = MAX_VALUE;
+        q[j] = (uint16_t )d;
+      }
+      outData[i].x = q[0];
+      outData[i].y = q[1];
+      outData[i].z = q[2];
+      outData[i].rgb = (uint16_t )(((inData[i].r >> 3) << 11) |
+                                   ((inData[i].g >> 2) << 5) |
+                                    (inData[i].b >> 3));
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // decode
+  // ---------------------------------------------------------------------------
+  static void decode(const qpcvCompactPoint *inData, size_t inNum,
+                     const GLfloat *inOrigin, const GLfloat *inStep,
+                     ibc::gl::glXYZf_RGBAub *outData)
+  {
+    for (size_t i = 0; i < inNum; i++)
+    {
+      outData[i].x = inOrigin[0] + inData[i].x * inStep[0];
+      outData[i].y = inOrigin[1] + inData[i].y * inStep[1];
+      outData[i].z = inOrigin[2] + inData[i].z * inStep[2];
+      uint16_t  rgb = inData[i].rgb;
+      // Replicate the high bits so 0x1F / 0x3F map to 255
+      GLubyte r = (GLubyte )((rgb >> 11) & 0x1F);
+      GLubyte g = (GLubyte )((rgb >> 5) & 0x3F);
+      GLubyte b = (GLubyte )(rgb & 0x1F);
+      outData[i].r = (GLubyte )((r << 3) | (r >> 2));
+      outData[i].g = (GLubyte )((g << 2) | (g >> 4));
+      outData[i].b = (GLubyte )((b << 3) | (b >> 2));
+      outData[i].a = 255;
+    }
+  }
+};
+
+#endif  // #ifdef QPCV_QUANTIZE_H_
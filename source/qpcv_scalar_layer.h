@@ -0,0 +1,395 @@
+// =============================================================================
+//  qpcv_scalar_layer.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_scalar_layer.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Points colored by a scalar attribute (one GPU buffer per attribute)
+*/
+
+#ifndef QPCV_SCALAR_LAYER_H_
+#define QPCV_SCALAR_LAYER_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <stddef.h>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <QMatrix4x4>
+#include "qpcv_lod.h"
+#include "qpcv_point_layer.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+#include "ibc/image/color_map.h"
+
+#ifndef GL_PROGRAM_POINT_SIZE
+#define GL_PROGRAM_POINT_SIZE 0x8642
+#endif
+
+// -----------------------------------------------------------------------------
+// qpcvScalarLayer class
+// -----------------------------------------------------------------------------
+// The color map of GLPointCloudView works on the x, y or z axis only, so the
+// points colored by another attribute are drawn here with their own program.
+// The positions are read from the buffer of qpcvPointLayer (no copy of the
+// records), and each attribute gets a float buffer of its own that stays on
+// the GPU until the point data is replaced. Switching the attribute only
+// changes the vertex attribute pointer. The values given to
+// setAttributeData() are freed right after the upload. The functions taking
+// QOpenGLExtraFunctions need the context current.
+class qpcvScalarLayer
+{
+public:
+  // Constants -----------------------------------------------------------------
+  static const int  COLOR_MAP_SIZE = 256;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvScalarLayer
+  // ---------------------------------------------------------------------------
+  qpcvScalarLayer()
+  {
+    mDataNum = 0;
+    mPositionBufferId = 0;
+    mIsReleasePending = false;
+    mCurrentIndex = -1;
+    mBoundIndex = -1;
+    mProgram = NULL;
+    mIsProgramFailed = false;
+    mColorMapTexture = 0;
+    mIsColorMapValid = false;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // setPointNum
+  // ---------------------------------------------------------------------------
+  // The point data was replaced. Drops all the attributes (their buffers are
+  // released at the next draw)
+  void  setPointNum(size_t inNum)
+  {
+    mDataNum = inNum;
+    mIsReleasePending = true;
+    mPendingTable.clear();
+    mCurrentIndex = -1;
+  }
+  // ---------------------------------------------------------------------------
+  // setAttributeData
+  // ---------------------------------------------------------------------------
+  // ioValues (one value per point) is taken over and uploaded at the next draw
+  void  setAttributeData(int inIndex, std::vector<float> *ioValues)
+  {
+    if (inIndex < 0)
+      return;
+    if ((size_t )inIndex >= mPendingTable.size())
+      mPendingTable.resize(inIndex + 1);
+    mPendingTable[inIndex].swap(*ioValues);
+  }
+  // ---------------------------------------------------------------------------
+  // hasAttributeData
+  // ---------------------------------------------------------------------------
+  bool  hasAttributeData(int inIndex) const
+  {
+    if (inIndex < 0)
+      return false;
+    if ((size_t )inIndex < mPendingTable.size() && mPendingTable[inIndex].size() != 0)
+      return true;
+    return (mIsReleasePending == false && (size_t )inIndex < mBufferTable.size() &&
+            mBufferTable[inIndex] != NULL);
+  }
+  // ---------------------------------------------------------------------------
+  // setCurrentAttribute
+  // ---------------------------------------------------------------------------
+  // -1 : none (the points are drawn by GLPointCloudView)
+  void  setCurrentAttribute(int inIndex)
+  {
+    mCurrentIndex = inIndex;
+  }
+  // ---------------------------------------------------------------------------
+  // getCurrentAttribute
+  // ---------------------------------------------------------------------------
+  int getCurrentAttribute() const
+  {
+    return mCurrentIndex;
+  }
+  // ---------------------------------------------------------------------------
+  // isEnabled
+  // ---------------------------------------------------------------------------
+  bool  isEnabled() const
+  {
+    return (mIsProgramFailed == false && mDataNum != 0 && hasAttributeData(mCurrentIndex));
+  }
+  // ---------------------------------------------------------------------------
+  // draw
+  // ---------------------------------------------------------------------------
+  // Draws the ranges of the points. inPointLayer has the point data and
+  // uploads the ranges that are not on the GPU yet. The value v of a point is
+  // mapped by (v - inOffset) * inGain to the color map (like the color map of
+  // GLPointCloudView). NaN values are not drawn
+  void  draw(QOpenGLContext *inContext, const QMatrix4x4 &inMatrix,
+             qpcvPointLayer *inPointLayer,
+             const std::vector<qpcvLOD::Range> &inRangeTable,
+             float inPointSize, float inOffset, float inGain, int inRepeatNum,
+             ibc::image::ColorMap::ColorMapIndex inColorMapIndex)
+  {
+    QOpenGLExtraFunctions *func = inContext->extraFunctions();
+    if (initProgram(inContext) == false ||
+        inPointLayer->prepare(inContext, inRangeTable) == false)
+      return;
+    upload(func);
+    if (mCurrentIndex < 0 || (size_t )mCurrentIndex >= mBufferTable.size() ||
+        mBufferTable[mCurrentIndex] == NULL)
+      return;
+    updateColorMap(func, inColorMapIndex);
+
+    QOpenGLVertexArrayObject::Binder  binder(&mVAO);
+    GLuint  positionBufferId = inPointLayer->getVertexBufferId();
+    if (mPositionBufferId != positionBufferId)
+    {
+      // The point layer keeps the buffer object when the data is replaced
+      func->glBindBuffer(GL_ARRAY_BUFFER, positionBufferId);
+      func->glEnableVertexAttribArray(0);
+      func->glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ibc::gl::glXYZf_RGBAub),
+                                  (const void *)offsetof(ibc::gl::glXYZf_RGBAub, x));
+      mPositionBufferId = positionBufferId;
+    }
+    if (mBoundIndex != mCurrentIndex)
+    {
+      // The only work of an attribute switch
+      mBufferTable[mCurrentIndex]->bind();
+      func->glEnableVertexAttribArray(1);
+      func->glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, sizeof(float), NULL);
+      mBoundIndex = mCurrentIndex;
+    }
+    func->glEnable(GL_DEPTH_TEST);
+    if (inContext->isOpenGLES() == false)
+      func->glEnable(GL_PROGRAM_POINT_SIZE);
+    func->glActiveTexture(GL_TEXTURE0);
+    func->glBindTexture(GL_TEXTURE_2D, mColorMapTexture);
+    mProgram->bind();
+    mProgram->setUniformValue("uMatrix", inMatrix);
+    mProgram->setUniformValue("uPointSize", inPointSize);
+    mProgram->setUniformValue("uOffset", inOffset);
+    mProgram->setUniformValue("uGain", inGain);
+    mProgram->setUniformValue("uRepeatNum", (float )std::max(inRepeatNum, 1));
+    mProgram->setUniformValue("uColorMap", 0);
+    for (size_t i = 0; i < inRangeTable.size(); i++)
+    {
+      const qpcvLOD::Range  &range = inRangeTable[i];
+      size_t  end = std::min(range.end, mDataNum);
+      if (end > range.begin)
+        func->glDrawArrays(GL_POINTS, (GLint )range.begin, (GLsizei )(end - range.begin));
+    }
+    mProgram->release();
+    func->glBindTexture(GL_TEXTURE_2D, 0);
+  }
+  // ---------------------------------------------------------------------------
+  // getVRAMUsed
+  // ---------------------------------------------------------------------------
+  // Bytes allocated for the attribute buffers
+  size_t  getVRAMUsed() const
+  {
+    size_t  size = 0;
+    for (size_t i = 0; i < mBufferSizeTable.size(); i++)
+      size += mBufferSizeTable[i];
+    return size;
+  }
+  // ---------------------------------------------------------------------------
+  // release
+  // ---------------------------------------------------------------------------
+  // Also when the buffer of the point layer is released
+  void  release(QOpenGLExtraFunctions *inFunc)
+  {
+    releaseBuffers();
+    if (mVAO.isCreated())
+      mVAO.destroy();
+    mPositionBufferId = 0;
+    if (mColorMapTexture != 0)
+    {
+      inFunc->glDeleteTextures(1, &mColorMapTexture);
+      mColorMapTexture = 0;
+      mIsColorMapValid = false;
+    }
+    if (mProgram != NULL)
+    {
+      delete mProgram;
+      mProgram = NULL;
+    }
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  size_t  mDataNum;
+  GLuint  mPositionBufferId;  // The buffer of qpcvPointLayer bound to mVAO
+  bool  mIsReleasePending;    // mBufferTable belongs to the previous data
+  std::vector<std::vector<float>> mPendingTable;
+  std::vector<QOpenGLBuffer *>  mBufferTable;
+  std::vector<size_t> mBufferSizeTable;   // Bytes of each buffer
+  int mCurrentIndex;
+  int mBoundIndex;            // The attribute bound to mVAO
+  QOpenGLShaderProgram  *mProgram;
+  bool  mIsProgramFailed;
+  QOpenGLVertexArrayObject  mVAO;
+  GLuint  mColorMapTexture;
+  bool  mIsColorMapValid;
+  ibc::image::ColorMap::ColorMapIndex mColorMapIndex;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // initProgram
+  // ---------------------------------------------------------------------------
+  bool  initProgram(QOpenGLContext *inContext)
+  {
+    if (mProgram != NULL)
+      return true;
+    if (mIsProgramFailed)
+      return false;
+    static const char *vertexShaderStr =
+      "in vec3 aPos;\n"
+      "in float aValue;\n"
+      "uniform mat4 uMatrix;\n"
+      "uniform float uPointSize;\n"
+      "uniform float uOffset;\n"
+      "uniform float uGain;\n"
+      "out float vValue;\n"
+      "void main()\n"
+      "{\n"
+      "  gl_Position = uMatrix * vec4(aPos, 1.0);\n"
+      "  gl_PointSize = uPointSize;\n"
+      "  vValue = (aValue - uOffset) * uGain;\n"
+      "}\n";
+    static const char *fragmentShaderStr =
+      "in float vValue;\n"
+      "uniform float uRepeatNum;\n"
+      "uniform sampler2D uColorMap;\n"
+      "out vec4 fragColor;\n"
+      "void main()\n"
+      "{\n"
+      "  if (isnan(vValue))\n"
+      "    discard;\n"
+      "  float t = clamp(vValue, 0.0, 1.0);\n"
+      "  if (uRepeatNum > 1.0)\n"
+      "    t = fract(t * uRepeatNum);\n"
+      "  float size = float(textureSize(uColorMap, 0).x);\n"
+      "  fragColor = vec4(texture(uColorMap, vec2((t * (size - 1.0) + 0.5) / size, 0.5)).rgb, 1.0);\n"
+      "}\n";
+    QByteArray  versionStr = inContext->isOpenGLES() ?
+                               "#version 300 es\nprecision highp float;\n" : "#version 330 core\n";
+    QOpenGLShaderProgram  *program = new QOpenGLShaderProgram();
+    if (program->addShaderFromSourceCode(QOpenGLShader::Vertex, versionStr + vertexShaderStr) == false ||
+        program->addShaderFromSourceCode(QOpenGLShader::Fragment, versionStr + fragmentShaderStr) == false)
+    {
+      delete program;
+      mIsProgramFailed = true;
+      return false;
+    }
+    program->bindAttributeLocation("aPos", 0);
+    program->bindAttributeLocation("aValue", 1);
+    if (program->link() == false)
+    {
+      delete program;
+      mIsProgramFailed = true;
+      return false;
+    }
+    mProgram = program;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // upload
+  // ---------------------------------------------------------------------------
+  void  upload(QOpenGLExtraFunctions *inFunc)
+  {
+    if (mIsReleasePending)
+    {
+      releaseBuffers();
+      mIsReleasePending = false;
+    }
+    if (mVAO.isCreated() == false)
+      mVAO.create();
+    QOpenGLVertexArrayObject::Binder  binder(&mVAO);
+    for (size_t i = 0; i < mPendingTable.size(); i++)
+    {
+      if (mPendingTable[i].size() == 0)
+        continue;
+      if (i >= mBufferTable.size())
+      {
+        mBufferTable.resize(i + 1, NULL);
+        mBufferSizeTable.resize(i + 1, 0);
+      }
+      if (mBufferTable[i] == NULL)
+      {
+        mBufferTable[i] = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+        mBufferTable[i]->create();
+      }
+      // glBufferData() directly, QOpenGLBuffer::allocate() takes an int size
+      mBufferTable[i]->bind();
+      inFunc->glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr )(mPendingTable[i].size() * sizeof(float)),
+                           mPendingTable[i].data(), GL_STATIC_DRAW);
+      mBufferSizeTable[i] = mPendingTable[i].size() * sizeof(float);
+      std::vector<float>().swap(mPendingTable[i]);
+      if ((int )i == mBoundIndex)
+        mBoundIndex = -1;
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // releaseBuffers
+  // ---------------------------------------------------------------------------
+  void  releaseBuffers()
+  {
+    for (size_t i = 0; i < mBufferTable.size(); i++)
+    {
+      if (mBufferTable[i] == NULL)
+        continue;
+      mBufferTable[i]->destroy();
+      delete mBufferTable[i];
+    }
+    mBufferTable.clear();
+    mBufferSizeTable.clear();
+    mBoundIndex = -1;
+  }
+  // ---------------------------------------------------------------------------
+  // updateColorMap
+  // ---------------------------------------------------------------------------
+  // The same table as GLPointCloudView (COLOR_MAP_SIZE x 1 RGB texture)
+  void  updateColorMap(QOpenGLExtraFunctions *inFunc, ibc::image::ColorMap::ColorMapIndex inIndex)
+  {
+    if (mIsColorMapValid && mColorMapIndex == inIndex)
+      return;
+    unsigned char table[COLOR_MAP_SIZE * 3];
+    ibc::image::ColorMap::getColorMap(inIndex, COLOR_MAP_SIZE, table);
+    if (mColorMapTexture == 0)
+    {
+      inFunc->glGenTextures(1, &mColorMapTexture);
+      inFunc->glBindTexture(GL_TEXTURE_2D, mColorMapTexture);
+      inFunc->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      inFunc->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      inFunc->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      inFunc->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    else
+      inFunc->glBindTexture(GL_TEXTURE_2D, mColorMapTexture);
+    inFunc->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    inFunc->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, COLOR_MAP_SIZE, 1, 0,
+                         GL_RGB, GL_UNSIGNED_BYTE, table);
+    inFunc->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    mColorMapIndex = inIndex;
+    mIsColorMapValid = true;
+  }
+};
+
+#endif  // #ifdef QPCV_SCALAR_LAYER_H_
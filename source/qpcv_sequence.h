@@ -0,0 +1,378 @@
+// =============================================================================
+//  qpcv_sequence.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_sequence.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    PLY sequence playback with a decode-ahead prefetcher
+*/
+
+#ifndef QPCV_SEQUENCE_H_
+#define QPCV_SEQUENCE_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <new>
+#include <stdint.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#endif
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QRegularExpression>
+#include "qpcv_ply_layout.h"
+#include "qpcv_ply_decoder.h"
+#include "qpcv_ply_ascii_decoder.h"
+#include "qpcv_bounds.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvSequencePlayer class
+// -----------------------------------------------------------------------------
+// Decodes the frames following the current one into a fixed pool of buffers
+// (prefetch number + 1 for the displayed frame). The buffers only grow, so
+// after the first few frames playback does not allocate at all. The frame
+// shown by the GUI is never reused until the next acquireFrame() call
+class qpcvSequencePlayer : public QThread
+{
+Q_OBJECT
+
+public:
+  // Constants -----------------------------------------------------------------
+  static const int  DEFAULT_PREFETCH_NUM = 8;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvSequencePlayer
+  // ---------------------------------------------------------------------------
+  qpcvSequencePlayer(const QStringList &inFileList, int inPrefetchNum, int inDecodeThreadNum,
+                     QObject *parent = Q_NULLPTR)
+  : QThread(parent)
+  {
+    mFileList = inFileList;
+    mPrefetchNum = inPrefetchNum;
+    if (mPrefetchNum < 1)
+      mPrefetchNum = DEFAULT_PREFETCH_NUM;
+    if (mPrefetchNum > mFileList.size())
+      mPrefetchNum = std::max(1, (int )mFileList.size());
+    mDecodeThreadNum = inDecodeThreadNum;
+    mCurrentFrame = 0;
+    mDisplaySlot = -1;
+    mSlotTable.resize(mPrefetchNum + 1);
+    for (size_t i = 0; i < mSlotTable.size(); i++)
+    {
+      mSlotTable[i].frameIndex = -1;
+      mSlotTable[i].isReady = false;
+      mSlotTable[i].num = 0;
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvSequencePlayer
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvSequencePlayer()
+  {
+    requestInterruption();
+    mMutex.lock();
+    mCondition.wakeAll();
+    mMutex.unlock();
+    wait();
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // findFrameFiles
+  // ---------------------------------------------------------------------------
+  // The files next to inFileName which only differ in the last number of the
+  // name (frame_00001.ply, frame_00002.ply ...), sorted by that number
+  static QStringList  findFrameFiles(const QString &inFileName)
+  {
+    QFileInfo fileInfo(inFileName);
+    QRegularExpression  regex("^(.*?)(\\d+)(\\D*)$");
+    QRegularExpressionMatch match = regex.match(fileInfo.fileName());
+    if (match.hasMatch() == false)
+      return QStringList() << inFileName;
+    QString prefix = match.captured(1);
+    QString suffix = match.captured(3);
+    QRegularExpression  frameRegex("^" + QRegularExpression::escape(prefix) +
+                                   "(\\d+)" + QRegularExpression::escape(suffix) + "$");
+    QDir  dir = fileInfo.absoluteDir();
+    QStringList nameList = dir.entryList(QDir::Files);
+    std::vector<std::pair<qulonglong, QString> >  frameTable;
+    for (int i = 0; i < nameList.size(); i++)
+    {
+      QRegularExpressionMatch frameMatch = frameRegex.match(nameList[i]);
+      if (frameMatch.hasMatch())
+        frameTable.push_back(std::make_pair(frameMatch.captured(1).toULongLong(),
+                                            dir.filePath(nameList[i])));
+    }
+    std::sort(frameTable.begin(), frameTable.end());
+    QStringList fileList;
+    for (size_t i = 0; i < frameTable.size(); i++)
+      fileList << frameTable[i].second;
+    return fileList;
+  }
+  // ---------------------------------------------------------------------------
+  // getFrameNum
+  // ---------------------------------------------------------------------------
+  int getFrameNum() const
+  {
+    return mFileList.size();
+  }
+  // ---------------------------------------------------------------------------
+  // getFileName
+  // ---------------------------------------------------------------------------
+  const QString &getFileName(int inIndex) const
+  {
+    return mFileList[inIndex];
+  }
+  // ---------------------------------------------------------------------------
+  // setCurrentFrame
+  // ---------------------------------------------------------------------------
+  // The prefetcher decodes inIndex and the following frames (wrapping around)
+  void  setCurrentFrame(int inIndex)
+  {
+    QMutexLocker  locker(&mMutex);
+    mCurrentFrame = inIndex;
+    mCondition.wakeAll();
+  }
+  // ---------------------------------------------------------------------------
+  // isFrameReady
+  // ---------------------------------------------------------------------------
+  bool  isFrameReady(int inIndex)
+  {
+    QMutexLocker  locker(&mMutex);
+    return (findSlot(inIndex) >= 0);
+  }
+  // ---------------------------------------------------------------------------
+  // acquireFrame
+  // ---------------------------------------------------------------------------
+  // Returns false when the frame is not decoded yet. The returned data stays
+  // valid until the next successful acquireFrame() call
+  bool  acquireFrame(int inIndex, ibc::gl::glXYZf_RGBAub **outData, size_t *outNum,
+                     GLfloat *outMinMax)
+  {
+    QMutexLocker  locker(&mMutex);
+    int slot = findSlot(inIndex);
+    if (slot < 0)
+      return false;
+    mDisplaySlot = slot;
+    *outData = mSlotTable[slot].buffer.data();
+    *outNum = mSlotTable[slot].num;
+    for (int i = 0; i < 6; i++)
+      outMinMax[i] = mSlotTable[slot].minMax[i];
+    mCondition.wakeAll();
+    return true;
+  }
+
+signals:
+  void  frameDecoded(int inIndex);
+  void  errorOccurred(const QString &inErrorStr);
+
+protected:
+  struct Slot
+  {
+    int frameIndex;
+    bool  isReady;
+    std::vector<ibc::gl::glXYZf_RGBAub> buffer;
+    size_t  num;
+    GLfloat minMax[6];
+  };
+
+  // Member variables ----------------------------------------------------------
+  QStringList mFileList;
+  int mPrefetchNum;
+  int mDecodeThreadNum;
+  QMutex  mMutex;
+  QWaitCondition  mCondition;
+  int mCurrentFrame;
+  int mDisplaySlot;
+  std::vector<Slot> mSlotTable;
+
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  virtual void  run()
+  {
+    while (isInterruptionRequested() == false)
+    {
+      int frameIndex, slot;
+      {
+        QMutexLocker  locker(&mMutex);
+        if (planNextFrame(&frameIndex, &slot) == false)
+        {
+          mCondition.wait(&mMutex);
+          continue;
+        }
+        mSlotTable[slot].frameIndex = frameIndex;
+        mSlotTable[slot].isReady = false;
+      }
+      // The slot is ours until it is marked ready
+      Slot  &target = mSlotTable[slot];
+      std::string errorStr;
+      if (decodeFrame(mFileList[frameIndex], &target, &errorStr) == false)
+      {
+        target.num = 0;
+        emit errorOccurred(QString("%1: %2").arg(mFileList[frameIndex])
+                                            .arg(QString(errorStr.c_str())));
+      }
+      {
+        QMutexLocker  locker(&mMutex);
+        target.isReady = true;
+      }
+      emit frameDecoded(frameIndex);
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // findSlot
+  // ---------------------------------------------------------------------------
+  // Call with mMutex locked
+  int findSlot(int inFrameIndex) const
+  {
+    for (size_t i = 0; i < mSlotTable.size(); i++)
+      if (mSlotTable[i].frameIndex == inFrameIndex && mSlotTable[i].isReady)
+        return (int )i;
+    return -1;
+  }
+  // ---------------------------------------------------------------------------
+  // planNextFrame
+  // ---------------------------------------------------------------------------
+  // The first frame of the prefetch window which is not decoded yet, and a
+  // slot that holds no frame of the window. Call with mMutex locked
+  bool  planNextFrame(int *outFrameIndex, int *outSlot) const
+  {
+    int frameNum = mFileList.size();
+    if (frameNum == 0)
+      return false;
+    *outFrameIndex = -1;
+    for (int i = 0; i < mPrefetchNum && *outFrameIndex < 0; i++)
+    {
+      int frameIndex = (mCurrentFrame + i) % frameNum;
+      bool  isFound = false;
+      for (size_t j = 0; j < mSlotTable.size(); j++)
+        if (mSlotTable[j].frameIndex == frameIndex)
+          isFound = true;
+      if (isFound == false)
+        *outFrameIndex = frameIndex;
+    }
+    if (*outFrameIndex < 0)
+      return false;
+    for (size_t i = 0; i < mSlotTable.size(); i++)
+    {
+      if ((int )i == mDisplaySlot)
+        continue;
+      int frameIndex = mSlotTable[i].frameIndex;
+      int distance = (frameIndex - mCurrentFrame + frameNum) % frameNum;
+      if (frameIndex < 0 || distance >= mPrefetchNum)
+      {
+        *outSlot = (int )i;
+        return true;
+      }
+    }
+    return false;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeFrame
+  // ---------------------------------------------------------------------------
+  // Same decoders as qpcvLoader::loadMapped(), but into the slot buffer
+  bool  decodeFrame(const QString &inFileName, Slot *ioSlot, std::string *outErrorStr)
+  {
+    QFile file(inFileName);
+    if (file.open(QIODevice::ReadOnly) == false || file.size() == 0)
+    {
+      *outErrorStr = "Can't open the file";
+      return false;
+    }
+    qint64  fileSize = file.size();
+    const unsigned char *filePtr = file.map(0, fileSize);
+    if (filePtr == NULL)
+    {
+      *outErrorStr = "Can't map the file";
+      return false;
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    posix_madvise((void *)filePtr, (size_t )fileSize, POSIX_MADV_SEQUENTIAL);
+#endif
+    qpcvPLYLayout layout;
+    size_t  vertexIndex, vertexOffset = 0;
+    qpcvPLYDecoder::VertexMap vertexMap;
+    if (layout.parse(filePtr, (size_t )fileSize) == false ||
+        layout.findElementIndex("vertex", &vertexIndex) == false ||
+        (layout.isBinary() &&
+         layout.getBinaryElementOffset(vertexIndex, &vertexOffset) == false) ||
+        qpcvPLYDecoder::prepareVertexMap(layout.getElement(vertexIndex), &vertexMap) == false)
+    {
+      *outErrorStr = "Unsupported PLY file";
+      return false;
+    }
+    const qpcvPLYLayout::Element  &vertex = layout.getElement(vertexIndex);
+    size_t  bodyOffset = layout.getHeaderSize() + vertexOffset;
+    if (layout.isBinary() && vertex.recordSize == 0)
+    {
+      *outErrorStr = "Binary vertices with list properties are not supported";
+      return false;
+    }
+    // Division, so a huge vertex count in the header can not wrap around
+    if (layout.isBinary() &&
+        (bodyOffset > (size_t )fileSize ||
+         vertex.count > ((size_t )fileSize - bodyOffset) / vertex.recordSize))
+    {
+      *outErrorStr = "The PLY file is truncated";
+      return false;
+    }
+    try
+    {
+      if (ioSlot->buffer.size() < vertex.count)
+        ioSlot->buffer.resize(vertex.count);
+    }
+    catch (const std::bad_alloc &)
+    {
+      *outErrorStr = "Can't allocate the frame buffer";
+      return false;
+    }
+
+    const unsigned char *records = filePtr + bodyOffset;
+    qpcvBounds  bounds;
+    bool  result;
+    if (layout.isBinary())
+    {
+      result = qpcvPLYDecoder::decodeBinaryVerticesParallel(
+                  vertexMap, records, layout.needsByteSwap(),
+                  vertex.count, ioSlot->buffer.data(), &bounds, mDecodeThreadNum);
+    }
+    else
+    {
+      const std::string &headerStr = layout.getHeaderStr();
+      size_t  firstLineNum = std::count(headerStr.begin(), headerStr.end(), '\n') + 1;
+      result = qpcvPLYAsciiDecoder::decodeVerticesParallel(
+                  layout, vertexIndex, vertexMap,
+                  records, fileSize - bodyOffset, firstLineNum,
+                  ioSlot->buffer.data(), &bounds, mDecodeThreadNum,
+                  qpcvPLYDecoder::ProgressFunc(), outErrorStr);
+    }
+    if (result == false)
+      return false;
+    ioSlot->num = vertex.count;
+    bounds.getMinMax(ioSlot->minMax);
+    return true;
+  }
+};
+
+#endif  // #ifdef QPCV_SEQUENCE_H_
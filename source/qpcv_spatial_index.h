@@ -0,0 +1,663 @@
+// =============================================================================
+//  qpcv_spatial_index.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_spatial_index.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Uniform grid index for picking and nearest point queries
+*/
+
+#ifndef QPCV_SPATIAL_INDEX_H_
+#define QPCV_SPATIAL_INDEX_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <math.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <QThread>
+#include <QElapsedTimer>
+#include "qpcv_parallel.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvSpatialIndex class
+// -----------------------------------------------------------------------------
+// The points are bucketed into a uniform grid of about TARGET_CELL_POINT_NUM
+// points per cell (a counting sort: 4 bytes per point plus 4 bytes per cell).
+// A ray query walks the cells along the ray (3D DDA) and tests the points of
+// each cell and its neighbors, so a pick costs a few hundred point tests
+// instead of a scan of the whole cloud.
+class qpcvSpatialIndex
+{
+public:
+  // Called with the number of processed points. Return false to cancel
+  typedef std::function<bool(size_t inDoneNum, size_t inTotalNum)> ProgressFunc;
+
+  // Constants -----------------------------------------------------------------
+  static const size_t TARGET_CELL_POINT_NUM = 16;
+  static const int    MAX_GRID_DIM = 1024;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvSpatialIndex
+  // ---------------------------------------------------------------------------
+  qpcvSpatialIndex()
+  {
+    mData = NULL;
+    mDataNum = 0;
+    for (int i = 0; i < 3; i++)
+    {
+      mGridDim[i] = 0;
+      mOrigin[i] = 0;
+      mCellSize[i] = 1;
+      mCellScale[i] = 1;
+    }
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // build
+  // ---------------------------------------------------------------------------
+  // inData must stay valid (and unchanged) while the index is used.
+  // Returns false when canceled or when there are 2^32 points or more
+  bool  build(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum, const GLfloat *inMinMax,
+              int inThreadNum, const ProgressFunc &inProgressFunc = ProgressFunc())
+  {
+    mData = NULL;
+    mDataNum = 0;
+    mCellStart.clear();
+    mIndex.clear();
+    if (inNum == 0 || inNum >= 0xFFFFFFFFull)
+      return false;
+    initGrid(inMinMax, inNum);
+    size_t  cellNum = getCellNum();
+    size_t  slabNum = (size_t )mGridDim[2];
+    size_t  slabCellNum = (size_t )mGridDim[0] * mGridDim[1];
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, inNum, 256 * 1024);
+    const size_t  stepNum = 3;
+    auto  progressFunc = [&](size_t inStep, size_t inDoneNum)
+    {
+      return !inProgressFunc ||
+             inProgressFunc((inStep * inNum + inDoneNum) / stepNum, inNum);
+    };
+
+    // A plain (atomic) counting sort stalls on a cache miss per point, so the
+    // points are first split into z slabs and then sorted inside each slab,
+    // where the writes stay local. No atomics are needed: every thread owns
+    // its slab cursors, and a slab is sorted by a single thread.
+
+    // Cell of each point and the slab counts of each thread
+    std::vector<uint32_t> cellTable(inNum);
+    std::vector<size_t> slabCountTable(threadNum * slabNum, 0);
+    if (qpcvParallel::forEachRange(
+          inNum, threadNum, 1024 * 1024,
+          [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+          {
+            size_t  *count = &(slabCountTable[inThreadIndex * slabNum]);
+            for (size_t i = inBegin; i < inEnd; i++)
+            {
+              size_t  cell = getCellIndex(&(inData[i].x));
+              cellTable[i] = (uint32_t )cell;
+              count[cell / slabCellNum]++;
+            }
+          },
+          [&](size_t inDoneNum)
+          {
+            return progressFunc(0, inDoneNum);
+          }) == false)
+      return false;
+
+    // Split into slabs (slab major, then thread, so the result is deterministic)
+    std::vector<size_t> slabStartTable(slabNum + 1);
+    size_t  offset = 0;
+    for (size_t z = 0; z < slabNum; z++)
+    {
+      slabStartTable[z] = offset;
+      for (int i = 0; i < threadNum; i++)
+      {
+        size_t  count = slabCountTable[i * slabNum + z];
+        slabCountTable[i * slabNum + z] = offset;
+        offset += count;
+      }
+    }
+    slabStartTable[slabNum] = offset;
+    std::vector<uint32_t> slabIndex(inNum);
+    if (qpcvParallel::forEachRange(
+          inNum, threadNum, 1024 * 1024,
+          [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+          {
+            size_t  *cursor = &(slabCountTable[inThreadIndex * slabNum]);
+            for (size_t i = inBegin; i < inEnd; i++)
+              slabIndex[cursor[cellTable[i] / slabCellNum]++] = (uint32_t )i;
+          },
+          [&](size_t inDoneNum)
+          {
+            return progressFunc(1, inDoneNum);
+          }) == false)
+      return false;
+
+    // Sort each slab into the cells
+    mCellStart.resize(cellNum + 1);
+    mIndex.resize(inNum);
+    int slabThreadNum = qpcvParallel::getThreadNum(threadNum, slabNum, 1);
+    std::vector<std::vector<uint32_t> > cursorTable(slabThreadNum);
+    if (qpcvParallel::forEachRange(
+          slabNum, slabThreadNum, 1,
+          [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+          {
+            std::vector<uint32_t> &cursor = cursorTable[inThreadIndex];
+            cursor.resize(slabCellNum);
+            for (size_t z = inBegin; z < inEnd; z++)
+            {
+              size_t  begin = slabStartTable[z];
+              size_t  end = slabStartTable[z + 1];
+              size_t  firstCell = z * slabCellNum;
+              std::fill(cursor.begin(), cursor.end(), 0);
+              for (size_t j = begin; j < end; j++)
+                cursor[cellTable[slabIndex[j]] - firstCell]++;
+              uint32_t  pos = (uint32_t )begin;
+              for (size_t c = 0; c < slabCellNum; c++)
+              {
+                mCellStart[firstCell + c] = pos;
+                uint32_t  count = cursor[c];
+                cursor[c] = pos;
+                pos += count;
+              }
+              for (size_t j = begin; j < end; j++)
+              {
+                uint32_t  index = slabIndex[j];
+                mIndex[cursor[cellTable[index] - firstCell]++] = index;
+              }
+            }
+          },
+          [&](size_t inDoneNum)
+          {
+            return progressFunc(2, inNum * inDoneNum / slabNum);
+          }) == false)
+      return false;
+    mCellStart[cellNum] = (uint32_t )inNum;
+    mData = inData;
+    mDataNum = inNum;
+    if (inProgressFunc)
+      inProgressFunc(inNum, inNum);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // isValid
+  // ---------------------------------------------------------------------------
+  bool  isValid() const
+  {
+    return (mData != NULL);
+  }
+  // ---------------------------------------------------------------------------
+  // getMemorySize
+  // ---------------------------------------------------------------------------
+  size_t  getMemorySize() const
+  {
+    return mIndex.size() * sizeof(uint32_t) + mCellStart.size() * sizeof(uint32_t);
+  }
+  // ---------------------------------------------------------------------------
+  // getGridDim
+  // ---------------------------------------------------------------------------
+  const int *getGridDim() const
+  {
+    return mGridDim;
+  }
+  // ---------------------------------------------------------------------------
+  // getIndexTable
+  // ---------------------------------------------------------------------------
+  // The point indices in the cell order (the neighbors of a point are close
+  // by, e.g. for running per point queries with a warm cache)
+  const std::vector<uint32_t> &getIndexTable() const
+  {
+    return mIndex;
+  }
+  // ---------------------------------------------------------------------------
+  // pickRay
+  // ---------------------------------------------------------------------------
+  // The first point (smallest t) along inOrigin + t * inDir (inDir normalized)
+  // whose distance from the ray is at most inRadius + t * inSlope (a cone,
+  // e.g. a few pixels of a perspective view)
+  bool  pickRay(const double *inOrigin, const double *inDir,
+                double inRadius, double inSlope, size_t *outIndex) const
+  {
+    if (isValid() == false)
+      return false;
+    // Upper bound of the radius (at the far side of the grid box)
+    double  farDist = 0;
+    for (int i = 0; i < 3; i++)
+    {
+      double  size = mCellSize[i] * mGridDim[i];
+      double  d = std::max(fabs(mOrigin[i] - inOrigin[i]), fabs(mOrigin[i] + size - inOrigin[i]));
+      farDist += d * d;
+    }
+    double  maxRadius = inRadius + inSlope * sqrt(farDist);
+
+    // Clip the ray to the grid box (grown by the radius)
+    double  tMin = 0, tMax = HUGE_VAL;
+    for (int i = 0; i < 3; i++)
+    {
+      double  lo = mOrigin[i] - maxRadius;
+      double  hi = mOrigin[i] + mCellSize[i] * mGridDim[i] + maxRadius;
+      if (fabs(inDir[i]) < 1e-12)
+      {
+        if (inOrigin[i] < lo || inOrigin[i] > hi)
+          return false;
+        continue;
+      }
+      double  t0 = (lo - inOrigin[i]) / inDir[i];
+      double  t1 = (hi - inOrigin[i]) / inDir[i];
+      if (t0 > t1)
+        std::swap(t0, t1);
+      tMin = std::max(tMin, t0);
+      tMax = std::min(tMax, t1);
+    }
+    if (tMin > tMax)
+      return false;
+
+    // 3D DDA (the cells may be outside of the grid, only the tested
+    // neighborhoods are clipped)
+    int cell[3], step[3];
+    double  tNext[3], tDelta[3];
+    for (int i = 0; i < 3; i++)
+    {
+      double  p = inOrigin[i] + inDir[i] * tMin;
+      cell[i] = (int )floor((p - mOrigin[i]) * mCellScale[i]);
+      if (inDir[i] > 0)
+      {
+        step[i] = 1;
+        tNext[i] = (mOrigin[i] + (cell[i] + 1) * mCellSize[i] - inOrigin[i]) / inDir[i];
+        tDelta[i] = mCellSize[i] / inDir[i];
+      }
+      else if (inDir[i] < 0)
+      {
+        step[i] = -1;
+        tNext[i] = (mOrigin[i] + cell[i] * mCellSize[i] - inOrigin[i]) / inDir[i];
+        tDelta[i] = -mCellSize[i] / inDir[i];
+      }
+      else
+      {
+        step[i] = 0;
+        tNext[i] = HUGE_VAL;
+        tDelta[i] = HUGE_VAL;
+      }
+    }
+    // A point within the radius of p(t) is found from the cell of p(t), so
+    // the walk can stop once the ray passed the best hit
+    double  tCell = tMin;
+    double  bestT = HUGE_VAL, bestDist = HUGE_VAL;
+    bool  isFound = false;
+    while (tCell <= tMax && tCell <= bestT)
+    {
+      int axis = 0;
+      if (tNext[1] < tNext[axis])
+        axis = 1;
+      if (tNext[2] < tNext[axis])
+        axis = 2;
+      double  radius = inRadius + inSlope * std::min(tNext[axis], tMax);
+      int lo[3], hi[3];
+      bool  isInside = true;
+      for (int i = 0; i < 3; i++)
+      {
+        int n = (int )std::min((double )mGridDim[i], ceil(radius * mCellScale[i]));
+        lo[i] = std::max(0, cell[i] - n);
+        hi[i] = std::min(mGridDim[i] - 1, cell[i] + n);
+        if (lo[i] > hi[i])
+          isInside = false;
+      }
+      if (isInside)
+        testCells(lo, hi, inOrigin, inDir, inRadius, inSlope,
+                  &bestT, &bestDist, outIndex, &isFound);
+      // Next cell
+      if (step[axis] == 0)
+        break;
+      tCell = tNext[axis];
+      tNext[axis] += tDelta[axis];
+      cell[axis] += step[axis];
+    }
+    return isFound;
+  }
+  // ---------------------------------------------------------------------------
+  // findNearest
+  // ---------------------------------------------------------------------------
+  // The point nearest to inPos within inMaxDist
+  bool  findNearest(const double *inPos, double inMaxDist, size_t *outIndex) const
+  {
+    if (isValid() == false)
+      return false;
+    int lo[3], hi[3];
+    for (int i = 0; i < 3; i++)
+    {
+      lo[i] = getCellCoord(inPos[i] - inMaxDist, i);
+      hi[i] = getCellCoord(inPos[i] + inMaxDist, i);
+    }
+    double  best = inMaxDist * inMaxDist;
+    bool  isFound = false;
+    for (int z = lo[2]; z <= hi[2]; z++)
+      for (int y = lo[1]; y <= hi[1]; y++)
+        for (int x = lo[0]; x <= hi[0]; x++)
+        {
+          size_t  c = ((size_t )z * mGridDim[1] + y) * mGridDim[0] + x;
+          for (uint32_t j = mCellStart[c]; j < mCellStart[c + 1]; j++)
+          {
+            const GLfloat *v = &(mData[mIndex[j]].x);
+            double  d[3] = {v[0] - inPos[0], v[1] - inPos[1], v[2] - inPos[2]};
+            double  dist2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+            if (dist2 <= best)
+            {
+              best = dist2;
+              *outIndex = mIndex[j];
+              isFound = true;
+            }
+          }
+        }
+    return isFound;
+  }
+  // ---------------------------------------------------------------------------
+  // findKNearest
+  // ---------------------------------------------------------------------------
+  // Up to inK nearest points of inPos (inSkipIndex, e.g. the query point
+  // itself, is not counted). outDist2 (squared distances, ascending) and
+  // outIndex hold inK entries. Returns the number of the points found.
+  // The cells are visited in growing shells around the cell of inPos until
+  // the shell is farther than the k-th point found. Also exact when the grid
+  // box of build() does not hold all the points (the points outside are
+  // clamped into the border cells, which are visited before anything beyond)
+  int findKNearest(const double *inPos, int inK, size_t inSkipIndex,
+                   double *outDist2, size_t *outIndex) const
+  {
+    if (isValid() == false || inK <= 0)
+      return 0;
+    int center[3];
+    for (int i = 0; i < 3; i++)
+      center[i] = getCellCoord(inPos[i], i);
+    int foundNum = 0;
+    for (int r = 0; ; r++)
+    {
+      int lo[3], hi[3];
+      bool  isAll = true;
+      double  coveredDist = HUGE_VAL;
+      for (int i = 0; i < 3; i++)
+      {
+        lo[i] = std::max(0, center[i] - r);
+        hi[i] = std::min(mGridDim[i] - 1, center[i] + r);
+        // Distance from inPos to the faces of the shell. A face at the border
+        // of the grid has nothing unvisited beyond it
+        if (lo[i] != 0)
+          coveredDist = std::min(coveredDist, inPos[i] - (mOrigin[i] + lo[i] * mCellSize[i]));
+        if (hi[i] != mGridDim[i] - 1)
+          coveredDist = std::min(coveredDist, mOrigin[i] + (hi[i] + 1) * mCellSize[i] - inPos[i]);
+        if (lo[i] != 0 || hi[i] != mGridDim[i] - 1)
+          isAll = false;
+      }
+      for (int z = lo[2]; z <= hi[2]; z++)
+        for (int y = lo[1]; y <= hi[1]; y++)
+        {
+          // Only the cells on the shell (the inner ones were visited)
+          bool  isFace = (abs(z - center[2]) == r || abs(y - center[1]) == r);
+          int step = isFace ? 1 : 2 * r;
+          for (int x = center[0] - r; x <= center[0] + r; x += step)
+          {
+            if (x < lo[0] || x > hi[0])
+              continue;
+            size_t  c = ((size_t )z * mGridDim[1] + y) * mGridDim[0] + x;
+            for (uint32_t j = mCellStart[c]; j < mCellStart[c + 1]; j++)
+            {
+              size_t  index = mIndex[j];
+              if (index == inSkipIndex)
+                continue;
+              const GLfloat *v = &(mData[index].x);
+              double  d[3] = {v[0] - inPos[0], v[1] - inPos[1], v[2] - inPos[2]};
+              double  dist2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+              if (!(dist2 < (foundNum < inK ? HUGE_VAL : outDist2[inK - 1])))
+                continue;   // Also skips NaN
+              // Insertion into the sorted table (inK is small)
+              int k = (foundNum < inK) ? foundNum++ : inK - 1;
+              while (k > 0 && outDist2[k - 1] > dist2)
+              {
+                outDist2[k] = outDist2[k - 1];
+                outIndex[k] = outIndex[k - 1];
+                k--;
+              }
+              outDist2[k] = dist2;
+              outIndex[k] = index;
+            }
+          }
+        }
+      if (isAll)
+        break;
+      if (foundNum == inK && outDist2[inK - 1] <= coveredDist * coveredDist)
+        break;
+    }
+    return foundNum;
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  const ibc::gl::glXYZf_RGBAub  *mData;
+  size_t  mDataNum;
+  int mGridDim[3];
+  double  mOrigin[3];
+  double  mCellSize[3];
+  double  mCellScale[3];
+  std::vector<uint32_t> mCellStart;   // Cell c holds mIndex[mCellStart[c] .. mCellStart[c + 1])
+  std::vector<uint32_t> mIndex;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // initGrid
+  // ---------------------------------------------------------------------------
+  // Cubic cells sized for TARGET_CELL_POINT_NUM points per cell on average.
+  // Flat axes (e.g. a planar scan) do not count in the cell volume
+  void  initGrid(const GLfloat *inMinMax, size_t inNum)
+  {
+    double  range[3], maxRange = 0;
+    for (int i = 0; i < 3; i++)
+    {
+      mOrigin[i] = inMinMax[i * 2];
+      range[i] = inMinMax[i * 2 + 1] - inMinMax[i * 2];
+      if (!(range[i] > 0))
+        range[i] = 0;
+      maxRange = std::max(maxRange, range[i]);
+    }
+    if (maxRange == 0)
+      maxRange = 1;
+    double  volume = 1;
+    int axisNum = 0;
+    for (int i = 0; i < 3; i++)
+      if (range[i] > maxRange * 1e-6)
+      {
+        volume *= range[i];
+        axisNum++;
+      }
+    double  cellNum = std::max(1.0, (double )inNum / TARGET_CELL_POINT_NUM);
+    double  size = maxRange;
+    if (axisNum != 0)
+      size = pow(volume / cellNum, 1.0 / axisNum);
+    for (int i = 0; i < 3; i++)
+    {
+      if (range[i] > maxRange * 1e-6)
+      {
+        mGridDim[i] = std::max(1, std::min((int )MAX_GRID_DIM, (int )ceil(range[i] / size)));
+        mCellSize[i] = range[i] / mGridDim[i];
+      }
+      else
+      {
+        // A flat axis gets one cell of the common size
+        mGridDim[i] = 1;
+        mCellSize[i] = size;
+        mOrigin[i] -= size / 2;
+      }
+      mCellScale[i] = 1.0 / mCellSize[i];
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // testCells
+  // ---------------------------------------------------------------------------
+  void  testCells(const int *inLo, const int *inHi,
+                  const double *inOrigin, const double *inDir,
+                  double inRadius, double inSlope,
+                  double *ioBestT, double *ioBestDist, size_t *outIndex, bool *outIsFound) const
+  {
+    for (int z = inLo[2]; z <= inHi[2]; z++)
+      for (int y = inLo[1]; y <= inHi[1]; y++)
+      {
+        size_t  c = ((size_t )z * mGridDim[1] + y) * mGridDim[0];
+        for (uint32_t j = mCellStart[c + inLo[0]]; j < mCellStart[c + inHi[0] + 1]; j++)
+        {
+          const GLfloat *v = &(mData[mIndex[j]].x);
+          double  d[3] = {v[0] - inOrigin[0], v[1] - inOrigin[1], v[2] - inOrigin[2]};
+          double  t = d[0] * inDir[0] + d[1] * inDir[1] + d[2] * inDir[2];
+          if (t < 0 || t > *ioBestT)
+            continue;
+          double  dist2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2] - t * t;
+          double  radius = inRadius + t * inSlope;
+          if (dist2 > radius * radius)
+            continue;
+          if (t < *ioBestT || dist2 < *ioBestDist)
+          {
+            *ioBestT = t;
+            *ioBestDist = dist2;
+            *outIndex = mIndex[j];
+            *outIsFound = true;
+          }
+        }
+      }
+  }
+  // ---------------------------------------------------------------------------
+  // getCellNum
+  // ---------------------------------------------------------------------------
+  size_t  getCellNum() const
+  {
+    return (size_t )mGridDim[0] * mGridDim[1] * mGridDim[2];
+  }
+  // ---------------------------------------------------------------------------
+  // getCellCoord
+  // ---------------------------------------------------------------------------
+  // Clamped to the grid
+  int getCellCoord(double inPos, int inAxis) const
+  {
+    double  d = (inPos - mOrigin[inAxis]) * mCellScale[inAxis];
+    if (!(d > 0))   // Also catches NaN
+      return 0;
+    if (d >= mGridDim[inAxis])
+      return mGridDim[inAxis] - 1;
+    return (int )d;
+  }
+  // ---------------------------------------------------------------------------
+  // getCellIndex
+  // ---------------------------------------------------------------------------
+  size_t  getCellIndex(const GLfloat *inPos) const
+  {
+    int cell[3];
+    for (int i = 0; i < 3; i++)
+      cell[i] = getCellCoord(inPos[i], i);
+    return ((size_t )cell[2] * mGridDim[1] + cell[1]) * mGridDim[0] + cell[0];
+  }
+};
+
+// -----------------------------------------------------------------------------
+// qpcvSpatialIndexBuilder class
+// -----------------------------------------------------------------------------
+// Builds a qpcvSpatialIndex on a worker thread. The data must not be released
+// before the builder finished (or was deleted, which waits for it)
+class qpcvSpatialIndexBuilder : public QThread
+{
+Q_OBJECT
+
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvSpatialIndexBuilder
+  // ---------------------------------------------------------------------------
+  qpcvSpatialIndexBuilder(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                          const GLfloat *inMinMax, int inThreadNum,
+                          QObject *parent = Q_NULLPTR)
+  : QThread(parent)
+  {
+    mData = inData;
+    mDataNum = inNum;
+    for (int i = 0; i < 6; i++)
+      mMinMax[i] = inMinMax[i];
+    mThreadNum = inThreadNum;
+    mIndex = NULL;
+    mBuildTime = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvSpatialIndexBuilder
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvSpatialIndexBuilder()
+  {
+    requestInterruption();
+    wait();
+    if (mIndex != NULL)
+      delete mIndex;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // takeIndex
+  // ---------------------------------------------------------------------------
+  // Only valid after finished() was emitted. Returns NULL when canceled.
+  // The caller owns the returned object
+  qpcvSpatialIndex  *takeIndex()
+  {
+    qpcvSpatialIndex  *index = mIndex;
+    mIndex = NULL;
+    return index;
+  }
+  // ---------------------------------------------------------------------------
+  // getBuildTime
+  // ---------------------------------------------------------------------------
+  qint64  getBuildTime() const
+  {
+    return mBuildTime;
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  const ibc::gl::glXYZf_RGBAub  *mData;
+  size_t  mDataNum;
+  GLfloat mMinMax[6];
+  int mThreadNum;
+  qpcvSpatialIndex  *mIndex;
+  qint64  mBuildTime;
+
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  virtual void  run()
+  {
+    QElapsedTimer timer;
+    timer.start();
+    qpcvSpatialIndex  *index = new qpcvSpatialIndex();
+    if (index->build(mData, mDataNum, mMinMax, mThreadNum,
+                     [&](size_t, size_t)
+                     {
+                       return !isInterruptionRequested();
+                     }) == false)
+    {
+      delete index;
+      return;
+    }
+    mBuildTime = timer.elapsed();
+    mIndex = index;
+  }
+};
+
+#endif  // #ifdef QPCV_SPATIAL_INDEX_H_
@@ -0,0 +1,457 @@
+// =============================================================================
+//  qpcv_stream.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_stream.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Live point frames over a local socket (receiver and test sender)
+*/
+
+#ifndef QPCV_STREAM_H_
+#define QPCV_STREAM_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include <QThread>
+#include <QMutex>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QElapsedTimer>
+#include "qpcv_bounds.h"
+#include "qpcv_ply_decoder.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvStreamFrameHeader struct
+// -----------------------------------------------------------------------------
+// Every frame is this header followed by pointNum points in the given format
+// (little endian, see swapBytes() and swapPoints() for big endian hosts). The
+// stream is a QLocalSocket (a UNIX domain socket, or a named pipe on Windows)
+// served by qpcv
+struct qpcvStreamFrameHeader
+{
+  enum  PointFormat
+  {
+    POINT_FORMAT_XYZF_RGBAUB  = 0,  // glXYZf_RGBAub (16 bytes)
+    POINT_FORMAT_XYZF               // 3 floats (12 bytes), drawn white
+  };
+
+  char      magic[8];     // "QPCVFRM1"
+  uint32_t  pointFormat;
+  uint32_t  reserved;
+  uint64_t  frameNo;
+  uint64_t  pointNum;
+
+  // ---------------------------------------------------------------------------
+  // getMagic
+  // ---------------------------------------------------------------------------
+  static const char *getMagic()
+  {
+    return "QPCVFRM1";
+  }
+  // ---------------------------------------------------------------------------
+  // getPointSize
+  // ---------------------------------------------------------------------------
+  static size_t getPointSize(uint32_t inPointFormat)
+  {
+    if (inPointFormat == POINT_FORMAT_XYZF)
+      return sizeof(GLfloat) * 3;
+    return sizeof(ibc::gl::glXYZf_RGBAub);
+  }
+  // ---------------------------------------------------------------------------
+  // isSwapNeeded
+  // ---------------------------------------------------------------------------
+  static bool isSwapNeeded()
+  {
+    return !qpcvPLYLayout::isHostLittleEndian();
+  }
+  // ---------------------------------------------------------------------------
+  // swapBytes
+  // ---------------------------------------------------------------------------
+  // Between the wire and the host byte order (the magic is a string)
+  void  swapBytes()
+  {
+    pointFormat = qpcvPLYDecoder::swapBytes(pointFormat);
+    reserved = qpcvPLYDecoder::swapBytes(reserved);
+    frameNo = qpcvPLYDecoder::swapBytes(frameNo);
+    pointNum = qpcvPLYDecoder::swapBytes(pointNum);
+  }
+  // ---------------------------------------------------------------------------
+  // swapPoints
+  // ---------------------------------------------------------------------------
+  // The x, y, z floats at the start of each point (the colors are bytes)
+  static void swapPoints(char *ioData, size_t inNum, size_t inPointSize)
+  {
+    for (size_t i = 0; i < inNum; i++)
+      for (int j = 0; j < 3; j++)
+      {
+        char  *ptr = ioData + i * inPointSize + j * sizeof(uint32_t);
+        uint32_t  bits;
+        memcpy(&bits, ptr, sizeof(bits));
+        bits = qpcvPLYDecoder::swapBytes(bits);
+        memcpy(ptr, &bits, sizeof(bits));
+      }
+  }
+};
+
+// -----------------------------------------------------------------------------
+// qpcvStreamReceiver class
+// -----------------------------------------------------------------------------
+// Frames are read straight into a ring of three buffers: the one the GUI
+// draws, the latest complete one and the one being received. When the GUI has
+// not taken the latest frame before the next one is complete, the older one
+// is dropped, so the receiver never waits for the GUI and vice versa.
+class qpcvStreamReceiver : public QThread
+{
+Q_OBJECT
+
+public:
+  struct FrameInfo
+  {
+    uint64_t  frameNo;
+    size_t  pointNum;
+    qint64  receiveTime;  // getTime() when the header arrived
+    GLfloat minMax[6];
+  };
+
+  // Constants -----------------------------------------------------------------
+  static const int    BUFFER_NUM = 3;
+  static const size_t MAX_POINT_NUM = 64 * 1024 * 1024;
+  static const int    WAIT_MSEC = 100;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvStreamReceiver
+  // ---------------------------------------------------------------------------
+  qpcvStreamReceiver(const QString &inServerName, QObject *parent = Q_NULLPTR)
+  : QThread(parent)
+  {
+    mServerName = inServerName;
+    mDisplayIndex = -1;
+    mReadyIndex = -1;
+    mReceivedNum = 0;
+    mDroppedNum = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvStreamReceiver
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvStreamReceiver()
+  {
+    requestInterruption();
+    wait();
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getTime
+  // ---------------------------------------------------------------------------
+  // Monotonic clock (usec) shared by the receiver and the GUI
+  static qint64 getTime()
+  {
+    return (qint64 )std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+  // ---------------------------------------------------------------------------
+  // getServerName
+  // ---------------------------------------------------------------------------
+  const QString &getServerName() const
+  {
+    return mServerName;
+  }
+  // ---------------------------------------------------------------------------
+  // acquireFrame
+  // ---------------------------------------------------------------------------
+  // Called from the GUI thread after frameReady(). The returned data stays
+  // valid until the next acquireFrame() call
+  bool  acquireFrame(ibc::gl::glXYZf_RGBAub **outData, FrameInfo *outInfo)
+  {
+    QMutexLocker  locker(&mMutex);
+    if (mReadyIndex < 0)
+      return false;
+    mDisplayIndex = mReadyIndex;
+    mReadyIndex = -1;
+    *outData = mBuffer[mDisplayIndex].data();
+    *outInfo = mInfo[mDisplayIndex];
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // getReceivedNum
+  // ---------------------------------------------------------------------------
+  quint64 getReceivedNum()
+  {
+    QMutexLocker  locker(&mMutex);
+    return mReceivedNum;
+  }
+  // ---------------------------------------------------------------------------
+  // getDroppedNum
+  // ---------------------------------------------------------------------------
+  quint64 getDroppedNum()
+  {
+    QMutexLocker  locker(&mMutex);
+    return mDroppedNum;
+  }
+
+signals:
+  void  frameReady();
+  void  connectionChanged(bool inIsConnected);
+  void  errorOccurred(const QString &inErrorStr);
+
+protected:
+  // Member variables ----------------------------------------------------------
+  QString mServerName;
+  QMutex  mMutex;
+  std::vector<ibc::gl::glXYZf_RGBAub> mBuffer[BUFFER_NUM];
+  FrameInfo mInfo[BUFFER_NUM];
+  int mDisplayIndex;
+  int mReadyIndex;
+  quint64 mReceivedNum;
+  quint64 mDroppedNum;
+  std::vector<char> mConvertBuffer;
+
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  virtual void  run()
+  {
+    QLocalServer  server;
+    QLocalServer::removeServer(mServerName);
+    if (server.listen(mServerName) == false)
+    {
+      emit errorOccurred(QString("Can't listen on %1: %2")
+                           .arg(mServerName).arg(server.errorString()));
+      return;
+    }
+    while (isInterruptionRequested() == false)
+    {
+      if (server.waitForNewConnection(WAIT_MSEC) == false)
+        continue;
+      QLocalSocket  *socket = server.nextPendingConnection();
+      if (socket == NULL)
+        continue;
+      emit connectionChanged(true);
+      while (isInterruptionRequested() == false &&
+             socket->state() == QLocalSocket::ConnectedState)
+        if (receiveFrame(socket) == false)
+          break;
+      emit connectionChanged(false);
+      delete socket;
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // receiveFrame
+  // ---------------------------------------------------------------------------
+  bool  receiveFrame(QLocalSocket *inSocket)
+  {
+    qpcvStreamFrameHeader header;
+    if (readAll(inSocket, (char *)&header, sizeof(header)) == false)
+      return false;
+    qint64  receiveTime = getTime();
+    const bool  swap = qpcvStreamFrameHeader::isSwapNeeded();
+    if (swap)
+      header.swapBytes();
+    if (memcmp(header.magic, qpcvStreamFrameHeader::getMagic(), sizeof(header.magic)) != 0 ||
+        header.pointFormat > qpcvStreamFrameHeader::POINT_FORMAT_XYZF ||
+        header.pointNum > MAX_POINT_NUM)
+    {
+      emit errorOccurred(QString("Invalid frame header from %1").arg(mServerName));
+      return false;
+    }
+
+    // The buffer which is neither drawn nor waiting to be drawn
+    int index = 0;
+    {
+      QMutexLocker  locker(&mMutex);
+      while (index == mDisplayIndex || index == mReadyIndex)
+        index++;
+    }
+    std::vector<ibc::gl::glXYZf_RGBAub> &buffer = mBuffer[index];
+    size_t  num = (size_t )header.pointNum;
+    if (buffer.size() < num)
+      buffer.resize(num);
+    if (header.pointFormat == qpcvStreamFrameHeader::POINT_FORMAT_XYZF_RGBAUB)
+    {
+      if (readAll(inSocket, (char *)buffer.data(), num * sizeof(ibc::gl::glXYZf_RGBAub)) == false)
+        return false;
+      if (swap)
+        qpcvStreamFrameHeader::swapPoints((char *)buffer.data(), num, sizeof(ibc::gl::glXYZf_RGBAub));
+    }
+    else
+    {
+      size_t  pointSize = qpcvStreamFrameHeader::getPointSize(header.pointFormat);
+      mConvertBuffer.resize(num * pointSize);
+      if (readAll(inSocket, mConvertBuffer.data(), mConvertBuffer.size()) == false)
+        return false;
+      if (swap)
+        qpcvStreamFrameHeader::swapPoints(mConvertBuffer.data(), num, pointSize);
+      for (size_t i = 0; i < num; i++)
+      {
+        memcpy(&(buffer[i].x), &(mConvertBuffer[i * pointSize]), pointSize);
+        buffer[i].r = buffer[i].g = buffer[i].b = buffer[i].a = 255;
+      }
+    }
+
+    FrameInfo &info = mInfo[index];
+    info.frameNo = header.frameNo;
+    info.pointNum = num;
+    info.receiveTime = receiveTime;
+    qpcvBounds  bounds;
+    bounds.add(buffer.data(), num);
+    bounds.getMinMax(info.minMax);
+    {
+      QMutexLocker  locker(&mMutex);
+      if (mReadyIndex >= 0)
+        mDroppedNum++;
+      mReadyIndex = index;
+      mReceivedNum++;
+    }
+    emit frameReady();
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // readAll
+  // ---------------------------------------------------------------------------
+  bool  readAll(QLocalSocket *inSocket, char *outData, size_t inSize)
+  {
+    size_t  done = 0;
+    while (done < inSize)
+    {
+      if (inSocket->bytesAvailable() == 0 &&
+          inSocket->waitForReadyRead(WAIT_MSEC) == false)
+      {
+        if (isInterruptionRequested() ||
+            inSocket->state() != QLocalSocket::ConnectedState)
+          return false;
+        continue;
+      }
+      qint64  size = inSocket->read(outData + done, (qint64 )(inSize - done));
+      if (size < 0)
+        return false;
+      done += (size_t )size;
+    }
+    return true;
+  }
+};
+
+// -----------------------------------------------------------------------------
+// qpcvStreamSender class
+// -----------------------------------------------------------------------------
+// Test sender standing in for a depth sensor: an animated sinc surface sampled
+// on a grid, sent at a fixed frame rate
+class qpcvStreamSender
+{
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvStreamSender
+  // ---------------------------------------------------------------------------
+  qpcvStreamSender()
+  {
+    mWidth = 640;
+    mHeight = 480;
+    mFrameRate = 30;
+    mFrameNum = 0;
+  }
+
+  // Member variables ----------------------------------------------------------
+  QString mServerName;
+  int mWidth, mHeight;
+  int mFrameRate;
+  int mFrameNum;    // 0 : until the connection is closed
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  // Returns the process exit code
+  int run()
+  {
+    QLocalSocket  socket;
+    socket.connectToServer(mServerName);
+    if (socket.waitForConnected(5000) == false)
+    {
+      std::cerr << "Can't connect to " << mServerName.toStdString() << ": "
+                << socket.errorString().toStdString() << std::endl;
+      return 1;
+    }
+    size_t  num = (size_t )mWidth * mHeight;
+    std::vector<ibc::gl::glXYZf_RGBAub> data(num);
+    qint64  interval = 1000 * 1000 / std::max(1, mFrameRate);
+    QElapsedTimer timer;
+    timer.start();
+    for (int frame = 0; mFrameNum == 0 || frame < mFrameNum; frame++)
+    {
+      makeFrame(frame / (double )std::max(1, mFrameRate), data.data());
+      qpcvStreamFrameHeader header;
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic, qpcvStreamFrameHeader::getMagic(), sizeof(header.magic));
+      header.pointFormat = qpcvStreamFrameHeader::POINT_FORMAT_XYZF_RGBAUB;
+      header.frameNo = (uint64_t )frame;
+      header.pointNum = (uint64_t )num;
+      if (qpcvStreamFrameHeader::isSwapNeeded())
+      {
+        header.swapBytes();
+        qpcvStreamFrameHeader::swapPoints((char *)data.data(), num, sizeof(ibc::gl::glXYZf_RGBAub));
+      }
+      qint64  size = (qint64 )(num * sizeof(ibc::gl::glXYZf_RGBAub));
+      if (socket.write((const char *)&header, sizeof(header)) != sizeof(header) ||
+          socket.write((const char *)data.data(), size) != size)
+        break;
+      while (socket.bytesToWrite() > 0)
+        if (socket.waitForBytesWritten(1000) == false)
+          break;
+      if (socket.state() != QLocalSocket::ConnectedState)
+        break;
+      qint64  wait = interval * (frame + 1) - timer.nsecsElapsed() / 1000;
+      if (wait > 0)
+        QThread::usleep((unsigned long )wait);
+    }
+    socket.disconnectFromServer();
+    return 0;
+  }
+
+protected:
+  // ---------------------------------------------------------------------------
+  // makeFrame
+  // ---------------------------------------------------------------------------
+  void  makeFrame(double inTime, ibc::gl::glXYZf_RGBAub *outData) const
+  {
+    double  k = M_PI * 3.0;
+    for (int i = 0; i < mHeight; i++)
+      for (int j = 0; j < mWidth; j++)
+      {
+        double  x = -1.0 + 2.0 * j / mWidth;
+        double  y = -1.0 + 2.0 * i / mHeight;
+        double  d = k * sqrt(x*x + y*y);
+        double  z = (d == 0) ? 1 : sin(d - inTime * 4.0) / d;
+        ibc::gl::glXYZf_RGBAub  &p = outData[(size_t )i * mWidth + j];
+        p.x = (GLfloat )x;
+        p.y = (GLfloat )y;
+        p.z = (GLfloat )z;
+        GLubyte c = (GLubyte )(z < 0 ? 0 : (z > 1 ? 255 : z * 255));
+        p.r = c;
+        p.g = c;
+        p.b = 255;
+        p.a = 255;
+      }
+  }
+};
+
+#endif  // #ifdef QPCV_STREAM_H_
@@ -0,0 +1,341 @@
+// =============================================================================
+//  qpcv_stream_layer.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_stream_layer.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Vertex buffer ring for the live stream frames of qpcvGLView
+*/
+
+#ifndef QPCV_STREAM_LAYER_H_
+#define QPCV_STREAM_LAYER_H_
+
+// Includes --------------------------------------------------------------------
+#include <algorithm>
+#include <string.h>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QMatrix4x4>
+#include "qpcv_point_layer.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT              0x0002
+#endif
+#ifndef GL_MAP_INVALIDATE_BUFFER_BIT
+#define GL_MAP_INVALIDATE_BUFFER_BIT  0x0008
+#endif
+#ifndef GL_MAP_UNSYNCHRONIZED_BIT
+#define GL_MAP_UNSYNCHRONIZED_BIT     0x0020
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT         0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT           0x0080
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT    0x00000001
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED            0x911B
+#endif
+#ifndef GL_WAIT_FAILED
+#define GL_WAIT_FAILED                0x911D
+#endif
+
+// -----------------------------------------------------------------------------
+// qpcvStreamLayer class
+// -----------------------------------------------------------------------------
+// The frames of a live stream go into a ring of RING_SIZE vertex buffers, so
+// the CPU writes one buffer while the GPU may still draw the previous ones.
+// A fence after each draw tells when a buffer can be written again. With
+// glBufferStorage() (OpenGL 4.4, GL_ARB_buffer_storage or
+// GL_EXT_buffer_storage) the buffers are mapped once, persistently and
+// coherently, and a frame is a memcpy() into the mapping. Otherwise each
+// frame maps the buffer with glMapBufferRange() (unsynchronized, the fence
+// already waited). The points are drawn with the program of qpcvPointLayer.
+// The functions taking QOpenGLContext need the context current.
+class qpcvStreamLayer
+{
+public:
+  // Constants -----------------------------------------------------------------
+  static const int  RING_SIZE = 3;
+  static const GLuint64 FENCE_WAIT_NSEC = 100 * 1000 * 1000;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvStreamLayer
+  // ---------------------------------------------------------------------------
+  qpcvStreamLayer()
+  {
+    mData = NULL;
+    mDataNum = 0;
+    mIsDataDirty = false;
+    mIsInitialized = false;
+    mBufferStorageFunc = NULL;
+    mCurrentIndex = -1;
+    for (int i = 0; i < RING_SIZE; i++)
+    {
+      mRing[i].buffer = 0;
+      mRing[i].vao = 0;
+      mRing[i].capacity = 0;
+      mRing[i].num = 0;
+      mRing[i].mapPtr = NULL;
+      mRing[i].fence = 0;
+    }
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // setFrame
+  // ---------------------------------------------------------------------------
+  // inData (NULL : no frame) is not owned and must stay until the next paint.
+  // It is written into the ring at the next draw()
+  void  setFrame(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum)
+  {
+    mData = inData;
+    mDataNum = (inData != NULL) ? inNum : 0;
+    mIsDataDirty = (inData != NULL);
+    if (inData == NULL)
+      mCurrentIndex = -1;
+  }
+  // ---------------------------------------------------------------------------
+  // hasFrame
+  // ---------------------------------------------------------------------------
+  bool  hasFrame() const
+  {
+    return (mData != NULL || mCurrentIndex >= 0);
+  }
+  // ---------------------------------------------------------------------------
+  // getVRAMUsed
+  // ---------------------------------------------------------------------------
+  // Bytes allocated for the buffer ring
+  size_t  getVRAMUsed() const
+  {
+    size_t  size = 0;
+    for (int i = 0; i < RING_SIZE; i++)
+      size += mRing[i].capacity * sizeof(ibc::gl::glXYZf_RGBAub);
+    return size;
+  }
+  // ---------------------------------------------------------------------------
+  // isPersistent
+  // ---------------------------------------------------------------------------
+  // true when the ring is persistently mapped (after the first draw)
+  bool  isPersistent() const
+  {
+    return (mBufferStorageFunc != NULL);
+  }
+  // ---------------------------------------------------------------------------
+  // draw
+  // ---------------------------------------------------------------------------
+  // inMatrix maps the data coordinates to the clip coordinates
+  void  draw(QOpenGLContext *inContext, const QMatrix4x4 &inMatrix,
+             qpcvPointLayer *inPointLayer, const qpcvPointLayer::DrawParam &inParam)
+  {
+    QOpenGLExtraFunctions *func = inContext->extraFunctions();
+    if (mIsInitialized == false)
+      init(inContext);
+    if (mIsDataDirty)
+    {
+      mIsDataDirty = false;
+      writeFrame(func);
+    }
+    if (mCurrentIndex < 0)
+      return;
+    RingBuffer  &ring = mRing[mCurrentIndex];
+    if (ring.num == 0 || inPointLayer->bindProgram(inContext, inMatrix, inParam) == false)
+      return;
+    func->glBindVertexArray(ring.vao);
+    func->glDrawArrays(GL_POINTS, 0, (GLsizei )ring.num);
+    func->glBindVertexArray(0);
+    inPointLayer->releaseProgram(func);
+    // The buffer is written again once the draws of this frame completed
+    if (ring.fence != 0)
+      func->glDeleteSync(ring.fence);
+    ring.fence = func->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+  // ---------------------------------------------------------------------------
+  // release
+  // ---------------------------------------------------------------------------
+  void  release(QOpenGLExtraFunctions *inFunc)
+  {
+    for (int i = 0; i < RING_SIZE; i++)
+      deleteBuffer(inFunc, &(mRing[i]));
+    mCurrentIndex = -1;
+    mIsDataDirty = (mData != NULL);
+  }
+
+protected:
+  typedef void (QOPENGLF_APIENTRYP BufferStorageFunc)(GLenum, GLsizeiptr, const void *, GLbitfield);
+
+  struct RingBuffer
+  {
+    GLuint  buffer;
+    GLuint  vao;
+    size_t  capacity;   // Points
+    size_t  num;
+    void    *mapPtr;    // The persistent mapping
+    GLsync  fence;      // After the last draw from the buffer
+  };
+
+  // Member variables ----------------------------------------------------------
+  const ibc::gl::glXYZf_RGBAub  *mData;
+  size_t  mDataNum;
+  bool  mIsDataDirty;
+  bool  mIsInitialized;
+  BufferStorageFunc mBufferStorageFunc;   // NULL : glMapBufferRange() per frame
+  RingBuffer  mRing[RING_SIZE];
+  int   mCurrentIndex;    // The buffer of the last frame (-1 : none)
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // init
+  // ---------------------------------------------------------------------------
+  void  init(QOpenGLContext *inContext)
+  {
+    mIsInitialized = true;
+    int version = inContext->format().majorVersion() * 100 + inContext->format().minorVersion();
+    const char  *name = NULL;
+    if (inContext->isOpenGLES())
+    {
+      if (inContext->hasExtension("GL_EXT_buffer_storage"))
+        name = "glBufferStorageEXT";
+    }
+    else if (version >= 404 || inContext->hasExtension("GL_ARB_buffer_storage"))
+      name = "glBufferStorage";
+    if (name != NULL)
+      mBufferStorageFunc = reinterpret_cast<BufferStorageFunc>(inContext->getProcAddress(name));
+  }
+  // ---------------------------------------------------------------------------
+  // writeFrame
+  // ---------------------------------------------------------------------------
+  // Copies the frame into the next buffer of the ring
+  void  writeFrame(QOpenGLExtraFunctions *inFunc)
+  {
+    int index = (mCurrentIndex + 1) % RING_SIZE;
+    RingBuffer  &ring = mRing[index];
+    waitFence(inFunc, &ring);
+    if (reserve(inFunc, &ring, mDataNum) == false)
+      return;
+    size_t  size = mDataNum * sizeof(ibc::gl::glXYZf_RGBAub);
+    if (ring.mapPtr != NULL)
+      memcpy(ring.mapPtr, mData, size);
+    else if (size != 0)
+    {
+      inFunc->glBindBuffer(GL_ARRAY_BUFFER, ring.buffer);
+      void  *ptr = inFunc->glMapBufferRange(GL_ARRAY_BUFFER, 0, (GLsizeiptr )size,
+                                            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT |
+                                            GL_MAP_UNSYNCHRONIZED_BIT);
+      if (ptr != NULL)
+      {
+        memcpy(ptr, mData, size);
+        if (inFunc->glUnmapBuffer(GL_ARRAY_BUFFER) == GL_FALSE)   // The data store was lost
+          ptr = NULL;
+      }
+      if (ptr == NULL)
+        inFunc->glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr )size, mData);
+      inFunc->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    ring.num = mDataNum;
+    mCurrentIndex = index;
+  }
+  // ---------------------------------------------------------------------------
+  // waitFence
+  // ---------------------------------------------------------------------------
+  void  waitFence(QOpenGLExtraFunctions *inFunc, RingBuffer *ioRing)
+  {
+    if (ioRing->fence == 0)
+      return;
+    while (true)
+    {
+      GLenum  result = inFunc->glClientWaitSync(ioRing->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                                FENCE_WAIT_NSEC);
+      if (result != GL_TIMEOUT_EXPIRED)
+        break;
+    }
+    inFunc->glDeleteSync(ioRing->fence);
+    ioRing->fence = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // reserve
+  // ---------------------------------------------------------------------------
+  // The storage of glBufferStorage() is immutable, so a larger frame needs a
+  // new buffer (the sensors send frames of the same size, so this is rare)
+  bool  reserve(QOpenGLExtraFunctions *inFunc, RingBuffer *ioRing, size_t inNum)
+  {
+    if (ioRing->buffer != 0 && inNum <= ioRing->capacity)
+      return true;
+    deleteBuffer(inFunc, ioRing);
+    size_t  capacity = std::max(inNum, (size_t )1);
+    GLsizeiptr  size = (GLsizeiptr )(capacity * sizeof(ibc::gl::glXYZf_RGBAub));
+    inFunc->glGenBuffers(1, &(ioRing->buffer));
+    if (ioRing->buffer == 0)
+      return false;
+    inFunc->glBindBuffer(GL_ARRAY_BUFFER, ioRing->buffer);
+    if (mBufferStorageFunc != NULL)
+    {
+      GLbitfield  flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      mBufferStorageFunc(GL_ARRAY_BUFFER, size, NULL, flags);
+      ioRing->mapPtr = inFunc->glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+      if (ioRing->mapPtr == NULL)
+      {
+        // Not usable after all, the next buffers use glMapBufferRange() per frame
+        inFunc->glBindBuffer(GL_ARRAY_BUFFER, 0);
+        deleteBuffer(inFunc, ioRing);
+        mBufferStorageFunc = NULL;
+        return reserve(inFunc, ioRing, inNum);
+      }
+    }
+    else
+      inFunc->glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+    ioRing->capacity = capacity;
+    inFunc->glGenVertexArrays(1, &(ioRing->vao));
+    inFunc->glBindVertexArray(ioRing->vao);
+    qpcvPointLayer::setVertexFormat(inFunc);
+    inFunc->glBindVertexArray(0);
+    inFunc->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // deleteBuffer
+  // ---------------------------------------------------------------------------
+  void  deleteBuffer(QOpenGLExtraFunctions *inFunc, RingBuffer *ioRing)
+  {
+    if (ioRing->fence != 0)
+      inFunc->glDeleteSync(ioRing->fence);
+    if (ioRing->mapPtr != NULL)
+    {
+      inFunc->glBindBuffer(GL_ARRAY_BUFFER, ioRing->buffer);
+      inFunc->glUnmapBuffer(GL_ARRAY_BUFFER);
+      inFunc->glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    if (ioRing->vao != 0)
+      inFunc->glDeleteVertexArrays(1, &(ioRing->vao));
+    if (ioRing->buffer != 0)
+      inFunc->glDeleteBuffers(1, &(ioRing->buffer));
+    ioRing->buffer = 0;
+    ioRing->vao = 0;
+    ioRing->capacity = 0;
+    ioRing->num = 0;
+    ioRing->mapPtr = NULL;
+    ioRing->fence = 0;
+  }
+};
+
+#endif  // #ifdef QPCV_STREAM_LAYER_H_
@@ -0,0 +1,517 @@
+// =============================================================================
+//  qpcv_text_decoder.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_text_decoder.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Column text point decoder (XYZ files and ascii PCD files)
+*/
+
+#ifndef QPCV_TEXT_DECODER_H_
+#define QPCV_TEXT_DECODER_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <sstream>
+#include <charconv>
+#include <algorithm>
+#include <mutex>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "qpcv_ply_decoder.h"
+#include "qpcv_ply_ascii_decoder.h"
+#include "qpcv_parallel.h"
+#include "qpcv_bounds.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvTextDecoder class
+// -----------------------------------------------------------------------------
+// One point per line, the values separated by spaces, tabs or commas. Blank
+// lines and '#' comment lines are skipped. Unlike a PLY body the number of
+// points is not known up front, so the data lines of the line aligned chunks
+// are counted in parallel first (as qpcvPLYAsciiDecoder does), then the chunks
+// are parsed in parallel straight into the output array. Points with a NaN
+// coordinate (invalid points of organized PCD clouds) are dropped.
+class qpcvTextDecoder
+{
+public:
+  typedef qpcvPLYDecoder::ProgressFunc  ProgressFunc;
+
+  enum  ColumnType
+  {
+    COLUMN_TYPE_SKIP  = 0,
+    COLUMN_TYPE_X,
+    COLUMN_TYPE_Y,
+    COLUMN_TYPE_Z,
+    COLUMN_TYPE_R,
+    COLUMN_TYPE_G,
+    COLUMN_TYPE_B,
+    COLUMN_TYPE_A,
+    COLUMN_TYPE_RGB_FLOAT,    // PCL packed color stored in the bits of a float
+    COLUMN_TYPE_RGB_UINT,     // PCL packed color (0xAARRGGBB)
+    COLUMN_TYPE_NUM
+  };
+
+  struct ColumnMap
+  {
+    std::vector<ColumnType> columnTable;    // Up to the last used column
+    bool  isColorFloat;                     // R, G, B, A columns are in [0, 1]
+    bool  hasAlpha;                         // The packed color has alpha
+  };
+
+  // Bodies smaller than this (per thread) are parsed on the calling thread only
+  static const size_t PARALLEL_MIN_BYTES = qpcvPLYAsciiDecoder::PARALLEL_MIN_BYTES;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // prepareXYZColumnMap
+  // ---------------------------------------------------------------------------
+  // x y z [r g b] : the first line with 3 or more numbers is the first data
+  // line (an optional column title line before it is skipped, outBodyOffset
+  // returns the offset of that line). 6 or more columns have colors in the
+  // columns 4 to 6, which are in [0, 1] when written as fractions and 0 - 255
+  // otherwise. Any other column is ignored
+  static bool prepareXYZColumnMap(const unsigned char *inPtr, size_t inSize,
+                                  ColumnMap *outMap, size_t *outBodyOffset,
+                                  size_t *outSkippedLineNum)
+  {
+    const char  *ptr = (const char *)inPtr;
+    const char  *end = ptr + inSize;
+    size_t  lineNum = 0;
+    while (ptr < end)
+    {
+      const char  *lineEnd = (const char *)memchr(ptr, '\n', end - ptr);
+      if (lineEnd == NULL)
+        lineEnd = end;
+      const char  *pos = ptr;
+      std::vector<double> valueTable;
+      bool  isFraction = false;
+      if (isDataLine(&pos, lineEnd))
+      {
+        double  value;
+        const char  *top = pos;
+        while (parseValue(&pos, lineEnd, &value))
+        {
+          if (valueTable.size() >= 3 && valueTable.size() < 6 &&
+              std::find(top, pos, '.') != pos)
+            isFraction = true;
+          valueTable.push_back(value);
+          top = pos;
+        }
+        skipSeparator(&pos, lineEnd);
+      }
+      if (valueTable.size() >= 3 && pos == lineEnd)
+      {
+        outMap->columnTable.clear();
+        outMap->columnTable.push_back(COLUMN_TYPE_X);
+        outMap->columnTable.push_back(COLUMN_TYPE_Y);
+        outMap->columnTable.push_back(COLUMN_TYPE_Z);
+        outMap->isColorFloat = false;
+        outMap->hasAlpha = false;
+        if (valueTable.size() >= 6)
+        {
+          outMap->columnTable.push_back(COLUMN_TYPE_R);
+          outMap->columnTable.push_back(COLUMN_TYPE_G);
+          outMap->columnTable.push_back(COLUMN_TYPE_B);
+          outMap->isColorFloat = isFraction &&
+                                 valueTable[3] <= 1.0 && valueTable[4] <= 1.0 && valueTable[5] <= 1.0;
+        }
+        *outBodyOffset = ptr - (const char *)inPtr;
+        *outSkippedLineNum = lineNum;
+        return true;
+      }
+      // Only a few title lines are accepted before the data
+      if (++lineNum > 16 || lineEnd == end)
+        break;
+      ptr = lineEnd + 1;
+    }
+    return false;
+  }
+  // ---------------------------------------------------------------------------
+  // getColorFormatStr
+  // ---------------------------------------------------------------------------
+  static std::string  getColorFormatStr(const ColumnMap &inMap)
+  {
+    std::string str;
+    for (size_t i = 0; i < inMap.columnTable.size(); i++)
+    {
+      std::ostringstream  stream;
+      switch (inMap.columnTable[i])
+      {
+        case COLUMN_TYPE_R:
+        case COLUMN_TYPE_G:
+        case COLUMN_TYPE_B:
+        case COLUMN_TYPE_A:
+          stream << "rgba"[inMap.columnTable[i] - COLUMN_TYPE_R] << " (column " << i + 1
+                 << (inMap.isColorFloat ? ", 0 - 1)" : ", 0 - 255)");
+          break;
+        case COLUMN_TYPE_RGB_FLOAT:
+          stream << "packed rgb (float, column " << i + 1 << ")";
+          break;
+        case COLUMN_TYPE_RGB_UINT:
+          stream << (inMap.hasAlpha ? "packed rgba" : "packed rgb") << " (uint, column " << i + 1 << ")";
+          break;
+        default:
+          continue;
+      }
+      if (str.size() != 0)
+        str += ", ";
+      str += stream.str();
+    }
+    return str;
+  }
+  // ---------------------------------------------------------------------------
+  // decodeParallel
+  // ---------------------------------------------------------------------------
+  // inBody points to the first data line, whose (1 based) line number is
+  // inFirstLineNum. Allocates *outData (new []) with *outNum points (NaN points
+  // are not counted). inMaxNum limits the number of data lines (0 : no limit),
+  // outLineNum returns the number of the parsed data lines (can be NULL).
+  // outErrorStr returns "<inFormatName> line N: ..." for the first bad line
+  static bool decodeParallel(const ColumnMap &inMap,
+                             const unsigned char *inBody, size_t inBodySize,
+                             size_t inFirstLineNum, size_t inMaxNum,
+                             const char *inFormatName,
+                             ibc::gl::glXYZf_RGBAub **outData, size_t *outNum,
+                             size_t *outLineNum,
+                             qpcvBounds *outBounds,
+                             int inThreadNum,
+                             const ProgressFunc &inProgressFunc,
+                             std::string *outErrorStr)
+  {
+    const char  *ptr = (const char *)inBody;
+    const char  *end = ptr + inBodySize;
+    *outData = NULL;
+    *outNum = 0;
+    if (outLineNum != NULL)
+      *outLineNum = 0;
+
+    // Line aligned chunks
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, end - ptr, PARALLEL_MIN_BYTES);
+    std::vector<const char *> chunkTable;
+    qpcvPLYAsciiDecoder::makeLineChunks(ptr, end, (size_t )threadNum * 8, &chunkTable);
+    size_t  chunkNum = chunkTable.size() - 1;
+
+    // Pass 1 : count the lines and the data lines of each chunk
+    std::vector<size_t> lineTable(chunkNum + 1, 0);
+    std::vector<size_t> indexTable(chunkNum + 1, 0);
+    qpcvParallel::forEachRange(
+      chunkNum, threadNum, 1,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+          countLines(chunkTable[i], chunkTable[i + 1], &(lineTable[i + 1]), &(indexTable[i + 1]));
+      });
+    for (size_t i = 0; i < chunkNum; i++)
+    {
+      lineTable[i + 1] += lineTable[i];
+      indexTable[i + 1] += indexTable[i];
+    }
+    size_t  num = indexTable[chunkNum];
+    if (inMaxNum != 0 && num > inMaxNum)
+      num = inMaxNum;
+    if (outLineNum != NULL)
+      *outLineNum = num;
+    if (num == 0)
+      return true;
+
+    // Pass 2 : parse (each chunk drops its NaN points itself)
+    ibc::gl::glXYZf_RGBAub  *data = new ibc::gl::glXYZf_RGBAub[num];
+    std::vector<size_t> keptTable(chunkNum, 0);
+    std::mutex  errorMutex;
+    size_t  errorLineNum = (size_t )-1;
+    std::string errorStr;
+    std::vector<qpcvBounds> boundsTable(threadNum);
+    bool  result = qpcvParallel::forEachRange(
+      chunkNum, threadNum, 1,
+      [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+      {
+        for (size_t i = inBegin; i < inEnd; i++)
+        {
+          size_t  index = indexTable[i];
+          if (index >= num)
+            return;
+          size_t  indexEnd = std::min(indexTable[i + 1], num);
+          size_t  badLine;
+          std::string str;
+          if (parseChunk(inMap, chunkTable[i], chunkTable[i + 1], indexEnd - index,
+                         data + index, &badLine, &str) == false)
+          {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (lineTable[i] + badLine < errorLineNum)
+            {
+              errorLineNum = lineTable[i] + badLine;
+              errorStr = str;
+            }
+            return;
+          }
+          keptTable[i] = removeNaN(data + index, indexEnd - index);
+          boundsTable[inThreadIndex].add(data + index, keptTable[i]);
+        }
+      },
+      [&](size_t inDoneNum)
+      {
+        if (!inProgressFunc)
+          return true;
+        return inProgressFunc(num * inDoneNum / chunkNum);
+      });
+    if (errorLineNum != (size_t )-1 || result == false)
+    {
+      delete [] data;
+      if (errorLineNum == (size_t )-1)
+        return false;
+      std::ostringstream  stream;
+      stream << inFormatName << " line " << inFirstLineNum + errorLineNum << ": " << errorStr;
+      *outErrorStr = stream.str();
+      return false;
+    }
+    if (outBounds != NULL)
+      for (size_t i = 0; i < boundsTable.size(); i++)
+        outBounds->merge(boundsTable[i]);
+    *outData = data;
+    *outNum = joinBlocks(data, indexTable, keptTable);
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // removeNaN
+  // ---------------------------------------------------------------------------
+  // Drops the points with a NaN coordinate (in place, the order is kept).
+  // Returns the number of the remaining points
+  static size_t removeNaN(ibc::gl::glXYZf_RGBAub *ioData, size_t inNum)
+  {
+    size_t  keptNum = 0;
+    for (size_t i = 0; i < inNum; i++)
+    {
+      if (isnan(ioData[i].x) || isnan(ioData[i].y) || isnan(ioData[i].z))
+        continue;
+      if (keptNum != i)
+        ioData[keptNum] = ioData[i];
+      keptNum++;
+    }
+    return keptNum;
+  }
+  // ---------------------------------------------------------------------------
+  // joinBlocks
+  // ---------------------------------------------------------------------------
+  // Block i started at inBeginTable[i] and has inKeptTable[i] points left
+  // after removeNaN(). Moves the blocks together and returns the total number
+  static size_t joinBlocks(ibc::gl::glXYZf_RGBAub *ioData,
+                           const std::vector<size_t> &inBeginTable,
+                           const std::vector<size_t> &inKeptTable)
+  {
+    size_t  num = 0;
+    for (size_t i = 0; i < inKeptTable.size(); i++)
+    {
+      if (num != inBeginTable[i] && inKeptTable[i] != 0)
+        memmove(ioData + num, ioData + inBeginTable[i], inKeptTable[i] * sizeof(ibc::gl::glXYZf_RGBAub));
+      num += inKeptTable[i];
+    }
+    return num;
+  }
+
+protected:
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // countLines
+  // ---------------------------------------------------------------------------
+  static void countLines(const char *inPtr, const char *inEnd,
+                         size_t *outLineNum, size_t *outDataLineNum)
+  {
+    const char  *ptr = inPtr;
+    size_t  lineNum = 0, dataLineNum = 0;
+    while (ptr < inEnd)
+    {
+      const char  *lineEnd = (const char *)memchr(ptr, '\n', inEnd - ptr);
+      if (lineEnd == NULL)
+        lineEnd = inEnd;
+      else
+        lineNum++;
+      const char  *pos = ptr;
+      if (isDataLine(&pos, lineEnd))
+        dataLineNum++;
+      ptr = lineEnd + 1;
+    }
+    *outLineNum = lineNum;
+    *outDataLineNum = dataLineNum;
+  }
+  // ---------------------------------------------------------------------------
+  // parseChunk
+  // ---------------------------------------------------------------------------
+  // Parses the first inNum data lines of [inPtr, inEnd) into outData.
+  // outBadLine returns the line offset from inPtr on error
+  static bool parseChunk(const ColumnMap &inMap, const char *inPtr, const char *inEnd,
+                         size_t inNum, ibc::gl::glXYZf_RGBAub *outData,
+                         size_t *outBadLine, std::string *outErrorStr)
+  {
+    const char  *ptr = inPtr;
+    const size_t  columnNum = inMap.columnTable.size();
+    const double  colorScale = inMap.isColorFloat ? 255.0 : 1.0;
+    const double  colorRound = inMap.isColorFloat ? 0.5 : 0.0;
+    size_t  line = 0;
+
+    for (size_t index = 0; index < inNum; line++)
+    {
+      const char  *lineEnd = (const char *)memchr(ptr, '\n', inEnd - ptr);
+      if (lineEnd == NULL)
+        lineEnd = inEnd;
+      const char  *pos = ptr;
+      ptr = lineEnd + 1;
+      if (isDataLine(&pos, lineEnd) == false)
+        continue;
+
+      ibc::gl::glXYZf_RGBAub  &out = outData[index++];
+      out.r = 255;
+      out.g = 255;
+      out.b = 255;
+      out.a = 255;
+      for (size_t j = 0; j < columnNum; j++)
+      {
+        double  value;
+        if (inMap.columnTable[j] == COLUMN_TYPE_RGB_FLOAT)
+        {
+          float packed;
+          if (parseFloat(&pos, lineEnd, &packed) == false)
+            return parseError(line, j, outBadLine, outErrorStr);
+          uint32_t  bits;
+          memcpy(&bits, &packed, sizeof(bits));
+          unpackColor(bits, false, &out);
+          continue;
+        }
+        if (parseValue(&pos, lineEnd, &value) == false)
+          return parseError(line, j, outBadLine, outErrorStr);
+        switch (inMap.columnTable[j])
+        {
+          case COLUMN_TYPE_X:
+            out.x = (GLfloat )value;
+            break;
+          case COLUMN_TYPE_Y:
+            out.y = (GLfloat )value;
+            break;
+          case COLUMN_TYPE_Z:
+            out.z = (GLfloat )value;
+            break;
+          case COLUMN_TYPE_R:
+            out.r = qpcvPLYDecoder::clampColor(value * colorScale + colorRound);
+            break;
+          case COLUMN_TYPE_G:
+            out.g = qpcvPLYDecoder::clampColor(value * colorScale + colorRound);
+            break;
+          case COLUMN_TYPE_B:
+            out.b = qpcvPLYDecoder::clampColor(value * colorScale + colorRound);
+            break;
+          case COLUMN_TYPE_A:
+            out.a = qpcvPLYDecoder::clampColor(value * colorScale + colorRound);
+            break;
+          case COLUMN_TYPE_RGB_UINT:
+            unpackColor((uint32_t )value, inMap.hasAlpha, &out);
+            break;
+          default:
+            break;
+        }
+      }
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // unpackColor
+  // ---------------------------------------------------------------------------
+  static void unpackColor(uint32_t inBits, bool inHasAlpha, ibc::gl::glXYZf_RGBAub *outPoint)
+  {
+    outPoint->r = (GLubyte )((inBits >> 16) & 0xFF);
+    outPoint->g = (GLubyte )((inBits >> 8) & 0xFF);
+    outPoint->b = (GLubyte )(inBits & 0xFF);
+    outPoint->a = inHasAlpha ? (GLubyte )(inBits >> 24) : 255;
+  }
+  // ---------------------------------------------------------------------------
+  // isDataLine
+  // ---------------------------------------------------------------------------
+  // Skips the leading separators. false for a blank or a comment line
+  static bool isDataLine(const char **ioPtr, const char *inLineEnd)
+  {
+    skipSeparator(ioPtr, inLineEnd);
+    return (*ioPtr < inLineEnd && **ioPtr != '#');
+  }
+  // ---------------------------------------------------------------------------
+  // parseValue
+  // ---------------------------------------------------------------------------
+  static bool parseValue(const char **ioPtr, const char *inLineEnd, double *outValue)
+  {
+    skipSeparator(ioPtr, inLineEnd);
+    const char  *ptr = *ioPtr;
+    if (ptr < inLineEnd && *ptr == '+')   // std::from_chars() does not accept '+'
+      ptr++;
+    std::from_chars_result  result = std::from_chars(ptr, inLineEnd, *outValue);
+    return checkValue(ioPtr, ptr, inLineEnd, result);
+  }
+  // ---------------------------------------------------------------------------
+  // parseFloat
+  // ---------------------------------------------------------------------------
+  // The packed colors need the exact float (the bits are the color)
+  static bool parseFloat(const char **ioPtr, const char *inLineEnd, float *outValue)
+  {
+    skipSeparator(ioPtr, inLineEnd);
+    const char  *ptr = *ioPtr;
+    if (ptr < inLineEnd && *ptr == '+')
+      ptr++;
+    std::from_chars_result  result = std::from_chars(ptr, inLineEnd, *outValue);
+    return checkValue(ioPtr, ptr, inLineEnd, result);
+  }
+  // ---------------------------------------------------------------------------
+  // checkValue
+  // ---------------------------------------------------------------------------
+  static bool checkValue(const char **ioPtr, const char *inPtr, const char *inLineEnd,
+                         const std::from_chars_result &inResult)
+  {
+    if (inResult.ec != std::errc() || inResult.ptr == inPtr)
+      return false;
+    if (inResult.ptr != inLineEnd && isSeparator(*inResult.ptr) == false)
+      return false;
+    *ioPtr = inResult.ptr;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // skipSeparator
+  // ---------------------------------------------------------------------------
+  static void skipSeparator(const char **ioPtr, const char *inLineEnd)
+  {
+    const char  *ptr = *ioPtr;
+    while (ptr < inLineEnd && isSeparator(*ptr))
+      ptr++;
+    *ioPtr = ptr;
+  }
+  // ---------------------------------------------------------------------------
+  // isSeparator
+  // ---------------------------------------------------------------------------
+  static bool isSeparator(char inChar)
+  {
+    return (inChar == ' ' || inChar == '\t' || inChar == '\r' || inChar == ',');
+  }
+  // ---------------------------------------------------------------------------
+  // parseError
+  // ---------------------------------------------------------------------------
+  static bool parseError(size_t inLine, size_t inColumn, size_t *outBadLine, std::string *outErrorStr)
+  {
+    std::ostringstream  stream;
+    stream << "malformed or missing value in column " << inColumn + 1;
+    *outBadLine = inLine;
+    *outErrorStr = stream.str();
+    return false;
+  }
+};
+
+#endif  // #ifdef QPCV_TEXT_DECODER_H_
@@ -0,0 +1,353 @@
+// =============================================================================
+//  qpcv_thumbnail.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_thumbnail.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Headless batch thumbnail renderer (--thumbnails)
+*/
+
+#ifndef QPCV_THUMBNAIL_H_
+#define QPCV_THUMBNAIL_H_
+
+// Includes --------------------------------------------------------------------
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QImage>
+#include <QPainter>
+#include <QTextStream>
+#include "qpcv_loader.h"
+#include "qpcv_gl_view.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvThumbnail class
+// -----------------------------------------------------------------------------
+// Renders each file of a list into a PNG with an offscreen qpcvGLView, using
+// the same color and backdrop settings as the window. While a file is
+// rendered, the next mPrefetchNum files are already being decoded by their
+// own qpcvLoader threads. Images larger than mTileSize are rendered a tile
+// at a time (see qpcvGLView::setRenderTile()), which keeps the multisampled
+// framebuffer small. One tab separated line per file goes to the log
+class qpcvThumbnail
+{
+public:
+  // Same values as the color modes of mDataModel
+  enum  ColorMode
+  {
+    COLOR_MODE_AUTO   = -1,   // The file colors if any, the color map otherwise
+    COLOR_MODE_SINGLE = 0,
+    COLOR_MODE_MAP,
+    COLOR_MODE_FILE
+  };
+
+  // Constants -----------------------------------------------------------------
+  static const int  DEFAULT_WIDTH = 512;
+  static const int  DEFAULT_HEIGHT = 512;
+  static const int  DEFAULT_TILE_SIZE = 2048;
+  static const int  DEFAULT_PREFETCH_NUM = 1;
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvThumbnail
+  // ---------------------------------------------------------------------------
+  qpcvThumbnail()
+  {
+    mWidth = DEFAULT_WIDTH;
+    mHeight = DEFAULT_HEIGHT;
+    mTileSize = DEFAULT_TILE_SIZE;
+    mPrefetchNum = DEFAULT_PREFETCH_NUM;
+    mDecodeThreadNum = 0;
+    mIsCacheEnabled = false;
+    mColorMode = COLOR_MODE_AUTO;
+    mColorMapAxis = 2;
+    mBackdropMode = qpcvGLView::BACKDROP_COLOR_MODE_SINGLE;
+    mBackColor[0] = 0.3f;   // Same as the window
+    mBackColor[1] = 0.3f;
+    mBackColor[2] = 0.3f;
+  }
+
+  // Member variables ----------------------------------------------------------
+  QStringList mFileList;
+  QString mOutputDir;       // Empty : next to each file
+  QString mLogFileName;     // Empty : stderr
+  int mWidth;
+  int mHeight;
+  int mTileSize;
+  int mPrefetchNum;
+  int mDecodeThreadNum;
+  bool  mIsCacheEnabled;
+  QString mCacheDir;
+  int mColorMode;
+  QString mColorMapName;    // Empty : the default of mDataModel
+  int mColorMapAxis;
+  int mBackdropMode;
+  GLfloat mBackColor[3];
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // parseSize
+  // ---------------------------------------------------------------------------
+  // "512" or "1920x1080"
+  static bool parseSize(const QString &inStr, int *outWidth, int *outHeight)
+  {
+    QStringList list = inStr.toLower().split('x');
+    bool  isOK1 = false, isOK2 = false;
+    if (list.size() == 1)
+    {
+      *outWidth = *outHeight = list[0].toInt(&isOK1);
+      isOK2 = true;
+    }
+    else if (list.size() == 2)
+    {
+      *outWidth = list[0].toInt(&isOK1);
+      *outHeight = list[1].toInt(&isOK2);
+    }
+    return (isOK1 && isOK2 && *outWidth > 0 && *outHeight > 0);
+  }
+  // ---------------------------------------------------------------------------
+  // findColorMode
+  // ---------------------------------------------------------------------------
+  // -2 when unknown
+  static int  findColorMode(const QString &inName)
+  {
+    static const char *nameTable[] = {"auto", "single", "map", "file"};
+    for (int i = 0; i < 4; i++)
+      if (inName.compare(nameTable[i], Qt::CaseInsensitive) == 0)
+        return i - 1;
+    return -2;
+  }
+  // ---------------------------------------------------------------------------
+  // findBackdropMode
+  // ---------------------------------------------------------------------------
+  // -1 when unknown
+  static int  findBackdropMode(const QString &inName)
+  {
+    static const char *nameTable[qpcvGLView::BACKDROP_COLOR_MODE_NUM] =
+      {"single", "blue", "darkBlue", "gray", "darkGray"};
+    for (int i = 0; i < (int )qpcvGLView::BACKDROP_COLOR_MODE_NUM; i++)
+      if (inName.compare(nameTable[i], Qt::CaseInsensitive) == 0)
+        return i;
+    return -1;
+  }
+  // ---------------------------------------------------------------------------
+  // readFileList
+  // ---------------------------------------------------------------------------
+  // One file per line (empty lines and lines starting with '#' are skipped)
+  static bool readFileList(const QString &inFileName, QStringList *outFileList)
+  {
+    QFile file(inFileName);
+    if (file.open(QIODevice::ReadOnly | QIODevice::Text) == false)
+      return false;
+    QTextStream stream(&file);
+    while (stream.atEnd() == false)
+    {
+      QString line = stream.readLine().trimmed();
+      if (line.isEmpty() || line.startsWith('#'))
+        continue;
+      *outFileList << line;
+    }
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  // Returns the process exit code (1 when any of the files failed)
+  int run()
+  {
+    ibc::image::ColorMap::ColorMapIndex colorMapIndex;
+    if (mColorMapName.size() != 0 && findColorMap(mColorMapName, &colorMapIndex) == false)
+    {
+      std::cerr << "Unknown color map " << mColorMapName.toStdString() << std::endl;
+      return 1;
+    }
+    QFile logFile;
+    if (mLogFileName.size() == 0)
+      logFile.open(stderr, QIODevice::WriteOnly | QIODevice::Text);
+    else
+      logFile.setFileName(mLogFileName);
+    if (logFile.isOpen() == false &&
+        logFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text) == false)
+    {
+      std::cerr << "Can't write " << mLogFileName.toStdString() << std::endl;
+      return 1;
+    }
+    QTextStream log(&logFile);
+
+    // The view is at most the tile size. Each tile has its own frustum, so
+    // the image size is not limited by GL_MAX_VIEWPORT_DIMS
+    int viewWidth = std::min(mWidth, mTileSize);
+    int viewHeight = std::min(mHeight, mTileSize);
+    bool  isTiled = (viewWidth < mWidth || viewHeight < mHeight);
+    qpcvGLView  view;
+    view.setAttribute(Qt::WA_DontShowOnScreen);
+    view.resize(viewWidth, viewHeight);
+    view.show();
+    QApplication::processEvents();
+    const GLfloat *topColor, *bottomColor;
+    qpcvGLView::getBackdropColor(mBackdropMode, mBackColor, &topColor, &bottomColor);
+    view.setBackdropColor(topColor, bottomColor);
+    if (mColorMapName.size() != 0)
+      view.mDataModel.setColorMapIndex(colorMapIndex);
+    view.mDataModel.setColorMapAxis(mColorMapAxis);
+
+    log << "file\tpoints\twaitMs\tloadMs\trenderMs\tsaveMs\tresult\n";
+    log.flush();
+    QElapsedTimer totalTimer, timer;
+    totalTimer.start();
+    std::deque<qpcvLoader *>  loaderQueue;
+    int nextIndex = 0;
+    int failNum = 0;
+    for (int i = 0; i < mFileList.size(); i++)
+    {
+      // Keep the loaders of the next files running
+      while (nextIndex < mFileList.size() && nextIndex <= i + mPrefetchNum)
+      {
+        qpcvLoader  *loader = new qpcvLoader(mFileList[nextIndex], mDecodeThreadNum, 0);
+        loader->setCache(mIsCacheEnabled, mCacheDir);
+        loader->start();
+        loaderQueue.push_back(loader);
+        nextIndex++;
+      }
+      qpcvLoader  *loader = loaderQueue.front();
+      loaderQueue.pop_front();
+      timer.start();
+      loader->wait();
+      qint64  waitTime = timer.elapsed();
+      qpcvLoadResult  *result = loader->takeResult();
+      QString errorStr = loader->getErrorStr();
+      delete loader;
+      if (result == NULL)
+      {
+        log << mFileList[i] << "\t0\t" << waitTime << "\t0\t0\t0\t" << "failed: " << errorStr << "\n";
+        log.flush();
+        failNum++;
+        continue;
+      }
+      qint64  loadTime = result->headerTime + result->decodeTime + result->faceTime +
+                         result->boundsTime + result->lodTime + result->histogramTime +
+                         result->cacheTime;
+
+      timer.restart();
+      QImage  image = render(&view, result, isTiled, viewWidth, viewHeight);
+      qint64  renderTime = timer.restart();
+      size_t  pointNum = result->dataNum;
+      delete result;
+
+      QString outFileName = getOutputFileName(mFileList[i]);
+      bool  isSaved = image.save(outFileName, "PNG");
+      qint64  saveTime = timer.elapsed();
+      log << mFileList[i] << "\t" << (qulonglong )pointNum << "\t" << waitTime << "\t"
+          << loadTime << "\t" << renderTime << "\t" << saveTime << "\t";
+      if (isSaved)
+        log << outFileName << "\n";
+      else
+      {
+        log << "failed: can't write " << outFileName << "\n";
+        failNum++;
+      }
+      log.flush();
+    }
+    log << "# " << mFileList.size() << " files (" << failNum << " failed) in "
+        << totalTimer.elapsed() << " ms\n";
+    return (failNum == 0) ? 0 : 1;
+  }
+
+protected:
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // render
+  // ---------------------------------------------------------------------------
+  // Same settings as qpcvWindow::applyLoadResult(): shaded meshes, the file
+  // colors when the file has them and the color map over the data range
+  QImage  render(qpcvGLView *inView, qpcvLoadResult *inResult,
+                 bool inIsTiled, int inViewWidth, int inViewHeight)
+  {
+    inView->setPointData(inResult->data, inResult->dataNum, inResult->lodLevelEndTable);
+    inView->setMeshData(inResult->faceIndex.data(), inResult->faceIndex.size() / 3);
+    if (inView->hasMesh())
+      inView->setRenderMode(qpcvGLView::RENDER_MODE_SHADED);
+    else
+      inView->setRenderMode(qpcvGLView::RENDER_MODE_POINTS);
+    inView->setModelFitParam(inResult->param);
+    bool  hasColor = (inResult->colorFormatStr.size() != 0);
+    int colorMode = mColorMode;
+    if (colorMode == COLOR_MODE_AUTO)
+      colorMode = hasColor ? COLOR_MODE_FILE : COLOR_MODE_MAP;
+    else if (colorMode == COLOR_MODE_FILE && hasColor == false)
+      colorMode = COLOR_MODE_MAP;
+    inView->mDataModel.setColorMode(colorMode);
+    double  from = inResult->minMax[mColorMapAxis * 2];
+    double  to = inResult->minMax[mColorMapAxis * 2 + 1];
+    inView->setColorMapRange(from, to);
+
+    QImage  image;
+    if (inIsTiled == false)
+      image = inView->grabFramebuffer().copy(0, 0, mWidth, mHeight);
+    else
+    {
+      // The last tiles extend past the image (the painter crops them)
+      image = QImage(mWidth, mHeight, QImage::Format_RGB32);
+      QPainter  painter(&image);
+      for (int y = 0; y < mHeight; y += inViewHeight)
+        for (int x = 0; x < mWidth; x += inViewWidth)
+        {
+          inView->setRenderTile(x, y, mWidth, mHeight);
+          painter.drawImage(x, y, inView->grabFramebuffer());
+        }
+      painter.end();
+      inView->clearRenderTile();
+    }
+    inView->setPointData(NULL, 0, std::vector<size_t>());
+    return image;
+  }
+  // ---------------------------------------------------------------------------
+  // getOutputFileName
+  // ---------------------------------------------------------------------------
+  // a.ply -> a.ply.png (a.ply and a.pcd in one directory don't collide)
+  QString getOutputFileName(const QString &inFileName) const
+  {
+    QFileInfo fileInfo(inFileName);
+    QString name = fileInfo.fileName() + ".png";
+    if (mOutputDir.size() == 0)
+      return fileInfo.dir().filePath(name);
+    return QDir(mOutputDir).filePath(name);
+  }
+  // ---------------------------------------------------------------------------
+  // findColorMap
+  // ---------------------------------------------------------------------------
+  static bool findColorMap(const QString &inName, ibc::image::ColorMap::ColorMapIndex *outIndex)
+  {
+    std::vector<std::string>  strTable;
+    std::vector<ibc::image::ColorMap::ColorMapIndex>  indexTable;
+    ibc::image::ColorMap::getColorMapNameTable(&strTable, &indexTable);
+    for (size_t i = 0; i < strTable.size() && i < indexTable.size(); i++)
+      if (inName.compare(QString(strTable[i].c_str()), Qt::CaseInsensitive) == 0)
+      {
+        *outIndex = indexTable[i];
+        return true;
+      }
+    return false;
+  }
+};
+
+#endif  // #ifdef QPCV_THUMBNAIL_H_
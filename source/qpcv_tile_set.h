@@ -0,0 +1,590 @@
+// =============================================================================
+//  qpcv_tile_set.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_tile_set.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Concurrent loading of a tiled (multi-file) data set
+*/
+
+#ifndef QPCV_TILE_SET_H_
+#define QPCV_TILE_SET_H_
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <string.h>
+#include <QObject>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QDir>
+#include <QStringList>
+#include "qpcv_loader.h"
+#include "qpcv_bounds.h"
+#include "qpcv_lod.h"
+#include "qpcv_parallel.h"
+#include "qpcv_histogram.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvTileSet class
+// -----------------------------------------------------------------------------
+// Up to inConcurrentNum qpcvLoader workers run at the same time and the cores
+// are shared between them. Every tile is stored in its own qpcvLOD order, and
+// compose() concatenates the visible tiles level by level, so any prefix of
+// the composed data still covers all the tiles evenly. Inside a level, the
+// blocks of the tile cells go to the cell of the composed data holding their
+// center, so the view still culls the composed data cell by cell. compose()
+// runs on a qpcvTileComposer with the sources taken by getComposeSources().
+class qpcvTileSet : public QObject
+{
+Q_OBJECT
+
+public:
+  enum  TileState
+  {
+    TILE_STATE_PENDING  = 0,
+    TILE_STATE_LOADING,
+    TILE_STATE_LOADED,
+    TILE_STATE_FAILED
+  };
+
+  // A loaded tile as seen by compose()
+  struct ComposeSource
+  {
+    const qpcvLoadResult  *result;
+    bool  isVisible;
+  };
+
+  struct Tile
+  {
+    QString fileName;
+    int   state;
+    bool  isVisible;
+    qpcvLoader  *loader;
+    qpcvLoadResult  *result;
+    QString errorStr;
+  };
+
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvTileSet
+  // ---------------------------------------------------------------------------
+  // inConcurrentNum <= 0 : one loader per 4 cores (at least 2)
+  qpcvTileSet(const QStringList &inFileList, int inConcurrentNum, int inThreadNum,
+              QObject *parent = Q_NULLPTR)
+  : QObject(parent)
+  {
+    int coreNum = QThread::idealThreadCount();
+    if (coreNum < 1)
+      coreNum = 1;
+    if (inThreadNum > 0)
+      coreNum = inThreadNum;
+    mConcurrentNum = inConcurrentNum;
+    if (mConcurrentNum <= 0)
+      mConcurrentNum = std::max(2, coreNum / 4);
+    mDecodeThreadNum = std::max(1, coreNum / mConcurrentNum);
+    mThreadNum = inThreadNum;
+    mIsCacheEnabled = false;
+    mLoadingNum = 0;
+    for (int i = 0; i < inFileList.size(); i++)
+    {
+      Tile  tile;
+      tile.fileName = inFileList[i];
+      tile.state = TILE_STATE_PENDING;
+      tile.isVisible = true;
+      tile.loader = NULL;
+      tile.result = NULL;
+      mTileTable.push_back(tile);
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvTileSet
+  // ---------------------------------------------------------------------------
+  // Running loaders are not waited for (they delete themselves when done)
+  virtual ~qpcvTileSet()
+  {
+    for (size_t i = 0; i < mTileTable.size(); i++)
+    {
+      qpcvLoader  *loader = mTileTable[i].loader;
+      if (loader != NULL)
+      {
+        loader->disconnect(this);
+        loader->requestInterruption();
+        if (loader->isFinished())
+          delete loader;
+        else
+          connect(loader, &QThread::finished, loader, &QObject::deleteLater);
+      }
+      if (mTileTable[i].result != NULL)
+        delete mTileTable[i].result;
+    }
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // findTileFiles
+  // ---------------------------------------------------------------------------
+  // The PLY, PCD and XYZ files in inDirName (sorted by name)
+  static QStringList  findTileFiles(const QString &inDirName)
+  {
+    QDir  dir(inDirName);
+    QStringList fileList;
+    QStringList nameList = dir.entryList(QStringList() << "*.ply" << "*.PLY" << "*.pcd" << "*.PCD"
+                                                       << "*.xyz" << "*.XYZ" << "*.xyzrgb"
+                                                       << "*.ply.gz" << "*.ply.zst",
+                                         QDir::Files, QDir::Name);
+    for (int i = 0; i < nameList.size(); i++)
+      fileList << dir.filePath(nameList[i]);
+    return fileList;
+  }
+  // ---------------------------------------------------------------------------
+  // setCache
+  // ---------------------------------------------------------------------------
+  // Must be called before start()
+  void  setCache(bool inIsEnabled, const QString &inCacheDir)
+  {
+    mIsCacheEnabled = inIsEnabled;
+    mCacheDir = inCacheDir;
+  }
+  // ---------------------------------------------------------------------------
+  // start
+  // ---------------------------------------------------------------------------
+  void  start()
+  {
+    startLoaders();
+  }
+  // ---------------------------------------------------------------------------
+  // getTileNum
+  // ---------------------------------------------------------------------------
+  int getTileNum() const
+  {
+    return (int )mTileTable.size();
+  }
+  // ---------------------------------------------------------------------------
+  // getTile
+  // ---------------------------------------------------------------------------
+  const Tile  &getTile(int inIndex) const
+  {
+    return mTileTable[inIndex];
+  }
+  // ---------------------------------------------------------------------------
+  // getFinishedNum
+  // ---------------------------------------------------------------------------
+  // Loaded or failed
+  int getFinishedNum() const
+  {
+    int num = 0;
+    for (size_t i = 0; i < mTileTable.size(); i++)
+      if (mTileTable[i].state == TILE_STATE_LOADED || mTileTable[i].state == TILE_STATE_FAILED)
+        num++;
+    return num;
+  }
+  // ---------------------------------------------------------------------------
+  // isFinished
+  // ---------------------------------------------------------------------------
+  bool  isFinished() const
+  {
+    return (getFinishedNum() == getTileNum());
+  }
+  // ---------------------------------------------------------------------------
+  // setTileVisible
+  // ---------------------------------------------------------------------------
+  // Takes effect on the next compose()
+  void  setTileVisible(int inIndex, bool inIsVisible)
+  {
+    if (inIndex < 0 || inIndex >= getTileNum())
+      return;
+    mTileTable[inIndex].isVisible = inIsVisible;
+  }
+  // ---------------------------------------------------------------------------
+  // getComposeSources
+  // ---------------------------------------------------------------------------
+  // The loaded tiles. The results stay valid until the tile set is deleted
+  std::vector<ComposeSource>  getComposeSources() const
+  {
+    std::vector<ComposeSource>  sourceTable;
+    for (size_t i = 0; i < mTileTable.size(); i++)
+    {
+      if (mTileTable[i].result == NULL)
+        continue;
+      ComposeSource source;
+      source.result = mTileTable[i].result;
+      source.isVisible = mTileTable[i].isVisible;
+      sourceTable.push_back(source);
+    }
+    return sourceTable;
+  }
+  // ---------------------------------------------------------------------------
+  // compose
+  // ---------------------------------------------------------------------------
+  // Makes one buffer of the visible tiles of inSourceTable (the caller owns
+  // *outData and releases it with delete []). outParam / outMinMax cover all
+  // the sources, so the view does not jump when a tile is hidden. Returns
+  // false when there is no source or when canceled by inProgressFunc
+  static bool compose(const std::vector<ComposeSource> &inSourceTable, int inThreadNum,
+                      ibc::gl::glXYZf_RGBAub **outData, size_t *outNum,
+                      std::vector<size_t> *outLevelEndTable,
+                      GLfloat *outParam, GLfloat *outMinMax,
+                      const qpcvParallel::ProgressFunc &inProgressFunc = qpcvParallel::ProgressFunc())
+  {
+    // Bounds (from the corners of each tile)
+    qpcvBounds  bounds;
+    int loadedNum = 0;
+    for (size_t i = 0; i < inSourceTable.size(); i++)
+    {
+      const qpcvLoadResult  *result = inSourceTable[i].result;
+      if (result->dataNum == 0)
+        continue;
+      for (int j = 0; j < 2; j++)
+      {
+        ibc::gl::glXYZf_RGBAub  corner;
+        corner.x = result->minMax[0 + j];
+        corner.y = result->minMax[2 + j];
+        corner.z = result->minMax[4 + j];
+        corner.r = corner.g = corner.b = corner.a = 255;
+        bounds.add(corner);
+      }
+      loadedNum++;
+    }
+    if (loadedNum == 0)
+      return false;
+    bounds.calcFitParam(outParam, outMinMax);
+
+    // Tile cells of each composed cell (source index, cell)
+    std::vector<std::vector<std::pair<size_t, int> > > memberTable(qpcvLOD::CELL_NUM);
+    for (size_t i = 0; i < inSourceTable.size(); i++)
+    {
+      const qpcvLoadResult  &result = *(inSourceTable[i].result);
+      if (inSourceTable[i].isVisible == false || result.dataNum == 0)
+        continue;
+      int cellNum = std::max(1, qpcvLOD::getCellNum(result.lodLevelEndTable));
+      for (int cell = 0; cell < cellNum; cell++)
+        memberTable[getComposedCell(result, cellNum, cell, outMinMax)].push_back(
+                                                                  std::make_pair(i, cell));
+    }
+
+    // Level by level, cell by cell copy list
+    std::vector<CopyRange>  copyTable;
+    std::vector<size_t> levelEndTable((size_t )qpcvLOD::LEVEL_NUM * qpcvLOD::CELL_NUM, 0);
+    size_t  num = 0;
+    for (int level = 0; level < qpcvLOD::LEVEL_NUM; level++)
+      for (int composedCell = 0; composedCell < qpcvLOD::CELL_NUM; composedCell++)
+      {
+        const std::vector<std::pair<size_t, int> > &members = memberTable[composedCell];
+        for (size_t i = 0; i < members.size(); i++)
+        {
+          const qpcvLoadResult  &result = *(inSourceTable[members[i].first].result);
+          size_t  begin, end;
+          getTileBlockRange(result, level, members[i].second, &begin, &end);
+          if (end <= begin)
+            continue;
+          CopyRange range;
+          range.src = result.data + begin;
+          range.dstIndex = num;
+          range.num = end - begin;
+          copyTable.push_back(range);
+          num += range.num;
+        }
+        levelEndTable[(size_t )level * qpcvLOD::CELL_NUM + composedCell] = num;
+      }
+
+    ibc::gl::glXYZf_RGBAub  *data = NULL;
+    if (num != 0)
+    {
+      data = new ibc::gl::glXYZf_RGBAub[num];
+      int threadNum = qpcvParallel::getThreadNum(inThreadNum, copyTable.size(), 1);
+      bool  isDone = qpcvParallel::forEachRange(
+        copyTable.size(), threadNum, 64,
+        [&](int, size_t inBegin, size_t inEnd)
+        {
+          for (size_t i = inBegin; i < inEnd; i++)
+            memcpy(data + copyTable[i].dstIndex, copyTable[i].src,
+                   copyTable[i].num * sizeof(ibc::gl::glXYZf_RGBAub));
+        },
+        inProgressFunc);
+      if (isDone == false)
+      {
+        delete [] data;
+        return false;
+      }
+    }
+    *outData = data;
+    *outNum = num;
+    *outLevelEndTable = levelEndTable;
+    return true;
+  }
+
+signals:
+  // Emitted when a tile is loaded (or failed to load)
+  void  tileFinished(int inIndex);
+
+protected:
+  struct CopyRange
+  {
+    const ibc::gl::glXYZf_RGBAub  *src;
+    size_t  dstIndex;
+    size_t  num;
+  };
+
+  // Member variables ----------------------------------------------------------
+  std::vector<Tile> mTileTable;
+  int mConcurrentNum;
+  int mDecodeThreadNum;
+  int mThreadNum;
+  int mLoadingNum;
+  bool  mIsCacheEnabled;
+  QString mCacheDir;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // startLoaders
+  // ---------------------------------------------------------------------------
+  void  startLoaders()
+  {
+    for (size_t i = 0; i < mTileTable.size() && mLoadingNum < mConcurrentNum; i++)
+    {
+      Tile  &tile = mTileTable[i];
+      if (tile.state != TILE_STATE_PENDING)
+        continue;
+      // Every tile is put in the LOD order (see compose())
+      tile.loader = new qpcvLoader(tile.fileName, mDecodeThreadNum, 1);
+      tile.loader->setCache(mIsCacheEnabled, mCacheDir);
+      tile.state = TILE_STATE_LOADING;
+      int index = (int )i;
+      connect(tile.loader, &QThread::finished,
+              this,
+              [=]()
+              {
+                loaderFinished(index);
+              });
+      mLoadingNum++;
+      tile.loader->start();
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // loaderFinished
+  // ---------------------------------------------------------------------------
+  void  loaderFinished(int inIndex)
+  {
+    Tile  &tile = mTileTable[inIndex];
+    qpcvLoader  *loader = tile.loader;
+    tile.loader = NULL;
+    mLoadingNum--;
+    tile.result = loader->takeResult();
+    if (tile.result == NULL)
+    {
+      tile.state = TILE_STATE_FAILED;
+      tile.errorStr = loader->getErrorStr();
+    }
+    else
+      tile.state = TILE_STATE_LOADED;
+    loader->deleteLater();
+    startLoaders();
+    emit tileFinished(inIndex);
+  }
+  // ---------------------------------------------------------------------------
+  // getTileBlockRange
+  // ---------------------------------------------------------------------------
+  // A tile without the LOD order is treated as a single block of the level 0
+  static void getTileBlockRange(const qpcvLoadResult &inResult, int inLevel, int inCell,
+                                size_t *outBegin, size_t *outEnd)
+  {
+    const std::vector<size_t> &table = inResult.lodLevelEndTable;
+    if (table.size() == 0)
+    {
+      *outBegin = 0;
+      *outEnd = (inLevel == 0) ? inResult.dataNum : 0;
+      return;
+    }
+    qpcvLOD::getBlockRange(table, inLevel, inCell, outBegin, outEnd);
+  }
+  // ---------------------------------------------------------------------------
+  // getComposedCell
+  // ---------------------------------------------------------------------------
+  // The cell of the composed data (inMinMax) holding the center of the cell
+  // inCell of the tile. The cells are the Morton ordered nodes of the level
+  // qpcvLOD::CELL_DEPTH of the bounds (see qpcvLOD::build())
+  static int  getComposedCell(const qpcvLoadResult &inResult, int inCellNum, int inCell,
+                              const GLfloat *inMinMax)
+  {
+    const int cellDepth = qpcvLOD::CELL_DEPTH;
+    const int cellSize = 1 << cellDepth;
+    int composedCell = 0;
+    for (int i = 0; i < 3; i++)
+    {
+      // Axis i of the cell (x is the highest bit of each level)
+      double  center = 0.5;
+      if (inCellNum == qpcvLOD::CELL_NUM)
+      {
+        int q = 0;
+        for (int level = 0; level < cellDepth; level++)
+          q = (q << 1) | ((inCell >> (3 * (cellDepth - 1 - level) + 2 - i)) & 1);
+        center = (q + 0.5) / cellSize;
+      }
+      double  v = inResult.minMax[i * 2] +
+                  (inResult.minMax[i * 2 + 1] - inResult.minMax[i * 2]) * center;
+      double  range = inMinMax[i * 2 + 1] - inMinMax[i * 2];
+      int composedQ = 0;
+      if (range > 0)
+        composedQ = std::min(cellSize - 1, std::max(0, (int )((v - inMinMax[i * 2]) / range * cellSize)));
+      for (int level = 0; level < cellDepth; level++)
+        composedCell |= ((composedQ >> (cellDepth - 1 - level)) & 1) << (3 * (cellDepth - 1 - level) + 2 - i);
+    }
+    return composedCell;
+  }
+};
+
+// -----------------------------------------------------------------------------
+// qpcvTileComposer class
+// -----------------------------------------------------------------------------
+// Runs qpcvTileSet::compose() (and the histogram of the result when asked)
+// off the GUI thread. The tile set must outlive the composer
+class qpcvTileComposer : public QThread
+{
+Q_OBJECT
+
+public:
+  // Constructors and Destructor -----------------------------------------------
+  // ---------------------------------------------------------------------------
+  // qpcvTileComposer
+  // ---------------------------------------------------------------------------
+  // The loaded tiles and their visibility are taken here
+  qpcvTileComposer(const qpcvTileSet &inTileSet, bool inIsHistogram, int inThreadNum,
+                   QObject *parent = Q_NULLPTR)
+  : QThread(parent)
+  {
+    mSourceTable = inTileSet.getComposeSources();
+    mIsHistogram = inIsHistogram;
+    mThreadNum = inThreadNum;
+    mIsSucceeded = false;
+    mData = NULL;
+    mDataNum = 0;
+    for (int i = 0; i < 4; i++)
+      mParam[i] = 0;
+    for (int i = 0; i < 6; i++)
+      mMinMax[i] = 0;
+    mTime = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // ~qpcvTileComposer
+  // ---------------------------------------------------------------------------
+  virtual ~qpcvTileComposer()
+  {
+    requestInterruption();
+    wait();
+    if (mData != NULL)
+      delete [] mData;
+  }
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // isSucceeded
+  // ---------------------------------------------------------------------------
+  // Only valid after finished() was emitted (false when canceled or when no
+  // tile is loaded)
+  bool  isSucceeded() const
+  {
+    return mIsSucceeded;
+  }
+  // ---------------------------------------------------------------------------
+  // takeData
+  // ---------------------------------------------------------------------------
+  // The caller owns *outData and releases it with delete []
+  void  takeData(ibc::gl::glXYZf_RGBAub **outData, size_t *outNum,
+                 std::vector<size_t> *outLevelEndTable)
+  {
+    *outData = mData;
+    *outNum = mDataNum;
+    *outLevelEndTable = mLevelEndTable;
+    mData = NULL;
+    mDataNum = 0;
+  }
+  // ---------------------------------------------------------------------------
+  // getParam
+  // ---------------------------------------------------------------------------
+  const GLfloat *getParam() const
+  {
+    return mParam;
+  }
+  // ---------------------------------------------------------------------------
+  // getMinMax
+  // ---------------------------------------------------------------------------
+  const GLfloat *getMinMax() const
+  {
+    return mMinMax;
+  }
+  // ---------------------------------------------------------------------------
+  // hasHistogram
+  // ---------------------------------------------------------------------------
+  bool  hasHistogram() const
+  {
+    return mIsHistogram;
+  }
+  // ---------------------------------------------------------------------------
+  // getHistogram
+  // ---------------------------------------------------------------------------
+  const qpcvHistogram &getHistogram() const
+  {
+    return mHistogram;
+  }
+  // ---------------------------------------------------------------------------
+  // getTime
+  // ---------------------------------------------------------------------------
+  qint64  getTime() const
+  {
+    return mTime;
+  }
+
+protected:
+  // Member variables ----------------------------------------------------------
+  std::vector<qpcvTileSet::ComposeSource> mSourceTable;
+  bool  mIsHistogram;
+  int mThreadNum;
+  bool  mIsSucceeded;
+  ibc::gl::glXYZf_RGBAub  *mData;
+  size_t  mDataNum;
+  std::vector<size_t> mLevelEndTable;
+  GLfloat mParam[4];
+  GLfloat mMinMax[6];
+  qpcvHistogram mHistogram;
+  qint64  mTime;
+
+  // ---------------------------------------------------------------------------
+  // run
+  // ---------------------------------------------------------------------------
+  virtual void  run()
+  {
+    QElapsedTimer timer;
+    timer.start();
+    qpcvParallel::ProgressFunc  progressFunc =
+      [&](size_t)
+      {
+        return !isInterruptionRequested();
+      };
+    if (qpcvTileSet::compose(mSourceTable, mThreadNum, &mData, &mDataNum, &mLevelEndTable,
+                             mParam, mMinMax, progressFunc) == false)
+      return;
+    if (mIsHistogram &&
+        qpcvHistogram::calcParallel(mData, mDataNum, mMinMax, mThreadNum,
+                                    &mHistogram, progressFunc) == false)
+      return;
+    mTime = timer.elapsed();
+    mIsSucceeded = true;
+  }
+};
+
+#endif  // #ifdef QPCV_TILE_SET_H_
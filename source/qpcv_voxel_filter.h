@@ -0,0 +1,368 @@
+// =============================================================================
+//  qpcv_voxel_filter.h
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     qpcv_voxel_filter.h
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    Voxel grid downsampling
+*/
+
+#ifndef QPCV_VOXEL_FILTER_H_
+#define QPCV_VOXEL_FILTER_H_
+
+// Includes --------------------------------------------------------------------
+#include <string>
+#include <vector>
+#include <functional>
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include "qpcv_parallel.h"
+// ibc related includes
+#include "ibc/gl/data.h"
+
+// -----------------------------------------------------------------------------
+// qpcvVoxelFilter class
+// -----------------------------------------------------------------------------
+// The voxel keys are hashed into PARTITION_NUM partitions first (a counting
+// sort with per-thread cursors), then every partition is reduced with its own
+// open addressing table by one thread. No locks and no shared table.
+// The output is in the order of the first point of each voxel inside each
+// partition, so it does not depend on the number of threads.
+class qpcvVoxelFilter
+{
+public:
+  enum  Mode
+  {
+    MODE_CENTROID = 0,  // Mean position and color of the voxel
+    MODE_FIRST,         // The first point of the voxel (as is)
+    MODE_NUM
+  };
+
+  // Called with the number of processed points. Return false to cancel
+  typedef std::function<bool(size_t inDoneNum, size_t inTotalNum)> ProgressFunc;
+
+  // Constants -----------------------------------------------------------------
+  static const int  PARTITION_BITS = 8;
+  static const int  PARTITION_NUM = 1 << PARTITION_BITS;
+  static const int  KEY_BITS = 21;    // Voxels per axis: 2^21
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getModeName
+  // ---------------------------------------------------------------------------
+  static const char *getModeName(int inMode)
+  {
+    static const char *nameTable[MODE_NUM] =
+    {
+      "Centroid", "First point"
+    };
+    if (inMode < 0 || inMode >= MODE_NUM)
+      return "";
+    return nameTable[inMode];
+  }
+  // ---------------------------------------------------------------------------
+  // downsample
+  // ---------------------------------------------------------------------------
+  // *outData is allocated with new [] (the caller releases it). NaN points are
+  // dropped. Returns false on cancel or error (outErrorStr is set on error)
+  static bool downsample(const ibc::gl::glXYZf_RGBAub *inData, size_t inNum,
+                         const GLfloat *inMinMax, double inVoxelSize, int inMode,
+                         int inThreadNum,
+                         ibc::gl::glXYZf_RGBAub **outData, size_t *outNum,
+                         std::string *outErrorStr,
+                         const ProgressFunc &inProgressFunc = ProgressFunc())
+  {
+    *outData = NULL;
+    *outNum = 0;
+    if (!(inVoxelSize > 0))
+    {
+      *outErrorStr = "Invalid voxel size";
+      return false;
+    }
+    if (inNum >= 0xFFFFFFFFull)
+    {
+      *outErrorStr = "Too many points";
+      return false;
+    }
+    double  origin[3], scale = 1.0 / inVoxelSize;
+    for (int i = 0; i < 3; i++)
+    {
+      origin[i] = inMinMax[i * 2];
+      if ((inMinMax[i * 2 + 1] - inMinMax[i * 2]) * scale >= (double )(1 << KEY_BITS))
+      {
+        *outErrorStr = "The voxel size is too small for the extent of the data";
+        return false;
+      }
+    }
+    int threadNum = qpcvParallel::getThreadNum(inThreadNum, inNum, 256 * 1024);
+    const size_t  stepNum = 3;
+    auto  progressFunc = [&](size_t inStep, size_t inDoneNum)
+    {
+      return !inProgressFunc ||
+             inProgressFunc((inStep * inNum + inDoneNum) / stepNum, inNum);
+    };
+
+    // Partition sizes of each thread
+    std::vector<size_t> countTable(threadNum * PARTITION_NUM, 0);
+    if (qpcvParallel::forEachRange(
+          inNum, threadNum, 1024 * 1024,
+          [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+          {
+            size_t  *count = &(countTable[inThreadIndex * PARTITION_NUM]);
+            for (size_t i = inBegin; i < inEnd; i++)
+            {
+              uint64_t  key;
+              if (getKey(&(inData[i].x), origin, scale, &key))
+                count[getPartition(key)]++;
+            }
+          },
+          [&](size_t inDoneNum)
+          {
+            return progressFunc(0, inDoneNum);
+          }) == false)
+      return false;
+
+    // Partition major, then thread (so each partition stays in the point order)
+    std::vector<size_t> partStartTable(PARTITION_NUM + 1);
+    size_t  offset = 0;
+    for (int p = 0; p < PARTITION_NUM; p++)
+    {
+      partStartTable[p] = offset;
+      for (int i = 0; i < threadNum; i++)
+      {
+        size_t  count = countTable[i * PARTITION_NUM + p];
+        countTable[i * PARTITION_NUM + p] = offset;
+        offset += count;
+      }
+    }
+    partStartTable[PARTITION_NUM] = offset;
+    std::vector<uint64_t> partKey(offset);
+    std::vector<uint32_t> partIndex(offset);
+    if (qpcvParallel::forEachRange(
+          inNum, threadNum, 1024 * 1024,
+          [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+          {
+            size_t  *cursor = &(countTable[inThreadIndex * PARTITION_NUM]);
+            for (size_t i = inBegin; i < inEnd; i++)
+            {
+              uint64_t  key;
+              if (getKey(&(inData[i].x), origin, scale, &key) == false)
+                continue;
+              size_t  pos = cursor[getPartition(key)]++;
+              partKey[pos] = key;
+              partIndex[pos] = (uint32_t )i;
+            }
+          },
+          [&](size_t inDoneNum)
+          {
+            return progressFunc(1, inDoneNum);
+          }) == false)
+      return false;
+
+    // Reduce each partition
+    std::vector<std::vector<ibc::gl::glXYZf_RGBAub> > resultTable(PARTITION_NUM);
+    int partThreadNum = qpcvParallel::getThreadNum(threadNum, PARTITION_NUM, 1);
+    std::vector<Reducer>  reducerTable(partThreadNum);
+    if (qpcvParallel::forEachRange(
+          PARTITION_NUM, partThreadNum, 1,
+          [&](int inThreadIndex, size_t inBegin, size_t inEnd)
+          {
+            for (size_t p = inBegin; p < inEnd; p++)
+            {
+              size_t  begin = partStartTable[p];
+              reducerTable[inThreadIndex].reduce(
+                inData, partKey.data() + begin, partIndex.data() + begin,
+                partStartTable[p + 1] - begin, inMode, &(resultTable[p]));
+            }
+          },
+          [&](size_t inDoneNum)
+          {
+            return progressFunc(2, inNum * inDoneNum / PARTITION_NUM);
+          }) == false)
+      return false;
+    partKey = std::vector<uint64_t>();
+    partIndex = std::vector<uint32_t>();
+
+    // Concatenate
+    std::vector<size_t> resultStartTable(PARTITION_NUM + 1);
+    size_t  num = 0;
+    for (int p = 0; p < PARTITION_NUM; p++)
+    {
+      resultStartTable[p] = num;
+      num += resultTable[p].size();
+    }
+    ibc::gl::glXYZf_RGBAub  *data = new (std::nothrow) ibc::gl::glXYZf_RGBAub[num == 0 ? 1 : num];
+    if (data == NULL)
+    {
+      *outErrorStr = "Out of memory";
+      return false;
+    }
+    qpcvParallel::forEachRange(
+      PARTITION_NUM, partThreadNum, 1,
+      [&](int, size_t inBegin, size_t inEnd)
+      {
+        for (size_t p = inBegin; p < inEnd; p++)
+          if (resultTable[p].size() != 0)
+            memcpy(data + resultStartTable[p], resultTable[p].data(),
+                   resultTable[p].size() * sizeof(ibc::gl::glXYZf_RGBAub));
+      });
+    *outData = data;
+    *outNum = num;
+    if (inProgressFunc)
+      inProgressFunc(inNum, inNum);
+    return true;
+  }
+
+protected:
+  // ---------------------------------------------------------------------------
+  // Reducer class
+  // ---------------------------------------------------------------------------
+  // The table and the sums are kept between the partitions of a thread
+  class Reducer
+  {
+  public:
+    void  reduce(const ibc::gl::glXYZf_RGBAub *inData,
+                 const uint64_t *inKey, const uint32_t *inIndex, size_t inNum,
+                 int inMode, std::vector<ibc::gl::glXYZf_RGBAub> *outResult)
+    {
+      size_t  tableSize = 16;
+      while (tableSize < inNum * 2)
+        tableSize *= 2;
+      mTable.assign(tableSize, (uint32_t )EMPTY);
+      mKey.clear();
+      mFirst.clear();
+      mSum.clear();
+      size_t  mask = tableSize - 1;
+      for (size_t i = 0; i < inNum; i++)
+      {
+        uint64_t  key = inKey[i];
+        size_t  pos = (size_t )(getHash(key) & mask);
+        uint32_t  voxel;
+        while (true)
+        {
+          voxel = mTable[pos];
+          if (voxel == EMPTY)
+          {
+            voxel = (uint32_t )mKey.size();
+            mTable[pos] = voxel;
+            mKey.push_back(key);
+            mFirst.push_back(inIndex[i]);
+            if (inMode == MODE_CENTROID)
+              mSum.push_back(Sum());
+            break;
+          }
+          if (mKey[voxel] == key)
+            break;
+          pos = (pos + 1) & mask;
+        }
+        if (inMode == MODE_CENTROID)
+          mSum[voxel].add(inData[inIndex[i]]);
+      }
+      outResult->resize(mKey.size());
+      for (size_t i = 0; i < mKey.size(); i++)
+      {
+        if (inMode == MODE_CENTROID)
+          mSum[i].get(&((*outResult)[i]));
+        else
+          (*outResult)[i] = inData[mFirst[i]];
+      }
+    }
+
+  protected:
+    static const uint32_t EMPTY = 0xFFFFFFFF;
+
+    struct Sum
+    {
+      Sum()
+      {
+        x = y = z = 0;
+        r = g = b = a = 0;
+        num = 0;
+      }
+      void  add(const ibc::gl::glXYZf_RGBAub &inPoint)
+      {
+        x += inPoint.x;
+        y += inPoint.y;
+        z += inPoint.z;
+        r += inPoint.r;
+        g += inPoint.g;
+        b += inPoint.b;
+        a += inPoint.a;
+        num++;
+      }
+      void  get(ibc::gl::glXYZf_RGBAub *outPoint) const
+      {
+        outPoint->x = (GLfloat )(x / num);
+        outPoint->y = (GLfloat )(y / num);
+        outPoint->z = (GLfloat )(z / num);
+        outPoint->r = (GLubyte )((r + num / 2) / num);
+        outPoint->g = (GLubyte )((g + num / 2) / num);
+        outPoint->b = (GLubyte )((b + num / 2) / num);
+        outPoint->a = (GLubyte )((a + num / 2) / num);
+      }
+      double  x, y, z;
+      uint64_t  r, g, b, a;
+      uint64_t  num;
+    };
+
+    std::vector<uint32_t> mTable;
+    std::vector<uint64_t> mKey;
+    std::vector<uint32_t> mFirst;
+    std::vector<Sum>  mSum;
+  };
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getKey
+  // ---------------------------------------------------------------------------
+  // Returns false for NaN
+  static bool getKey(const GLfloat *inPos, const double *inOrigin, double inScale,
+                     uint64_t *outKey)
+  {
+    uint64_t  key = 0;
+    for (int i = 0; i < 3; i++)
+    {
+      double  d = (inPos[i] - inOrigin[i]) * inScale;
+      if (d != d)
+        return false;
+      uint64_t  v = 0;
+      if (d > 0)
+        v = (d >= (double )((1 << KEY_BITS) - 1)) ? ((1 << KEY_BITS) - 1) : (uint64_t )d;
+      key |= v << (KEY_BITS * i);
+    }
+    *outKey = key;
+    return true;
+  }
+  // ---------------------------------------------------------------------------
+  // getHash
+  // ---------------------------------------------------------------------------
+  static uint64_t getHash(uint64_t inKey)
+  {
+    uint64_t  z = inKey * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+  // ---------------------------------------------------------------------------
+  // getPartition
+  // ---------------------------------------------------------------------------
+  // The top bits of the hash (the table inside a partition uses the low bits)
+  static int  getPartition(uint64_t inKey)
+  {
+    return (int )(getHash(inKey) >> (64 - PARTITION_BITS));
+  }
+};
+
+#endif  // #ifdef QPCV_VOXEL_FILTER_H_
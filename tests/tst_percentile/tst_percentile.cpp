@@ -0,0 +1,152 @@
+// =============================================================================
+//  tst_percentile.cpp
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     tst_percentile.cpp
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    qpcvHistogram percentile ranges against a full sort
+*/
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <math.h>
+#include <QtTest>
+#include "qpcv_histogram.h"
+
+// -----------------------------------------------------------------------------
+// TestPercentile class
+// -----------------------------------------------------------------------------
+// One distribution per axis: x is normal, y is a narrow normal stretched by a
+// few far outliers (the refine passes) and z is skewed. The percentile ranges
+// must match the sorted values to 1e-4 of the range
+class TestPercentile : public QObject
+{
+Q_OBJECT
+
+public:
+  // Constants -----------------------------------------------------------------
+  static const size_t POINT_NUM = 1000000;
+  static const size_t OUTLIER_NUM = 200;
+
+protected:
+  // Member variables ----------------------------------------------------------
+  std::vector<ibc::gl::glXYZf_RGBAub> mData;
+  GLfloat mMinMax[6];
+  qpcvHistogram mHistogram;
+  std::vector<GLfloat>  mSortedTable[3];
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getSortedPercentile
+  // ---------------------------------------------------------------------------
+  double  getSortedPercentile(int inAxis, double inPercent) const
+  {
+    const std::vector<GLfloat>  &table = mSortedTable[inAxis];
+    size_t  index = (size_t )(table.size() * inPercent / 100.0);
+    return table[std::min(index, table.size() - 1)];
+  }
+  // ---------------------------------------------------------------------------
+  // compareRange
+  // ---------------------------------------------------------------------------
+  void  compareRange(int inAxis, double inPercent, double inFrom, double inTo)
+  {
+    double  from = getSortedPercentile(inAxis, inPercent);
+    double  to = getSortedPercentile(inAxis, 100.0 - inPercent);
+    double  tolerance = (to - from) * 1e-4;
+    QVERIFY(to > from);
+    QVERIFY(fabs(inFrom - from) <= tolerance);
+    QVERIFY(fabs(inTo - to) <= tolerance);
+  }
+
+private slots:
+  // ---------------------------------------------------------------------------
+  // initTestCase
+  // ---------------------------------------------------------------------------
+  void  initTestCase()
+  {
+    std::mt19937  random(1234);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::exponential_distribution<float>  exponential(1.0f);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    mData.resize(POINT_NUM);
+    for (size_t i = 0; i < POINT_NUM; i++)
+    {
+      ibc::gl::glXYZf_RGBAub  &p = mData[i];
+      p.x = normal(random);
+      p.y = 5.0f + normal(random) * 0.01f;
+      p.z = exponential(random);
+    }
+    // The raw y range becomes 1e6 times the one of the 1 - 99 % points
+    for (size_t i = 0; i < OUTLIER_NUM; i++)
+      mData[random() % POINT_NUM].y = 5.0f + uniform(random) * 1.0e4f;
+
+    for (int i = 0; i < 6; i++)
+      mMinMax[i] = (i % 2) ? -HUGE_VALF : HUGE_VALF;
+    for (int axis = 0; axis < 3; axis++)
+    {
+      mSortedTable[axis].resize(POINT_NUM);
+      for (size_t i = 0; i < POINT_NUM; i++)
+      {
+        GLfloat v = (&(mData[i].x))[axis];
+        mSortedTable[axis][i] = v;
+        mMinMax[axis * 2] = std::min(mMinMax[axis * 2], v);
+        mMinMax[axis * 2 + 1] = std::max(mMinMax[axis * 2 + 1], v);
+      }
+      std::sort(mSortedTable[axis].begin(), mSortedTable[axis].end());
+    }
+    QVERIFY(qpcvHistogram::calcParallel(mData.data(), mData.size(), mMinMax, 4, &mHistogram));
+    for (int axis = 0; axis < 3; axis++)
+      QCOMPARE(mHistogram.getTotalNum(axis), (uint64_t )POINT_NUM);
+  }
+  // ---------------------------------------------------------------------------
+  // calcPercentileRange
+  // ---------------------------------------------------------------------------
+  void  calcPercentileRange()
+  {
+    const double  percentTable[] = {0.1, 1.0, 5.0, 25.0};
+    for (int axis = 0; axis < 3; axis++)
+      for (double percent : percentTable)
+      {
+        double  from, to;
+        QVERIFY(qpcvHistogram::calcPercentileRange(mData.data(), mData.size(), mHistogram,
+                                                   axis, percent, 100.0 - percent, 4,
+                                                   &from, &to));
+        compareRange(axis, percent, from, to);
+      }
+  }
+  // ---------------------------------------------------------------------------
+  // percentileRangeJob
+  // ---------------------------------------------------------------------------
+  // Without a histogram, the job builds the same one first
+  void  percentileRangeJob()
+  {
+    qpcvPercentileRangeJob  job(mData.data(), mData.size(), NULL, mMinMax, 1,
+                                1.0, 99.0, 4);
+    job.start();
+    QVERIFY(job.wait());
+    QVERIFY(job.isSucceeded());
+    QCOMPARE(job.getAxis(), 1);
+    for (int axis = 0; axis < 3; axis++)
+      QCOMPARE(job.getHistogram().getTotalNum(axis), mHistogram.getTotalNum(axis));
+    double  from, to;
+    job.getRange(&from, &to);
+    compareRange(1, 1.0, from, to);
+  }
+};
+
+QTEST_APPLESS_MAIN(TestPercentile)
+
+#include "tst_percentile.moc"
@@ -0,0 +1,254 @@
+// =============================================================================
+//  tst_spatial_index.cpp
+//
+//  Written in 2019 by Dairoku Sekiguchi (sekiguchi at acm dot org)
+//
+//  To the extent possible under law, the author(s) have dedicated all copyright
+//  and related and neighboring rights to this software to the public domain worldwide.
+//  This software is distributed without any warranty.
+//
+//  You should have received a copy of the CC0 Public Domain Dedication along with
+//  this software. If not, see <http://creativecommons.org/publicdomain/zero/1.0/>.
+// =============================================================================
+/*!
+  \file     tst_spatial_index.cpp
+  \author   Dairoku Sekiguchi
+  \version  1.0.0
+  \date     2019/05/01
+  \brief    qpcvSpatialIndex queries against a brute force scan
+*/
+
+// Includes --------------------------------------------------------------------
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <math.h>
+#include <QtTest>
+#include "qpcv_spatial_index.h"
+
+// -----------------------------------------------------------------------------
+// TestSpatialIndex class
+// -----------------------------------------------------------------------------
+// A clustered cloud (dense and empty cells) with a few points outside of the
+// box given to build(). Every query is compared with a scan of all points
+class TestSpatialIndex : public QObject
+{
+Q_OBJECT
+
+public:
+  // Constants -----------------------------------------------------------------
+  static const size_t POINT_NUM = 200000;
+  static const size_t OUTSIDE_POINT_NUM = 100;
+  static const int    QUERY_NUM = 500;
+  static const int    K_NUM = 8;
+
+protected:
+  // Member variables ----------------------------------------------------------
+  std::vector<ibc::gl::glXYZf_RGBAub> mData;
+  GLfloat mMinMax[6];
+  qpcvSpatialIndex  mIndex;
+  std::mt19937  mRandom;
+
+  // Member functions ----------------------------------------------------------
+  // ---------------------------------------------------------------------------
+  // getRandomPos
+  // ---------------------------------------------------------------------------
+  // A position in or around the box
+  void  getRandomPos(double *outPos)
+  {
+    std::uniform_real_distribution<double>  dist(-0.2, 1.2);
+    for (int i = 0; i < 3; i++)
+      outPos[i] = mMinMax[i * 2] + dist(mRandom) * (mMinMax[i * 2 + 1] - mMinMax[i * 2]);
+  }
+  // ---------------------------------------------------------------------------
+  // getDist2
+  // ---------------------------------------------------------------------------
+  double  getDist2(size_t inIndex, const double *inPos) const
+  {
+    const GLfloat *v = &(mData[inIndex].x);
+    double  d[3] = {v[0] - inPos[0], v[1] - inPos[1], v[2] - inPos[2]};
+    return d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+  }
+  // ---------------------------------------------------------------------------
+  // getRayHit
+  // ---------------------------------------------------------------------------
+  // The same test as qpcvSpatialIndex::pickRay. Returns the ray parameter t,
+  // or -1 when the point is not in the cone
+  double  getRayHit(size_t inIndex, const double *inOrigin, const double *inDir,
+                    double inRadius, double inSlope) const
+  {
+    const GLfloat *v = &(mData[inIndex].x);
+    double  d[3] = {v[0] - inOrigin[0], v[1] - inOrigin[1], v[2] - inOrigin[2]};
+    double  t = d[0] * inDir[0] + d[1] * inDir[1] + d[2] * inDir[2];
+    if (t < 0)
+      return -1;
+    double  dist2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2] - t * t;
+    double  radius = inRadius + t * inSlope;
+    if (dist2 > radius * radius)
+      return -1;
+    return t;
+  }
+
+private slots:
+  // ---------------------------------------------------------------------------
+  // initTestCase
+  // ---------------------------------------------------------------------------
+  void  initTestCase()
+  {
+    mRandom.seed(1234);
+    std::normal_distribution<float> cluster(0.0f, 0.05f);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    mData.resize(POINT_NUM + OUTSIDE_POINT_NUM);
+    for (size_t i = 0; i < POINT_NUM; i++)
+    {
+      ibc::gl::glXYZf_RGBAub  &p = mData[i];
+      if (i % 4 == 0)
+      {
+        p.x = uniform(mRandom);
+        p.y = uniform(mRandom);
+        p.z = uniform(mRandom) * 0.1f;   // A flat axis
+      }
+      else
+      {
+        float center = (float )(i % 3) * 0.4f + 0.1f;
+        p.x = center + cluster(mRandom);
+        p.y = center + cluster(mRandom);
+        p.z = 0.05f + cluster(mRandom) * 0.2f;
+      }
+    }
+    for (int i = 0; i < 6; i++)
+      mMinMax[i] = (i % 2) ? -HUGE_VALF : HUGE_VALF;
+    for (size_t i = 0; i < POINT_NUM; i++)
+    {
+      const GLfloat *v = &(mData[i].x);
+      for (int j = 0; j < 3; j++)
+      {
+        mMinMax[j * 2] = std::min(mMinMax[j * 2], v[j]);
+        mMinMax[j * 2 + 1] = std::max(mMinMax[j * 2 + 1], v[j]);
+      }
+    }
+    // Not in the box of build() (e.g. the data was edited after the bounds)
+    for (size_t i = POINT_NUM; i < mData.size(); i++)
+    {
+      ibc::gl::glXYZf_RGBAub  &p = mData[i];
+      p.x = 1.5f + uniform(mRandom);
+      p.y = -0.5f - uniform(mRandom);
+      p.z = uniform(mRandom);
+    }
+    QVERIFY(mIndex.build(mData.data(), mData.size(), mMinMax, 4));
+    QVERIFY(mIndex.isValid());
+  }
+  // ---------------------------------------------------------------------------
+  // pickRay
+  // ---------------------------------------------------------------------------
+  // Rays from around the box through random points of the cloud
+  void  pickRay()
+  {
+    const double  radius = 0.002;
+    const double  slope = 0.002;
+    int hitNum = 0;
+    for (int q = 0; q < QUERY_NUM; q++)
+    {
+      double  origin[3], dir[3];
+      getRandomPos(origin);
+      origin[2] += 2.0;
+      const GLfloat *target = &(mData[mRandom() % POINT_NUM].x);
+      double  len = 0;
+      for (int i = 0; i < 3; i++)
+      {
+        dir[i] = target[i] - origin[i];
+        len += dir[i] * dir[i];
+      }
+      len = sqrt(len);
+      for (int i = 0; i < 3; i++)
+        dir[i] /= len;
+      if (q % 10 == 0)    // Misses too
+        dir[0] = -dir[0];
+
+      double  bestT = HUGE_VAL;
+      for (size_t i = 0; i < mData.size(); i++)
+      {
+        double  t = getRayHit(i, origin, dir, radius, slope);
+        if (t >= 0 && t < bestT)
+          bestT = t;
+      }
+      size_t  index = (size_t )-1;
+      bool  isFound = mIndex.pickRay(origin, dir, radius, slope, &index);
+      QCOMPARE(isFound, bestT != HUGE_VAL);
+      if (isFound == false)
+        continue;
+      hitNum++;
+      QVERIFY(index < mData.size());
+      QCOMPARE(getRayHit(index, origin, dir, radius, slope), bestT);
+    }
+    QVERIFY(hitNum > QUERY_NUM / 2);
+  }
+  // ---------------------------------------------------------------------------
+  // findNearest
+  // ---------------------------------------------------------------------------
+  void  findNearest()
+  {
+    const double  maxDist = 0.05;
+    for (int q = 0; q < QUERY_NUM; q++)
+    {
+      double  pos[3];
+      getRandomPos(pos);
+      double  best = maxDist * maxDist;
+      bool  isExpected = false;
+      for (size_t i = 0; i < mData.size(); i++)
+      {
+        double  dist2 = getDist2(i, pos);
+        if (dist2 <= best)
+        {
+          best = dist2;
+          isExpected = true;
+        }
+      }
+      size_t  index = (size_t )-1;
+      QCOMPARE(mIndex.findNearest(pos, maxDist, &index), isExpected);
+      if (isExpected)
+        QCOMPARE(getDist2(index, pos), best);
+    }
+  }
+  // ---------------------------------------------------------------------------
+  // findKNearest
+  // ---------------------------------------------------------------------------
+  // Also from the points themselves (skipped) and from outside of the box
+  void  findKNearest()
+  {
+    for (int q = 0; q < QUERY_NUM; q++)
+    {
+      double  pos[3];
+      size_t  skipIndex = (size_t )-1;
+      if (q % 2 == 0)
+      {
+        skipIndex = mRandom() % mData.size();
+        for (int i = 0; i < 3; i++)
+          pos[i] = (&(mData[skipIndex].x))[i];
+      }
+      else
+        getRandomPos(pos);
+
+      std::vector<double> expected;
+      expected.reserve(mData.size());
+      for (size_t i = 0; i < mData.size(); i++)
+        if (i != skipIndex)
+          expected.push_back(getDist2(i, pos));
+      std::partial_sort(expected.begin(), expected.begin() + K_NUM, expected.end());
+
+      double  dist2[K_NUM];
+      size_t  index[K_NUM];
+      QCOMPARE(mIndex.findKNearest(pos, K_NUM, skipIndex, dist2, index), K_NUM);
+      for (int k = 0; k < K_NUM; k++)
+      {
+        QVERIFY(index[k] != skipIndex);
+        QCOMPARE(dist2[k], expected[k]);
+        QCOMPARE(getDist2(index[k], pos), dist2[k]);
+      }
+    }
+  }
+};
+
+QTEST_APPLESS_MAIN(TestSpatialIndex)
+
+#include "tst_spatial_index.moc"
@@ -0,0 +1,17 @@
+QT += core gui testlib
+
+TARGET = tst_spatial_index
+CONFIG += console testcase c++17
+CONFIG -= app_bundle
+TEMPLATE = app
+
+INCLUDEPATH += \
+  ../../../libibc/include \
+  ../../source
+
+HEADERS += \
+  ../../source/qpcv_parallel.h \
+  ../../source/qpcv_spatial_index.h
+
+SOURCES += \
+  tst_spatial_index.cpp